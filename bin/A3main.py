@@ -2,10 +2,12 @@
 import os
 import sys
 import ctypes
-from ctypes import c_char_p, POINTER, c_int, c_void_p
+import json
+from ctypes import c_bool, c_char_p, POINTER, c_int, c_void_p
 import mysql.connector
 from mysql.connector import Error
-import datetime
+import cardsync
+from vclib import vc_parser, OK, CardSummary, summary_fingerprint, summarize_cards
 
 from asciimatics.widgets import (
     Frame, ListBox, Layout, Label, Divider, Text, Button, TextBox,
@@ -26,16 +28,21 @@ BASE_DIR = os.path.dirname(os.path.abspath(__file__))
 # Global variable to hold the selected file path between scenes.
 LAST_SELECTED_FILE = None
 
+# Global parse cache of the cards directory, shared by every scene.
+CARD_CACHE = None
+
+# Global watcher of the cards directory, which reports the files that changed.
+CARD_WATCHER = None
+
+# Global contact index of the cards directory, rebuilt from CARD_SUMMARIES when stale.
+CARD_INDEX = None
+CARD_SUMMARIES = {}
+CARD_INDEX_STALE = True
+
 # ------------------------
 # C Library Integration
 # ------------------------
-LIB_PATH = os.path.join(BASE_DIR, "libvcparser.so")
-try:
-    vc_parser = ctypes.CDLL(LIB_PATH)
-except Exception as e:
-    print("Error loading shared library:", e)
-    sys.exit(1)
-
+# The library, CardSummary and summarize_cards come from vclib, which cardsync shares.
 # Setup function prototypes
 vc_parser.createCard.argtypes = [c_char_p, POINTER(c_void_p)]
 vc_parser.createCard.restype = c_int
@@ -46,6 +53,74 @@ vc_parser.deleteCard.restype = None
 vc_parser.cardToString.argtypes = [c_void_p]
 vc_parser.cardToString.restype = c_char_p
 
+# Returned as a raw pointer so that the string can be freed after it is decoded.
+vc_parser.cardToJSON.argtypes = [c_void_p]
+vc_parser.cardToJSON.restype = c_void_p
+
+CARD_ADDED, CARD_CHANGED, CARD_REMOVED = 0, 1, 2
+
+
+class CardChange(ctypes.Structure):
+    """Mirrors the CardChange struct in VCParser.h."""
+    _fields_ = [
+        ("kind", c_int),
+        ("fileName", c_char_p),
+        ("card", c_void_p),
+        ("summary", CardSummary),
+    ]
+
+
+CardChangeCallback = ctypes.CFUNCTYPE(c_bool, POINTER(CardChange), c_void_p)
+
+
+vc_parser.openCardCache.argtypes = [c_char_p]
+vc_parser.openCardCache.restype = c_void_p
+
+vc_parser.createCardCached.argtypes = [c_void_p, c_char_p, POINTER(c_void_p)]
+vc_parser.createCardCached.restype = c_int
+
+vc_parser.closeCardCache.argtypes = [c_void_p]
+vc_parser.closeCardCache.restype = None
+
+vc_parser.openCardWatcher.argtypes = [c_char_p, c_void_p]
+vc_parser.openCardWatcher.restype = c_void_p
+
+vc_parser.pollCardWatcher.argtypes = [c_void_p, c_int, CardChangeCallback, c_void_p]
+vc_parser.pollCardWatcher.restype = c_int
+
+vc_parser.closeCardWatcher.argtypes = [c_void_p]
+vc_parser.closeCardWatcher.restype = None
+
+BIRTHDAY_DATE, ANNIVERSARY_DATE = 0, 1
+
+
+class IndexedCard(ctypes.Structure):
+    """Mirrors the IndexedCard struct in VCParser.h."""
+    _fields_ = [
+        ("fileName", c_char_p),
+        ("fn", c_char_p),
+        ("birthday", c_char_p),
+        ("anniversary", c_char_p),
+    ]
+
+
+IndexedCardCallback = ctypes.CFUNCTYPE(c_bool, POINTER(IndexedCard), c_void_p)
+
+vc_parser.writeCardIndex.argtypes = [c_char_p, POINTER(c_char_p), POINTER(CardSummary), c_int]
+vc_parser.writeCardIndex.restype = c_int
+
+vc_parser.openCardIndex.argtypes = [c_char_p]
+vc_parser.openCardIndex.restype = c_void_p
+
+vc_parser.findCardsByName.argtypes = [c_void_p, c_char_p, IndexedCardCallback, c_void_p]
+vc_parser.findCardsByName.restype = c_int
+
+vc_parser.findCardsByDate.argtypes = [c_void_p, c_int, c_int, c_int, c_int, IndexedCardCallback, c_void_p]
+vc_parser.findCardsByDate.restype = c_int
+
+vc_parser.closeCardIndex.argtypes = [c_void_p]
+vc_parser.closeCardIndex.restype = None
+
 vc_parser.errorToString.argtypes = [c_int]
 vc_parser.errorToString.restype = c_char_p
 
@@ -55,7 +130,46 @@ vc_parser.createEmptyCard.restype = c_void_p
 
 vc_parser.updateFN.argtypes = [c_void_p, c_char_p]
 vc_parser.updateFN.restype = c_int
-OK = 0
+
+# The C library allocates returned strings with malloc.
+libc = ctypes.CDLL(None)
+libc.free.argtypes = [c_void_p]
+libc.free.restype = None
+
+
+def card_to_dict(card_ptr):
+    """Converts a Card to a dict through cardToJSON (see VCParser.h for the layout)."""
+    json_ptr = vc_parser.cardToJSON(card_ptr)
+    if not json_ptr:
+        return None
+    try:
+        return json.loads(ctypes.string_at(json_ptr).decode("utf-8"))
+    finally:
+        libc.free(json_ptr)
+
+
+def load_card(file_path):
+    """
+    Parses a vCard file with the C library and returns it as a dict, or None on error.
+    Through the parse cache, an unchanged file is decoded from its cached binary form.
+    """
+    card_ptr = c_void_p()
+    if CARD_CACHE:
+        ret = vc_parser.createCardCached(CARD_CACHE, file_path.encode("utf-8"), ctypes.byref(card_ptr))
+    else:
+        ret = vc_parser.createCard(file_path.encode("utf-8"), ctypes.byref(card_ptr))
+    if ret != OK:
+        return None
+    try:
+        return card_to_dict(card_ptr)
+    finally:
+        vc_parser.deleteCard(card_ptr)
+
+
+def card_fn(card):
+    """Returns the first FN value of a card dict."""
+    values = card["fn"]["values"] if card and card["fn"] else []
+    return values[0].strip() if values else ""
 
 # ------------------------
 # Database Helper Functions
@@ -69,7 +183,8 @@ def init_db_tables(db_conn):
             file_id INT AUTO_INCREMENT PRIMARY KEY,
             file_name VARCHAR(60) NOT NULL,
             last_modified DATETIME,
-            creation_time DATETIME NOT NULL
+            creation_time DATETIME NOT NULL,
+            INDEX file_name_index (file_name)
         )
     """)
     cursor.execute("""
@@ -86,48 +201,68 @@ def init_db_tables(db_conn):
     cursor.close()
 
 
-def extract_fn_from_card(file_path):
-    """Creates a card using the C library and extracts the FN property."""
-    card_ptr = c_void_p()
-    ret = vc_parser.createCard(file_path.encode("utf-8"), ctypes.byref(card_ptr))
-    if ret != OK:
+def poll_card_changes(watcher):
+    """
+    Returns the changes reported by a directory watcher since the last poll, without
+    waiting, as (kind, file path, CardSummary) tuples, or None if the watcher failed
+    (e.g. its directory was removed).
+    """
+    changes = []
+
+    def on_change(change, user_data):
+        change = change.contents
+        if change.card:
+            vc_parser.deleteCard(change.card)
+        summary = CardSummary.from_buffer_copy(change.summary)
+        changes.append((change.kind, change.fileName.decode("utf-8"), summary))
+        return True
+
+    if vc_parser.pollCardWatcher(watcher, 0, CardChangeCallback(on_change), None) < 0:
         return None
-    card_str_ptr = vc_parser.cardToString(card_ptr)
-    card_str = ctypes.string_at(card_str_ptr).decode("utf-8")
-    vc_parser.deleteCard(card_ptr)
-    for line in card_str.splitlines():
-        if line.startswith("FN:"):
-            return line[3:].strip()
-    return None
+    return changes
 
 
-def update_db_with_card(file_path, db_conn, fn_value):
-    """Inserts or updates the FILE and CONTACT records for the given file."""
-    file_name = os.path.basename(file_path)
-    mod_time = datetime.datetime.fromtimestamp(os.path.getmtime(file_path)).strftime('%Y-%m-%d %H:%M:%S')
-    cursor = db_conn.cursor()
-    cursor.execute("SELECT file_id, last_modified FROM FILE WHERE file_name = %s", (file_name,))
-    result = cursor.fetchone()
-    if result:
-        file_id, last_modified = result
-        if last_modified != mod_time:
-            cursor.execute("UPDATE FILE SET last_modified = %s WHERE file_id = %s", (mod_time, file_id))
-            db_conn.commit()
-        cursor.execute("SELECT contact_id, name FROM CONTACT WHERE file_id = %s", (file_id,))
-        contact = cursor.fetchone()
-        if contact:
-            contact_id, current_name = contact
-            if current_name != fn_value:
-                cursor.execute("UPDATE CONTACT SET name = %s WHERE contact_id = %s", (fn_value, contact_id))
-                db_conn.commit()
-    else:
-        cursor.execute("INSERT INTO FILE (file_name, last_modified, creation_time) VALUES (%s, %s, %s)",
-                       (file_name, mod_time, mod_time))
-        db_conn.commit()
-        file_id = cursor.lastrowid
-        cursor.execute("INSERT INTO CONTACT (name, file_id) VALUES (%s, %s)", (fn_value, file_id))
-        db_conn.commit()
-    cursor.close()
+def card_index():
+    """
+    Returns the contact index of the cards directory, first rewriting it from the summaries
+    of the listed cards if any of them changed since it was written. Returns None if no
+    index can be written.
+    """
+    global CARD_INDEX, CARD_INDEX_STALE
+    if CARD_INDEX and not CARD_INDEX_STALE:
+        return CARD_INDEX
+    index_path = os.path.join(BASE_DIR, "cards", ".vcparser-index")
+    paths = list(CARD_SUMMARIES)
+    count = len(paths)
+    names = (c_char_p * count)(*(path.encode("utf-8") for path in paths))
+    summaries = (CardSummary * count)(*(CARD_SUMMARIES[path] for path in paths))
+    vc_parser.closeCardIndex(CARD_INDEX)
+    CARD_INDEX = None
+    if vc_parser.writeCardIndex(index_path.encode("utf-8"), names, summaries, count) == OK:
+        CARD_INDEX = vc_parser.openCardIndex(index_path.encode("utf-8"))
+        CARD_INDEX_STALE = not CARD_INDEX
+    return CARD_INDEX
+
+
+def query_card_index(find, *args):
+    """
+    Runs an index query (findCardsByName or findCardsByDate) and returns the cards found as
+    (name, birthday, file name) tuples in index order, shaped like CONTACT rows: cards
+    with an empty FN, which get no CONTACT row, are left out, and the birthday is in
+    DB_TIME_FORMAT or None where the DB stores NULL (partial and text dates).
+    """
+    cards = []
+
+    def on_card(card, user_data):
+        card = card.contents
+        name = card.fn.decode("utf-8").strip()
+        if name:
+            cards.append((name, cardsync.vcard_datetime(card.birthday.decode("utf-8")),
+                          os.path.basename(card.fileName.decode("utf-8"))))
+        return True
+
+    find(*args, IndexedCardCallback(on_card), None)
+    return cards
 
 
 def update_db_for_file(file_path, new_fn, db_conn):
@@ -145,7 +280,9 @@ def update_db_for_file(file_path, new_fn, db_conn):
 
 def insert_db_for_new_file(file_path, contact, db_conn):
     """Inserts a new FILE and CONTACT record for a new vCard file."""
-    update_db_with_card(file_path, db_conn, contact)
+    if db_conn:
+        row = cardsync.CardRow(os.path.basename(file_path), cardsync.file_time(file_path), contact, None, None)
+        cardsync.sync_cards(db_conn, [row])
 
 
 # ------------------------
@@ -206,21 +343,20 @@ def parseDateTime(dt_str):
             # text
             return dt_str
 
-def parseCardDetails(card_str):
+def formatCardDateTime(dt):
     """
-    Extract BDAY and ANNIVERSARY lines from card_str, returning nicely formatted strings.
+    Formats a DateTime dict from cardToJSON for display, as parseDateTime does for raw text.
     """
-    bdayVal = ""
-    annivVal = ""
-    for line in card_str.splitlines():
-        line = line.strip()
-        if line.startswith("BDAY:"):
-            raw = line[5:].strip()
-            bdayVal = parseDateTime(raw)
-        elif line.startswith("ANNIVERSARY:"):
-            raw = line[12:].strip()
-            annivVal = parseDateTime(raw)
-    return (bdayVal, annivVal)
+    if not dt:
+        return ""
+    if dt["isText"]:
+        return dt["text"]
+    raw = dt["date"]
+    if dt["time"] or not dt["date"]:
+        raw += "T" + dt["time"]
+    if dt["UTC"] and not raw.endswith("Z"):
+        raw += "Z"
+    return parseDateTime(raw)
 
 # ------------------------
 # UI Classes (Asciimatics)
@@ -279,7 +415,8 @@ class MainFrame(Frame):
                                         can_scroll=False,
                                         title="vCard List")
         self.db_conn = DB_CONN
-        self.vcard_files = []
+        self.vcard_files = {}
+        self.synced_conn = None
         layout = Layout([100])
         self.add_layout(layout)
         self._listbox = ListBox(
@@ -300,26 +437,85 @@ class MainFrame(Frame):
         self.refresh_file_list()
 
     def refresh_file_list(self):
+        """
+        Lists the valid cards and syncs them to the DB. The first refresh, and the first one
+        after logging in, scans the whole directory; later ones only apply the changes
+        reported by the directory watcher.
+        """
         self.db_conn = DB_CONN
-        self.vcard_files = []
-        items = []
         cards_dir = os.path.join(BASE_DIR, "cards")
-        if os.path.isdir(cards_dir):
-            for f in os.listdir(cards_dir):
-                if f.lower().endswith((".vcf", ".vcard")):
-                    file_path = os.path.join(cards_dir, f)
-                    card_ptr = c_void_p()
-                    ret = vc_parser.createCard(file_path.encode("utf-8"), ctypes.byref(card_ptr))
-                    if ret == OK:
-                        if self.db_conn:
-                            fn_value = extract_fn_from_card(file_path)
-                            if fn_value:
-                                update_db_with_card(file_path, self.db_conn, fn_value)
-                        self.vcard_files.append(file_path)
-                        items.append((f, f))
-                        vc_parser.deleteCard(card_ptr)
+        global CARD_CACHE, CARD_WATCHER
+        if not os.path.isdir(cards_dir):
+            self.vcard_files = {}
+        elif CARD_WATCHER and self.synced_conn is self.db_conn:
+            changes = poll_card_changes(CARD_WATCHER)
+            if changes is None:
+                # The directory was lost between the check and the poll; rescan next time.
+                self.synced_conn = None
+                return
+            if not changes:
+                return
+            self.apply_card_changes(changes)
+        else:
+            # Watch first, so that no change made during the scan is missed.
+            if not CARD_WATCHER:
+                CARD_WATCHER = vc_parser.openCardWatcher(cards_dir.encode("utf-8"), None)
+            if not CARD_CACHE:
+                CARD_CACHE = vc_parser.openCardCache(cards_dir.encode("utf-8"))
+            self.vcard_files = {}
+            CARD_SUMMARIES.clear()
+            names = [f for f in os.listdir(cards_dir) if f.lower().endswith((".vcf", ".vcard"))]
+            paths = [os.path.join(cards_dir, f) for f in names]
+            summaries = summarize_cards(paths, CARD_CACHE)
+            self.apply_card_changes([(CARD_ADDED, path, summary) for path, summary in zip(paths, summaries)])
+            self.synced_conn = self.db_conn
+
+        selected = self._listbox.value
+        items = [(f, f) for f in sorted(self.vcard_files)]
         self._listbox.options = items if items else [("No valid files", None)]
-        self._listbox.value = items[0][1] if items else None
+        if selected not in self.vcard_files:
+            self._listbox.value = items[0][1] if items else None
+
+    def apply_card_changes(self, changes):
+        """
+        Applies added, changed and removed cards to the file list, then syncs them to the DB
+        in one batch. A changed file whose card has the same fingerprint as before, such as
+        one that was only touched or saved again unchanged, keeps the contact index; its
+        row is still synced so that FILE.last_modified follows the file on disk.
+        """
+        global CARD_INDEX_STALE
+        rows = []
+        removed = []
+        for kind, file_path, summary in changes:
+            f = os.path.basename(file_path)
+            previous = CARD_SUMMARIES.get(file_path)
+            unchanged = (kind == CARD_CHANGED and summary.error == OK and previous is not None
+                         and summary_fingerprint(previous) == summary_fingerprint(summary))
+            if not unchanged:
+                CARD_INDEX_STALE = True
+            if kind == CARD_REMOVED:
+                self.vcard_files.pop(f, None)
+                CARD_SUMMARIES.pop(file_path, None)
+                removed.append(f)
+            elif summary.error == OK:
+                self.vcard_files[f] = file_path
+                CARD_SUMMARIES[file_path] = summary
+                # For an unchanged card, only the file time differs from the DB.
+                if summary.fn.strip():
+                    rows.append(cardsync.card_row(file_path, summary))
+            else:
+                # A card that no longer parses leaves the DB too, as it leaves the list.
+                self.vcard_files.pop(f, None)
+                CARD_SUMMARIES.pop(file_path, None)
+                removed.append(f)
+        if self.db_conn:
+            cardsync.sync_cards(self.db_conn, rows, removed)
+
+    def _update(self, frame_no):
+        # Pick up changes to the cards directory while the list is on screen.
+        if CARD_WATCHER:
+            self.refresh_file_list()
+        super(MainFrame, self)._update(frame_no)
 
     def _view(self):
         file_selected = self._listbox.value
@@ -337,6 +533,15 @@ class MainFrame(Frame):
         raise NextScene("DB")
 
     def _exit(self):
+        global CARD_CACHE, CARD_WATCHER, CARD_INDEX
+        if CARD_CACHE:
+            vc_parser.saveCardCache(CARD_CACHE)
+            vc_parser.closeCardCache(CARD_CACHE)
+            CARD_CACHE = None
+        vc_parser.closeCardWatcher(CARD_WATCHER)
+        CARD_WATCHER = None
+        vc_parser.closeCardIndex(CARD_INDEX)
+        CARD_INDEX = None
         raise StopApplication("User requested exit.")
 
 
@@ -384,7 +589,7 @@ class DetailFrame(Frame):
 
         self.fix()
 
-        self.card_str = ""
+        self.card = None
         self.selected_file = None
 
     def reset(self):
@@ -395,51 +600,21 @@ class DetailFrame(Frame):
             self._file_label.text = f"File: {self.selected_file}"
 
             # Attempt to load the card from disk
-            card_ptr = c_void_p()
-            ret = vc_parser.createCard(self.selected_file.encode("utf-8"), ctypes.byref(card_ptr))
-            if ret == OK:
-                card_str_ptr = vc_parser.cardToString(card_ptr)
-                self.card_str = ctypes.string_at(card_str_ptr).decode("utf-8")
-                vc_parser.deleteCard(card_ptr)
-
-                # Extract FN
-                self._contact.value = self._extractFN(self.card_str)
-
-                # Parse out BDAY and ANNIVERSARY with improved formatting
-                bday, anniv = parseCardDetails(self.card_str)
-                self._bday_label.text = f"Birthday: {bday}"
-                self._anniv_label.text = f"Anniversary: {anniv}"
-
-                # Count "other" lines
-                other_count = self._countOtherProps(self.card_str)
-                self._other_label.text = f"Other properties: {other_count}"
+            card = load_card(self.selected_file)
+            if card is not None:
+                self.card = card
+                self._contact.value = card_fn(card)
+
+                # Format BDAY and ANNIVERSARY from their structured fields
+                self._bday_label.text = f"Birthday: {formatCardDateTime(card['birthday'])}"
+                self._anniv_label.text = f"Anniversary: {formatCardDateTime(card['anniversary'])}"
+
+                self._other_label.text = f"Other properties: {len(card['optionalProperties'])}"
             else:
                 self._file_label.text = "Error loading card."
         else:
             self._file_label.text = "No file selected."
 
-    def _extractFN(self, card_str):
-        for line in card_str.splitlines():
-            if line.startswith("FN:"):
-                return line[3:].strip()
-        return ""
-
-    def _countOtherProps(self, card_str):
-        """
-        Count lines that do not start with FN:, BDAY:, ANNIVERSARY:, VERSION:, BEGIN:, or END:.
-        This is a quick approximation of how many optional properties we have.
-        """
-        skip_prefixes = ("FN:", "BDAY:", "ANNIVERSARY:", "VERSION:", "BEGIN:", "END:")
-        count = 0
-        for line in card_str.splitlines():
-            line = line.strip()
-            if not line:
-                continue
-            if any(line.startswith(pref) for pref in skip_prefixes):
-                continue
-            count += 1
-        return count
-
     def _save(self):
         new_fn = self._contact.value.strip()
         if not new_fn:
@@ -573,16 +748,22 @@ class DBFrame(Frame):
 
     def _query_all(self):
         try:
-            if not self.db_conn:
+            index = card_index()
+            if index:
+                # The index keeps the cards in name order (case and accents ignored, as in
+                # the DB's collation); no DB round trip is needed.
+                rows = query_card_index(vc_parser.findCardsByName, index, b"")
+            elif not self.db_conn:
                 self._query_result.value = "Error: No DB connection."
                 return
-            cursor = self.db_conn.cursor()
-            cursor.execute("""SELECT CONTACT.name, CONTACT.birthday, FILE.file_name
-                              FROM CONTACT
-                              JOIN FILE ON CONTACT.file_id = FILE.file_id
-                              ORDER BY CONTACT.name""")
-            rows = cursor.fetchall()
-            cursor.close()
+            else:
+                cursor = self.db_conn.cursor()
+                cursor.execute("""SELECT CONTACT.name, CONTACT.birthday, FILE.file_name
+                                  FROM CONTACT
+                                  JOIN FILE ON CONTACT.file_id = FILE.file_id
+                                  ORDER BY CONTACT.name""")
+                rows = [(row[0], cardsync.db_time(row[1]), row[2]) for row in cursor.fetchall()]
+                cursor.close()
             
             # Format rows as one line each
             lines = ["All Contacts:\n"]
@@ -590,7 +771,7 @@ class DBFrame(Frame):
                 # row = (name, birthday, file_name)
                 # Convert None or empty to something user-friendly
                 name_str = row[0] if row[0] else "N/A"
-                bday_str = row[1].strftime("%Y-%m-%d %H:%M:%S") if row[1] else ""
+                bday_str = row[1] if row[1] else ""
                 file_str = row[2] if row[2] else "N/A"
                 
                 # Or just do str(row)
@@ -607,21 +788,30 @@ class DBFrame(Frame):
 
     def _query_june(self):
         try:
-            if not self.db_conn:
+            index = card_index()
+            if index:
+                # A range scan of the (month, day) tree instead of MONTH() over every row.
+                # Like the SQL, yearless birthdays (NULL in the DB) are skipped and the
+                # rest are ordered by the whole date rather than by day of the month.
+                rows = [(name, birthday) for name, birthday, _ in
+                        query_card_index(vc_parser.findCardsByDate, index, BIRTHDAY_DATE, 6, 0, 31) if birthday]
+                rows.sort(key=lambda row: row[1])
+            elif not self.db_conn:
                 self._query_result.value = "Error: No DB connection."
                 return
-            cursor = self.db_conn.cursor()
-            cursor.execute("""SELECT name, birthday
-                              FROM CONTACT
-                              WHERE MONTH(birthday) = 6
-                              ORDER BY birthday""")
-            rows = cursor.fetchall()
-            cursor.close()
+            else:
+                cursor = self.db_conn.cursor()
+                cursor.execute("""SELECT name, birthday
+                                  FROM CONTACT
+                                  WHERE MONTH(birthday) = 6
+                                  ORDER BY birthday""")
+                rows = [(row[0], cardsync.db_time(row[1])) for row in cursor.fetchall()]
+                cursor.close()
             
             lines = ["Contacts Born in June:\n"]
             for row in rows:
                 name_str = row[0] if row[0] else "N/A"
-                bday_str = row[1].strftime("%Y-%m-%d %H:%M:%S") if row[1] else ""
+                bday_str = row[1] if row[1] else ""
                 line = f"Name: {name_str}, Birthday: {bday_str}"
                 lines.append(line)
             
@@ -0,0 +1,258 @@
+#!/usr/bin/env python3
+"""
+Batched sync of card summaries into the contact DB.
+
+The C library summarizes many cards per call (summarizeCards, summarizeCardsCached and
+the directory watcher all produce CardSummary records). sync_cards turns those records
+into FILE and CONTACT rows, diffs them against the stored rows with one query per chunk
+of file names, and writes only the differences with multi-row inserts and upserts,
+committing once per batch.
+
+open_local_db creates an SQLite stand-in with the same tables, so the pipeline can be
+run without the MySQL server:
+
+    python3 cardsync.py cards [contacts.db]
+"""
+
+import os
+import sys
+import sqlite3
+import datetime
+from collections import namedtuple
+
+# Rows written per transaction.
+BATCH_SIZE = 10000
+
+DB_TIME_FORMAT = "%Y-%m-%d %H:%M:%S"
+
+# One card file as the DB stores it. The times are DB_TIME_FORMAT strings or None.
+CardRow = namedtuple("CardRow", ["file_name", "last_modified", "name", "birthday", "anniversary"])
+
+# The stored state of one file: its FILE row and its first CONTACT row, if any.
+StoredRow = namedtuple("StoredRow", ["file_id", "last_modified", "creation_time",
+                                     "contact_id", "name", "birthday", "anniversary"])
+
+
+# ------------------------
+# SQL Dialects
+# ------------------------
+
+class Dialect:
+    """The SQL that differs between MySQL and the SQLite stand-in."""
+
+    def __init__(self, placeholder, upsert, update, max_params):
+        self.placeholder = placeholder
+        self.upsert = upsert
+        self.update = update
+        self.max_params = max_params
+
+    def params(self, count):
+        return ", ".join([self.placeholder] * count)
+
+    def upsert_sql(self, table, key, columns, updated):
+        """Multi-row insert of rows by primary key that updates the rows that exist."""
+        assignments = ", ".join(self.update.format(column) for column in updated)
+        return "INSERT INTO {} ({}) VALUES ({}) {}".format(
+            table, ", ".join(columns), self.params(len(columns)),
+            self.upsert.format(key=key, assignments=assignments))
+
+
+MYSQL = Dialect("%s", "ON DUPLICATE KEY UPDATE {assignments}", "{0} = VALUES({0})", 10000)
+SQLITE = Dialect("?", "ON CONFLICT({key}) DO UPDATE SET {assignments}", "{0} = excluded.{0}", 900)
+
+
+def dialect_of(db_conn):
+    return SQLITE if isinstance(db_conn, sqlite3.Connection) else MYSQL
+
+
+def open_local_db(path=":memory:"):
+    """Opens an SQLite stand-in for the contact DB, creating the FILE and CONTACT tables."""
+    db_conn = sqlite3.connect(path)
+    db_conn.execute("PRAGMA foreign_keys = ON")
+    # The UI's queries use MySQL's MONTH on DATETIME columns.
+    db_conn.create_function("MONTH", 1, lambda value: int(value[5:7]) if value else None)
+    db_conn.execute("""
+        CREATE TABLE IF NOT EXISTS FILE (
+            file_id INTEGER PRIMARY KEY AUTOINCREMENT,
+            file_name VARCHAR(60) NOT NULL,
+            last_modified DATETIME,
+            creation_time DATETIME NOT NULL
+        )
+    """)
+    db_conn.execute("CREATE INDEX IF NOT EXISTS file_name_index ON FILE (file_name)")
+    db_conn.execute("""
+        CREATE TABLE IF NOT EXISTS CONTACT (
+            contact_id INTEGER PRIMARY KEY AUTOINCREMENT,
+            name VARCHAR(256) NOT NULL,
+            birthday DATETIME,
+            anniversary DATETIME,
+            file_id INT NOT NULL,
+            FOREIGN KEY (file_id) REFERENCES FILE(file_id) ON DELETE CASCADE
+        )
+    """)
+    # MySQL indexes foreign keys by itself; SQLite needs it spelled out.
+    db_conn.execute("CREATE INDEX IF NOT EXISTS contact_file_index ON CONTACT (file_id)")
+    db_conn.commit()
+    return db_conn
+
+
+# ------------------------
+# Rows
+# ------------------------
+
+def db_time(value):
+    """Normalizes a DATETIME read from either DB to a DB_TIME_FORMAT string."""
+    if isinstance(value, datetime.datetime):
+        return value.strftime(DB_TIME_FORMAT)
+    return str(value)[:19] if value else None
+
+
+def vcard_datetime(text):
+    """
+    Converts a summary date ('19540203', '19540203T123000Z') to DB_TIME_FORMAT.
+    Partial dates such as '--0203' and text dates have no DATETIME form and give None.
+    """
+    if len(text) < 8 or not text[:8].isdigit():
+        return None
+    time = text[9:15] if text[8:9] == "T" else ""
+    if len(time) != 6 or not time.isdigit():
+        time = "000000"
+    try:
+        value = datetime.datetime.strptime(text[:8] + time, "%Y%m%d%H%M%S")
+    except ValueError:
+        return None
+    return value.strftime(DB_TIME_FORMAT)
+
+
+def file_time(file_path):
+    """The modification time of a file in DB_TIME_FORMAT, or None if it is gone."""
+    try:
+        return datetime.datetime.fromtimestamp(int(os.stat(file_path).st_mtime)).strftime(DB_TIME_FORMAT)
+    except OSError:
+        return None
+
+
+def card_row(file_path, summary):
+    """Builds the row of a card file from its CardSummary record."""
+    return CardRow(os.path.basename(file_path), file_time(file_path),
+                   summary.fn.decode("utf-8").strip(),
+                   vcard_datetime(summary.birthday.decode("utf-8")),
+                   vcard_datetime(summary.anniversary.decode("utf-8")))
+
+
+def chunks(items, size):
+    for start in range(0, len(items), size):
+        yield items[start:start + size]
+
+
+# ------------------------
+# Sync
+# ------------------------
+
+def fetch_stored(cursor, dialect, file_names):
+    """Reads the stored state of the given files, one query per chunk of names."""
+    stored = {}
+    for chunk in chunks(list(file_names), dialect.max_params):
+        cursor.execute("""SELECT FILE.file_name, FILE.file_id, FILE.last_modified, FILE.creation_time,
+                                 CONTACT.contact_id, CONTACT.name, CONTACT.birthday, CONTACT.anniversary
+                          FROM FILE LEFT JOIN CONTACT ON CONTACT.file_id = FILE.file_id
+                          WHERE FILE.file_name IN ({})
+                          ORDER BY CONTACT.contact_id""".format(dialect.params(len(chunk))), chunk)
+        for row in cursor.fetchall():
+            if row[0] not in stored:
+                stored[row[0]] = StoredRow(row[1], db_time(row[2]), db_time(row[3]), row[4], row[5],
+                                           db_time(row[6]), db_time(row[7]))
+    return stored
+
+
+def sync_batch(cursor, dialect, rows):
+    """Writes one batch of rows: new files, changed files and changed contacts. Returns the
+    number of files that differed from the DB."""
+    stored = fetch_stored(cursor, dialect, (row.file_name for row in rows))
+    new_rows = [row for row in rows if row.file_name not in stored]
+    file_updates = []
+    contact_updates = []
+    contact_inserts = []
+    changed = len(new_rows)
+    for row in rows:
+        old = stored.get(row.file_name)
+        if not old:
+            continue
+        file_changed = old.last_modified != row.last_modified
+        contact_changed = (old.name, old.birthday, old.anniversary) != (row.name, row.birthday, row.anniversary)
+        if file_changed:
+            file_updates.append((old.file_id, row.file_name, row.last_modified, old.creation_time))
+        if old.contact_id is None:
+            contact_inserts.append((row.name, row.birthday, row.anniversary, old.file_id))
+        elif contact_changed:
+            contact_updates.append((old.contact_id, row.name, row.birthday, row.anniversary, old.file_id))
+        changed += file_changed or contact_changed
+
+    if new_rows:
+        cursor.executemany("INSERT INTO FILE (file_name, last_modified, creation_time) VALUES ({})"
+                           .format(dialect.params(3)),
+                           [(row.file_name, row.last_modified, row.last_modified) for row in new_rows])
+        # Read the new ids back rather than relying on consecutive auto-increment values.
+        new_ids = fetch_stored(cursor, dialect, (row.file_name for row in new_rows))
+        contact_inserts.extend((row.name, row.birthday, row.anniversary, new_ids[row.file_name].file_id)
+                               for row in new_rows)
+    if file_updates:
+        cursor.executemany(dialect.upsert_sql("FILE", "file_id",
+                                              ["file_id", "file_name", "last_modified", "creation_time"],
+                                              ["last_modified"]), file_updates)
+    if contact_updates:
+        cursor.executemany(dialect.upsert_sql("CONTACT", "contact_id",
+                                              ["contact_id", "name", "birthday", "anniversary", "file_id"],
+                                              ["name", "birthday", "anniversary"]), contact_updates)
+    if contact_inserts:
+        cursor.executemany("INSERT INTO CONTACT (name, birthday, anniversary, file_id) VALUES ({})"
+                           .format(dialect.params(4)), contact_inserts)
+    return changed
+
+
+def sync_cards(db_conn, rows, removed=(), batch_size=BATCH_SIZE):
+    """
+    Brings the FILE and CONTACT tables in line with the given card rows and deletes the
+    rows of the removed file names. Each batch is diffed against the DB with one query
+    per chunk of names and written with multi-row statements in one transaction, so
+    unchanged cards cost no writes at all. Returns the number of files written.
+    """
+    dialect = dialect_of(db_conn)
+    cursor = db_conn.cursor()
+    written = 0
+    try:
+        for batch in chunks(list(rows), batch_size):
+            written += sync_batch(cursor, dialect, batch)
+            db_conn.commit()
+        removed = list(removed)
+        for chunk in chunks(removed, dialect.max_params):
+            # CONTACT rows go with their FILE row through ON DELETE CASCADE.
+            cursor.execute("DELETE FROM FILE WHERE file_name IN ({})".format(dialect.params(len(chunk))), chunk)
+        if removed:
+            db_conn.commit()
+            written += len(removed)
+    except Exception:
+        db_conn.rollback()
+        raise
+    finally:
+        cursor.close()
+    return written
+
+
+if __name__ == "__main__":
+    import time
+    import vclib
+
+    if len(sys.argv) < 2:
+        sys.exit("usage: cardsync.py CARDS_DIR [DB_FILE]")
+    cards_dir = sys.argv[1]
+    names = [f for f in os.listdir(cards_dir) if f.lower().endswith((".vcf", ".vcard"))]
+    paths = [os.path.join(cards_dir, f) for f in names]
+    start = time.time()
+    summaries = vclib.summarize_cards(paths)
+    rows = [card_row(path, summary) for path, summary in zip(paths, summaries) if summary.error == vclib.OK]
+    parsed = time.time()
+    db_conn = open_local_db(sys.argv[2] if len(sys.argv) > 2 else ":memory:")
+    written = sync_cards(db_conn, rows)
+    print("{} cards, {} valid, {} written; parse {:.2f}s, sync {:.2f}s".format(
+        len(paths), len(rows), written, parsed - start, time.time() - parsed))
@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""
+Checks of sync_cards against the SQLite stand-in for the contact DB.
+Usage (from the repository root):
+
+    python3 bin/test_cardsync.py
+"""
+
+import os
+import sys
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+import cardsync
+from cardsync import CardRow
+
+
+def card(number, name=None, birthday=None, last_modified="2024-01-01 10:00:00"):
+    return CardRow("card{}.vcf".format(number), last_modified, name or "Person {}".format(number),
+                   birthday, None)
+
+
+class SyncCardsTest(unittest.TestCase):
+
+    def setUp(self):
+        self.db_conn = cardsync.open_local_db()
+        # Small batches so that the diff runs over more than one transaction.
+        self.rows = [card(n, birthday="1990-06-{:02d} 00:00:00".format(n)) for n in range(1, 8)]
+        self.written = cardsync.sync_cards(self.db_conn, self.rows, batch_size=3)
+
+    def tearDown(self):
+        self.db_conn.close()
+
+    def stored(self):
+        return self.db_conn.execute("""SELECT FILE.file_name, FILE.last_modified, FILE.creation_time,
+                                              CONTACT.name, CONTACT.birthday
+                                       FROM FILE JOIN CONTACT ON CONTACT.file_id = FILE.file_id
+                                       ORDER BY FILE.file_name""").fetchall()
+
+    def count(self, table):
+        return self.db_conn.execute("SELECT COUNT(*) FROM " + table).fetchone()[0]
+
+    def test_new_files(self):
+        self.assertEqual(self.written, 7)
+        self.assertEqual(self.count("FILE"), 7)
+        self.assertEqual(self.count("CONTACT"), 7)
+        self.assertEqual(self.stored()[0], ("card1.vcf", "2024-01-01 10:00:00", "2024-01-01 10:00:00",
+                                            "Person 1", "1990-06-01 00:00:00"))
+
+    def test_unchanged_rows_write_nothing(self):
+        changes = self.db_conn.total_changes
+        self.assertEqual(cardsync.sync_cards(self.db_conn, self.rows, batch_size=3), 0)
+        self.assertEqual(self.db_conn.total_changes, changes)
+
+    def test_contact_change(self):
+        rows = list(self.rows)
+        rows[1] = card(2, name="Renamed")
+        rows[4] = card(5, birthday="1985-12-25 00:00:00")
+        changes = self.db_conn.total_changes
+        self.assertEqual(cardsync.sync_cards(self.db_conn, rows, batch_size=3), 2)
+        # One CONTACT upsert per card; the FILE rows are untouched.
+        self.assertEqual(self.db_conn.total_changes - changes, 2)
+        stored = self.stored()
+        self.assertEqual(stored[1][3:], ("Renamed", None))
+        self.assertEqual(stored[4][3:], ("Person 5", "1985-12-25 00:00:00"))
+        self.assertEqual(self.count("CONTACT"), 7)
+
+    def test_last_modified_change(self):
+        rows = list(self.rows)
+        rows[2] = rows[2]._replace(last_modified="2024-02-01 09:30:00")
+        changes = self.db_conn.total_changes
+        self.assertEqual(cardsync.sync_cards(self.db_conn, rows, batch_size=3), 1)
+        self.assertEqual(self.db_conn.total_changes - changes, 1)
+        # The creation time stays that of the first sync.
+        self.assertEqual(self.stored()[2][:3], ("card3.vcf", "2024-02-01 09:30:00", "2024-01-01 10:00:00"))
+
+    def test_removed_cascades_to_contact(self):
+        removed = ["card2.vcf", "card6.vcf"]
+        self.assertEqual(cardsync.sync_cards(self.db_conn, [], removed), 2)
+        self.assertEqual(self.count("FILE"), 5)
+        self.assertEqual(self.count("CONTACT"), 5)
+        names = [row[0] for row in self.stored()]
+        self.assertNotIn("card2.vcf", names)
+        self.assertNotIn("card6.vcf", names)
+
+
+if __name__ == "__main__":
+    unittest.main()
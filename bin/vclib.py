@@ -0,0 +1,73 @@
+"""
+ctypes bindings of libvcparser.so shared by the UI (A3main.py) and the offline sync
+(cardsync.py): the library itself, the CardSummary record and batch summaries.
+Importing this module needs neither the MySQL driver nor asciimatics.
+"""
+
+import os
+import sys
+import ctypes
+from ctypes import c_bool, c_char, c_char_p, POINTER, c_int, c_uint64, c_void_p
+
+LIB_PATH = os.path.join(os.path.dirname(os.path.abspath(__file__)), "libvcparser.so")
+try:
+    vc_parser = ctypes.CDLL(LIB_PATH)
+except Exception as e:
+    print("Error loading shared library:", e)
+    sys.exit(1)
+
+OK = 0
+
+CARD_SUMMARY_FIELD = 256
+
+
+class CardFingerprint(ctypes.Structure):
+    """Mirrors the CardFingerprint struct in VCParser.h."""
+    _fields_ = [
+        ("low", c_uint64),
+        ("high", c_uint64),
+    ]
+
+
+class CardSummary(ctypes.Structure):
+    """Mirrors the CardSummary struct in VCParser.h."""
+    _fields_ = [
+        ("error", c_int),
+        ("propertyCount", c_int),
+        ("truncated", c_bool),
+        ("fn", c_char * CARD_SUMMARY_FIELD),
+        ("birthday", c_char * CARD_SUMMARY_FIELD),
+        ("anniversary", c_char * CARD_SUMMARY_FIELD),
+        ("fingerprint", CardFingerprint),
+    ]
+
+
+vc_parser.summarizeCards.argtypes = [POINTER(c_char_p), c_int, POINTER(CardSummary)]
+vc_parser.summarizeCards.restype = c_int
+
+vc_parser.summarizeCardsCached.argtypes = [c_void_p, POINTER(c_char_p), c_int, POINTER(CardSummary)]
+vc_parser.summarizeCardsCached.restype = c_int
+
+vc_parser.saveCardCache.argtypes = [c_void_p]
+vc_parser.saveCardCache.restype = c_int
+
+
+def summary_fingerprint(summary):
+    """The fingerprint of a CardSummary as one integer."""
+    return summary.fingerprint.high << 64 | summary.fingerprint.low
+
+
+def summarize_cards(file_paths, cache=None):
+    """
+    Parses every file with one call into the C library and returns its CardSummary records.
+    With a parse cache, only the files that changed since the cache was saved are parsed.
+    """
+    count = len(file_paths)
+    names = (c_char_p * count)(*(path.encode("utf-8") for path in file_paths))
+    summaries = (CardSummary * count)()
+    if count and cache:
+        vc_parser.summarizeCardsCached(cache, names, count, summaries)
+        vc_parser.saveCardCache(cache)
+    elif count:
+        vc_parser.summarizeCards(names, count, summaries)
+    return summaries
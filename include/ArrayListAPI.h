@@ -0,0 +1,111 @@
+/**
+ * @file ArrayListAPI.h
+ * @brief File containing the function definitions of a growable array list
+ */
+
+#ifndef _ARRAY_LIST_API_
+#define _ARRAY_LIST_API_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/**
+ * Metadata head of the array list.
+ * The elements are stored as a contiguous array of pointers that grows geometrically,
+ * so iterating over the list walks consecutive memory instead of following node links.
+ * The function pointers have the same meaning as in the List struct of LinkedListAPI.h.
+ **/
+typedef struct arrayListHead{
+    void** elements;
+    int length;
+    int capacity;
+    void (*deleteData)(void* toBeDeleted);
+    int (*compare)(const void* first,const void* second);
+    char* (*printData)(void* toBePrinted);
+} ArrayList;
+
+
+/** Function to initialize the array list metadata head with the appropriate function pointers.
+*@pre function pointer arguments must not be NULL
+*@post ArrayList structure has been allocated and initialized. No element storage is allocated yet.
+*@return On success returns newly allocated ArrayList struct. Returns NULL if malloc fails
+*@param printFunction - function pointer to print a single element of the list
+*@param deleteFunction - function pointer to delete a single piece of data from the list
+*@param compareFunction - function pointer to compare two elements of the list in order to test for equality or order
+**/
+ArrayList* initializeArrayList(char* (*printFunction)(void* toBePrinted),void (*deleteFunction)(void* toBeDeleted),int (*compareFunction)(const void* first,const void* second));
+
+
+/** Makes room for at least capacity elements without changing the contents of the list.
+*@pre ArrayList exists and is valid
+*@return true on success, false if memory allocation fails
+*@param list - a pointer to the ArrayList struct
+*@param capacity - the number of elements the list must be able to hold
+**/
+bool reserveArrayList(ArrayList* list, int capacity);
+
+
+/** Appends an element to the back of an array list, growing its storage if needed.
+*@pre ArrayList exists and is valid. toBeAdded is not NULL.
+*@return true on success, false if an argument is NULL or memory allocation fails
+*@param list - a pointer to the ArrayList struct
+*@param toBeAdded - a pointer to data that is to be added to the list
+**/
+bool appendArrayElement(ArrayList* list, void* toBeAdded);
+
+
+/** Returns a pointer to the data at a position in the list. Does not alter list structure.
+*@pre ArrayList exists and is valid
+*@return pointer to the data at index, or NULL if index is out of range
+*@param list - a pointer to the ArrayList struct
+*@param index - the zero-based position of the element
+**/
+void* getArrayElement(const ArrayList* list, int index);
+
+
+/** Returns the number of elements in the list.
+*@pre ArrayList must exist, but does not have to have elements.
+*@return on success: number of elements in the list (0 or more). on failure: -1
+*@param list - a pointer to the ArrayList struct
+**/
+int getArrayLength(const ArrayList* list);
+
+
+/** Clears the list: frees the data stored in it without deleting the ArrayList struct or its storage.
+*Uses the supplied function pointer to release allocated memory for the data.
+*@post ArrayList struct still exists, list length = 0
+*@param list - a pointer to the ArrayList struct
+**/
+void clearArrayList(ArrayList* list);
+
+
+/** Deletes the entire array list, freeing all memory asssociated with the list, including the list struct itself.
+*Uses the supplied function pointer to release allocated memory for the data.
+*@param list - a pointer to the ArrayList struct
+**/
+void freeArrayList(ArrayList* list);
+
+
+/** Returns a string that contains a string representation of the list traversed from first to last element.
+*Utilizes the list's printData function pointer to create the string.
+*Returned string must be freed by the calling function.
+*@pre ArrayList must exist, but does not have to have elements.
+*@return on success: char * to string representation of list (must be freed after use). on failure: NULL
+*@param list - a pointer to the ArrayList struct
+**/
+char* arrayListToString(const ArrayList* list);
+
+
+/** Function that searches for an element in the list using a comparator function.
+*@pre ArrayList exists and is valid. Comparator function has been provided.
+*@post ArrayList remains unchanged.
+*@return The data of the first element that matches the search criteria. If element is not found, return NULL.
+*@param list - a pointer to the ArrayList struct
+*@param customCompare - a pointer to comparator function for customizing the search
+*@param searchRecord - a pointer to search data, which contains seach criteria
+**/
+void* findArrayElement(const ArrayList* list, bool (*customCompare)(const void* first,const void* second), const void* searchRecord);
+
+#endif
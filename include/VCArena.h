@@ -0,0 +1,60 @@
+/**
+ * @file VCArena.h
+ * @brief Chunked bump allocator used for arena-backed Cards
+ */
+
+#ifndef _VCARENA_H
+#define _VCARENA_H
+
+#include <stddef.h>
+
+/*	One contiguous block of arena memory. Chunks are chained so that the whole
+	arena can be released by walking a handful of blocks.
+*/
+typedef struct arenaChunk {
+	struct arenaChunk*	next;
+	size_t				size;
+	size_t				used;
+} ArenaChunk;
+
+/*	Bump allocator. Allocations are carved out of the newest chunk; when it is full,
+	a new chunk at least twice as large is added, so a card of n bytes needs O(log n) chunks.
+	Individual allocations are never freed - the arena is released as a whole.
+*/
+typedef struct arena {
+	ArenaChunk*	chunks;
+	size_t		nextChunkSize;
+} Arena;
+
+/** Function to create an empty arena.
+ *@post A new arena has been allocated with one chunk of at least initialSize bytes
+ *@return the new arena, or NULL if memory allocation fails
+ *@param initialSize - expected number of bytes the arena will hold
+ **/
+Arena* createArena(size_t initialSize);
+
+/** Function to allocate memory from an arena.
+ *@pre arena is not NULL
+ *@post size bytes, aligned for any type, have been reserved in the arena
+ *@return a pointer to the memory, or NULL if memory allocation fails
+ *@param arena - the arena to allocate from
+		 size - the number of bytes to allocate
+ **/
+void* arenaAlloc(Arena* arena, size_t size);
+
+/** Function to copy a string of known length into an arena, adding a NUL terminator.
+ *@pre arena is not NULL and str holds at least length bytes
+ *@return the copy, or NULL if memory allocation fails
+ *@param arena - the arena to allocate from
+		 str - the characters to copy
+		 length - the number of characters to copy
+ **/
+char* arenaStrndup(Arena* arena, const char* str, size_t length);
+
+/** Function to release an arena and every allocation made from it.
+ *@post All chunks of the arena and the arena itself have been freed
+ *@param arena - the arena to release. May be NULL.
+ **/
+void destroyArena(Arena* arena);
+
+#endif
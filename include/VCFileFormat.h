@@ -0,0 +1,61 @@
+/**
+ * @file VCFileFormat.h
+ * @brief Helpers shared by the on-disk formats: little-endian integers, atomic file
+ *        replacement and the Latin-1 fold of index keys and terms
+ */
+
+#ifndef _VCFILEFORMAT_H
+#define _VCFILEFORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*	Integers are stored little-endian, one byte at a time, so that the formats are the
+	same on every host and can be read at any alignment. They are inline because index
+	lookups decode them in their inner loops.
+*/
+static inline void storeU16(unsigned char* out, uint16_t value)
+{
+	out[0] = (unsigned char)value;
+	out[1] = (unsigned char)(value >> 8);
+}
+
+static inline void storeU32(unsigned char* out, uint32_t value)
+{
+	for (int i = 0; i < 4; i++)
+		out[i] = (unsigned char)(value >> (8 * i));
+}
+
+static inline uint16_t loadU16(const unsigned char* in)
+{
+	return (uint16_t)(in[0] | in[1] << 8);
+}
+
+static inline uint32_t loadU32(const unsigned char* in)
+{
+	return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+/** Function to write a whole file under a temporary name (fileName with ".tmp" appended)
+	and rename it into place, so that readers never see a partly written file and readers
+	that still map the old file are not disturbed.
+ *@post fileName holds head followed by tail, or is unchanged on failure
+ *@return true on success, false if the file cannot be written or memory allocation fails
+ *@param fileName - the file to create or replace
+		 head - the first part of the contents
+		 headLength - the length of head
+		 tail - the second part of the contents, or NULL
+		 tailLength - the length of tail, 0 if it is NULL
+ **/
+bool replaceFile(const char* fileName, const void* head, size_t headLength, const void* tail, size_t tailLength);
+
+/** Function to fold an accented Latin-1 letter to lowercase ASCII, so that names and
+	words sort and match without regard to case or accents.
+ *@return the ASCII letters the UTF-8 character at text folds to (e.g. "e" for "É", "ss"
+		for "ß"), or NULL if it is not a letter of U+00C0 to U+00FF
+ *@param text - the character; two bytes are read only if the first one is 0xC3
+ **/
+const char* foldLatinLetter(const unsigned char* text);
+
+#endif
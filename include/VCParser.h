@@ -2,11 +2,13 @@
 #define _CARDPARSER_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "LinkedListAPI.h"
+#include "ArrayListAPI.h"
 
 typedef enum ers {OK, INV_FILE, INV_CARD, INV_PROP, INV_DT, WRITE_ERROR, OTHER_ERROR } VCardErrorCode;
 
@@ -147,4 +149,884 @@ char* dateToString(void* date);
   **/
  VCardErrorCode validateCard(const Card* obj);
 
-#endif	
+// ************* Assignment 3 functions *************************************
+
+/** Function to create an empty Card object.
+ *@post The Card has an empty optionalProperties list and no FN, birthday or anniversary.
+		FN must be added with updateFN before the Card is valid.
+ *@return the Card, or NULL if memory allocation fails. Must be released with deleteCard.
+ **/
+Card* createEmptyCard(void);
+
+/** Function to set the FN value of a Card.
+ *@pre card was created by createCard, createArenaCard, createEmptyCard or flatCardView
+ *@post The first value of FN is newFN; FN is created if the Card has none. For arena-backed
+		Cards and FlatCard views the value is allocated from the Card's arena, and the old
+		value is reclaimed with the arena.
+ *@return OK on success, INV_PROP if an argument is NULL or newFN is empty, OTHER_ERROR on
+		allocation failure
+ *@param card - the Card to update
+		 newFN - the new contact name
+ **/
+VCardErrorCode updateFN(Card* card, const char* newFN);
+
+// ************* Additional parser functions ********************************
+
+/*	Property names defined by RFC 6350, in the order of its sections.
+	Names are matched exactly (case-sensitively), like the rest of the parser.
+	Unknown names, including X- extensions, map to PROP_OTHER.
+*/
+typedef enum propKind {
+	PROP_OTHER,
+	PROP_BEGIN, PROP_END, PROP_SOURCE, PROP_KIND, PROP_XML,
+	PROP_FN, PROP_N, PROP_NICKNAME, PROP_PHOTO, PROP_BDAY, PROP_ANNIVERSARY, PROP_GENDER,
+	PROP_ADR,
+	PROP_TEL, PROP_EMAIL, PROP_IMPP, PROP_LANG,
+	PROP_TZ, PROP_GEO,
+	PROP_TITLE, PROP_ROLE, PROP_LOGO, PROP_ORG, PROP_MEMBER, PROP_RELATED,
+	PROP_CATEGORIES, PROP_NOTE, PROP_PRODID, PROP_REV, PROP_SOUND, PROP_UID, PROP_CLIENTPIDMAP, PROP_URL, PROP_VERSION,
+	PROP_KEY,
+	PROP_FBURL, PROP_CALADRURI, PROP_CALURI
+} PropertyKind;
+
+/** Function to classify a property name.
+ *@pre name is not NULL
+ *@return the PropertyKind of the name, or PROP_OTHER if it is not an RFC 6350 property.
+		Runs in constant time: one perfect-hash probe and at most one comparison.
+ *@param name - the property name, without its group
+ **/
+PropertyKind propertyKind(const char* name);
+
+/** Function to get the name of a property kind, the inverse of propertyKind.
+ *@return the RFC 6350 property name, or NULL for PROP_OTHER and values outside the enum
+ *@param kind - the property kind
+ **/
+const char* propertyKindName(PropertyKind kind);
+
+/*	Callback invoked once per card by the streaming parser.
+	card is NULL unless err is OK, in which case the callback takes ownership of the Card.
+	cardIndex is the zero-based position of the card in the stream.
+	Return true to continue streaming, or false to stop after this card.
+*/
+typedef bool (*CardStreamCallback)(Card* card, VCardErrorCode err, int cardIndex, void* userData);
+
+/** Function to parse every card of a multi-card vCard file, one card at a time.
+ *@pre fileName is not NULL and has the correct extension. callback is not NULL.
+ *@post callback has been invoked once for each BEGIN:VCARD ... END:VCARD block, in file order.
+		Only the card currently being parsed is held in memory, and an invalid card
+		is reported through the callback without stopping the stream.
+ *@return INV_FILE if the file cannot be read, OTHER_ERROR on allocation failure, OK otherwise
+ *@param fileName - the name of the input file
+		 callback - function receiving each parsed Card or its error code
+		 userData - caller data passed through to the callback
+ **/
+VCardErrorCode parseCardStream(const char* fileName, CardStreamCallback callback, void* userData);
+
+/** Function to create a Card object from vCard text held in memory, e.g. read from a pipe or a database.
+ *@pre buffer is not NULL and holds length bytes of vCard text. It need not be NUL-terminated.
+ *@post buffer has not been modified. On success, obj points to a newly allocated Card.
+ *@return the error code indicating success or the error encountered when parsing the card
+ *@param buffer - the vCard text
+		 length - the number of bytes of vCard text
+		 obj - set to the newly created Card on success
+ **/
+VCardErrorCode createCardFromBuffer(const char* buffer, size_t length, Card** obj);
+
+/** Function to parse every card of a multi-card vCard held in memory, one card at a time.
+ *@pre buffer is not NULL and holds length bytes of vCard text. callback is not NULL.
+ *@post buffer has not been modified. callback has been invoked once for each card, in order.
+ *@return INV_FILE for a NULL buffer or callback, OTHER_ERROR on allocation failure, OK otherwise
+ *@param buffer - the vCard text
+		 length - the number of bytes of vCard text
+		 callback - function receiving each parsed Card or its error code
+		 userData - caller data passed through to the callback
+ **/
+VCardErrorCode parseCardBufferStream(const char* buffer, size_t length, CardStreamCallback callback, void* userData);
+
+/** Function to create an arena-backed Card object from a vCard file.
+ *@pre fileName is not NULL and has the correct extension
+ *@post Same as createCard, except that all memory of the Card comes from a single arena,
+		so deleteCard releases it in O(1) regardless of its size.
+		The Card must be released with deleteCard only, and its contents must not be
+		modified other than through updateFN, since the arena does not own caller-allocated data.
+ *@return the error code indicating success or the error encountered when parsing the card
+ *@param fileName - a string containing the name of the vCard file
+		 obj - a double pointer to a Card struct that needs to be allocated
+ **/
+VCardErrorCode createArenaCard(char* fileName, Card** obj);
+
+// ************* Packed dates ***********************************************
+
+/*	Presence flags of the fields of a PackedDateTime. */
+#define DATE_HAS_YEAR	0x01
+#define DATE_HAS_MONTH	0x02
+#define DATE_HAS_DAY	0x04
+#define DATE_HAS_HOUR	0x08
+#define DATE_HAS_MINUTE	0x10
+#define DATE_HAS_SECOND	0x20
+#define DATE_HAS_ZONE	0x40
+
+/*	A date-and-or-time value (RFC 6350 section 4.3.4) as integers, for sorting and range
+	tests without string comparisons or allocation. Fields that the value does not specify,
+	such as the year of --0612, are zero and their flag is clear.
+*/
+typedef struct packedDateTime {
+	uint16_t	year;
+	uint8_t		month;
+	uint8_t		day;
+	uint8_t		hour;
+	uint8_t		minute;
+	uint8_t		second;
+
+	//DATE_HAS_* flags of the fields that are present
+	uint8_t		fields;
+
+	//Offset from UTC in minutes, if DATE_HAS_ZONE is set. 0 for Z.
+	int16_t		utcOffset;
+} PackedDateTime;
+
+/** Function to parse a date-and-or-time value.
+ *@pre out is not NULL
+ *@post out holds the fields of the value, or is all zero if the value is not valid.
+		Accepts the basic forms of RFC 6350 (including the reduced dates --MMDD, --MM,
+		---DD, YYYY-MM and YYYY, truncated times such as -MMSS, and zones Z and +HHMM)
+		and the extended forms YYYY-MM-DD and HH:MM:SS. Runs in one pass without allocating.
+ *@return OK if the value is a valid date-and-or-time, INV_DT otherwise
+ *@param value - the value, e.g. "19540203", "--0612" or "20090808T143000Z"
+		 out - receives the packed value
+ **/
+VCardErrorCode parseDateAndOrTime(const char* value, PackedDateTime* out);
+
+/** Function to pack the date and time of a DateTime.
+ *@pre out is not NULL
+ *@post out holds the fields of dt, or is all zero if dt is not a valid date-and-or-time
+ *@return OK on success, INV_DT if dt is NULL, a text value or not a valid date-and-or-time
+ *@param dt - the DateTime
+		 out - receives the packed value
+ **/
+VCardErrorCode packDateTime(const DateTime* dt, PackedDateTime* out);
+
+/** Function to order two packed date-and-or-time values.
+ *@return negative, zero or positive as first sorts before, with or after second. Values
+		are ordered by year, month, day, hour, minute and second as written, with absent
+		fields as zero; the zone is not applied. A reduced form sorts before the fuller
+		forms it matches.
+ *@param first - the first value
+		 second - the second value
+ **/
+int comparePackedDateTimes(const PackedDateTime* first, const PackedDateTime* second);
+
+// ************* Serialization *******************************************
+
+/** Function to serialize a Card in vCard file format into a caller-provided buffer.
+ *@pre obj is a valid Card with an FN property
+ *@post Like snprintf: at most capacity bytes are stored, including a terminating NUL.
+		Calling it with buffer NULL and capacity 0 computes the exact size without writing.
+ *@return the full length of the serialized card, excluding the NUL, or 0 if obj is invalid
+ *@param obj - the Card to serialize
+		 buffer - the output buffer, or NULL if capacity is 0
+		 capacity - the size of buffer in bytes
+ **/
+size_t serializeCard(const Card* obj, char* buffer, size_t capacity);
+
+/*	Serialization flag: fold content lines longer than 75 octets (RFC 6350 section 3.2) by
+	inserting CRLF and a space, never inside a UTF-8 sequence.
+*/
+#define VCARD_FOLD_LINES 0x1
+
+/** Function to serialize a Card like serializeCard, with serialization flags.
+ *@pre obj is a valid Card with an FN property
+ *@post Same as serializeCard. The computed size accounts for any folding.
+ *@return the full length of the serialized card, excluding the NUL, or 0 if obj is invalid
+ *@param obj - the Card to serialize
+		 buffer - the output buffer, or NULL if capacity is 0
+		 capacity - the size of buffer in bytes
+		 flags - VCARD_FOLD_LINES, or 0 for unfolded output
+ **/
+size_t serializeCardWithFlags(const Card* obj, char* buffer, size_t capacity, int flags);
+
+/** Function to write a Card to a file like writeCard, with serialization flags.
+ *@pre obj is a valid Card with an FN property
+ *@post The file contains the serialized card, written with a single write call
+ *@return OK on success, WRITE_ERROR on failure
+ *@param fileName - the name of the output file
+		 obj - the Card to write
+		 flags - VCARD_FOLD_LINES, or 0 for unfolded output
+ **/
+VCardErrorCode writeCardWithFlags(const char* fileName, const Card* obj, int flags);
+
+/** Function to serialize a Card in vCard file format into a newly allocated string.
+ *@pre obj is a valid Card with an FN property
+ *@post The string is allocated once, at its exact size. Must be freed by the caller.
+ *@return the vCard text (the same bytes writeCard writes), or NULL if obj is invalid or allocation fails
+ *@param obj - the Card to serialize
+ **/
+char* cardToFileString(const Card* obj);
+
+/** Function to convert a Card into a JSON object mirroring the Card struct:
+	{"fn":Property,"birthday":DateTime|null,"anniversary":DateTime|null,"optionalProperties":[Property...]}
+	where Property is {"group","name","parameters":[{"name","value"}...],"values":[...]}
+	and DateTime is {"UTC","isText","date","time","text"}.
+ *@pre obj is NULL or a valid Card
+ *@post The string is produced in one linear pass into an exactly sized buffer. Must be freed by the caller.
+ *@return the JSON text, "null" if obj is NULL, or NULL if memory allocation fails
+ *@param obj - the Card to convert
+ **/
+char* cardToJSON(const Card* obj);
+
+// ************* Binary card format ***************************************
+
+/*	Version of the binary card format written by writeCardBinary. Encodings of any other
+	version are rejected with INV_CARD.
+	Layout: "VCRD", version byte, flags byte (1 = birthday, 2 = anniversary), two zero
+	bytes, then little-endian u32 counts of properties (FN first), parameters and values,
+	and the u32 total length; then each property as a PropertyKind byte, its name only for
+	PROP_OTHER, its group, a parameter count and name/value pairs, a value count and the
+	values; then the present dates as a flags byte (1 = UTC, 2 = text) and date, time and
+	text. Counts inside properties and string lengths are LEB128 varints, and every
+	string is followed by a NUL.
+*/
+#define CARD_BINARY_VERSION 1
+
+/** Function to encode a Card in binary card format into a caller-provided buffer.
+ *@pre obj is a valid Card with an FN property
+ *@post At most capacity bytes are stored. Calling it with buffer NULL and capacity 0
+		computes the exact size without writing. NULL strings are encoded as empty strings.
+ *@return the full length of the encoding, or 0 if obj is invalid or larger than 4 GiB
+ *@param obj - the Card to encode
+		 buffer - the output buffer, or NULL if capacity is 0
+		 capacity - the size of buffer in bytes
+ **/
+size_t serializeCardBinary(const Card* obj, char* buffer, size_t capacity);
+
+/** Function to write a Card to a file in binary card format.
+ *@pre obj is a valid Card with an FN property
+ *@post The file contains the encoding, written with a single write call
+ *@return OK on success, WRITE_ERROR on failure
+ *@param fileName - the name of the output file
+		 obj - the Card to write
+ **/
+VCardErrorCode writeCardBinary(const char* fileName, const Card* obj);
+
+/** Function to create a Card from an encoding in binary card format held in memory.
+ *@pre buffer holds length bytes. Bytes after the encoding's recorded length are ignored.
+ *@post buffer has not been modified. On success, obj points to an arena-backed Card (see
+		createArenaCard) whose strings point into the arena's copy of the encoding, so
+		loading costs one memcpy plus one small allocation per object.
+ *@return OK on success, INV_CARD if the encoding is malformed or of another version,
+		OTHER_ERROR on allocation failure
+ *@param buffer - the encoding
+		 length - the number of bytes available in buffer
+		 obj - set to the newly created Card on success
+ **/
+VCardErrorCode createCardFromBinary(const char* buffer, size_t length, Card** obj);
+
+/** Function to create a Card from a file in binary card format.
+ *@pre fileName is not NULL
+ *@post Same as createCardFromBinary on the contents of the file
+ *@return OK on success, INV_FILE if the file cannot be read, INV_CARD if it is not a valid
+		encoding, OTHER_ERROR on allocation failure
+ *@param fileName - the name of the input file
+		 obj - set to the newly created Card on success
+ **/
+VCardErrorCode readCardBinary(const char* fileName, Card** obj);
+
+// ************* Fingerprints ***********************************************
+
+/*	128-bit hash of the content of a Card. Two Cards have the same fingerprint when they
+	have the same properties in any order, each with the same name and group (ignoring
+	ASCII case), the same parameters in any order (names ignoring ASCII case) and the same
+	values in order, and the same birthday and anniversary.
+	Fingerprints of different content collide with negligible probability; they are not
+	meant to resist deliberate collisions.
+*/
+typedef struct cardFingerprint {
+	uint64_t	low;
+	uint64_t	high;
+} CardFingerprint;
+
+/** Function to compute the fingerprint of a card.
+ *@pre card is a valid Card
+ *@post card is unchanged. Dates are hashed in their packed form (see packDateTime), so
+		the same date written with a Z or with the UTC flag gives the same fingerprint.
+ *@return OK on success, INV_CARD if an argument is NULL
+ *@param card - the Card
+		 out - receives the fingerprint
+ **/
+VCardErrorCode cardFingerprint(const Card* card, CardFingerprint* out);
+
+// ************* Card summaries *******************************************
+
+#define CARD_SUMMARY_FIELD 256
+
+/*	Fixed-layout record describing one vCard file, filled by summarizeCards.
+	The record holds no pointers, so an array of them can be mapped directly by
+	foreign-function interfaces such as Python ctypes or cffi.
+	The text fields are NUL-terminated UTF-8 and empty when absent. Dates use the same
+	form as dateToString. Text longer than CARD_SUMMARY_FIELD - 1 bytes is cut at a
+	character boundary and truncated is set.
+	fingerprint is the cardFingerprint of the card, so an unchanged card can be told from
+	a changed one by comparing it alone.
+	All fields other than error are zero unless error is OK.
+*/
+typedef struct cardSummary {
+	VCardErrorCode	error;
+	int				propertyCount;
+	bool			truncated;
+	char			fn[CARD_SUMMARY_FIELD];
+	char			birthday[CARD_SUMMARY_FIELD];
+	char			anniversary[CARD_SUMMARY_FIELD];
+	CardFingerprint	fingerprint;
+} CardSummary;
+
+/** Function to parse a batch of vCard files and summarize each one.
+ *@pre summaries has room for count records
+ *@post The files are parsed in parallel, one worker thread per CPU.
+		summaries[i] describes fileNames[i]: error is the result createCard would return,
+		and on success fn is the first FN value, birthday and anniversary are the dates,
+		propertyCount is the number of optional properties and fingerprint is the
+		fingerprint of the card. No memory is retained.
+ *@return the number of files that parsed successfully, or -1 if the arguments are invalid
+ *@param fileNames - the names of the vCard files
+		 count - the number of files
+		 summaries - caller-provided array of count records to fill
+ **/
+int summarizeCards(const char* const* fileNames, int count, CardSummary* summaries);
+
+/*	Options for scanCardDirectory. A zeroed struct selects the defaults.
+	threads is the number of worker threads, or 0 for one per online CPU.
+	useArena builds each Card as createArenaCard does instead of createCard.
+*/
+typedef struct scanOptions {
+	int		threads;
+	bool	useArena;
+} ScanOptions;
+
+/*	Callback invoked once per file by scanCardDirectory.
+	card is NULL unless err is OK, in which case the callback takes ownership of the Card.
+	fileName is the path of the file and is only valid during the call.
+	The callback runs on the worker threads, concurrently for different files and in no
+	particular order, so anything it shares must be thread-safe.
+	Return true to continue scanning, or false to stop once the files in progress finish.
+*/
+typedef bool (*CardScanCallback)(Card* card, VCardErrorCode err, const char* fileName, void* userData);
+
+/** Function to parse every vCard file in a directory in parallel.
+ *@pre dirName is not NULL. callback is not NULL.
+ *@post Every .vcf and .vcard file directly in dirName has been parsed exactly once, on a
+		pool of worker threads that steal work from each other, and reported to callback.
+		Subdirectories are not scanned.
+ *@return INV_FILE if the directory cannot be read, OTHER_ERROR on allocation failure, OK otherwise
+ *@param dirName - the directory to scan
+		 options - the scan options, or NULL for the defaults
+		 callback - function receiving each parsed Card or its error code
+		 userData - caller data passed through to the callback
+ **/
+VCardErrorCode scanCardDirectory(const char* dirName, const ScanOptions* options, CardScanCallback callback, void* userData);
+
+// ************* Parse cache **********************************************
+
+/*	Persistent cache of parsed cards for one card directory, stored in the file
+	.vcparser-cache inside it. Each entry is keyed by the path of a card file and is
+	reused only while the file's inode, size and modification time (in nanoseconds)
+	are unchanged, which a single stat call checks. An entry holds the card's summary
+	and, once the card has been loaded through the cache, its binary encoding. Replacing
+	an entry frees the memory of the old one, so an open cache does not grow as files
+	are edited. A cache file of another version or that is damaged is ignored and rebuilt.
+	A CardCache must not be used by several threads at once.
+*/
+typedef struct cardCache CardCache;
+
+/** Function to open the parse cache of a card directory.
+ *@pre dirName is not NULL
+ *@post The cache file has been loaded if it exists and is valid; otherwise the cache starts empty
+ *@return the cache, or NULL if memory allocation fails. Must be released with closeCardCache.
+ *@param dirName - the card directory
+ **/
+CardCache* openCardCache(const char* dirName);
+
+/** Function to summarize a batch of vCard files like summarizeCards, through a parse cache.
+ *@pre cache was returned by openCardCache. summaries has room for count records.
+ *@post summaries[i] describes fileNames[i], exactly as summarizeCards would fill it.
+		Unchanged files are answered from the cache without being opened; the others are
+		parsed in parallel and their summaries replace the cached ones in memory.
+ *@return the number of files that are valid cards, or -1 if the arguments are invalid
+ *@param cache - the parse cache
+		 fileNames - the names of the vCard files
+		 count - the number of files
+		 summaries - caller-provided array of count records to fill
+ **/
+int summarizeCardsCached(CardCache* cache, const char* const* fileNames, int count, CardSummary* summaries);
+
+/** Function to create a Card like createCard, through a parse cache.
+ *@pre cache was returned by openCardCache
+ *@post An unchanged file whose card is cached is decoded from its binary encoding without
+		being read. Any other file is parsed, and its summary and encoding are cached.
+ *@return the error code createCard would return for the file
+ *@param cache - the parse cache
+		 fileName - the name of the vCard file
+		 obj - set to the new Card on success; it must be released with deleteCard
+ **/
+VCardErrorCode createCardCached(CardCache* cache, const char* fileName, Card** obj);
+
+/** Function to write a parse cache back to its file.
+ *@pre cache was returned by openCardCache
+ *@post The file has been replaced atomically, unless nothing changed. Entries that were
+		not looked up or stored since the cache was opened or last saved are dropped.
+ *@return OK on success, WRITE_ERROR if the file cannot be written, OTHER_ERROR on allocation failure
+ *@param cache - the parse cache
+ **/
+VCardErrorCode saveCardCache(CardCache* cache);
+
+/** Function to release a parse cache without saving it.
+ *@post All memory of the cache has been freed
+ *@param cache - the parse cache. May be NULL.
+ **/
+void closeCardCache(CardCache* cache);
+
+// ************* Directory watcher *****************************************
+
+/*	Watcher of one card directory that reports changes to its card files as a delta
+	stream. It is built on inotify and is only available on Linux; elsewhere
+	openCardWatcher returns NULL. A file counts as modified when a writer closes it,
+	so a file is not parsed while it is still being written.
+	A CardWatcher must not be used by several threads at once.
+*/
+typedef struct cardWatcher CardWatcher;
+
+typedef enum cardChangeKind { CARD_ADDED, CARD_CHANGED, CARD_REMOVED } CardChangeKind;
+
+/*	One change reported by pollCardWatcher.
+	fileName is the path of the card file and is only valid during the callback.
+	For CARD_ADDED and CARD_CHANGED, summary describes the new version of the file as
+	summarizeCards would, and card is NULL unless summary.error is OK, in which case the
+	callback takes ownership of the Card. For CARD_REMOVED, card is NULL and summary is zeroed.
+*/
+typedef struct cardChange {
+	CardChangeKind	kind;
+	const char*		fileName;
+	Card*			card;
+	CardSummary		summary;
+} CardChange;
+
+/*	Callback invoked once per change by pollCardWatcher, on the thread that polls.
+	Return true to continue, or false to stop; the remaining changes are reported by the next poll.
+*/
+typedef bool (*CardChangeCallback)(const CardChange* change, void* userData);
+
+/** Function to start watching a card directory.
+ *@pre dirName is not NULL
+ *@post The card files now in the directory are known to the watcher, so only later changes
+		are reported. Open the watcher before the initial scan so that no change is missed.
+ *@return the watcher, or NULL if the directory cannot be watched. Must be released with closeCardWatcher.
+ *@param dirName - the card directory
+		 options - the options used to parse changed files, or NULL for the defaults
+ **/
+CardWatcher* openCardWatcher(const char* dirName, const ScanOptions* options);
+
+/** Function to get the descriptor that becomes readable when a watched directory changes.
+ *@return the descriptor, for use with poll or select, or -1 for a NULL watcher
+ *@param watcher - the watcher
+ **/
+int cardWatcherDescriptor(const CardWatcher* watcher);
+
+/** Function to report the changes in a watched directory.
+ *@pre watcher was returned by openCardWatcher. callback is not NULL.
+ *@post Each card file created, closed after writing, deleted or moved in or out since the last
+		poll has been examined once. Only files whose inode, size or modification time differ
+		from what was last reported are parsed, in parallel, and reported to callback. A lost
+		inotify event makes the watcher re-examine every file. When the directory is deleted
+		or moved away, the directory now at dirName is watched instead and every file is
+		re-examined, so the files of the old directory are reported removed.
+ *@return the number of changes reported, or -1 on error, including when no directory
+		exists at dirName any more; a later poll succeeds again once it is recreated
+ *@param watcher - the watcher
+		 timeout - the longest time to wait for a change in milliseconds, 0 to return at once, or -1 to wait indefinitely
+		 callback - function receiving each change
+		 userData - caller data passed through to the callback
+ **/
+int pollCardWatcher(CardWatcher* watcher, int timeout, CardChangeCallback callback, void* userData);
+
+/** Function to stop watching a directory.
+ *@post All memory of the watcher has been freed
+ *@param watcher - the watcher. May be NULL.
+ **/
+void closeCardWatcher(CardWatcher* watcher);
+
+// ************* Contact index *********************************************
+
+/*	Self-contained index file over a set of summarized cards, for queries that need no
+	external database. It holds two B+trees: one keyed on the collation key of FN (case,
+	Latin-1 accents and runs of white space are ignored) and one keyed on the (month, day)
+	of each birthday and anniversary. The file is mapped when opened, so a query costs a
+	few page lookups; it is replaced atomically when rewritten.
+	A CardIndex may be queried by several threads at once.
+*/
+typedef struct cardIndex CardIndex;
+
+typedef enum cardDateKind { BIRTHDAY_DATE, ANNIVERSARY_DATE } CardDateKind;
+
+/*	One card found in an index. The strings are those of the card's CardSummary and stay
+	valid until the index is closed.
+*/
+typedef struct indexedCard {
+	const char*	fileName;
+	const char*	fn;
+	const char*	birthday;
+	const char*	anniversary;
+} IndexedCard;
+
+/*	Callback invoked once per card found by an index query, in index order.
+	Return true to continue, or false to end the query.
+*/
+typedef bool (*IndexedCardCallback)(const IndexedCard* card, void* userData);
+
+/** Function to write the contact index of a set of summarized cards.
+ *@pre summaries has count records, as filled by summarizeCards or summarizeCardsCached
+ *@post indexFileName holds an index of every card whose summary error is OK
+ *@return OK on success, WRITE_ERROR if the file cannot be written, OTHER_ERROR on allocation failure
+ *@param indexFileName - the index file to create or replace
+		 fileNames - the names of the vCard files
+		 summaries - the summary of each file
+		 count - the number of files
+ **/
+VCardErrorCode writeCardIndex(const char* indexFileName, const char* const* fileNames, const CardSummary* summaries, int count);
+
+/** Function to open a contact index.
+ *@return the index, or NULL if the file cannot be read or is not a valid index.
+		Must be released with closeCardIndex.
+ *@param indexFileName - the index file
+ **/
+CardIndex* openCardIndex(const char* indexFileName);
+
+/** Function to find the cards whose FN begins with a prefix.
+ *@pre index was returned by openCardIndex. callback is not NULL.
+ *@post callback has been invoked for each match in collation order of FN
+ *@return the number of cards reported, or -1 if the arguments are invalid or the index is damaged
+ *@param index - the contact index
+		 prefix - the name prefix, matched like the index keys; "" matches every card
+		 callback - function receiving each card
+		 userData - caller data passed through to the callback
+ **/
+int findCardsByName(const CardIndex* index, const char* prefix, IndexedCardCallback callback, void* userData);
+
+/** Function to find the cards with a birthday or anniversary in a range of days of one month.
+ *@pre index was returned by openCardIndex. callback is not NULL.
+ *@post callback has been invoked for each match in day order. Dates with a month but no
+		day (such as --06) have day 0; text dates and dates without a month are not indexed.
+ *@return the number of cards reported, or -1 if the arguments are invalid or the index is damaged
+ *@param index - the contact index
+		 kind - whether to search birthdays or anniversaries
+		 month - the month, 1 to 12
+		 firstDay - the first day of the range; 0 includes dates with no day
+		 lastDay - the last day of the range, up to 31
+		 callback - function receiving each card
+		 userData - caller data passed through to the callback
+ **/
+int findCardsByDate(const CardIndex* index, CardDateKind kind, int month, int firstDay, int lastDay, IndexedCardCallback callback, void* userData);
+
+/** Function to close a contact index.
+ *@post The index file has been unmapped and all memory of the index freed
+ *@param index - the contact index. May be NULL.
+ **/
+void closeCardIndex(CardIndex* index);
+
+// ************* Text index ************************************************
+
+/*	Inverted index over the words of the FN, N, ORG, NOTE and EMAIL values and the digits
+	of the TEL values of a set of cards, for finding contacts by part of a name, an email
+	domain or a run of phone digits. Each term lists the cards that have it, and each
+	trigram lists the terms that contain it. An index is built in memory from parsed
+	Cards and can be written to a file, which is mapped when opened.
+	Cards may be added from several threads at once. Queries must not run concurrently
+	with adding cards, since the first query after a card was added compiles the index.
+*/
+typedef struct cardTextIndex CardTextIndex;
+
+/*	Callback invoked once per card found by findCardsByText, in the order the cards
+	were added. fileName stays valid until the index is changed or closed.
+	Return true to continue, or false to end the query.
+*/
+typedef bool (*TextMatchCallback)(const char* fileName, void* userData);
+
+/** Function to create an empty text index in memory.
+ *@return the index, or NULL on allocation failure. Must be released with closeCardTextIndex.
+ **/
+CardTextIndex* createCardTextIndex(void);
+
+/** Function to add the searchable values of a card to a text index.
+ *@pre index was returned by createCardTextIndex
+ *@post The words of the card's FN, N, ORG, NOTE and EMAIL values (runs of letters and
+		digits, with ASCII letters lowercased and accented Latin-1 letters folded to
+		ASCII) and the digits of its TEL values are indexed under fileName.
+		card is not modified and may be deleted afterwards.
+ *@return OK on success, INV_CARD if card is NULL, INV_FILE for other invalid arguments or
+		an index opened from a file, OTHER_ERROR on allocation failure
+ *@param index - the text index
+		 fileName - the name reported for the card by queries
+		 card - the card
+ **/
+VCardErrorCode addCardToTextIndex(CardTextIndex* index, const char* fileName, const Card* card);
+
+/** Function to write a text index to a file.
+ *@post indexFileName has been replaced atomically with the index
+ *@return OK on success, INV_FILE for invalid arguments, WRITE_ERROR if the file cannot be
+		written, OTHER_ERROR on allocation failure
+ *@param index - the text index
+		 indexFileName - the file to create or replace
+ **/
+VCardErrorCode writeCardTextIndex(CardTextIndex* index, const char* indexFileName);
+
+/** Function to open a text index file for queries.
+ *@return the index, or NULL if the file cannot be read or is not a valid text index.
+		Cards cannot be added to it. Must be released with closeCardTextIndex.
+ *@param indexFileName - the index file
+ **/
+CardTextIndex* openCardTextIndex(const char* indexFileName);
+
+/** Function to find the cards that match every word of a query.
+ *@pre index was returned by createCardTextIndex or openCardTextIndex. callback is not NULL.
+ *@post callback has been invoked once per matching card. A query word of three or more
+		characters matches any indexed term containing it; a shorter word matches the
+		terms it begins. Query words are split, lowercased and folded like indexed
+		values, so "alv" and "ÁLV" both find "Álvarez".
+ *@return the number of cards reported, or -1 if the arguments are invalid, the index is
+		damaged or memory allocation fails
+ *@param index - the text index
+		 query - the words to look for, e.g. "smi", "example.com" or "555-0123"
+		 callback - function receiving the file name of each card
+		 userData - caller data passed through to the callback
+ **/
+int findCardsByText(CardTextIndex* index, const char* query, TextMatchCallback callback, void* userData);
+
+/** Function to close a text index.
+ *@post All memory of the index has been freed, and its file unmapped
+ *@param index - the text index. May be NULL.
+ **/
+void closeCardTextIndex(CardTextIndex* index);
+
+// ************* Duplicate detection ***************************************
+
+/*	Options for findDuplicateCards. A zeroed struct selects the defaults.
+	threads is the number of worker threads, or 0 for one per online CPU.
+*/
+typedef struct dedupeOptions {
+	int		threads;
+} DedupeOptions;
+
+/** Function to group the cards of a corpus that likely describe the same contact.
+ *@pre cards holds count cards. clusters has room for count entries.
+ *@post clusters[i] holds the position of the first card of the group of cards[i]. A card
+		without duplicates is its own group. Cards are grouped when they share a UID or an
+		email address, or when two of these agree: a phone number (its last ten digits), the
+		FN (case, punctuation and word order ignored) or a similar FN. Only cards sharing a
+		blocking key are compared, so the cost grows about linearly with count.
+		The cards are not modified.
+ *@return the number of groups with more than one card, or -1 if the arguments are
+		invalid or memory allocation fails
+ *@param cards - the cards. NULL entries are never grouped.
+		 count - the number of cards
+		 options - the options, or NULL for the defaults
+		 clusters - caller-provided array of count entries to fill
+ **/
+int findDuplicateCards(const Card* const* cards, int count, const DedupeOptions* options, int* clusters);
+
+// ************* Property lookup *******************************************
+
+/** Function to look up every property of a Card with a given name.
+ *@pre card is a valid Card that is released with deleteCard
+ *@post The first lookup builds a name index for the card; later lookups are O(1). Adding or
+		removing properties through addProperty/removeProperty keeps results correct. After
+		changing optionalProperties or fn any other way (e.g. deleteDataFromList followed
+		by insertSorted), call invalidatePropertyIndex before the next lookup.
+ *@return a read-only array of Property* (FN first, then optional properties in card order),
+		or NULL if the card has no property with that name. The array is owned by the card
+		and is valid until the card's properties next change.
+ *@param card - the Card to search
+		 name - the property name, matched exactly and without its group
+ **/
+const ArrayList* getPropertiesByName(const Card* card, const char* name);
+
+/** Function to look up the first property of a Card with a given name.
+ *@pre card is a valid Card that is released with deleteCard
+ *@return the first matching Property, or NULL if there is none
+ *@param card - the Card to search
+		 name - the property name, matched exactly and without its group
+ **/
+Property* getPropertyByName(const Card* card, const char* name);
+
+/** Function to append a property to the optional properties of a Card, updating its name index.
+ *@pre card is a heap Card (not arena-backed and not a view), prop is a valid Property
+ *@post prop is owned by card
+ *@return OK on success, INV_CARD or INV_PROP for invalid arguments, OTHER_ERROR on allocation failure
+ *@param card - the Card to modify
+		 prop - the Property to add
+ **/
+VCardErrorCode addProperty(Card* card, Property* prop);
+
+/** Function to remove a property from the optional properties of a Card, updating its name index.
+ *@pre card is a heap Card (not arena-backed and not a view)
+ *@post prop is no longer in the card and is owned by the caller. It is matched by address.
+ *@return prop on success, or NULL if it is not an optional property of the card
+ *@param card - the Card to modify
+		 prop - the Property to remove
+ **/
+Property* removeProperty(Card* card, Property* prop);
+
+/** Function to discard the property index of a Card after its properties were changed
+	directly through the List API.
+ *@post The next getPropertiesByName or getPropertyByName call rebuilds the index. Arrays
+		returned by earlier lookups are no longer valid.
+ *@param card - the Card whose properties changed. NULL is ignored.
+ **/
+void invalidatePropertyIndex(const Card* card);
+
+/** Function to get the structured value of a property: its components (separated by ';'),
+	each holding one or more values (separated by ','), with backslash escapes decoded.
+ *@pre prop is a valid Property
+ *@post The value is split on first request and cached until the property is deleted or
+		its value is replaced. Which separators apply follows RFC 6350 for the property
+		(e.g. ORG splits on ';' only, CATEGORIES on ',' only, NOTE on neither); unknown
+		and X- properties split on both. Values the parser already split, such as those
+		of N, contribute one component each.
+ *@return a read-only array of components, each a read-only array of char*, or NULL if
+		the property has no value or memory allocation fails
+ *@param prop - the Property
+ **/
+const ArrayList* getPropertyComponents(const Property* prop);
+
+/** Function to get one decoded value of a structured property value.
+ *@pre prop is a valid Property
+ *@return the value, or NULL if the component or index is out of range
+ *@param prop - the Property
+		 component - zero-based component (';'-separated field)
+		 index - zero-based value within the component (','-separated item)
+ **/
+const char* getPropertyComponent(const Property* prop, int component, int index);
+
+// ************* Card diff and patch ***************************************
+
+/*	Kind of one edit of a CardPatch. */
+typedef enum cardEditKind { PROPERTY_ADDED, PROPERTY_REMOVED, PROPERTY_CHANGED, DATE_CHANGED } CardEditKind;
+
+/*	Parts of a property replaced by a PROPERTY_CHANGED edit. */
+#define EDIT_NAME		0x01
+#define EDIT_GROUP		0x02
+#define EDIT_PARAMETERS	0x04
+#define EDIT_VALUES		0x08
+
+/*	One edit of a CardPatch.
+	position is, for PROPERTY_REMOVED and PROPERTY_CHANGED, the position of the property in
+	the optionalProperties of the old card, and for PROPERTY_ADDED its position in those of
+	the new card; -1 stands for FN. For DATE_CHANGED it is BIRTHDAY_DATE or ANNIVERSARY_DATE.
+	property is the added property, or the changed property as it is in the new card; it is
+	NULL for PROPERTY_REMOVED and DATE_CHANGED. date is the new date of a DATE_CHANGED edit,
+	or NULL if the date was removed.
+*/
+typedef struct cardEdit {
+	CardEditKind	kind;
+	int				position;
+	int				changes;	//EDIT_* flags of a PROPERTY_CHANGED edit
+	Property*		property;
+	DateTime*		date;
+} CardEdit;
+
+/*	Structural difference between two cards. The patch owns copies of the properties and
+	dates of its edits.
+*/
+typedef struct cardPatch {
+	CardEdit*	edits;
+	int			numEdits;
+	int			oldLength;	//number of optional properties of the old card
+	int			newLength;	//number of optional properties of the new card
+} CardPatch;
+
+/** Function to compute the edits that turn one card into another.
+ *@pre oldCard and newCard are valid Cards
+ *@post Neither card is modified. Properties are equal when their names, groups, parameters
+		(in order) and values (in order) are equal. The optional properties of both cards
+		are aligned on a longest common subsequence of equal properties; between two aligned
+		properties, a removed and an added property of the same name (case-insensitive) are
+		paired into one PROPERTY_CHANGED edit. Edits are ordered by position.
+ *@return the patch, with numEdits 0 if the cards are equal, or NULL if an argument is NULL
+		or memory allocation fails. Must be released with deleteCardPatch.
+ *@param oldCard - the card before the change
+		 newCard - the card after the change
+ **/
+CardPatch* diffCards(const Card* oldCard, const Card* newCard);
+
+/** Function to apply a patch to a card.
+ *@pre card is a heap Card (not arena-backed and not a view)
+ *@post card is equal to the new card of the patch. Every copy is made before the card is
+		modified, so on error the card is unchanged. patch is not modified.
+ *@return OK on success, INV_CARD if card is NULL, arena-backed, a view, or does not have
+		oldLength optional properties, INV_PROP if patch is NULL or its edits are
+		inconsistent, OTHER_ERROR on allocation failure
+ *@param card - the Card to modify
+		 patch - a patch returned by diffCards
+ **/
+VCardErrorCode applyCardPatch(Card* card, const CardPatch* patch);
+
+/** Function to delete a patch and all of its edits.
+ *@param patch - the patch. May be NULL.
+ **/
+void deleteCardPatch(CardPatch* patch);
+
+// ************* Contiguous card representation ***************************
+
+/*	Property whose parameters and values are kept in contiguous arrays.
+	The fields mean the same as in Property: parameters holds Parameter*, values holds char*.
+*/
+typedef struct flatProp {
+	char* 		name;
+	char* 		group;
+	ArrayList*	parameters;
+	ArrayList*	values;
+} FlatProperty;
+
+/*	Card whose properties are kept in a contiguous array of FlatProperty*.
+	The fields mean the same as in Card.
+*/
+typedef struct flatCard {
+	FlatProperty*	fn;
+	ArrayList*		optionalProperties;
+	DateTime*		birthday;
+	DateTime*		anniversary;
+} FlatCard;
+
+/** Function to create a FlatCard object from a vCard file.
+ *@pre fileName is not NULL and has the correct extension
+ *@post Same as createCard, except that the result uses contiguous arrays instead of linked lists
+ *@return the error code indicating success or the error encountered when parsing the card
+ *@param fileName - a string containing the name of the vCard file
+		 obj - a double pointer to a FlatCard struct that needs to be allocated
+ **/
+VCardErrorCode createFlatCard(char* fileName, FlatCard** obj);
+
+/** Function to copy a Card into the contiguous representation.
+ *@pre card is a valid Card
+ *@post card is unchanged. The FlatCard owns copies of all of its data.
+ *@return the new FlatCard, or NULL if memory allocation fails
+ *@param card - the Card to copy
+ **/
+FlatCard* flattenCard(const Card* card);
+
+/** Function to create a read-only Card view of a FlatCard, for code written against the List API.
+ *@pre flat is a valid FlatCard
+ *@post The view shares the strings, Parameters and DateTimes of flat. Its Lists are backed
+		by contiguous Node arrays and its Properties by one contiguous array, so
+		ListIterator walks consecutive memory. The view must be released with deleteCard
+		before flat is deleted, and must not be modified other than through updateFN.
+ *@return the view, or NULL if memory allocation fails
+ *@param flat - the FlatCard to view
+ **/
+Card* flatCardView(const FlatCard* flat);
+
+/** Function to delete all FlatCard content and free all the memory.
+ *@pre FlatCard object exists, is not null, and has not been freed
+ *@post FlatCard object had been freed
+ *@param obj - a pointer to a FlatCard struct
+ **/
+void deleteFlatCard(FlatCard* obj);
+
+#endif
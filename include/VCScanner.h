@@ -0,0 +1,51 @@
+/**
+ * @file VCScanner.h
+ * @brief Vectorized scanner for the structural characters of vCard content lines
+ */
+
+#ifndef _VCSCANNER_H
+#define _VCSCANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*	Cursor over the structural characters of a block of text: CR, LF, ':', ';', '=', '.', ','
+	and '\\'. The text is classified 64 bytes at a time into a bit mask (SSE2, or AVX2 when
+	the CPU supports it), and offsets are handed out from the mask, so each byte is examined
+	once and scanning stops as soon as the caller stops asking.
+*/
+typedef struct delimiterScanner {
+	const char*	data;
+	size_t		length;
+
+	//Offset of the block described by mask, and of the next block to classify
+	size_t		blockStart;
+	size_t		nextBlock;
+
+	//One bit per delimiter of the current block that has not been returned yet
+	uint64_t	mask;
+} DelimiterScanner;
+
+/** Function to start scanning a block of text for delimiters.
+ *@pre data holds length bytes. It does not need to be NUL-terminated.
+ *@post scanner is positioned before the first delimiter
+ *@param scanner - the scanner to initialize
+		 data - the text to scan
+		 length - the number of bytes of text
+ **/
+void initDelimiterScanner(DelimiterScanner* scanner, const char* data, size_t length);
+
+/** Function to return the offset of the next delimiter.
+ *@pre scanner has been initialized
+ *@post scanner has advanced past the returned delimiter
+ *@return the offset of the next delimiter, in increasing order, or the text length once none remain
+ *@param scanner - the scanner to advance
+ **/
+size_t nextDelimiter(DelimiterScanner* scanner);
+
+/** Function to report which kernel the scanner selected for this CPU.
+ *@return "avx2", "sse2" or "scalar"
+ **/
+const char* delimiterScannerKernel(void);
+
+#endif
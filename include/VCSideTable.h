@@ -0,0 +1,59 @@
+/**
+ * @file VCSideTable.h
+ * @brief Thread-safe map from object addresses to attached data
+ */
+
+#ifndef _VCSIDETABLE_H
+#define _VCSIDETABLE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/*	Hash map keyed by object address, used to attach extra state to Cards and Properties
+	without changing the layout of the public structs in VCParser.h (callers allocate
+	those structs themselves). Uses open addressing with linear probing.
+	count is atomic so that lookups in an empty table can skip the lock entirely.
+*/
+typedef struct sideTable {
+	pthread_mutex_t	lock;
+	const void**	keys;
+	void**			values;
+	size_t			capacity;
+	atomic_size_t	count;
+} SideTable;
+
+#define SIDE_TABLE_INITIALIZER { PTHREAD_MUTEX_INITIALIZER, NULL, NULL, 0, 0 }
+
+/** Function to attach a value to a key, replacing any value already attached.
+ *@pre table has been initialized with SIDE_TABLE_INITIALIZER. key and value are not NULL.
+ *@return true on success, false if memory allocation fails
+ *@param table - the side table
+		 key - the object address
+		 value - the data to attach
+ **/
+bool sideTablePut(SideTable* table, const void* key, void* value);
+
+/** Function to look up the value attached to a key.
+ *@return the attached value, or NULL if there is none
+ *@param table - the side table
+		 key - the object address
+ **/
+void* sideTableGet(SideTable* table, const void* key);
+
+/** Function to detach the value attached to a key.
+ *@post key no longer has a value attached
+ *@return the value that was attached, or NULL if there was none
+ *@param table - the side table
+		 key - the object address
+ **/
+void* sideTableRemove(SideTable* table, const void* key);
+
+/** Function to count the keys that have a value attached, without taking the lock.
+ *@return the number of entries in the table
+ *@param table - the side table
+ **/
+size_t sideTableSize(SideTable* table);
+
+#endif
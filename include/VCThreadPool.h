@@ -0,0 +1,38 @@
+/**
+ * @file VCThreadPool.h
+ * @brief Work-stealing pool for running one task per item of a batch in parallel
+ */
+
+#ifndef _VCTHREADPOOL_H
+#define _VCTHREADPOOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*	Task run once for each item of a batch. index is the zero-based item number.
+	Tasks run concurrently on different items, so any state shared through context
+	must be thread-safe. Return false to stop the batch: items not yet started are skipped.
+*/
+typedef bool (*WorkItemFunction)(size_t index, void* context);
+
+/** Function to get the default number of workers for a batch.
+ *@return the number of online CPUs, or 1 if it cannot be determined
+ **/
+size_t defaultWorkerCount(void);
+
+/** Function to run a task on every item of a batch with a pool of worker threads.
+ *@pre run is not NULL
+ *@post Each worker starts with an equal share of the item range. A worker that runs out
+		steals the upper half of the remaining range of another worker, so the load stays
+		balanced when items take uneven time. The calling thread acts as one of the workers,
+		and the batch still completes if some threads cannot be created.
+		Every worker has finished when the function returns.
+ *@return true if every item ran, false if a task stopped the batch
+ *@param count - the number of items
+		 workers - the number of workers, or 0 for defaultWorkerCount(). Capped at count.
+		 run - the task to run for each item
+		 context - caller data passed through to each task
+ **/
+bool runWorkStealing(size_t count, size_t workers, WorkItemFunction run, void* context);
+
+#endif
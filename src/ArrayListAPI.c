@@ -0,0 +1,172 @@
+#include "../include/ArrayListAPI.h"
+
+/** Function to initialize the array list metadata head to the appropriate function pointers. Allocates memory to the struct.
+ *@return pointer to the list head, or NULL if malloc fails
+ *@param printFunction function pointer to print a single element of the list
+ *@param deleteFunction function pointer to delete a single piece of data from the list
+ *@param compareFunction function pointer to compare two elements of the list in order to test for equality or order
+ **/
+ArrayList *initializeArrayList(char *(*printFunction)(void *toBePrinted), void (*deleteFunction)(void *toBeDeleted), int (*compareFunction)(const void *first, const void *second))
+{
+	ArrayList *list = malloc(sizeof(ArrayList));
+	if (list == NULL)
+		return NULL;
+
+	list->elements = NULL;
+	list->length = 0;
+	list->capacity = 0;
+
+	list->deleteData = deleteFunction;
+	list->compare = compareFunction;
+	list->printData = printFunction;
+
+	return list;
+}
+
+/** Makes room for at least capacity elements.
+ *@return true on success, false if memory allocation fails
+ *@param list pointer to the ArrayList struct
+ *@param capacity the number of elements the list must be able to hold
+ **/
+bool reserveArrayList(ArrayList *list, int capacity)
+{
+	if (list == NULL)
+		return false;
+	if (capacity <= list->capacity)
+		return true;
+
+	void **elements = realloc(list->elements, (size_t)capacity * sizeof(void *));
+	if (elements == NULL)
+		return false;
+	list->elements = elements;
+	list->capacity = capacity;
+	return true;
+}
+
+/** Appends an element to the back of an array list, doubling its storage when it is full.
+ *@return true on success, false if an argument is NULL or memory allocation fails
+ *@param list pointer to the ArrayList struct
+ *@param toBeAdded a pointer to data that is to be added to the list
+ **/
+bool appendArrayElement(ArrayList *list, void *toBeAdded)
+{
+	if (list == NULL || toBeAdded == NULL)
+		return false;
+
+	if (list->length == list->capacity && !reserveArrayList(list, list->capacity ? list->capacity * 2 : 4))
+		return false;
+
+	list->elements[list->length++] = toBeAdded;
+	return true;
+}
+
+/** Returns a pointer to the data at a position in the list.
+ *@return pointer to the data at index, or NULL if index is out of range
+ *@param list pointer to the ArrayList struct
+ *@param index the zero-based position of the element
+ **/
+void *getArrayElement(const ArrayList *list, int index)
+{
+	if (list == NULL || index < 0 || index >= list->length)
+		return NULL;
+	return list->elements[index];
+}
+
+/** Returns the number of elements in the list.
+ *@return number of elements in the list, or -1 if list is NULL
+ *@param list pointer to the ArrayList struct
+ **/
+int getArrayLength(const ArrayList *list)
+{
+	if (list == NULL)
+		return -1;
+	return list->length;
+}
+
+/** Clears the contents of the list, keeping the list struct and its storage.
+ *@param list pointer to the ArrayList struct
+ **/
+void clearArrayList(ArrayList *list)
+{
+	if (list == NULL)
+		return;
+
+	for (int i = 0; i < list->length; i++)
+		list->deleteData(list->elements[i]);
+	list->length = 0;
+}
+
+/** Frees the contents of the list, its storage and the list struct itself.
+ *@param list pointer to the ArrayList struct
+ **/
+void freeArrayList(ArrayList *list)
+{
+	if (list == NULL)
+		return;
+
+	clearArrayList(list);
+	free(list->elements);
+	free(list);
+}
+
+/** Builds a string representation of the list from the printData of each element.
+ *@return on success: newly allocated string. on failure: NULL
+ *@param list pointer to the ArrayList struct
+ **/
+char *arrayListToString(const ArrayList *list)
+{
+	if (list == NULL)
+		return NULL;
+
+	size_t length = 0, capacity = 64;
+	char *str = malloc(capacity);
+	if (str == NULL)
+		return NULL;
+	str[0] = '\0';
+
+	for (int i = 0; i < list->length; i++)
+	{
+		char *currDescr = list->printData(list->elements[i]);
+		if (currDescr == NULL)
+			continue;
+		size_t descrLength = strlen(currDescr);
+		if (length + descrLength + 1 > capacity)
+		{
+			while (length + descrLength + 1 > capacity)
+				capacity *= 2;
+			char *tmp = realloc(str, capacity);
+			if (tmp == NULL)
+			{
+				free(currDescr);
+				free(str);
+				return NULL;
+			}
+			str = tmp;
+		}
+		memcpy(str + length, currDescr, descrLength + 1);
+		length += descrLength;
+		free(currDescr);
+	}
+
+	return str;
+}
+
+/** Searches the list for the first element matching a record.
+ *@return the matching data, or NULL if no element matches
+ *@param list pointer to the ArrayList struct
+ *@param customCompare comparator returning true on a match
+ *@param searchRecord the search criteria passed to customCompare
+ **/
+void *findArrayElement(const ArrayList *list, bool (*customCompare)(const void *first, const void *second), const void *searchRecord)
+{
+	if (list == NULL || customCompare == NULL || searchRecord == NULL)
+		return NULL;
+
+	for (int i = 0; i < list->length; i++)
+	{
+		if (customCompare(list->elements[i], searchRecord))
+			return list->elements[i];
+	}
+
+	return NULL;
+}
@@ -0,0 +1,136 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/VCArena.h"
+
+#define MIN_CHUNK_SIZE 1024
+
+/**
+ * Rounds a size up to the strictest alignment of any standard type.
+ * @param size The size to round.
+ * @return The rounded size.
+ */
+static size_t alignSize(size_t size)
+{
+    size_t align = alignof(max_align_t);
+    return (size + align - 1) & ~(align - 1);
+}
+
+/**
+ * Adds a chunk with room for at least minimumSize bytes to the front of the arena.
+ * @param arena The arena to grow.
+ * @param minimumSize The allocation that must fit into the new chunk.
+ * @return The new chunk, or NULL if memory allocation fails.
+ */
+static ArenaChunk *addChunk(Arena *arena, size_t minimumSize)
+{
+    size_t size = arena->nextChunkSize;
+    if (size < minimumSize)
+        size = minimumSize;
+    ArenaChunk *chunk = malloc(alignSize(sizeof(ArenaChunk)) + size);
+    if (!chunk)
+        return NULL;
+    chunk->next = arena->chunks;
+    chunk->size = size;
+    chunk->used = 0;
+    arena->chunks = chunk;
+    arena->nextChunkSize = size * 2;
+    return chunk;
+}
+
+/**
+ * Creates an empty arena with one chunk of at least initialSize bytes.
+ * @param initialSize The expected number of bytes the arena will hold.
+ * @return The new arena, or NULL if memory allocation fails.
+ */
+Arena *createArena(size_t initialSize)
+{
+    Arena *arena = malloc(sizeof(Arena));
+    if (!arena)
+        return NULL;
+    arena->chunks = NULL;
+    arena->nextChunkSize = initialSize < MIN_CHUNK_SIZE ? MIN_CHUNK_SIZE : alignSize(initialSize);
+    if (!addChunk(arena, 0))
+    {
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+/**
+ * Carves an allocation with the given alignment out of the newest chunk of an arena,
+ * adding a chunk if it is full.
+ * @param arena The arena to allocate from.
+ * @param size The number of bytes to allocate.
+ * @param align The required alignment, a power of two.
+ * @return A pointer to the memory, or NULL if memory allocation fails.
+ */
+static void *allocAligned(Arena *arena, size_t size, size_t align)
+{
+    ArenaChunk *chunk = arena->chunks;
+    size_t offset = (chunk->used + align - 1) & ~(align - 1);
+    if (offset > chunk->size || chunk->size - offset < size)
+    {
+        chunk = addChunk(arena, size);
+        if (!chunk)
+            return NULL;
+        offset = 0;
+    }
+    chunk->used = offset + size;
+    return (char *)chunk + alignSize(sizeof(ArenaChunk)) + offset;
+}
+
+/**
+ * Allocates memory from an arena, aligned for any type.
+ * @param arena The arena to allocate from.
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the memory, or NULL if memory allocation fails.
+ */
+void *arenaAlloc(Arena *arena, size_t size)
+{
+    return allocAligned(arena, size, alignof(max_align_t));
+}
+
+/**
+ * Copies a string of known length into an arena and NUL-terminates it.
+ * @param arena The arena to allocate from.
+ * @param str The characters to copy.
+ * @param length The number of characters to copy.
+ * @return The copy, or NULL if memory allocation fails.
+ */
+char *arenaStrndup(Arena *arena, const char *str, size_t length)
+{
+    // Strings need no alignment, so they are packed back to back.
+    char *copy = allocAligned(arena, length + 1, 1);
+    if (copy)
+    {
+        memcpy(copy, str, length);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+/**
+ * Releases every chunk of an arena and the arena itself.
+ * @param arena The arena to release. May be NULL.
+ */
+void destroyArena(Arena *arena)
+{
+    if (!arena)
+        return;
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk)
+    {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(arena);
+}
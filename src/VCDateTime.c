@@ -0,0 +1,281 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/VCParser.h"
+
+/* Days in each month, with 29 for February; leap years are checked separately. */
+static const uint8_t monthDays[13] = {0, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+/**
+ * Reads a run of decimal digits. The caller has checked that count bytes are available.
+ * Every byte is converted before the result is checked, so the loop has no early exit.
+ * @param text The digits.
+ * @param count The number of digits, at most 4.
+ * @return The value, or -1 if any byte is not a digit.
+ */
+static int readDigits(const char *text, size_t count)
+{
+    int value = 0;
+    unsigned invalid = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned digit = (unsigned)((unsigned char)text[i] - '0');
+        invalid |= digit > 9;
+        value = value * 10 + (int)digit;
+    }
+    return invalid ? -1 : value;
+}
+
+/**
+ * Parses the date part of a date-and-or-time (RFC 6350 section 4.3.1), dispatching on its
+ * length: YYYYMMDD, YYYY-MM-DD, YYYY-MM, YYYY, --MMDD, --MM and ---DD.
+ * @param text The date, not NUL-terminated.
+ * @param length The length of the date.
+ * @param complete Whether the reduced forms YYYY-MM, YYYY and --MM are excluded, as they
+ *                 are before a time.
+ * @param out Receives the fields of the date.
+ * @return true if the date is well formed and in range.
+ */
+static bool parseDatePart(const char *text, size_t length, bool complete, PackedDateTime *out)
+{
+    int year = 0;
+    int month = 0;
+    int day = 0;
+    uint8_t fields = 0;
+    if (length == 8 || (length == 10 && text[4] == '-' && text[7] == '-'))
+    {
+        size_t separator = length == 10;
+        year = readDigits(text, 4);
+        month = readDigits(text + 4 + separator, 2);
+        day = readDigits(text + 6 + 2 * separator, 2);
+        fields = DATE_HAS_YEAR | DATE_HAS_MONTH | DATE_HAS_DAY;
+    }
+    else if (length == 6 && text[0] == '-' && text[1] == '-')
+    {
+        month = readDigits(text + 2, 2);
+        day = readDigits(text + 4, 2);
+        fields = DATE_HAS_MONTH | DATE_HAS_DAY;
+    }
+    else if (length == 5 && text[0] == '-' && text[1] == '-' && text[2] == '-')
+    {
+        day = readDigits(text + 3, 2);
+        fields = DATE_HAS_DAY;
+    }
+    else if (complete)
+        return false;
+    else if (length == 7 && text[4] == '-')
+    {
+        year = readDigits(text, 4);
+        month = readDigits(text + 5, 2);
+        fields = DATE_HAS_YEAR | DATE_HAS_MONTH;
+    }
+    else if (length == 4 && text[0] == '-' && text[1] == '-')
+    {
+        month = readDigits(text + 2, 2);
+        fields = DATE_HAS_MONTH;
+    }
+    else if (length == 4)
+    {
+        year = readDigits(text, 4);
+        fields = DATE_HAS_YEAR;
+    }
+    else
+        return false;
+
+    if (year < 0 || month < 0 || day < 0)
+        return false;
+    if ((fields & DATE_HAS_MONTH) && (month < 1 || month > 12))
+        return false;
+    // Without a month, a day may be up to 31.
+    if ((fields & DATE_HAS_DAY) && (day < 1 || day > monthDays[month ? month : 1]))
+        return false;
+    if ((fields & DATE_HAS_YEAR) && month == 2 && day == 29 && (year % 4 != 0 || (year % 100 == 0 && year % 400 != 0)))
+        return false;
+
+    out->year = (uint16_t)year;
+    out->month = (uint8_t)month;
+    out->day = (uint8_t)day;
+    out->fields |= fields;
+    return true;
+}
+
+/**
+ * Parses a UTC designator or offset: Z, +HH, +HHMM or +HH:MM, with either sign.
+ * @param text The zone, not NUL-terminated.
+ * @param length The length of the zone.
+ * @param out Receives the offset.
+ * @return true if the zone is well formed and in range.
+ */
+static bool parseZone(const char *text, size_t length, PackedDateTime *out)
+{
+    int hours = 0;
+    int minutes = 0;
+    if (length == 1 && text[0] == 'Z')
+        hours = 0;
+    else if (length == 3)
+        hours = readDigits(text + 1, 2);
+    else if (length == 5)
+    {
+        hours = readDigits(text + 1, 2);
+        minutes = readDigits(text + 3, 2);
+    }
+    else if (length == 6 && text[3] == ':')
+    {
+        hours = readDigits(text + 1, 2);
+        minutes = readDigits(text + 4, 2);
+    }
+    else
+        return false;
+    if (length > 1 && text[0] != '+' && text[0] != '-')
+        return false;
+    if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59)
+        return false;
+
+    int offset = hours * 60 + minutes;
+    out->utcOffset = (int16_t)(text[0] == '-' ? -offset : offset);
+    out->fields |= DATE_HAS_ZONE;
+    return true;
+}
+
+/**
+ * Parses the time part of a date-and-or-time (RFC 6350 section 4.3.2), dispatching on
+ * its length: HH, HHMM, HHMMSS, HH:MM, HH:MM:SS and the truncated -MM, -MMSS and --SS,
+ * each optionally followed by a zone.
+ * @param text The time, not NUL-terminated, without its 'T'.
+ * @param length The length of the time.
+ * @param complete Whether the truncated forms are excluded, as they are after a date.
+ * @param out Receives the fields of the time.
+ * @return true if the time is well formed and in range.
+ */
+static bool parseTimePart(const char *text, size_t length, bool complete, PackedDateTime *out)
+{
+    // The zone starts at the first sign or Z after any leading truncation dashes.
+    size_t start = 0;
+    while (start < length && text[start] == '-')
+        start++;
+    size_t zone = start;
+    while (zone < length && text[zone] != 'Z' && text[zone] != '+' && text[zone] != '-')
+        zone++;
+    if (zone < length && !parseZone(text + zone, length - zone, out))
+        return false;
+
+    int hour = -1;
+    int minute = -1;
+    int second = -1;
+    uint8_t fields = 0;
+    if (start == 0 && (zone == 2 || zone == 4 || zone == 6))
+    {
+        hour = readDigits(text, 2);
+        minute = zone >= 4 ? readDigits(text + 2, 2) : 0;
+        second = zone == 6 ? readDigits(text + 4, 2) : 0;
+        fields = DATE_HAS_HOUR | (zone >= 4 ? DATE_HAS_MINUTE : 0) | (zone == 6 ? DATE_HAS_SECOND : 0);
+    }
+    else if (start == 0 && (zone == 5 || zone == 8) && text[2] == ':' && (zone == 5 || text[5] == ':'))
+    {
+        hour = readDigits(text, 2);
+        minute = readDigits(text + 3, 2);
+        second = zone == 8 ? readDigits(text + 6, 2) : 0;
+        fields = DATE_HAS_HOUR | DATE_HAS_MINUTE | (zone == 8 ? DATE_HAS_SECOND : 0);
+    }
+    else if (!complete && start == 1 && (zone == 3 || zone == 5))
+    {
+        hour = 0;
+        minute = readDigits(text + 1, 2);
+        second = zone == 5 ? readDigits(text + 3, 2) : 0;
+        fields = DATE_HAS_MINUTE | (zone == 5 ? DATE_HAS_SECOND : 0);
+    }
+    else if (!complete && start == 2 && zone == 4)
+    {
+        hour = 0;
+        minute = 0;
+        second = readDigits(text + 2, 2);
+        fields = DATE_HAS_SECOND;
+    }
+    else
+        return false;
+
+    // Second 60 is a leap second.
+    if (hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60)
+        return false;
+    out->hour = (uint8_t)hour;
+    out->minute = (uint8_t)minute;
+    out->second = (uint8_t)second;
+    out->fields |= fields;
+    return true;
+}
+
+static void clearPackedDateTime(PackedDateTime *out)
+{
+    memset(out, 0, sizeof(PackedDateTime));
+}
+
+VCardErrorCode parseDateAndOrTime(const char *value, PackedDateTime *out)
+{
+    if (!value || !out)
+        return INV_DT;
+    clearPackedDateTime(out);
+    size_t dateLength = 0;
+    while (value[dateLength] != '\0' && value[dateLength] != 'T')
+        dateLength++;
+    size_t length = dateLength + strlen(value + dateLength);
+    bool ok;
+    if (dateLength == length)
+        ok = parseDatePart(value, length, false, out);
+    else if (dateLength == 0)
+        ok = parseTimePart(value + 1, length - 1, false, out);
+    else
+        ok = parseDatePart(value, dateLength, true, out) &&
+             parseTimePart(value + dateLength + 1, length - dateLength - 1, true, out);
+    if (!ok)
+        clearPackedDateTime(out);
+    return ok ? OK : INV_DT;
+}
+
+VCardErrorCode packDateTime(const DateTime *dt, PackedDateTime *out)
+{
+    if (!dt || !out || dt->isText || !dt->date || !dt->time)
+        return INV_DT;
+    clearPackedDateTime(out);
+    size_t dateLength = strlen(dt->date);
+    size_t timeLength = strlen(dt->time);
+    bool ok = dateLength > 0 || timeLength > 0;
+    if (ok && dateLength > 0)
+        ok = parseDatePart(dt->date, dateLength, timeLength > 0, out);
+    if (ok && timeLength > 0)
+        ok = parseTimePart(dt->time, timeLength, dateLength > 0, out);
+    // UTC is the same zone as a Z in the time.
+    if (ok && dt->UTC)
+    {
+        ok = !(out->fields & DATE_HAS_ZONE) || out->utcOffset == 0;
+        out->fields |= DATE_HAS_ZONE;
+    }
+    if (!ok)
+        clearPackedDateTime(out);
+    return ok ? OK : INV_DT;
+}
+
+/**
+ * Orders the fields of a packed date-and-or-time as one integer: year, month, day, hour,
+ * minute and second from the most significant bits down. Absent fields are zero.
+ */
+static uint64_t packedDateTimeKey(const PackedDateTime *dt)
+{
+    return (uint64_t)dt->year << 40 | (uint64_t)dt->month << 32 | (uint64_t)dt->day << 24 |
+           (uint64_t)dt->hour << 16 | (uint64_t)dt->minute << 8 | (uint64_t)dt->second;
+}
+
+int comparePackedDateTimes(const PackedDateTime *first, const PackedDateTime *second)
+{
+    uint64_t a = packedDateTimeKey(first);
+    uint64_t b = packedDateTimeKey(second);
+    if (a != b)
+        return a < b ? -1 : 1;
+    // A reduced form has a subset of the presence flags, so it sorts first.
+    if (first->fields != second->fields)
+        return first->fields < second->fields ? -1 : 1;
+    return (first->utcOffset > second->utcOffset) - (first->utcOffset < second->utcOffset);
+}
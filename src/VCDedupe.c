@@ -0,0 +1,611 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../include/VCParser.h"
+#include "../include/VCThreadPool.h"
+
+/*	Duplicate detection runs in four steps, none of which compares every pair of cards:
+	1. Each card is reduced, in parallel, to the hashes of its normalized FN, UID, email
+	   addresses and phone numbers, and to a MinHash sketch of the trigrams of its FN.
+	2. Every hash, and every band of rows of the sketch, becomes a blocking key. The keys
+	   are scattered into partitions by their top byte.
+	3. Each partition is sorted on its own worker. Cards sharing a UID or an email address
+	   are duplicates outright; within any other block, each card is scored against the
+	   next few cards only, so a block of common keys costs linear time.
+	4. The accepted pairs are merged with union-find.
+*/
+#define MAX_NAME_LENGTH 256
+#define MAX_NAME_WORDS 16
+#define MAX_EMAILS 4
+#define MAX_PHONES 4
+#define MIN_PHONE_DIGITS 7
+#define PHONE_DIGITS 10
+#define SKETCH_SIZE 16
+#define BAND_ROWS 2
+#define BANDS (SKETCH_SIZE / BAND_ROWS)
+#define SIMILAR_SKETCH_ROWS 8
+#define MAX_CARD_KEYS (2 + MAX_EMAILS + MAX_PHONES + BANDS)
+#define BLOCK_WINDOW 8
+#define PARTITIONS 256
+#define DUPLICATE_SCORE 2
+
+typedef enum blockKind
+{
+    NAME_BLOCK,
+    UID_BLOCK,
+    EMAIL_BLOCK,
+    PHONE_BLOCK,
+    BAND_BLOCK
+} BlockKind;
+
+/*	What duplicate detection knows of one card. A hash of 0 means the field is absent. */
+typedef struct cardFeatures
+{
+    uint64_t name;
+    uint64_t uid;
+    uint64_t emails[MAX_EMAILS];
+    uint64_t phones[MAX_PHONES];
+    uint16_t sketch[SKETCH_SIZE];
+    uint8_t emailCount;
+    uint8_t phoneCount;
+} CardFeatures;
+
+/*	One blocking key of one card. */
+typedef struct blockEntry
+{
+    uint64_t key;
+    uint32_t card;
+    uint32_t kind;
+} BlockEntry;
+
+/*	A pair of cards found to be duplicates. */
+typedef struct cardPair
+{
+    uint32_t first;
+    uint32_t second;
+} CardPair;
+
+/*	The keys of one partition and the pairs found in it. */
+typedef struct partition
+{
+    BlockEntry *entries;
+    size_t count;
+    CardPair *pairs;
+    size_t pairCount;
+    size_t pairCapacity;
+    bool failed;
+} Partition;
+
+typedef struct dedupeRun
+{
+    const Card *const *cards;
+    CardFeatures *features;
+    Partition *partitions;
+} DedupeRun;
+
+/* Odd multipliers of the MinHash functions, one per row of the sketch. */
+static const uint64_t sketchMultipliers[SKETCH_SIZE] = {
+    0x9E3779B97F4A7C15u, 0xC2B2AE3D27D4EB4Fu, 0x165667B19E3779F9u, 0xD6E8FEB86659FD93u,
+    0xFF51AFD7ED558CCDu, 0xC4CEB9FE1A85EC53u, 0x94D049BB133111EBu, 0xBF58476D1CE4E5B9u,
+    0x2545F4914F6CDD1Du, 0x5851F42D4C957F2Du, 0x14057B7EF767814Fu, 0xA0761D6478BD642Fu,
+    0xE7037ED1A0B428DBu, 0x8EBC6AF09C88C6E3u, 0x589965CC75374CC3u, 0x1D8E4E27C47D124Fu};
+
+/**
+ * Scrambles a 64-bit value so that every input bit affects every output bit (the
+ * splitmix64 finalizer).
+ */
+static uint64_t mixBits(uint64_t value)
+{
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9u;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBu;
+    return value ^ (value >> 31);
+}
+
+/**
+ * Hashes a byte string with FNV-1a, then scrambles it with a seed. Never returns 0, which
+ * marks an absent field.
+ */
+static uint64_t hashBytes(const char *bytes, size_t length, uint64_t seed)
+{
+    uint64_t hash = 14695981039346656037u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)bytes[i];
+        hash *= 1099511628211u;
+    }
+    hash = mixBits(hash ^ seed);
+    return hash ? hash : 1;
+}
+
+static char foldByte(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c + 'a' - 'A') : c;
+}
+
+static bool isNameByte(unsigned char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+/*	One word of a name being normalized. */
+typedef struct nameWord
+{
+    const char *start;
+    size_t length;
+} NameWord;
+
+static int compareNameWords(const NameWord *first, const NameWord *second)
+{
+    size_t length = first->length < second->length ? first->length : second->length;
+    int order = memcmp(first->start, second->start, length);
+    return order != 0 ? order : (first->length > second->length) - (first->length < second->length);
+}
+
+/**
+ * Normalizes a name for comparison: words are runs of letters, digits and non-ASCII
+ * bytes, lowercased and sorted, so "Smith, John" and "john  SMITH" agree.
+ * @param name The name.
+ * @param normalized Buffer of MAX_NAME_LENGTH bytes for the words, joined by spaces.
+ * @return The length of the normalized name.
+ */
+static size_t normalizeName(const char *name, char *normalized)
+{
+    char folded[MAX_NAME_LENGTH];
+    NameWord words[MAX_NAME_WORDS];
+    size_t wordCount = 0;
+    size_t length = 0;
+    for (const unsigned char *c = (const unsigned char *)name; *c && wordCount < MAX_NAME_WORDS;)
+    {
+        while (*c && !isNameByte(*c))
+            c++;
+        size_t start = length;
+        for (; *c && isNameByte(*c); c++)
+        {
+            if (length < MAX_NAME_LENGTH)
+                folded[length++] = foldByte((char)*c);
+        }
+        if (length > start)
+            words[wordCount++] = (NameWord){folded + start, length - start};
+    }
+    // Insertion sort: names have few words.
+    for (size_t i = 1; i < wordCount; i++)
+    {
+        NameWord word = words[i];
+        size_t j = i;
+        for (; j > 0 && compareNameWords(&words[j - 1], &word) > 0; j--)
+            words[j] = words[j - 1];
+        words[j] = word;
+    }
+    size_t out = 0;
+    for (size_t i = 0; i < wordCount && out < MAX_NAME_LENGTH; i++)
+    {
+        if (i > 0)
+            normalized[out++] = ' ';
+        size_t copy = words[i].length < MAX_NAME_LENGTH - out ? words[i].length : MAX_NAME_LENGTH - out;
+        memcpy(normalized + out, words[i].start, copy);
+        out += copy;
+    }
+    return out;
+}
+
+/**
+ * Fills the MinHash sketch of the trigrams of a normalized name, padded with a space on
+ * each side. Two names agree on each row with probability equal to the Jaccard
+ * similarity of their trigram sets.
+ */
+static void sketchName(const char *name, size_t length, uint16_t *sketch)
+{
+    char padded[MAX_NAME_LENGTH + 2];
+    padded[0] = ' ';
+    memcpy(padded + 1, name, length);
+    padded[length + 1] = ' ';
+    for (int row = 0; row < SKETCH_SIZE; row++)
+        sketch[row] = UINT16_MAX;
+    for (size_t at = 0; at + 3 <= length + 2; at++)
+    {
+        uint64_t trigram = mixBits((uint64_t)(unsigned char)padded[at] << 16 | (uint64_t)(unsigned char)padded[at + 1] << 8 |
+                                   (unsigned char)padded[at + 2]);
+        for (int row = 0; row < SKETCH_SIZE; row++)
+        {
+            uint16_t value = (uint16_t)((trigram * sketchMultipliers[row]) >> 48);
+            if (value < sketch[row])
+                sketch[row] = value;
+        }
+    }
+}
+
+/**
+ * Hashes the last PHONE_DIGITS digits of a phone number, so that "+1 (555) 010-0123"
+ * and "tel:555-010-0123" agree. Numbers with fewer than MIN_PHONE_DIGITS digits are
+ * ignored.
+ * @return The hash, or 0 if the number is ignored.
+ */
+static uint64_t hashPhone(const char *value)
+{
+    char digits[PHONE_DIGITS];
+    size_t count = 0;
+    // URI parameters such as ;ext=12 are not part of the number.
+    for (const char *c = value; *c && *c != ';'; c++)
+    {
+        if (*c >= '0' && *c <= '9')
+            digits[count++ % PHONE_DIGITS] = *c;
+    }
+    if (count < MIN_PHONE_DIGITS)
+        return 0;
+    // Rotate the ring buffer of the last digits into order.
+    char ordered[PHONE_DIGITS];
+    size_t kept = count < PHONE_DIGITS ? count : PHONE_DIGITS;
+    for (size_t i = 0; i < kept; i++)
+        ordered[i] = digits[(count - kept + i) % PHONE_DIGITS];
+    return hashBytes(ordered, kept, PHONE_BLOCK);
+}
+
+/**
+ * Hashes an email address or a UID, lowercased and trimmed, without a mailto: or
+ * urn:uuid: prefix.
+ * @return The hash, or 0 for an empty value.
+ */
+static uint64_t hashIdentifier(const char *value, const char *prefix, uint64_t seed)
+{
+    while (*value == ' ' || *value == '\t')
+        value++;
+    size_t prefixLength = strlen(prefix);
+    if (strncasecmp(value, prefix, prefixLength) == 0)
+        value += prefixLength;
+    size_t length = strlen(value);
+    while (length > 0 && (value[length - 1] == ' ' || value[length - 1] == '\t'))
+        length--;
+    if (length == 0)
+        return 0;
+    uint64_t hash = 14695981039346656037u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)foldByte(value[i]);
+        hash *= 1099511628211u;
+    }
+    hash = mixBits(hash ^ seed);
+    return hash ? hash : 1;
+}
+
+static const char *firstValue(const Property *property)
+{
+    return property && property->values ? getFromFront(property->values) : NULL;
+}
+
+/**
+ * Reduces one card to its features. Runs on a pool worker.
+ * @param index The position of the card.
+ * @param context The DedupeRun.
+ * @return true, so that every card is reduced.
+ */
+static bool extractFeatures(size_t index, void *context)
+{
+    DedupeRun *run = context;
+    const Card *card = run->cards[index];
+    CardFeatures *features = &run->features[index];
+    memset(features, 0, sizeof(CardFeatures));
+    for (int row = 0; row < SKETCH_SIZE; row++)
+        features->sketch[row] = UINT16_MAX;
+    if (!card)
+        return true;
+
+    const char *fn = firstValue(card->fn);
+    if (fn)
+    {
+        char name[MAX_NAME_LENGTH];
+        size_t length = normalizeName(fn, name);
+        if (length > 0)
+        {
+            features->name = hashBytes(name, length, NAME_BLOCK);
+            sketchName(name, length, features->sketch);
+        }
+    }
+    ListIterator properties = createIterator(card->optionalProperties);
+    Property *property;
+    while ((property = nextElement(&properties)) != NULL)
+    {
+        const char *value = property->name ? firstValue(property) : NULL;
+        if (!value)
+            continue;
+        switch (propertyKind(property->name))
+        {
+        case PROP_UID:
+            if (!features->uid)
+                features->uid = hashIdentifier(value, "urn:uuid:", UID_BLOCK);
+            break;
+        case PROP_EMAIL:
+            if (features->emailCount < MAX_EMAILS && strchr(value, '@'))
+                features->emails[features->emailCount++] = hashIdentifier(value, "mailto:", EMAIL_BLOCK);
+            break;
+        case PROP_TEL:
+        {
+            uint64_t phone = hashPhone(value);
+            if (phone && features->phoneCount < MAX_PHONES)
+                features->phones[features->phoneCount++] = phone;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * Lists the blocking keys of a card.
+ * @param features The features of the card.
+ * @param keys Receives up to MAX_CARD_KEYS keys.
+ * @param kinds Receives the BlockKind of each key.
+ * @return The number of keys.
+ */
+static size_t cardKeys(const CardFeatures *features, uint64_t *keys, uint32_t *kinds)
+{
+    size_t count = 0;
+    if (features->name)
+    {
+        keys[count] = features->name;
+        kinds[count++] = NAME_BLOCK;
+        for (int band = 0; band < BANDS; band++)
+        {
+            uint64_t rows = (uint64_t)band << 32;
+            for (int row = 0; row < BAND_ROWS; row++)
+                rows |= (uint64_t)features->sketch[band * BAND_ROWS + row] << (16 * row);
+            keys[count] = mixBits(rows ^ ((uint64_t)BAND_BLOCK << 56));
+            kinds[count++] = BAND_BLOCK;
+        }
+    }
+    if (features->uid)
+    {
+        keys[count] = features->uid;
+        kinds[count++] = UID_BLOCK;
+    }
+    for (int i = 0; i < features->emailCount; i++)
+    {
+        keys[count] = features->emails[i];
+        kinds[count++] = EMAIL_BLOCK;
+    }
+    for (int i = 0; i < features->phoneCount; i++)
+    {
+        keys[count] = features->phones[i];
+        kinds[count++] = PHONE_BLOCK;
+    }
+    return count;
+}
+
+static bool shareHash(const uint64_t *first, int firstCount, const uint64_t *second, int secondCount)
+{
+    for (int i = 0; i < firstCount; i++)
+    {
+        for (int j = 0; j < secondCount; j++)
+        {
+            if (first[i] == second[j])
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Scores how likely two cards are to describe the same contact. A shared UID or email
+ * address scores DUPLICATE_SCORE on its own; a shared phone number and an equal or
+ * similar name score one each.
+ */
+static int scorePair(const CardFeatures *first, const CardFeatures *second)
+{
+    int score = 0;
+    if (first->uid && first->uid == second->uid)
+        score += 2;
+    if (shareHash(first->emails, first->emailCount, second->emails, second->emailCount))
+        score += 2;
+    if (shareHash(first->phones, first->phoneCount, second->phones, second->phoneCount))
+        score++;
+    if (first->name && first->name == second->name)
+        score++;
+    else if (first->name && second->name)
+    {
+        int equalRows = 0;
+        for (int row = 0; row < SKETCH_SIZE; row++)
+            equalRows += first->sketch[row] == second->sketch[row];
+        score += equalRows >= SIMILAR_SKETCH_ROWS;
+    }
+    return score;
+}
+
+static bool addPair(Partition *partition, uint32_t first, uint32_t second)
+{
+    if (partition->pairCount == partition->pairCapacity)
+    {
+        size_t capacity = partition->pairCapacity ? partition->pairCapacity * 2 : 64;
+        CardPair *pairs = realloc(partition->pairs, capacity * sizeof(CardPair));
+        if (!pairs)
+            return false;
+        partition->pairs = pairs;
+        partition->pairCapacity = capacity;
+    }
+    partition->pairs[partition->pairCount++] = (CardPair){first, second};
+    return true;
+}
+
+static int compareBlockEntries(const void *first, const void *second)
+{
+    const BlockEntry *a = first;
+    const BlockEntry *b = second;
+    if (a->key != b->key)
+        return a->key < b->key ? -1 : 1;
+    if (a->kind != b->kind)
+        return a->kind < b->kind ? -1 : 1;
+    return (a->card > b->card) - (a->card < b->card);
+}
+
+/**
+ * Sorts one partition of blocking keys and finds the duplicate pairs in its blocks. Runs
+ * on a pool worker.
+ * @param index The partition number.
+ * @param context The DedupeRun.
+ * @return true, so that every partition is processed.
+ */
+static bool findPartitionPairs(size_t index, void *context)
+{
+    DedupeRun *run = context;
+    Partition *partition = &run->partitions[index];
+    BlockEntry *entries = partition->entries;
+    qsort(entries, partition->count, sizeof(BlockEntry), compareBlockEntries);
+    bool ok = true;
+    for (size_t start = 0, end; ok && start < partition->count; start = end)
+    {
+        for (end = start + 1; end < partition->count && entries[end].key == entries[start].key &&
+                              entries[end].kind == entries[start].kind;
+             end++)
+            ;
+        bool identifies = entries[start].kind == UID_BLOCK || entries[start].kind == EMAIL_BLOCK;
+        for (size_t i = start; ok && i + 1 < end; i++)
+        {
+            // A shared UID or email address links the whole block, one card to the next.
+            if (identifies)
+            {
+                ok = addPair(partition, entries[i].card, entries[i + 1].card);
+                continue;
+            }
+            size_t last = end - i > BLOCK_WINDOW ? i + BLOCK_WINDOW : end - 1;
+            for (size_t j = i + 1; ok && j <= last; j++)
+            {
+                uint32_t first = entries[i].card;
+                uint32_t second = entries[j].card;
+                if (first != second && scorePair(&run->features[first], &run->features[second]) >= DUPLICATE_SCORE)
+                    ok = addPair(partition, first, second);
+            }
+        }
+    }
+    partition->failed = !ok;
+    return true;
+}
+
+/**
+ * Finds the representative of a card's set, halving the path on the way.
+ */
+static uint32_t findRoot(uint32_t *parents, uint32_t card)
+{
+    while (parents[card] != card)
+    {
+        parents[card] = parents[parents[card]];
+        card = parents[card];
+    }
+    return card;
+}
+
+/**
+ * Scatters the blocking keys of every card into partitions by the top byte of the key.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool partitionKeys(DedupeRun *run, size_t count)
+{
+    uint64_t keys[MAX_CARD_KEYS];
+    uint32_t kinds[MAX_CARD_KEYS];
+    for (size_t card = 0; card < count; card++)
+    {
+        size_t keyCount = cardKeys(&run->features[card], keys, kinds);
+        for (size_t k = 0; k < keyCount; k++)
+            run->partitions[keys[k] >> 56].count++;
+    }
+    for (size_t p = 0; p < PARTITIONS; p++)
+    {
+        run->partitions[p].entries = malloc((run->partitions[p].count + 1) * sizeof(BlockEntry));
+        if (!run->partitions[p].entries)
+            return false;
+        run->partitions[p].count = 0;
+    }
+    for (size_t card = 0; card < count; card++)
+    {
+        size_t keyCount = cardKeys(&run->features[card], keys, kinds);
+        for (size_t k = 0; k < keyCount; k++)
+        {
+            Partition *partition = &run->partitions[keys[k] >> 56];
+            partition->entries[partition->count++] = (BlockEntry){keys[k], (uint32_t)card, kinds[k]};
+        }
+    }
+    return true;
+}
+
+/**
+ * Groups the cards of a corpus that likely describe the same contact.
+ * @param cards The cards. NULL entries are never duplicates.
+ * @param count The number of cards.
+ * @param options The options, or NULL for the defaults.
+ * @param clusters Receives, for each card, the position of the first card of its group.
+ *                 A card without duplicates is its own group.
+ * @return The number of groups with more than one card, or -1 for invalid arguments or a
+ *         memory allocation failure.
+ */
+int findDuplicateCards(const Card *const *cards, int count, const DedupeOptions *options, int *clusters)
+{
+    if (count < 0 || (count > 0 && (!cards || !clusters)))
+        return -1;
+    size_t workers = options && options->threads > 0 ? (size_t)options->threads : 0;
+    DedupeRun run = {cards, malloc(((size_t)count + 1) * sizeof(CardFeatures)), calloc(PARTITIONS, sizeof(Partition))};
+    uint32_t *parents = malloc(((size_t)count + 1) * sizeof(uint32_t));
+    bool ok = run.features && run.partitions && parents;
+    if (ok)
+    {
+        runWorkStealing((size_t)count, workers, extractFeatures, &run);
+        ok = partitionKeys(&run, (size_t)count);
+    }
+    if (ok)
+        runWorkStealing(PARTITIONS, workers, findPartitionPairs, &run);
+
+    int groups = 0;
+    if (ok)
+    {
+        for (uint32_t card = 0; card < (uint32_t)count; card++)
+            parents[card] = card;
+        for (size_t p = 0; p < PARTITIONS; p++)
+        {
+            ok = ok && !run.partitions[p].failed;
+            for (size_t i = 0; i < run.partitions[p].pairCount; i++)
+            {
+                uint32_t first = findRoot(parents, run.partitions[p].pairs[i].first);
+                uint32_t second = findRoot(parents, run.partitions[p].pairs[i].second);
+                // The lower position becomes the root, so each root is its group's first card.
+                if (first < second)
+                    parents[second] = first;
+                else if (second < first)
+                    parents[first] = second;
+            }
+        }
+        for (uint32_t card = 0; ok && card < (uint32_t)count; card++)
+            clusters[card] = (int)findRoot(parents, card);
+        // The parents are no longer needed; reuse them to mark the groups already counted.
+        memset(parents, 0, (size_t)count * sizeof(uint32_t));
+        for (int card = 0; ok && card < count; card++)
+        {
+            int root = clusters[card];
+            if (root != card && !parents[root])
+            {
+                parents[root] = 1;
+                groups++;
+            }
+        }
+    }
+
+    if (run.partitions)
+    {
+        for (size_t p = 0; p < PARTITIONS; p++)
+        {
+            free(run.partitions[p].entries);
+            free(run.partitions[p].pairs);
+        }
+    }
+    free(run.partitions);
+    free(run.features);
+    free(parents);
+    return ok ? groups : -1;
+}
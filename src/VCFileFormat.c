@@ -0,0 +1,78 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/VCFileFormat.h"
+
+/*	Fold of U+00C0 to U+00FF to lowercase ASCII. NULL keeps the character (the
+	multiplication and division signs).
+*/
+static const char *const latinFolds[64] = {
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", NULL, "o", "u", "u", "u", "u", "y", "th", "ss",
+    "a", "a", "a", "a", "a", "a", "ae", "c", "e", "e", "e", "e", "i", "i", "i", "i",
+    "d", "n", "o", "o", "o", "o", "o", NULL, "o", "u", "u", "u", "u", "y", "th", "y"};
+
+/**
+ * Writes a whole file under a temporary name and renames it into place, so that readers
+ * that still map the old file are not disturbed.
+ * @param fileName The file to create or replace.
+ * @param head The first part of the contents.
+ * @param headLength The length of head.
+ * @param tail The second part of the contents, or NULL.
+ * @param tailLength The length of tail.
+ * @return true on success.
+ */
+bool replaceFile(const char *fileName, const void *head, size_t headLength, const void *tail, size_t tailLength)
+{
+    size_t nameLength = strlen(fileName);
+    char *tempName = malloc(nameLength + sizeof(".tmp"));
+    if (!tempName)
+        return false;
+    memcpy(tempName, fileName, nameLength);
+    memcpy(tempName + nameLength, ".tmp", sizeof(".tmp"));
+    int fd = open(tempName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    bool ok = fd >= 0;
+    const char *parts[2] = {head, tail};
+    size_t lengths[2] = {headLength, tail ? tailLength : 0};
+    for (int part = 0; ok && part < 2; part++)
+    {
+        for (size_t done = 0; ok && done < lengths[part];)
+        {
+            ssize_t written = write(fd, parts[part] + done, lengths[part] - done);
+            if (written < 0 && errno == EINTR)
+                continue;
+            ok = written > 0;
+            done += ok ? (size_t)written : 0;
+        }
+    }
+    if (fd >= 0 && close(fd) != 0)
+        ok = false;
+    if (ok)
+        ok = rename(tempName, fileName) == 0;
+    if (!ok)
+        unlink(tempName);
+    free(tempName);
+    return ok;
+}
+
+/**
+ * Folds an accented Latin-1 letter, encoded in UTF-8, to lowercase ASCII.
+ * @param text The character.
+ * @return The ASCII letters it folds to, or NULL if it is not a letter of U+00C0 to U+00FF.
+ */
+const char *foldLatinLetter(const unsigned char *text)
+{
+    if (text[0] != 0xC3 || text[1] < 0x80 || text[1] > 0xBF)
+        return NULL;
+    return latinFolds[text[1] - 0x80];
+}
@@ -0,0 +1,236 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/VCParser.h"
+
+/*	A fingerprint is the sum, lane by lane, of a 128-bit hash of every property, so the
+	order of the properties does not matter. Each property hash covers the case-folded
+	name and group, the sum of the hashes of its parameters (whose order does not matter
+	either) and its values in order. The birthday and anniversary are hashed through
+	their packed form, so equal dates written differently agree.
+*/
+#define FINGERPRINT_PROPERTY 0x50u
+#define FINGERPRINT_PARAMETER 0x51u
+#define FINGERPRINT_BIRTHDAY 0x52u
+#define FINGERPRINT_ANNIVERSARY 0x53u
+
+/*	Running state of a 128-bit hash: two lanes fed the same words with different
+	multipliers.
+*/
+typedef struct fingerprintHash
+{
+    uint64_t a;
+    uint64_t b;
+} FingerprintHash;
+
+/**
+ * Rotates a 64-bit value left.
+ * @param value The value.
+ * @param bits The number of bits, from 1 to 63.
+ * @return The rotated value.
+ */
+static uint64_t rotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/**
+ * Scrambles a 64-bit value so that every input bit affects every output bit (the
+ * splitmix64 finalizer).
+ * @param value The value.
+ * @return The scrambled value.
+ */
+static uint64_t finishLane(uint64_t value)
+{
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9u;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBu;
+    return value ^ (value >> 31);
+}
+
+/**
+ * Starts a hash. Each kind of item (property, parameter, birthday, anniversary) uses its
+ * own seed, so that items of different kinds never hash alike.
+ * @param seed The seed.
+ * @return The initial state.
+ */
+static FingerprintHash startHash(uint64_t seed)
+{
+    return (FingerprintHash){0x9E3779B97F4A7C15u ^ seed, 0xC2B2AE3D27D4EB4Fu + seed};
+}
+
+/**
+ * Feeds one 64-bit word to both lanes of a hash.
+ * @param hash The hash.
+ * @param word The word.
+ */
+static void hashWord(FingerprintHash *hash, uint64_t word)
+{
+    hash->a = rotateLeft(hash->a ^ word, 31) * 0x87C37B91114253D5u;
+    hash->b = rotateLeft(hash->b + word, 27) * 0x4CF5AD432745937Fu;
+}
+
+/**
+ * Feeds a string to a hash eight bytes at a time, followed by its length, so that
+ * consecutive strings cannot run into each other.
+ * @param hash The hash.
+ * @param text The string. NULL is hashed like an empty string.
+ * @param fold Whether ASCII letters are folded to lower case.
+ */
+static void hashText(FingerprintHash *hash, const char *text, bool fold)
+{
+    size_t length = text ? strlen(text) : 0;
+    size_t at = 0;
+    for (; at + 8 <= length; at += 8)
+    {
+        uint64_t word;
+        memcpy(&word, text + at, 8);
+        if (fold)
+        {
+            // Sets bit 5 of every byte from 'A' to 'Z' at once.
+            uint64_t high = 0x8080808080808080u;
+            uint64_t aboveA = (word | high) - 0x4141414141414141u;
+            uint64_t aboveZ = (word | high) - 0x5B5B5B5B5B5B5B5Bu;
+            uint64_t upper = aboveA & ~aboveZ & ~word & high;
+            word |= upper >> 2;
+        }
+        hashWord(hash, word);
+    }
+    uint64_t tail = 0;
+    for (size_t i = 0; at + i < length; i++)
+    {
+        unsigned char c = (unsigned char)text[at + i];
+        if (fold && c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+        tail |= (uint64_t)c << (8 * i);
+    }
+    hashWord(hash, tail);
+    hashWord(hash, length);
+}
+
+/**
+ * Ends a hash, adding its lanes to the running sums of a fingerprint.
+ * @param sum The running sums.
+ * @param hash The hash to end.
+ */
+static void addHash(CardFingerprint *sum, FingerprintHash hash)
+{
+    uint64_t a = finishLane(hash.a + hash.b);
+    uint64_t b = finishLane(hash.b ^ rotateLeft(hash.a, 17));
+    sum->low += a;
+    sum->high += b;
+}
+
+/**
+ * Adds the hash of one property to the sums of a fingerprint. Because the sums are
+ * commutative, the fingerprint does not depend on the order in which properties are
+ * added; this stands in for hashing the properties in a sorted, canonical order. The
+ * parameters are summed the same way into a pair of words hashed with the property, so
+ * their order does not matter either, while the values are hashed in order.
+ * @param sum The running sums of the fingerprint.
+ * @param prop The property.
+ */
+static void hashProperty(CardFingerprint *sum, const Property *prop)
+{
+    FingerprintHash hash = startHash(FINGERPRINT_PROPERTY);
+    hashText(&hash, prop->name, true);
+    hashText(&hash, prop->group, true);
+
+    CardFingerprint params = {0, 0};
+    ListIterator paramIter = createIterator(prop->parameters);
+    const Parameter *param;
+    while ((param = nextElement(&paramIter)) != NULL)
+    {
+        FingerprintHash paramHash = startHash(FINGERPRINT_PARAMETER);
+        hashText(&paramHash, param->name, true);
+        hashText(&paramHash, param->value, false);
+        addHash(&params, paramHash);
+    }
+    hashWord(&hash, params.low);
+    hashWord(&hash, params.high);
+
+    ListIterator valueIter = createIterator(prop->values);
+    const char *value;
+    uint64_t count = 0;
+    while ((value = nextElement(&valueIter)) != NULL)
+    {
+        hashText(&hash, value, false);
+        count++;
+    }
+    hashWord(&hash, count);
+    addHash(sum, hash);
+}
+
+/**
+ * Adds the hash of a birthday or anniversary to the sums of a fingerprint. A date that
+ * packDateTime accepts is hashed through its packed fields, so equal dates written
+ * differently agree; any other date is hashed as written.
+ * @param sum The running sums of the fingerprint.
+ * @param dt The date.
+ * @param seed FINGERPRINT_BIRTHDAY or FINGERPRINT_ANNIVERSARY.
+ */
+static void hashDate(CardFingerprint *sum, const DateTime *dt, uint64_t seed)
+{
+    FingerprintHash hash = startHash(seed);
+    PackedDateTime packed;
+    if (packDateTime(dt, &packed) == OK)
+    {
+        hashWord(&hash, (uint64_t)packed.year << 48 | (uint64_t)packed.month << 40 | (uint64_t)packed.day << 32 |
+                            (uint64_t)packed.hour << 24 | (uint64_t)packed.minute << 16 | (uint64_t)packed.second << 8 |
+                            packed.fields);
+        hashWord(&hash, (uint64_t)(uint16_t)packed.utcOffset);
+    }
+    else
+    {
+        // Text and unparsable values are compared as written.
+        hashWord(&hash, (uint64_t)dt->isText << 1 | (uint64_t)dt->UTC);
+        hashText(&hash, dt->date, false);
+        hashText(&hash, dt->time, false);
+        hashText(&hash, dt->text, false);
+    }
+    addHash(sum, hash);
+}
+
+/**
+ * Computes the fingerprint of a Card: the sums of the hashes of FN, the optional
+ * properties and the dates, mixed with the number of properties.
+ * @param card The Card.
+ * @param out Receives the fingerprint.
+ * @return OK on success, or INV_CARD if an argument is NULL.
+ */
+VCardErrorCode cardFingerprint(const Card *card, CardFingerprint *out)
+{
+    if (!card || !out)
+        return INV_CARD;
+    CardFingerprint sum = {0, 0};
+    uint64_t count = 0;
+    if (card->fn)
+    {
+        hashProperty(&sum, card->fn);
+        count++;
+    }
+    ListIterator iter = createIterator(card->optionalProperties);
+    const Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
+    {
+        hashProperty(&sum, prop);
+        count++;
+    }
+    if (card->birthday)
+        hashDate(&sum, card->birthday, FINGERPRINT_BIRTHDAY);
+    if (card->anniversary)
+        hashDate(&sum, card->anniversary, FINGERPRINT_ANNIVERSARY);
+
+    // Mixing the sums with the count keeps cards with no properties from sharing 0.
+    FingerprintHash total = startHash(count);
+    hashWord(&total, sum.low);
+    hashWord(&total, sum.high);
+    out->low = finishLane(total.a);
+    out->high = finishLane(total.b ^ total.a);
+    return OK;
+}
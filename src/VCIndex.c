@@ -0,0 +1,674 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/VCFileFormat.h"
+#include "../include/VCParser.h"
+
+/*	Layout of an index file, all integers little-endian:
+	page 0        header: "VCIX", version, page size, page count, record count,
+	              root page of the name tree, root page of the date tree, string length
+	pages 1..n-1  B+tree pages of both trees
+	records       four u32 string offsets per record: file name, FN, birthday, anniversary
+	strings       the NUL-terminated strings of the records
+
+	Both trees are bulk-loaded from sorted keys, so every page is full except the last of
+	each level. A page starts with its type, its cell count and a link (the next leaf of a
+	leaf, the first child of a branch), then an array of u16 cell offsets; the cells are
+	packed from the end of the page. A cell is a u16 key length and the key, followed in a
+	branch by the u32 child holding the keys from that key on. Every key ends with the
+	big-endian record number, so keys are unique and equal sort keys keep record order.
+*/
+#define INDEX_MAGIC "VCIX"
+#define INDEX_VERSION 1u
+#define INDEX_PAGE_SIZE 4096u
+#define PAGE_HEADER_SIZE 8u
+#define LEAF_PAGE 1
+#define BRANCH_PAGE 2
+#define RECORD_SIZE 16u
+#define RECORD_ID_SIZE 4u
+#define DATE_KEY_SIZE (3u + RECORD_ID_SIZE)
+#define MAX_TREE_DEPTH 32
+#define MAX_PREFIX_LENGTH 1024
+
+typedef struct indexKey
+{
+    const unsigned char *bytes;
+    uint16_t length;
+} IndexKey;
+
+/*	First key and page of each node of the tree level being built. */
+typedef struct levelNode
+{
+    IndexKey first;
+    uint32_t page;
+} LevelNode;
+
+/*	Growable image of the page area of an index file. */
+typedef struct pageImage
+{
+    unsigned char *data;
+    uint32_t pageCount;
+    uint32_t capacity;
+} PageImage;
+
+struct cardIndex
+{
+    const unsigned char *data;
+    size_t length;
+    uint32_t pageCount;
+    uint32_t recordCount;
+    uint32_t nameRoot;
+    uint32_t dateRoot;
+    const unsigned char *records;
+    const char *strings;
+    uint32_t stringLength;
+};
+
+static uint32_t loadU32BigEndian(const unsigned char *in)
+{
+    return (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 | (uint32_t)in[2] << 8 | (uint32_t)in[3];
+}
+
+/**
+ * Writes the collation key of a name: leading and trailing white space is dropped, runs
+ * of white space become one space, ASCII letters are lowercased and accented Latin-1
+ * letters are folded to ASCII. Other characters keep their UTF-8 bytes, so keys sort in
+ * code point order past ASCII.
+ * @param text The name.
+ * @param key The buffer for the key.
+ * @param capacity The size of the buffer. The key is cut off to fit.
+ * @return The length of the key.
+ */
+static size_t collationKey(const char *text, unsigned char *key, size_t capacity)
+{
+    size_t length = 0;
+    bool space = false;
+    for (const unsigned char *c = (const unsigned char *)text; *c && length < capacity; c++)
+    {
+        if (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')
+        {
+            space = length > 0;
+            continue;
+        }
+        if (space)
+        {
+            key[length++] = ' ';
+            space = false;
+            if (length == capacity)
+                break;
+        }
+        const char *fold = foldLatinLetter(c);
+        if (fold)
+        {
+            for (; *fold && length < capacity; fold++)
+                key[length++] = (unsigned char)*fold;
+            c++;
+        }
+        else
+            key[length++] = (*c >= 'A' && *c <= 'Z') ? (unsigned char)(*c + 'a' - 'A') : *c;
+    }
+    return length;
+}
+
+/**
+ * Reads the month and day of a summary date. Dates without a month, text dates and
+ * dates that are only a time have none. A date with a month but no day has day 0.
+ * @param text The date as a summary renders it, e.g. "19540203T1200", "--0203" or "2009-08".
+ * @param month Set to the month, 1 to 12.
+ * @param day Set to the day, 0 to 31.
+ * @return true if the date has a month.
+ */
+static bool dateMonthDay(const char *text, int *month, int *day)
+{
+    PackedDateTime packed;
+    if (parseDateAndOrTime(text, &packed) != OK || !(packed.fields & DATE_HAS_MONTH))
+        return false;
+    *month = packed.month;
+    *day = packed.day;
+    return true;
+}
+
+/**
+ * Orders two keys by their bytes, a key before every longer key it is a prefix of.
+ */
+static int compareKeyBytes(const unsigned char *first, size_t firstLength, const unsigned char *second, size_t secondLength)
+{
+    int order = memcmp(first, second, firstLength < secondLength ? firstLength : secondLength);
+    if (order != 0)
+        return order;
+    return firstLength < secondLength ? -1 : firstLength > secondLength;
+}
+
+static int compareIndexKeys(const void *first, const void *second)
+{
+    const IndexKey *a = first;
+    const IndexKey *b = second;
+    return compareKeyBytes(a->bytes, a->length, b->bytes, b->length);
+}
+
+/**
+ * Appends a zeroed page to an image.
+ * @param image The image.
+ * @return The page number, or 0 if memory allocation fails.
+ */
+static uint32_t addPage(PageImage *image)
+{
+    if (image->pageCount == image->capacity)
+    {
+        uint32_t capacity = image->capacity * 2;
+        unsigned char *data = realloc(image->data, (size_t)capacity * INDEX_PAGE_SIZE);
+        if (!data)
+            return 0;
+        image->data = data;
+        image->capacity = capacity;
+    }
+    memset(image->data + (size_t)image->pageCount * INDEX_PAGE_SIZE, 0, INDEX_PAGE_SIZE);
+    return image->pageCount++;
+}
+
+/**
+ * Packs cells into one page, in order, until the page is full.
+ * @param image The image.
+ * @param page The page to fill.
+ * @param keys The keys of the cells.
+ * @param children The child of each cell of a branch, or NULL for a leaf.
+ * @param count The number of keys available.
+ * @return The number of cells packed.
+ */
+static size_t fillPage(PageImage *image, uint32_t page, const IndexKey *keys, const uint32_t *children, size_t count)
+{
+    unsigned char *data = image->data + (size_t)page * INDEX_PAGE_SIZE;
+    size_t childSize = children ? 4 : 0;
+    size_t top = INDEX_PAGE_SIZE;
+    size_t packed = 0;
+    while (packed < count)
+    {
+        size_t cellSize = 2 + keys[packed].length + childSize;
+        if (PAGE_HEADER_SIZE + 2 * (packed + 1) + cellSize > top)
+            break;
+        top -= cellSize;
+        storeU16(data + top, keys[packed].length);
+        memcpy(data + top + 2, keys[packed].bytes, keys[packed].length);
+        if (children)
+            storeU32(data + top + 2 + keys[packed].length, children[packed]);
+        storeU16(data + PAGE_HEADER_SIZE + 2 * packed, (uint16_t)top);
+        packed++;
+    }
+    data[0] = children ? BRANCH_PAGE : LEAF_PAGE;
+    storeU16(data + 2, (uint16_t)packed);
+    return packed;
+}
+
+/**
+ * Bulk-loads a B+tree from sorted keys: the leaves are filled in key order and linked,
+ * then each level of branches is built over the first keys of the level below.
+ * @param image The image the pages are added to.
+ * @param keys The keys, sorted.
+ * @param count The number of keys.
+ * @param root Set to the root page, or 0 for an empty tree.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool buildTree(PageImage *image, const IndexKey *keys, size_t count, uint32_t *root)
+{
+    *root = 0;
+    if (count == 0)
+        return true;
+    LevelNode *level = malloc(count * sizeof(LevelNode));
+    IndexKey *firsts = malloc(count * sizeof(IndexKey));
+    uint32_t *children = malloc(count * sizeof(uint32_t));
+    bool ok = level && firsts && children;
+    size_t nodes = 0;
+    uint32_t previous = 0;
+    for (size_t i = 0; ok && i < count;)
+    {
+        uint32_t page = addPage(image);
+        if (!(ok = page != 0))
+            break;
+        if (previous)
+            storeU32(image->data + (size_t)previous * INDEX_PAGE_SIZE + 4, page);
+        level[nodes++] = (LevelNode){keys[i], page};
+        i += fillPage(image, page, keys + i, NULL, count - i);
+        previous = page;
+    }
+    while (ok && nodes > 1)
+    {
+        // A branch links to the first child of its range; the cells hold the others.
+        for (size_t i = 0; i < nodes; i++)
+        {
+            firsts[i] = level[i].first;
+            children[i] = level[i].page;
+        }
+        size_t parents = 0;
+        for (size_t i = 0; i < nodes;)
+        {
+            uint32_t page = addPage(image);
+            if (!(ok = page != 0))
+                break;
+            storeU32(image->data + (size_t)page * INDEX_PAGE_SIZE + 4, children[i]);
+            level[parents++] = (LevelNode){firsts[i], page};
+            i++;
+            i += fillPage(image, page, firsts + i, children + i, nodes - i);
+        }
+        nodes = parents;
+    }
+    if (ok)
+        *root = level[0].page;
+    free(level);
+    free(firsts);
+    free(children);
+    return ok;
+}
+
+/*	Everything an index file is built from: the record table and strings (the tail of
+	the file), the keys of both trees and the image of the page area.
+*/
+typedef struct indexBuild
+{
+    unsigned char *tail;
+    size_t tailLength;
+    size_t records;
+    unsigned char *nameBytes;
+    unsigned char *dateBytes;
+    IndexKey *nameKeys;
+    IndexKey *dateKeys;
+    size_t names;
+    size_t dates;
+    PageImage image;
+} IndexBuild;
+
+/**
+ * Writes a record number after a key, most significant byte first.
+ * @param key The end of the key.
+ * @param record The record number.
+ */
+static void storeRecordId(unsigned char *key, size_t record)
+{
+    for (size_t b = 0; b < RECORD_ID_SIZE; b++)
+        key[b] = (unsigned char)(record >> (8 * (RECORD_ID_SIZE - 1 - b)));
+}
+
+/**
+ * Fills the records and strings of an index and collects the keys of both trees.
+ * @param build The index being built, with room for every record.
+ * @param fileNames The names of the vCard files.
+ * @param summaries The summary of each file.
+ * @param count The number of files.
+ */
+static void addIndexRecords(IndexBuild *build, const char *const *fileNames, const CardSummary *summaries, int count)
+{
+    unsigned char *strings = build->tail + build->records * RECORD_SIZE;
+    size_t record = 0, stringOffset = 0, nameOffset = 0;
+    for (int i = 0; i < count; i++)
+    {
+        const CardSummary *summary = &summaries[i];
+        if (summary->error != OK || !fileNames[i])
+            continue;
+        const char *fields[4] = {fileNames[i], summary->fn, summary->birthday, summary->anniversary};
+        for (int field = 0; field < 4; field++)
+        {
+            size_t length = strlen(fields[field]) + 1;
+            storeU32(build->tail + record * RECORD_SIZE + 4 * field, (uint32_t)stringOffset);
+            memcpy(strings + stringOffset, fields[field], length);
+            stringOffset += length;
+        }
+
+        // The NUL after the collation key sorts a name before the longer names it begins.
+        unsigned char *key = build->nameBytes + nameOffset;
+        size_t length = collationKey(summary->fn, key, CARD_SUMMARY_FIELD - 1);
+        key[length++] = 0;
+        storeRecordId(key + length, record);
+        length += RECORD_ID_SIZE;
+        build->nameKeys[build->names++] = (IndexKey){key, (uint16_t)length};
+        nameOffset += length;
+
+        const char *dates[2] = {summary->birthday, summary->anniversary};
+        for (int kind = BIRTHDAY_DATE; kind <= ANNIVERSARY_DATE; kind++)
+        {
+            int month, day;
+            if (!dateMonthDay(dates[kind], &month, &day))
+                continue;
+            unsigned char *dateKey = build->dateBytes + build->dates * DATE_KEY_SIZE;
+            dateKey[0] = (unsigned char)kind;
+            dateKey[1] = (unsigned char)month;
+            dateKey[2] = (unsigned char)day;
+            storeRecordId(dateKey + 3, record);
+            build->dateKeys[build->dates++] = (IndexKey){dateKey, DATE_KEY_SIZE};
+        }
+        record++;
+    }
+}
+
+/**
+ * Sorts the keys of an index, builds both trees and writes the index file.
+ * @param indexFileName The index file to create or replace.
+ * @param build The index being built, with its records and keys filled.
+ * @return OK on success, WRITE_ERROR if the file cannot be written, or OTHER_ERROR if
+ *         memory allocation fails.
+ */
+static VCardErrorCode writeIndexFile(const char *indexFileName, IndexBuild *build)
+{
+    qsort(build->nameKeys, build->names, sizeof(IndexKey), compareIndexKeys);
+    qsort(build->dateKeys, build->dates, sizeof(IndexKey), compareIndexKeys);
+    uint32_t nameRoot, dateRoot;
+    if (!buildTree(&build->image, build->nameKeys, build->names, &nameRoot) ||
+        !buildTree(&build->image, build->dateKeys, build->dates, &dateRoot))
+        return OTHER_ERROR;
+
+    unsigned char *header = build->image.data;
+    memset(header, 0, INDEX_PAGE_SIZE);
+    memcpy(header, INDEX_MAGIC, 4);
+    storeU32(header + 4, INDEX_VERSION);
+    storeU32(header + 8, INDEX_PAGE_SIZE);
+    storeU32(header + 12, build->image.pageCount);
+    storeU32(header + 16, (uint32_t)build->records);
+    storeU32(header + 20, nameRoot);
+    storeU32(header + 24, dateRoot);
+    storeU32(header + 28, (uint32_t)(build->tailLength - build->records * RECORD_SIZE));
+    size_t pagesLength = (size_t)build->image.pageCount * INDEX_PAGE_SIZE;
+    return replaceFile(indexFileName, header, pagesLength, build->tail, build->tailLength) ? OK : WRITE_ERROR;
+}
+
+/**
+ * Writes the contact index of a set of summarized cards. Cards that did not parse are
+ * left out. The name tree holds the collation key of every FN; the date tree holds
+ * (kind, month, day) for every birthday and anniversary that has a month.
+ * @param indexFileName The index file to create or replace.
+ * @param fileNames The names of the vCard files.
+ * @param summaries The summary of each file.
+ * @param count The number of files.
+ * @return OK on success, INV_FILE for invalid arguments, WRITE_ERROR if the file cannot
+ *         be written, or OTHER_ERROR if memory allocation fails or the index would be
+ *         too large for its 32-bit offsets.
+ */
+VCardErrorCode writeCardIndex(const char *indexFileName, const char *const *fileNames, const CardSummary *summaries, int count)
+{
+    if (!indexFileName || count < 0 || (count > 0 && (!fileNames || !summaries)))
+        return INV_FILE;
+    size_t records = 0;
+    size_t stringLength = 1;
+    for (int i = 0; i < count; i++)
+    {
+        if (summaries[i].error != OK || !fileNames[i])
+            continue;
+        records++;
+        stringLength += strlen(fileNames[i]) + strlen(summaries[i].fn) + strlen(summaries[i].birthday) +
+                        strlen(summaries[i].anniversary) + 4;
+    }
+    if (records * RECORD_SIZE + stringLength > UINT32_MAX)
+        return OTHER_ERROR;
+
+    IndexBuild build = {0};
+    build.records = records;
+    build.tailLength = records * RECORD_SIZE + stringLength;
+    build.tail = calloc(1, build.tailLength);
+    // A key is at most the FN (folding never lengthens it), a NUL and the record number.
+    build.nameBytes = malloc(records * (CARD_SUMMARY_FIELD + RECORD_ID_SIZE) + 1);
+    build.dateBytes = malloc(records * 2 * DATE_KEY_SIZE + 1);
+    build.nameKeys = malloc((records + 1) * sizeof(IndexKey));
+    build.dateKeys = malloc((records * 2 + 1) * sizeof(IndexKey));
+    build.image = (PageImage){malloc(16 * INDEX_PAGE_SIZE), 1, 16};
+    VCardErrorCode err = OTHER_ERROR;
+    if (build.tail && build.nameBytes && build.dateBytes && build.nameKeys && build.dateKeys && build.image.data)
+    {
+        addIndexRecords(&build, fileNames, summaries, count);
+        err = writeIndexFile(indexFileName, &build);
+    }
+    free(build.tail);
+    free(build.nameBytes);
+    free(build.dateBytes);
+    free(build.nameKeys);
+    free(build.dateKeys);
+    free(build.image.data);
+    return err;
+}
+
+/**
+ * Maps an index file and checks that its header and sections are consistent. The pages
+ * are checked as queries reach them, so a damaged file cannot make a query read outside
+ * the mapping.
+ * @param indexFileName The index file.
+ * @return The index, or NULL if the file cannot be read, is not a valid index or memory
+ *         allocation fails.
+ */
+CardIndex *openCardIndex(const char *indexFileName)
+{
+    if (!indexFileName)
+        return NULL;
+    int fd = open(indexFileName, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || (size_t)info.st_size < INDEX_PAGE_SIZE)
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t length = (size_t)info.st_size;
+    unsigned char *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    CardIndex header = {data, length, loadU32(data + 12), loadU32(data + 16), loadU32(data + 20), loadU32(data + 24), NULL, NULL, loadU32(data + 28)};
+    size_t pagesLength = (size_t)header.pageCount * INDEX_PAGE_SIZE;
+    bool valid = memcmp(data, INDEX_MAGIC, 4) == 0 && loadU32(data + 4) == INDEX_VERSION &&
+                 loadU32(data + 8) == INDEX_PAGE_SIZE && header.pageCount > 0 && header.stringLength > 0 &&
+                 header.nameRoot < header.pageCount && header.dateRoot < header.pageCount &&
+                 pagesLength <= length && (length - pagesLength) / RECORD_SIZE >= header.recordCount &&
+                 length - pagesLength - (size_t)header.recordCount * RECORD_SIZE == header.stringLength &&
+                 data[length - 1] == '\0';
+    CardIndex *index = valid ? malloc(sizeof(CardIndex)) : NULL;
+    if (!index)
+    {
+        munmap(data, length);
+        return NULL;
+    }
+    *index = header;
+    index->records = data + pagesLength;
+    index->strings = (const char *)index->records + (size_t)header.recordCount * RECORD_SIZE;
+    return index;
+}
+
+/**
+ * Finds a page of an index.
+ * @param index The index.
+ * @param page The page number.
+ * @return The page, or NULL for page 0 or a number past the page area.
+ */
+static const unsigned char *indexPage(const CardIndex *index, uint32_t page)
+{
+    return page > 0 && page < index->pageCount ? index->data + (size_t)page * INDEX_PAGE_SIZE : NULL;
+}
+
+/**
+ * Reads one cell of a page.
+ * @param page The page.
+ * @param cell The cell number, less than the cell count of the page.
+ * @param key Set to the key of the cell.
+ * @param length Set to the length of the key.
+ * @param child Set to the child of a branch cell. May be NULL for a leaf.
+ * @return true if the cell lies inside the page.
+ */
+static bool readCell(const unsigned char *page, uint16_t cell, const unsigned char **key, uint16_t *length, uint32_t *child)
+{
+    size_t offsetAt = PAGE_HEADER_SIZE + 2 * (size_t)cell;
+    if (offsetAt + 2 > INDEX_PAGE_SIZE)
+        return false;
+    size_t offset = loadU16(page + offsetAt);
+    size_t childSize = child ? 4 : 0;
+    if (offset + 2 > INDEX_PAGE_SIZE)
+        return false;
+    *length = loadU16(page + offset);
+    if (offset + 2 + *length + childSize > INDEX_PAGE_SIZE)
+        return false;
+    *key = page + offset + 2;
+    if (child)
+        *child = loadU32(page + offset + 2 + *length);
+    return true;
+}
+
+/**
+ * Finds the first cell of a page whose key is not less than a key.
+ * @param page The page.
+ * @param isBranch true for a branch page.
+ * @param key The key to look for.
+ * @param length The length of the key.
+ * @param position Set to the cell number, or the cell count if every key is less.
+ * @return true on success, false if the page is damaged.
+ */
+static bool lowerBound(const unsigned char *page, bool isBranch, const unsigned char *key, size_t length, uint16_t *position)
+{
+    uint32_t child;
+    uint16_t low = 0, high = loadU16(page + 2);
+    while (low < high)
+    {
+        uint16_t middle = (uint16_t)(low + (high - low) / 2);
+        const unsigned char *cellKey;
+        uint16_t cellLength;
+        if (!readCell(page, middle, &cellKey, &cellLength, isBranch ? &child : NULL))
+            return false;
+        if (compareKeyBytes(cellKey, cellLength, key, length) < 0)
+            low = (uint16_t)(middle + 1);
+        else
+            high = middle;
+    }
+    *position = low;
+    return true;
+}
+
+/**
+ * Reports the records of a tree in key order, starting from the first key not less than
+ * a start key, for as long as the keys begin with the start key's first prefixLength
+ * bytes and are not greater than a limit.
+ * @param index The index.
+ * @param root The root page of the tree.
+ * @param start The start key.
+ * @param startLength The length of the start key.
+ * @param prefixLength The number of bytes of the start key every key must begin with.
+ * @param limit The greatest key prefix to report, compared over limitLength bytes, or NULL.
+ * @param limitLength The length of the limit.
+ * @param callback Function receiving each record.
+ * @param userData Caller data passed through to the callback.
+ * @return The number of records reported, or -1 if the index is damaged.
+ */
+static int scanTree(const CardIndex *index, uint32_t root, const unsigned char *start, size_t startLength, size_t prefixLength,
+                    const unsigned char *limit, size_t limitLength, IndexedCardCallback callback, void *userData)
+{
+    const unsigned char *page = indexPage(index, root);
+    uint16_t position = 0;
+    for (int depth = 0; page; depth++)
+    {
+        bool isBranch = page[0] == BRANCH_PAGE;
+        if (depth == MAX_TREE_DEPTH || (!isBranch && page[0] != LEAF_PAGE) || !lowerBound(page, isBranch, start, startLength, &position))
+            return -1;
+        if (!isBranch)
+            break;
+        // Keys equal to the start key may begin at the end of the child before a separator.
+        const unsigned char *key;
+        uint16_t length;
+        uint32_t child = loadU32(page + 4);
+        if (position > 0 && !readCell(page, (uint16_t)(position - 1), &key, &length, &child))
+            return -1;
+        if (!(page = indexPage(index, child)))
+            return -1;
+    }
+
+    int reported = 0;
+    for (uint32_t leaves = 0; page && leaves < index->pageCount; leaves++)
+    {
+        for (uint16_t cell = position; cell < loadU16(page + 2); cell++)
+        {
+            const unsigned char *key;
+            uint16_t length;
+            if (!readCell(page, cell, &key, &length, NULL) || length < prefixLength || length < RECORD_ID_SIZE)
+                return -1;
+            if (memcmp(key, start, prefixLength) != 0 ||
+                (limit && memcmp(key, limit, length < limitLength ? length : limitLength) > 0))
+                return reported;
+            uint32_t record = loadU32BigEndian(key + length - RECORD_ID_SIZE);
+            if (record >= index->recordCount)
+                return -1;
+            const unsigned char *fields = index->records + (size_t)record * RECORD_SIZE;
+            IndexedCard card;
+            const char **targets[4] = {&card.fileName, &card.fn, &card.birthday, &card.anniversary};
+            for (int field = 0; field < 4; field++)
+            {
+                uint32_t offset = loadU32(fields + 4 * field);
+                if (offset >= index->stringLength)
+                    return -1;
+                *targets[field] = index->strings + offset;
+            }
+            reported++;
+            if (!callback(&card, userData))
+                return reported;
+        }
+        position = 0;
+        page = indexPage(index, loadU32(page + 4));
+        if (page && page[0] != LEAF_PAGE)
+            return -1;
+    }
+    return reported;
+}
+
+/**
+ * Reports the cards of an index whose FN begins with a prefix, in collation order.
+ * Case, accents and runs of white space are ignored on both sides.
+ * @param index The index.
+ * @param prefix The prefix, or "" for every card.
+ * @param callback Function receiving each card.
+ * @param userData Caller data passed through to the callback.
+ * @return The number of cards reported, or -1 for invalid arguments or a damaged index.
+ */
+int findCardsByName(const CardIndex *index, const char *prefix, IndexedCardCallback callback, void *userData)
+{
+    if (!index || !prefix || !callback)
+        return -1;
+    unsigned char key[MAX_PREFIX_LENGTH];
+    size_t length = collationKey(prefix, key, sizeof(key));
+    return scanTree(index, index->nameRoot, key, length, length, NULL, 0, callback, userData);
+}
+
+/**
+ * Reports the cards of an index with a birthday or an anniversary in a range of days of
+ * one month, in day order and, within a day, in the order the cards were indexed.
+ * @param index The index.
+ * @param kind Which date to search.
+ * @param month The month, 1 to 12.
+ * @param firstDay The first day of the range, 0 to include dates with no day.
+ * @param lastDay The last day of the range.
+ * @param callback Function receiving each card.
+ * @param userData Caller data passed through to the callback.
+ * @return The number of cards reported, or -1 for invalid arguments or a damaged index.
+ */
+int findCardsByDate(const CardIndex *index, CardDateKind kind, int month, int firstDay, int lastDay, IndexedCardCallback callback, void *userData)
+{
+    if (!index || !callback || (kind != BIRTHDAY_DATE && kind != ANNIVERSARY_DATE) || month < 1 || month > 12 ||
+        firstDay < 0 || lastDay > 31 || firstDay > lastDay)
+        return -1;
+    unsigned char start[3] = {(unsigned char)kind, (unsigned char)month, (unsigned char)firstDay};
+    unsigned char limit[3] = {(unsigned char)kind, (unsigned char)month, (unsigned char)lastDay};
+    return scanTree(index, index->dateRoot, start, sizeof(start), 2, limit, sizeof(limit), callback, userData);
+}
+
+/**
+ * Unmaps an index and releases it.
+ * @param index The index. May be NULL.
+ */
+void closeCardIndex(CardIndex *index)
+{
+    if (!index)
+        return;
+    munmap((void *)index->data, index->length);
+    free(index);
+}
@@ -2,14 +2,34 @@
 // Student #: 1232341
 // Class: CIS*2750
 
+#define _DEFAULT_SOURCE
+
 #include <stdbool.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
 
 #include "../include/VCParser.h"
 #include "../include/LinkedListAPI.h"
+#include "../include/VCScanner.h"
+#include "../include/VCArena.h"
+#include "../include/VCSideTable.h"
+#include "../include/VCThreadPool.h"
+#include "../include/VCFileFormat.h"
 
 /**
  * Allocates memory and returns a duplicate of the input string.
@@ -101,93 +121,117 @@ List *splitComposite(const char *str, char delim)
  */
 static void removeBOM(FILE *file)
 {
-    unsigned char bom[3];
-    size_t bytesRead = fread(bom, 1, 3, file);
-    if (bytesRead == 3)
-    {
-        if (!(bom[0] == 0xEF && bom[1] == 0xBB && bom[2] == 0xBF))
-            fseek(file, 0, SEEK_SET);
-    }
-    else
+    // Peek a single byte so that non-seekable streams (pipes) work too. A file whose
+    // first byte is 0xEF but is not a BOM cannot start with BEGIN:VCARD anyway.
+    int c = getc(file);
+    if (c != 0xEF)
     {
-        fseek(file, 0, SEEK_SET);
+        if (c != EOF)
+            ungetc(c, file);
+        return;
     }
+    if (getc(file) != 0xBB || getc(file) != 0xBF)
+        ungetc(0xEF, file);
 }
 
 /**
- * Parses a vCard file and creates a Card object.
- * Checks for proper file extension, required vCard tags, and processes properties.
- * @param fileName The name of the vCard file.
- * @param obj A pointer to a Card pointer that will be set to the newly created Card on success.
- * @return OK on success, or an appropriate VCardErrorCode if an error occurs.
+ * Checks that a file name carries one of the accepted vCard extensions (.vcf or .vcard).
+ * @param fileName The file name to check.
+ * @return true if the extension is accepted, false otherwise.
  */
-VCardErrorCode createCard(char *fileName, Card **obj)
+static bool hasCardExtension(const char *fileName)
 {
-    if (!fileName || strlen(fileName) == 0 || !obj)
-        return INV_FILE;
-
-    // Check file extension (.vcf or .vcard)
+    if (!fileName || strlen(fileName) == 0)
+        return false;
     char *ext = strrchr(fileName, '.');
-    if (!ext || (strcmp(ext, ".vcf") != 0 && strcmp(ext, ".vcard") != 0))
-        return INV_FILE;
+    return ext && (strcmp(ext, ".vcf") == 0 || strcmp(ext, ".vcard") == 0);
+}
 
-    FILE *file = fopen(fileName, "r");
-    if (!file)
-        return INV_FILE;
+/**
+ * Reads physical lines from a vCard file and joins folded lines into logical lines.
+ * One logical line of lookahead is kept in pending, since a logical line is only
+ * complete once the next non-continuation line has been read. Physical lines have
+ * no length limit, and each logical line grows geometrically, so unfolding is linear
+ * in the size of the input no matter how many continuation lines a property has.
+ */
+typedef struct lineReader
+{
+    FILE *file;
+    char *pending;
+    size_t pendingLength;
+    size_t pendingCapacity;
+    char *scratch;
+    size_t scratchCapacity;
+    bool done;
+} LineReader;
 
-    // Remove BOM if present.
-    removeBOM(file);
+/**
+ * Initializes a line reader over an open file.
+ * @param reader The line reader to initialize.
+ * @param file The file to read from.
+ */
+static void initLineReader(LineReader *reader, FILE *file)
+{
+    reader->file = file;
+    reader->pending = NULL;
+    reader->pendingLength = 0;
+    reader->pendingCapacity = 0;
+    reader->scratch = NULL;
+    reader->scratchCapacity = 0;
+    reader->done = false;
+}
 
-    Card *newCard = malloc(sizeof(Card));
-    if (!newCard)
-    {
-        fclose(file);
-        return OTHER_ERROR;
-    }
-    newCard->fn = NULL;
-    newCard->optionalProperties = initializeList(&propertyToString, &deleteProperty, &compareProperties);
-    newCard->birthday = NULL;
-    newCard->anniversary = NULL;
+/**
+ * Frees the buffers held by a line reader. The file itself is not closed.
+ * @param reader The line reader.
+ */
+static void releaseLineReader(LineReader *reader)
+{
+    free(reader->pending);
+    free(reader->scratch);
+    reader->pending = NULL;
+    reader->scratch = NULL;
+}
 
-    // Read the file into an array of "logical" lines.
-    char buffer[256];
-    int numLines = 0, capacity = 10;
-    char **logicalLines = malloc(capacity * sizeof(char *));
-    if (!logicalLines)
-    {
-        fclose(file);
-        deleteCard(newCard);
-        return OTHER_ERROR;
-    }
-    char *currentLogical = NULL;
+/**
+ * Reads the next logical (unfolded) line from the reader.
+ * @param reader The line reader.
+ * @param line Set to the newly allocated logical line, or NULL once the file is exhausted.
+ * @return OK on success, INV_CARD for an incomplete physical line, INV_PROP for a
+ *         continuation line with nothing to continue, or OTHER_ERROR on allocation failure.
+ */
+static VCardErrorCode nextLogicalLine(LineReader *reader, char **line)
+{
+    char *currentLogical = reader->pending;
+    size_t currentLength = reader->pendingLength;
+    size_t currentCapacity = reader->pendingCapacity;
+    reader->pending = NULL;
+    *line = NULL;
 
-    while (fgets(buffer, sizeof(buffer), file))
+    while (!reader->done)
     {
-        size_t len = strlen(buffer);
+        ssize_t read = getline(&reader->scratch, &reader->scratchCapacity, reader->file);
+        if (read < 0)
+        {
+            reader->done = true;
+            break;
+        }
+        size_t len = (size_t)read;
         if (len == 0)
             continue;
+        char *buffer = reader->scratch;
 
         // Remove trailing newline and optional carriage return.
         if (buffer[len - 1] == '\n')
         {
-            buffer[len - 1] = '\0';
-            len--;
+            buffer[--len] = '\0';
             if (len > 0 && buffer[len - 1] == '\r')
-            {
-                buffer[len - 1] = '\0';
-                len--;
-            }
+                buffer[--len] = '\0';
         }
         else
         {
             // Incomplete line
-            for (int i = 0; i < numLines; i++)
-                free(logicalLines[i]);
-            free(logicalLines);
-            if (currentLogical)
-                free(currentLogical);
-            fclose(file);
-            deleteCard(newCard);
+            free(currentLogical);
             return INV_CARD;
         }
 
@@ -195,1054 +239,5709 @@ VCardErrorCode createCard(char *fileName, Card **obj)
         if (buffer[0] == ' ' || buffer[0] == '\t')
         {
             if (!currentLogical)
-            {
-                for (int i = 0; i < numLines; i++)
-                    free(logicalLines[i]);
-                free(logicalLines);
-                fclose(file);
-                deleteCard(newCard);
                 return INV_PROP;
-            }
-            char *trimmed = buffer;
-            while (*trimmed && (*trimmed == ' ' || *trimmed == '\t'))
-                trimmed++;
-            size_t newSize = strlen(currentLogical) + strlen(trimmed) + 1;
-            char *tmp = realloc(currentLogical, newSize);
-            if (!tmp)
-            {
-                for (int i = 0; i < numLines; i++)
-                    free(logicalLines[i]);
-                free(logicalLines);
-                fclose(file);
-                deleteCard(newCard);
-                return OTHER_ERROR;
-            }
-            currentLogical = tmp;
-            strcat(currentLogical, trimmed);
-        }
-        else
-        {
-            if (currentLogical)
+            // Unfolding removes exactly one leading whitespace character (RFC 6350 3.2).
+            char *trimmed = buffer + 1;
+            size_t trimmedLength = len - (size_t)(trimmed - buffer);
+            size_t needed = currentLength + trimmedLength + 1;
+            if (needed > currentCapacity)
             {
-                if (numLines == capacity)
+                size_t newCapacity = currentCapacity * 2;
+                if (newCapacity < needed)
+                    newCapacity = needed;
+                char *tmp = realloc(currentLogical, newCapacity);
+                if (!tmp)
                 {
-                    capacity *= 2;
-                    char **tmp = realloc(logicalLines, capacity * sizeof(char *));
-                    if (!tmp)
-                    {
-                        for (int i = 0; i < numLines; i++)
-                            free(logicalLines[i]);
-                        free(logicalLines);
-                        free(currentLogical);
-                        fclose(file);
-                        deleteCard(newCard);
-                        return OTHER_ERROR;
-                    }
-                    logicalLines = tmp;
+                    free(currentLogical);
+                    return OTHER_ERROR;
                 }
-                logicalLines[numLines++] = currentLogical;
-            }
-            currentLogical = duplicateString(buffer);
-            if (!currentLogical)
-            {
-                for (int i = 0; i < numLines; i++)
-                    free(logicalLines[i]);
-                free(logicalLines);
-                fclose(file);
-                deleteCard(newCard);
-                return OTHER_ERROR;
+                currentLogical = tmp;
+                currentCapacity = newCapacity;
             }
+            memcpy(currentLogical + currentLength, trimmed, trimmedLength + 1);
+            currentLength += trimmedLength;
         }
-    }
-    if (currentLogical)
-    {
-        if (numLines == capacity)
+        else
         {
-            capacity *= 2;
-            char **tmp = realloc(logicalLines, capacity * sizeof(char *));
-            if (!tmp)
+            // The physical line becomes the start of a logical line; getline allocates
+            // a fresh scratch buffer on the next call, so nothing is copied.
+            char *start = reader->scratch;
+            size_t startCapacity = reader->scratchCapacity;
+            reader->scratch = NULL;
+            reader->scratchCapacity = 0;
+            if (currentLogical)
             {
-                for (int i = 0; i < numLines; i++)
-                    free(logicalLines[i]);
-                free(logicalLines);
-                free(currentLogical);
-                fclose(file);
-                deleteCard(newCard);
-                return OTHER_ERROR;
+                // The logical line is complete; keep this physical line for the next call.
+                reader->pending = start;
+                reader->pendingLength = len;
+                reader->pendingCapacity = startCapacity;
+                *line = currentLogical;
+                return OK;
             }
-            logicalLines = tmp;
+            currentLogical = start;
+            currentLength = len;
+            currentCapacity = startCapacity;
         }
-        logicalLines[numLines++] = currentLogical;
     }
-    fclose(file);
+    *line = currentLogical;
+    return OK;
+}
 
-    // Check for proper BEGIN/END lines.
-    if (numLines < 2 ||
-        strcmp(logicalLines[0], "BEGIN:VCARD") != 0 ||
-        strcmp(logicalLines[numLines - 1], "END:VCARD") != 0)
-    {
-        for (int i = 0; i < numLines; i++)
-            free(logicalLines[i]);
-        free(logicalLines);
-        deleteCard(newCard);
-        return INV_CARD;
-    }
+/**
+ * Frees an array of logical lines along with the array itself.
+ * @param lines The array of lines.
+ * @param numLines The number of lines in the array.
+ */
+static void freeLogicalLines(char **lines, int numLines)
+{
+    for (int i = 0; i < numLines; i++)
+        free(lines[i]);
+    free(lines);
+}
 
-    bool versionFound = false;
-    // Process lines 2 to (numLines - 1)
-    for (int i = 1; i < numLines - 1; i++)
+/**
+ * Appends a logical line to a growable array of lines, doubling its capacity as needed.
+ * @param lines The array of lines, possibly reallocated.
+ * @param numLines The number of lines in the array, incremented on success.
+ * @param capacity The capacity of the array, updated if it grows.
+ * @param line The line to append.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool appendLogicalLine(char ***lines, int *numLines, int *capacity, char *line)
+{
+    if (*numLines == *capacity)
     {
-        char *line = logicalLines[i];
-        if (strlen(line) == 0)
-            continue;
-        char *colon = strchr(line, ':');
-        if (!colon)
-        {
-            for (int j = 0; j < numLines; j++)
-                free(logicalLines[j]);
-            free(logicalLines);
-            deleteCard(newCard);
-            return INV_PROP;
-        }
-        *colon = '\0';
-        char *leftPart = trimWhitespace(line);
-        char *rightPart = trimWhitespace(colon + 1);
-        if (strlen(rightPart) == 0)
-        {
-            for (int j = 0; j < numLines; j++)
-                free(logicalLines[j]);
-            free(logicalLines);
-            deleteCard(newCard);
-            return INV_PROP;
-        }
+        int newCapacity = *capacity * 2;
+        char **tmp = realloc(*lines, newCapacity * sizeof(char *));
+        if (!tmp)
+            return false;
+        *lines = tmp;
+        *capacity = newCapacity;
+    }
+    (*lines)[(*numLines)++] = line;
+    return true;
+}
 
-        // Duplicate leftPart for tokenizing parameters.
-        char *leftDup = duplicateString(leftPart);
-        if (!leftDup)
-        {
-            for (int j = 0; j < numLines; j++)
-                free(logicalLines[j]);
-            free(logicalLines);
-            deleteCard(newCard);
-            return OTHER_ERROR;
-        }
-        char *token = strtok(leftDup, ";");
-        if (!token)
-        {
-            free(leftDup);
-            for (int j = 0; j < numLines; j++)
-                free(logicalLines[j]);
-            free(logicalLines);
-            deleteCard(newCard);
-            return INV_PROP;
-        }
-        token = trimWhitespace(token);
-        char *propGroup = NULL;
-        char *propName = NULL;
-        char *dot = strchr(token, '.');
-        if (dot)
-        {
-            *dot = '\0';
-            propGroup = duplicateString(token);
-            propName = duplicateString(trimWhitespace(dot + 1));
-        }
-        else
-        {
-            propGroup = duplicateString("");
-            propName = duplicateString(token);
-        }
+static VCardErrorCode parseLogicalLines(char **logicalLines, int numLines, Arena *arena, Card **obj);
 
-        // Allocate and initialize a new Property.
-        Property *property = malloc(sizeof(Property));
-        if (!property)
-        {
-            free(leftDup);
-            for (int j = 0; j < numLines; j++)
-                free(logicalLines[j]);
-            free(logicalLines);
-            deleteCard(newCard);
-            return OTHER_ERROR;
-        }
-        property->name = propName;
-        property->group = propGroup;
-        property->parameters = initializeList(&parameterToString, &deleteParameter, &compareParameters);
-        property->values = initializeList(&valueToString, &deleteValue, &compareValues);
+/**
+ * Returns the length of the UTF-8 Byte Order Mark (BOM) at the start of a buffer.
+ * @param data The buffer to check.
+ * @param length The number of bytes in the buffer.
+ * @return 3 if the buffer starts with a BOM, 0 otherwise.
+ */
+static size_t byteOrderMarkLength(const char *data, size_t length)
+{
+    if (length >= 3 && (unsigned char)data[0] == 0xEF &&
+        (unsigned char)data[1] == 0xBB && (unsigned char)data[2] == 0xBF)
+        return 3;
+    return 0;
+}
 
-        // Process parameters for the property.
-        while ((token = strtok(NULL, ";")) != NULL)
-        {
-            token = trimWhitespace(token);
-            // Skip empty tokens (from trailing semicolons)
-            if (strlen(token) == 0)
-                continue;
-            char *equalSign = strchr(token, '=');
-            if (!equalSign)
-            {
-                free(leftDup);
-                deleteProperty(property);
-                for (int j = 0; j < numLines; j++)
-                    free(logicalLines[j]);
-                free(logicalLines);
-                deleteCard(newCard);
-                return INV_PROP;
-            }
-            *equalSign = '\0';
-            char *paramName = duplicateString(trimWhitespace(token));
-            char *paramValue = duplicateString(trimWhitespace(equalSign + 1));
-            if (!paramName || !paramValue || strlen(paramName) == 0 || strlen(paramValue) == 0)
-            {
-                free(paramName);
-                free(paramValue);
-                free(leftDup);
-                deleteProperty(property);
-                for (int j = 0; j < numLines; j++)
-                    free(logicalLines[j]);
-                free(logicalLines);
-                deleteCard(newCard);
-                return INV_PROP;
-            }
-            Parameter *param = malloc(sizeof(Parameter));
-            if (!param)
-            {
-                free(paramName);
-                free(paramValue);
-                free(leftDup);
-                deleteProperty(property);
-                for (int j = 0; j < numLines; j++)
-                    free(logicalLines[j]);
-                free(logicalLines);
-                deleteCard(newCard);
-                return OTHER_ERROR;
-            }
-            param->name = paramName;
-            param->value = paramValue;
-            insertBack(property->parameters, param);
-        }
-        // Finished processing parameters.
-        free(leftDup);
+/**
+ * Unfolds logical lines in place inside a mutable buffer, such as a private file mapping.
+ * Continuation lines are moved down over the line breaks they follow, and each logical
+ * line is NUL-terminated where its last physical line ended, so no line is copied.
+ */
+typedef struct spanReader
+{
+    char *data;
+    size_t length;
+    size_t pos;
+} SpanReader;
 
-        // Process the property value.
-        if (strcmp(property->name, "N") == 0)
-        {
-            clearList(property->values);
-            free(property->values);
-            property->values = splitComposite(rightPart, ';');
-        }
-        else
-        {
-            char *val = duplicateString(rightPart);
-            insertBack(property->values, val);
-        }
+/**
+ * Reads the next logical (unfolded) line from a buffer, unfolding it in place.
+ * @param reader The span reader.
+ * @param line Set to the start of the logical line within the buffer, or NULL once the buffer is exhausted.
+ * @return OK on success, INV_CARD for an incomplete physical line, or INV_PROP for a
+ *         continuation line with nothing to continue.
+ */
+static VCardErrorCode nextSpanLine(SpanReader *reader, char **line)
+{
+    char *data = reader->data;
+    size_t end = reader->length;
+    *line = NULL;
+    if (reader->pos >= end)
+        return OK;
 
-        // Special handling for reserved properties.
-        if (strcmp(property->name, "BEGIN") == 0 ||
-            strcmp(property->name, "END") == 0)
-        {
-            deleteProperty(property);
-        }
-        else if (strcmp(property->name, "VERSION") == 0)
-        {
-            char *versionVal = (char *)getFromFront(property->values);
-            if (!versionVal || strcmp(versionVal, "4.0") != 0)
-            {
-                deleteProperty(property);
-                for (int j = 0; j < numLines; j++)
-                    free(logicalLines[j]);
-                free(logicalLines);
-                deleteCard(newCard);
-                return INV_CARD;
-            }
-            versionFound = true;
-            deleteProperty(property);
-        }
-        else if (strcmp(property->name, "FN") == 0)
-        {
-            if (newCard->fn != NULL)
-                insertBack(newCard->optionalProperties, property);
-            else
-                newCard->fn = property;
-        }
-        else if (strcmp(property->name, "BDAY") == 0)
-        {
-            DateTime *dt = malloc(sizeof(DateTime));
-            if (!dt)
-            {
-                deleteProperty(property);
-                for (int j = 0; j < numLines; j++)
-                    free(logicalLines[j]);
-                free(logicalLines);
-                deleteCard(newCard);
-                return OTHER_ERROR;
-            }
-            dt->UTC = false;
-            bool isTextParam = false;
-            ListIterator paramIter = createIterator(property->parameters);
-            Parameter *currParam = NULL;
-            while ((currParam = nextElement(&paramIter)) != NULL)
-            {
-                if (strcmp(currParam->name, "VALUE") == 0 &&
-                    strcmp(currParam->value, "text") == 0)
-                {
-                    isTextParam = true;
-                    break;
-                }
-            }
-            if (isTextParam)
-            {
-                dt->date = duplicateString("");
-                dt->time = duplicateString("");
-                dt->isText = true;
-                dt->text = duplicateString(rightPart);
-            }
-            else
-            {
-                char *tPos = strchr(rightPart, 'T');
-                if (tPos)
-                {
-                    size_t dateLen = tPos - rightPart;
-                    dt->date = malloc(dateLen + 1);
-                    if (!dt->date)
-                    {
-                        free(dt);
-                        deleteProperty(property);
-                        for (int j = 0; j < numLines; j++)
-                            free(logicalLines[j]);
-                        free(logicalLines);
-                        deleteCard(newCard);
-                        return OTHER_ERROR;
-                    }
-                    strncpy(dt->date, rightPart, dateLen);
-                    dt->date[dateLen] = '\0';
-                    dt->time = duplicateString(tPos + 1);
-                    dt->isText = false;
-                    dt->text = duplicateString("");
-                }
-                else if (strlen(rightPart) == 10 || !containsAlpha(rightPart))
-                {
-                    dt->date = duplicateString(rightPart);
-                    dt->time = duplicateString("");
-                    dt->isText = false;
-                    dt->text = duplicateString("");
-                }
-                else
-                {
-                    dt->date = duplicateString("");
-                    dt->time = duplicateString("");
-                    dt->isText = true;
-                    dt->text = duplicateString(rightPart);
-                }
-            }
-            newCard->birthday = dt;
-            deleteProperty(property);
-        }
-        else if (strcmp(property->name, "ANNIVERSARY") == 0)
-        {
-            DateTime *dt = malloc(sizeof(DateTime));
-            if (!dt)
-            {
-                deleteProperty(property);
-                for (int j = 0; j < numLines; j++)
-                    free(logicalLines[j]);
-                free(logicalLines);
-                deleteCard(newCard);
-                return OTHER_ERROR;
-            }
-            dt->UTC = false;
-            bool isTextParam = false;
-            ListIterator paramIter = createIterator(property->parameters);
-            Parameter *currParam = NULL;
-            while ((currParam = nextElement(&paramIter)) != NULL)
-            {
-                if (strcmp(currParam->name, "VALUE") == 0 &&
-                    strcmp(currParam->value, "text") == 0)
-                {
-                    isTextParam = true;
-                    break;
-                }
-            }
-            if (isTextParam)
-            {
-                dt->date = duplicateString("");
-                dt->time = duplicateString("");
-                dt->isText = true;
-                dt->text = duplicateString(rightPart);
-            }
-            else
-            {
-                char *tPos = strchr(rightPart, 'T');
-                if (tPos)
-                {
-                    size_t dateLen = tPos - rightPart;
-                    dt->date = malloc(dateLen + 1);
-                    if (!dt->date)
-                    {
-                        free(dt);
-                        deleteProperty(property);
-                        for (int j = 0; j < numLines; j++)
-                            free(logicalLines[j]);
-                        free(logicalLines);
-                        deleteCard(newCard);
-                        return OTHER_ERROR;
-                    }
-                    strncpy(dt->date, rightPart, dateLen);
-                    dt->date[dateLen] = '\0';
-                    dt->time = duplicateString(tPos + 1);
-                    dt->isText = false;
-                    dt->text = duplicateString("");
-                }
-                else if (strlen(rightPart) == 10 || !containsAlpha(rightPart))
-                {
-                    dt->date = duplicateString(rightPart);
-                    dt->time = duplicateString("");
-                    dt->isText = false;
-                    dt->text = duplicateString("");
-                }
-                else
-                {
-                    dt->date = duplicateString("");
-                    dt->time = duplicateString("");
-                    dt->isText = true;
-                    dt->text = duplicateString(rightPart);
-                }
-            }
-            newCard->anniversary = dt;
-            deleteProperty(property);
-        }
-        else
-        {
-            // All other properties go into optionalProperties.
-            insertBack(newCard->optionalProperties, property);
-        }
+    size_t start = reader->pos;
+    char *newline = memchr(data + start, '\n', end - start);
+    if (!newline)
+    {
+        reader->pos = end;
+        return INV_CARD;
     }
+    size_t next = (size_t)(newline - data) + 1;
+    reader->pos = next;
+    if (data[start] == ' ' || data[start] == '\t')
+        return INV_PROP;
 
-    for (int i = 0; i < numLines; i++)
-        free(logicalLines[i]);
-    free(logicalLines);
+    // Remove the optional carriage return.
+    size_t write = (size_t)(newline - data);
+    if (write > start && data[write - 1] == '\r')
+        write--;
 
-    if (!versionFound || !newCard->fn)
+    // Move each continuation line down to the end of the logical line so far.
+    while (next < end && (data[next] == ' ' || data[next] == '\t'))
     {
-        deleteCard(newCard);
-        return INV_CARD;
+        newline = memchr(data + next, '\n', end - next);
+        if (!newline)
+        {
+            reader->pos = end;
+            return INV_CARD;
+        }
+        // Unfolding removes exactly one leading whitespace character (RFC 6350 3.2).
+        size_t contStart = next + 1;
+        size_t contEnd = (size_t)(newline - data);
+        if (contEnd > contStart && data[contEnd - 1] == '\r')
+            contEnd--;
+        memmove(data + write, data + contStart, contEnd - contStart);
+        write += contEnd - contStart;
+        next = (size_t)(newline - data) + 1;
     }
-
-    *obj = newCard;
+    data[write] = '\0';
+    reader->pos = next;
+    *line = data + start;
     return OK;
 }
 
 /**
- * Converts a Property structure to a string in valid vCard file format.
- * The output format is: [group.]name[;paramName=paramValue...]:value[;value2...]
- * @param prop A pointer to the Property structure.
- * @return A newly allocated string representing the property.
+ * Parses a single card held in a mutable buffer. The buffer is unfolded and tokenized
+ * in place, so only the strings stored in the resulting Card are allocated.
+ * @param data The buffer holding the vCard text. Its contents are modified.
+ * @param length The number of bytes in the buffer.
+ * @param arena The arena to build the Card in, or NULL to build it on the heap.
+ * @param obj A pointer to a Card pointer that will be set to the newly created Card on success.
+ * @return OK on success, or an appropriate VCardErrorCode if an error occurs.
  */
-static char *propertyToFileString(void *prop)
+static VCardErrorCode parseCardSpan(char *data, size_t length, Arena *arena, Card **obj)
 {
-    Property *p = (Property *)prop;
-    char *result = malloc(1024);
-    if (!result)
-        return NULL;
-    result[0] = '\0';
-
-    if (strlen(p->group) > 0)
-    {
-        strcat(result, p->group);
-        strcat(result, ".");
-    }
-    strcat(result, p->name);
+    // Skip a UTF-8 byte order mark if present.
+    size_t bom = byteOrderMarkLength(data, length);
+    data += bom;
+    length -= bom;
 
-    // Append parameters.
-    ListIterator paramIter = createIterator(p->parameters);
-    void *pdata;
-    while ((pdata = nextElement(&paramIter)) != NULL)
-    {
-        Parameter *param = (Parameter *)pdata;
-        strcat(result, ";");
-        strcat(result, param->name);
-        strcat(result, "=");
-        strcat(result, param->value);
-    }
+    int numLines = 0, capacity = 16;
+    char **lines = malloc(capacity * sizeof(char *));
+    if (!lines)
+        return OTHER_ERROR;
 
-    strcat(result, ":");
-    // Append property values, joined by semicolons.
-    if (getLength(p->values) > 0)
+    SpanReader reader = {data, length, 0};
+    char *line = NULL;
+    VCardErrorCode err;
+    while ((err = nextSpanLine(&reader, &line)) == OK && line)
     {
-        ListIterator valIter = createIterator(p->values);
-        void *vdata;
-        bool first = true;
-        while ((vdata = nextElement(&valIter)) != NULL)
+        if (!appendLogicalLine(&lines, &numLines, &capacity, line))
         {
-            if (!first)
-                strcat(result, ";");
-            strcat(result, (char *)vdata);
-            first = false;
+            err = OTHER_ERROR;
+            break;
         }
     }
-    return result;
+
+    if (err == OK)
+        err = parseLogicalLines(lines, numLines, arena, obj);
+    // The lines point into the buffer, so only the array itself is freed.
+    free(lines);
+    return err;
 }
 
 /**
- * Writes a Card object to a file in valid vCard format with CRLF line endings.
- * The output is not folded. If any write fails, returns WRITE_ERROR.
- * @param fileName The output file name.
- * @param obj The Card object to write.
- * @return OK on success, WRITE_ERROR on failure.
+ * Narrows a span of text so that it excludes leading and trailing whitespace.
+ * @param text The text the span refers to.
+ * @param start The start offset of the span, advanced past leading whitespace.
+ * @param end The end offset (exclusive) of the span, moved back before trailing whitespace.
  */
-VCardErrorCode writeCard(const char *fileName, const Card *obj)
+static void trimSpan(const char *text, size_t *start, size_t *end)
 {
-    if (!fileName || !obj)
-        return WRITE_ERROR;
+    while (*start < *end && isspace((unsigned char)text[*start]))
+        (*start)++;
+    while (*end > *start && isspace((unsigned char)text[*end - 1]))
+        (*end)--;
+}
 
-    FILE *fp = fopen(fileName, "w");
-    if (!fp)
-        return WRITE_ERROR;
+/*
+ * Arena-backed Cards keep every Property, Parameter, DateTime, List, Node and string in
+ * the chunks of one Arena, so deleteCard releases them in a single step. The arena of
+ * each such Card is found through this side table, since the Card struct itself is
+ * shared with callers and cannot grow a field.
+ */
+static SideTable cardArenas = SIDE_TABLE_INITIALIZER;
 
-    if (fprintf(fp, "BEGIN:VCARD\r\n") < 0 ||
-        fprintf(fp, "VERSION:4.0\r\n") < 0)
-    {
-        fclose(fp);
-        return WRITE_ERROR;
-    }
+/**
+ * Allocates memory for a Card being built: from its arena when it has one, otherwise from the heap.
+ * @param arena The arena of the Card, or NULL for a heap Card.
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the memory, or NULL if memory allocation fails.
+ */
+static void *cardAlloc(Arena *arena, size_t size)
+{
+    return arena ? arenaAlloc(arena, size) : malloc(size);
+}
 
-    // Write FN property.
-    char *line = propertyToFileString((void *)obj->fn);
-    if (!line)
-    {
-        fclose(fp);
-        return WRITE_ERROR;
-    }
-    if (fprintf(fp, "%s\r\n", line) < 0)
+/**
+ * Allocates a NUL-terminated copy of a span of text for a Card being built.
+ * @param arena The arena of the Card, or NULL for a heap Card.
+ * @param text The text the span refers to.
+ * @param start The start offset of the span.
+ * @param end The end offset (exclusive) of the span.
+ * @return The newly allocated string, or NULL if memory allocation fails.
+ */
+static char *cardCopySpan(Arena *arena, const char *text, size_t start, size_t end)
+{
+    if (arena)
+        return arenaStrndup(arena, text + start, end - start);
+    char *copy = malloc(end - start + 1);
+    if (copy)
     {
-        free(line);
-        fclose(fp);
-        return WRITE_ERROR;
+        memcpy(copy, text + start, end - start);
+        copy[end - start] = '\0';
     }
-    free(line);
+    return copy;
+}
 
-    // Write BDAY property if present.
-    if (obj->birthday)
-    {
-        DateTime *dt = obj->birthday;
-        if (dt->isText)
+/**
+ * Allocates a copy of a string for a Card being built.
+ * @param arena The arena of the Card, or NULL for a heap Card.
+ * @param str The string to copy.
+ * @return The newly allocated string, or NULL if memory allocation fails.
+ */
+static char *cardCopyString(Arena *arena, const char *str)
+{
+    return cardCopySpan(arena, str, 0, strlen(str));
+}
+
+/**
+ * Creates an empty List for a Card being built.
+ * @param arena The arena of the Card, or NULL for a heap Card.
+ * @param printFunction Function pointer to print a single element of the list.
+ * @param deleteFunction Function pointer to delete a single element of the list.
+ * @param compareFunction Function pointer to compare two elements of the list.
+ * @return The new List, or NULL if memory allocation fails.
+ */
+static List *cardList(Arena *arena, char *(*printFunction)(void *), void (*deleteFunction)(void *),
+                      int (*compareFunction)(const void *, const void *))
+{
+    if (!arena)
+        return initializeList(printFunction, deleteFunction, compareFunction);
+    List *list = arenaAlloc(arena, sizeof(List));
+    if (list)
+    {
+        list->head = NULL;
+        list->tail = NULL;
+        list->length = 0;
+        list->deleteData = deleteFunction;
+        list->compare = compareFunction;
+        list->printData = printFunction;
+    }
+    return list;
+}
+
+/**
+ * Appends an element to a List of a Card being built, mirroring insertBack.
+ * @param arena The arena of the Card, or NULL for a heap Card.
+ * @param list The List to append to.
+ * @param data The element to append.
+ * @return true on success, false if data is NULL or memory allocation fails.
+ */
+static bool cardAppend(Arena *arena, List *list, void *data)
+{
+    if (!list || !data)
+        return false;
+    if (!arena)
+    {
+        int length = list->length;
+        insertBack(list, data);
+        return list->length > length && list->tail && list->tail->data == data;
+    }
+    Node *node = arenaAlloc(arena, sizeof(Node));
+    if (!node)
+        return false;
+    node->data = data;
+    node->next = NULL;
+    node->previous = list->tail;
+    if (list->tail)
+        list->tail->next = node;
+    else
+        list->head = node;
+    list->tail = node;
+    list->length++;
+    return true;
+}
+
+/**
+ * Discards a Property that is not kept in the Card being built. Arena memory is
+ * reclaimed with the rest of the arena, so only heap Properties are deleted here.
+ * @param arena The arena of the Card, or NULL for a heap Card.
+ * @param property The Property to discard. May be NULL.
+ */
+static void discardProperty(Arena *arena, Property *property)
+{
+    if (!arena)
+        deleteProperty(property);
+}
+
+/**
+ * Discards a partially built Card after a parse error.
+ * @param arena The arena of the Card, or NULL for a heap Card.
+ * @param card The Card to discard.
+ */
+static void discardCard(Arena *arena, Card *card)
+{
+    if (!arena)
+        deleteCard(card);
+}
+
+/**
+ * Creates a Property from the first field of a content line, i.e. [group.]name.
+ * @param arena The arena of the Card being built, or NULL for a heap Card.
+ * @param line The content line.
+ * @param start The start offset of the field.
+ * @param end The end offset (exclusive) of the field.
+ * @param dot The offset of the first '.' in the field, or SIZE_MAX if there is none.
+ * @param out Set to the new Property, with empty parameter and value lists.
+ * @return OK on success, or OTHER_ERROR on allocation failure.
+ */
+static VCardErrorCode createLineProperty(Arena *arena, const char *line, size_t start, size_t end, size_t dot, Property **out)
+{
+    trimSpan(line, &start, &end);
+    char *propGroup = NULL;
+    char *propName = NULL;
+    if (dot >= start && dot < end)
+    {
+        size_t nameStart = dot + 1, nameEnd = end;
+        trimSpan(line, &nameStart, &nameEnd);
+        propGroup = cardCopySpan(arena, line, start, dot);
+        propName = cardCopySpan(arena, line, nameStart, nameEnd);
+    }
+    else
+    {
+        propGroup = cardCopyString(arena, "");
+        propName = cardCopySpan(arena, line, start, end);
+    }
+
+    // Allocate and initialize a new Property.
+    Property *property = cardAlloc(arena, sizeof(Property));
+    if (!property || !propName || !propGroup)
+    {
+        if (!arena)
+        {
+            free(propName);
+            free(propGroup);
+            free(property);
+        }
+        return OTHER_ERROR;
+    }
+    property->name = propName;
+    property->group = propGroup;
+    property->parameters = cardList(arena, &parameterToString, &deleteParameter, &compareParameters);
+    property->values = cardList(arena, &valueToString, &deleteValue, &compareValues);
+    if (!property->parameters || !property->values)
+    {
+        discardProperty(arena, property);
+        return OTHER_ERROR;
+    }
+    *out = property;
+    return OK;
+}
+
+/**
+ * Adds a parameter field (name=value) of a content line to a Property.
+ * Fields that are empty after trimming (e.g. from trailing semicolons) are skipped.
+ * @param arena The arena of the Card being built, or NULL for a heap Card.
+ * @param property The Property the parameter belongs to.
+ * @param line The content line.
+ * @param start The start offset of the field.
+ * @param end The end offset (exclusive) of the field.
+ * @param equals The offset of the first '=' in the field, or SIZE_MAX if there is none.
+ * @return OK on success, INV_PROP for a malformed parameter, or OTHER_ERROR on allocation failure.
+ */
+static VCardErrorCode addLineParameter(Arena *arena, Property *property, const char *line, size_t start, size_t end, size_t equals)
+{
+    trimSpan(line, &start, &end);
+    if (start == end)
+        return OK;
+    if (equals < start || equals >= end)
+        return INV_PROP;
+
+    size_t nameStart = start, nameEnd = equals;
+    size_t valueStart = equals + 1, valueEnd = end;
+    trimSpan(line, &nameStart, &nameEnd);
+    trimSpan(line, &valueStart, &valueEnd);
+    if (nameStart == nameEnd || valueStart == valueEnd)
+        return INV_PROP;
+
+    Parameter *param = cardAlloc(arena, sizeof(Parameter));
+    if (!param)
+        return OTHER_ERROR;
+    param->name = cardCopySpan(arena, line, nameStart, nameEnd);
+    param->value = cardCopySpan(arena, line, valueStart, valueEnd);
+    if (!param->name || !param->value || !cardAppend(arena, property->parameters, param))
+    {
+        if (!arena)
+            deleteParameter(param);
+        return OTHER_ERROR;
+    }
+    return OK;
+}
+
+/**
+ * Appends a copy of a span of a content line to the values of a Property.
+ * @param arena The arena of the Card being built, or NULL for a heap Card.
+ * @param property The Property the value belongs to.
+ * @param line The content line.
+ * @param start The start offset of the value.
+ * @param end The end offset (exclusive) of the value.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool appendValueSpan(Arena *arena, Property *property, const char *line, size_t start, size_t end)
+{
+    char *value = cardCopySpan(arena, line, start, end);
+    if (value && cardAppend(arena, property->values, value))
+        return true;
+    if (!arena)
+        free(value);
+    return false;
+}
+
+/**
+ * Splits one unfolded content line into a Property: group, name, parameters and value(s).
+ * The delimiters are located by the block scanner in a single pass over the line, and
+ * the tokenizer walks them in order instead of searching the line again for each one.
+ * The first ':' ends the name and parameters; ';' separates the fields before it.
+ * @param arena The arena of the Card being built, or NULL for a heap Card.
+ * @param line The content line. It is not modified.
+ * @param length The length of the line.
+ * @param out Set to the new Property on success.
+ * @param kind Set to the PropertyKind of the property name on success.
+ * @return OK on success, INV_PROP for a malformed line, or OTHER_ERROR on allocation failure.
+ */
+static VCardErrorCode tokenizeContentLine(Arena *arena, const char *line, size_t length, Property **out, PropertyKind *kind)
+{
+    DelimiterScanner scanner;
+    initDelimiterScanner(&scanner, line, length);
+
+    size_t fieldStart = 0;
+    while (fieldStart < length && isspace((unsigned char)line[fieldStart]))
+        fieldStart++;
+    size_t firstEquals = SIZE_MAX, firstDot = SIZE_MAX;
+    size_t colon = length;
+    Property *property = NULL;
+    VCardErrorCode err = OK;
+
+    size_t pos;
+    while (err == OK && (pos = nextDelimiter(&scanner)) < length)
+    {
+        char c = line[pos];
+        if (pos < fieldStart)
+            continue;
+        if (c == ';' || c == ':')
+        {
+            size_t fieldEnd = pos;
+            if (c == ':')
+            {
+                while (fieldEnd > fieldStart && isspace((unsigned char)line[fieldEnd - 1]))
+                    fieldEnd--;
+            }
+            // The first non-empty field is the name; the rest are parameters.
+            if (fieldEnd > fieldStart)
+            {
+                if (!property)
+                    err = createLineProperty(arena, line, fieldStart, fieldEnd, firstDot, &property);
+                else
+                    err = addLineParameter(arena, property, line, fieldStart, fieldEnd, firstEquals);
+            }
+            if (c == ':')
+            {
+                colon = pos;
+                break;
+            }
+            fieldStart = pos + 1;
+            firstEquals = firstDot = SIZE_MAX;
+        }
+        else if (c == '=' && firstEquals == SIZE_MAX)
+        {
+            firstEquals = pos;
+        }
+        else if (c == '.' && firstDot == SIZE_MAX)
+        {
+            firstDot = pos;
+        }
+    }
+
+    size_t valueStart = colon + 1, valueEnd = length;
+    if (err == OK && colon < length)
+        trimSpan(line, &valueStart, &valueEnd);
+    if (err == OK && (colon == length || !property || valueStart >= valueEnd))
+        err = INV_PROP;
+    if (err != OK)
+    {
+        discardProperty(arena, property);
+        return err;
+    }
+
+    // Process the property value. N is composite, so it is split on every ';'.
+    bool stored = true;
+    *kind = propertyKind(property->name);
+    if (*kind == PROP_N)
+    {
+        size_t tokenStart = valueStart;
+        while (stored && (pos = nextDelimiter(&scanner)) < valueEnd)
+        {
+            if (pos >= valueStart && line[pos] == ';')
+            {
+                stored = appendValueSpan(arena, property, line, tokenStart, pos);
+                tokenStart = pos + 1;
+            }
+        }
+        stored = stored && appendValueSpan(arena, property, line, tokenStart, valueEnd);
+    }
+    else
+    {
+        stored = appendValueSpan(arena, property, line, valueStart, valueEnd);
+    }
+    if (!stored)
+    {
+        discardProperty(arena, property);
+        return OTHER_ERROR;
+    }
+
+    *out = property;
+    return OK;
+}
+
+/**
+ * Builds the DateTime of a BDAY or ANNIVERSARY property.
+ * A value that parses as a date-and-or-time is split into date and time at the 'T', and a
+ * trailing Z of the time sets UTC. A VALUE=text parameter makes a text DateTime. Any other
+ * value is a text DateTime if it has letters in it, and otherwise kept as date and time.
+ * @param arena The arena of the Card being built, or NULL for a heap Card.
+ * @param property The BDAY or ANNIVERSARY property.
+ * @param value The property value.
+ * @return The new DateTime, or NULL if memory allocation fails.
+ */
+static DateTime *createLineDateTime(Arena *arena, const Property *property, const char *value)
+{
+    DateTime *dt = cardAlloc(arena, sizeof(DateTime));
+    if (!dt)
+        return NULL;
+    dt->UTC = false;
+    bool isTextParam = false;
+    ListIterator paramIter = createIterator(property->parameters);
+    Parameter *currParam = NULL;
+    while ((currParam = nextElement(&paramIter)) != NULL)
+    {
+        if (strcmp(currParam->name, "VALUE") == 0 &&
+            strcmp(currParam->value, "text") == 0)
+        {
+            isTextParam = true;
+            break;
+        }
+    }
+
+    PackedDateTime packed;
+    size_t length = strlen(value);
+    size_t dateLength = strcspn(value, "T");
+    bool isDate = !isTextParam && parseDateAndOrTime(value, &packed) == OK;
+    if (isDate && dateLength < length)
+    {
+        dt->UTC = value[length - 1] == 'Z';
+        dt->date = cardCopySpan(arena, value, 0, dateLength);
+        dt->time = cardCopySpan(arena, value, dateLength + 1, length - dt->UTC);
+        dt->isText = false;
+        dt->text = cardCopyString(arena, "");
+    }
+    else if (isDate)
+    {
+        dt->date = cardCopySpan(arena, value, 0, length);
+        dt->time = cardCopyString(arena, "");
+        dt->isText = false;
+        dt->text = cardCopyString(arena, "");
+    }
+    else if (!isTextParam && (dateLength < length || length == 10 || !containsAlpha(value)))
+    {
+        // Not a valid date-and-or-time, but kept in the form earlier versions parsed it to.
+        dt->date = cardCopySpan(arena, value, 0, dateLength);
+        dt->time = cardCopyString(arena, dateLength < length ? value + dateLength + 1 : "");
+        dt->isText = false;
+        dt->text = cardCopyString(arena, "");
+    }
+    else
+    {
+        dt->date = cardCopyString(arena, "");
+        dt->time = cardCopyString(arena, "");
+        dt->isText = true;
+        dt->text = cardCopySpan(arena, value, 0, length);
+    }
+
+    if (!dt->date || !dt->time || !dt->text)
+    {
+        if (!arena)
+            deleteDate(dt);
+        return NULL;
+    }
+    return dt;
+}
+
+/**
+ * Builds a Card object from the logical lines of a single BEGIN:VCARD ... END:VCARD block.
+ * The lines are not modified and remain owned by the caller.
+ * @param logicalLines The unfolded lines of the card.
+ * @param numLines The number of lines.
+ * @param arena The arena to build the Card in, or NULL to build it on the heap.
+ * @param obj A pointer to a Card pointer that will be set to the newly created Card on success.
+ * @return OK on success, or an appropriate VCardErrorCode if an error occurs.
+ */
+static VCardErrorCode parseLogicalLines(char **logicalLines, int numLines, Arena *arena, Card **obj)
+{
+    // Check for proper BEGIN/END lines.
+    if (numLines < 2 ||
+        strcmp(logicalLines[0], "BEGIN:VCARD") != 0 ||
+        strcmp(logicalLines[numLines - 1], "END:VCARD") != 0)
+        return INV_CARD;
+
+    Card *newCard = cardAlloc(arena, sizeof(Card));
+    if (!newCard)
+        return OTHER_ERROR;
+    newCard->fn = NULL;
+    newCard->optionalProperties = cardList(arena, &propertyToString, &deleteProperty, &compareProperties);
+    newCard->birthday = NULL;
+    newCard->anniversary = NULL;
+    if (!newCard->optionalProperties)
+    {
+        discardCard(arena, newCard);
+        return OTHER_ERROR;
+    }
+
+    bool versionFound = false;
+    // Process lines 2 to (numLines - 1)
+    for (int i = 1; i < numLines - 1; i++)
+    {
+        const char *line = logicalLines[i];
+        size_t length = strlen(line);
+        if (length == 0)
+            continue;
+        Property *property = NULL;
+        PropertyKind kind = PROP_OTHER;
+        VCardErrorCode err = tokenizeContentLine(arena, line, length, &property, &kind);
+        if (err != OK)
+        {
+            discardCard(arena, newCard);
+            return err;
+        }
+        const char *value = (const char *)getFromFront(property->values);
+
+        // Special handling for reserved properties.
+        switch (kind)
+        {
+        case PROP_BEGIN:
+        case PROP_END:
+            discardProperty(arena, property);
+            break;
+        case PROP_VERSION:
         {
-            if (fprintf(fp, "BDAY;VALUE=text:%s\r\n", dt->text) < 0)
+            bool validVersion = value && strcmp(value, "4.0") == 0;
+            discardProperty(arena, property);
+            if (!validVersion)
+            {
+                discardCard(arena, newCard);
+                return INV_CARD;
+            }
+            versionFound = true;
+            break;
+        }
+        case PROP_BDAY:
+        case PROP_ANNIVERSARY:
+        {
+            DateTime *dt = createLineDateTime(arena, property, value);
+            discardProperty(arena, property);
+            if (!dt)
+            {
+                discardCard(arena, newCard);
+                return OTHER_ERROR;
+            }
+            DateTime **slot = kind == PROP_BDAY ? &newCard->birthday : &newCard->anniversary;
+            if (*slot && !arena)
+                deleteDate(*slot);
+            *slot = dt;
+            break;
+        }
+        case PROP_FN:
+            if (newCard->fn == NULL)
+            {
+                newCard->fn = property;
+                break;
+            }
+            // fall through
+        default:
+            // All other properties (and any additional FN) go into optionalProperties.
+            if (!cardAppend(arena, newCard->optionalProperties, property))
             {
-                fclose(fp);
-                return WRITE_ERROR;
+                discardProperty(arena, property);
+                discardCard(arena, newCard);
+                return OTHER_ERROR;
             }
         }
+    }
+
+    if (!versionFound || !newCard->fn)
+    {
+        discardCard(arena, newCard);
+        return INV_CARD;
+    }
+
+    *obj = newCard;
+    return OK;
+}
+
+/**
+ * Creates the arena for an arena-backed Card. Parsing needs roughly twice the size of
+ * the card text once the structs and list nodes are counted.
+ * @param textSize The size of the card text, or 0 if it is not known.
+ * @return The new arena, or NULL if memory allocation fails.
+ */
+static Arena *createCardArena(size_t textSize)
+{
+    size_t size = textSize * 2;
+    return createArena(size < 4096 ? 4096 : size);
+}
+
+/**
+ * Loads a vCard file into a Card, on the heap or in an arena of its own.
+ * Regular files are mapped and parsed in place; anything else is read through stdio.
+ * @param fileName The name of the vCard file.
+ * @param useArena true to build the Card in an arena registered in cardArenas.
+ * @param obj A pointer to a Card pointer that will be set to the newly created Card on success.
+ * @return OK on success, or an appropriate VCardErrorCode if an error occurs.
+ */
+static VCardErrorCode loadCard(char *fileName, bool useArena, Card **obj)
+{
+    if (!obj || !hasCardExtension(fileName))
+        return INV_FILE;
+
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+        return INV_FILE;
+
+    // Regular files are mapped privately and unfolded in place; the mapping is
+    // copy-on-write, so the file itself is never modified.
+    struct stat info;
+    Arena *arena = NULL;
+    VCardErrorCode err;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode))
+    {
+        if (info.st_size == 0)
+        {
+            close(fd);
+            return INV_CARD;
+        }
+        size_t size = (size_t)info.st_size;
+        char *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+            return OTHER_ERROR;
+        madvise(data, size, MADV_SEQUENTIAL);
+
+        if (useArena && !(arena = createCardArena(size)))
+            err = OTHER_ERROR;
         else
+            err = parseCardSpan(data, size, arena, obj);
+        munmap(data, size);
+    }
+    else
+    {
+        // Anything else (pipes, character devices) is read through stdio.
+        FILE *file = fdopen(fd, "r");
+        if (!file)
+        {
+            close(fd);
+            return INV_FILE;
+        }
+
+        // Remove BOM if present.
+        removeBOM(file);
+
+        // Read the file into an array of "logical" lines.
+        int numLines = 0, capacity = 10;
+        char **logicalLines = malloc(capacity * sizeof(char *));
+        if (!logicalLines)
+        {
+            fclose(file);
+            return OTHER_ERROR;
+        }
+
+        LineReader reader;
+        initLineReader(&reader, file);
+        char *line = NULL;
+        while ((err = nextLogicalLine(&reader, &line)) == OK && line)
         {
-            char *bday = dateToString((void *)dt);
-            if (fprintf(fp, "BDAY:%s\r\n", bday) < 0)
+            if (!appendLogicalLine(&logicalLines, &numLines, &capacity, line))
             {
-                free(bday);
-                fclose(fp);
-                return WRITE_ERROR;
+                free(line);
+                err = OTHER_ERROR;
+                break;
             }
-            free(bday);
         }
+        releaseLineReader(&reader);
+        fclose(file);
+
+        if (err == OK && useArena && !(arena = createCardArena(0)))
+            err = OTHER_ERROR;
+        if (err == OK)
+            err = parseLogicalLines(logicalLines, numLines, arena, obj);
+        freeLogicalLines(logicalLines, numLines);
+    }
+
+    if (arena && (err != OK || !sideTablePut(&cardArenas, *obj, arena)))
+    {
+        destroyArena(arena);
+        if (err == OK)
+            err = OTHER_ERROR;
+    }
+    return err;
+}
+
+/**
+ * Parses a vCard file and creates a Card object.
+ * Checks for proper file extension, required vCard tags, and processes properties.
+ * @param fileName The name of the vCard file.
+ * @param obj A pointer to a Card pointer that will be set to the newly created Card on success.
+ * @return OK on success, or an appropriate VCardErrorCode if an error occurs.
+ */
+VCardErrorCode createCard(char *fileName, Card **obj)
+{
+    return loadCard(fileName, false, obj);
+}
+
+/**
+ * Parses a vCard file into a Card whose memory all comes from one arena.
+ * The Card behaves like one from createCard, but deleteCard frees it in a single step.
+ * @param fileName The name of the vCard file.
+ * @param obj A pointer to a Card pointer that will be set to the newly created Card on success.
+ * @return OK on success, or an appropriate VCardErrorCode if an error occurs.
+ */
+VCardErrorCode createArenaCard(char *fileName, Card **obj)
+{
+    return loadCard(fileName, true, obj);
+}
+
+/**
+ * Parses the collected lines of one card in a stream and hands the result to the callback.
+ * @param lines The logical lines of the card.
+ * @param numLines The number of lines.
+ * @param lineError The first line-level error seen while reading the card, or OK.
+ * @param cardIndex The zero-based position of the card in the stream.
+ * @param callback The stream callback.
+ * @param userData Caller data passed through to the callback.
+ * @return The callback's result: true to keep streaming, false to stop.
+ */
+static bool emitStreamCard(char **lines, int numLines, VCardErrorCode lineError, int cardIndex,
+                           CardStreamCallback callback, void *userData)
+{
+    Card *card = NULL;
+    VCardErrorCode err = lineError;
+    if (err == OK)
+        err = parseLogicalLines(lines, numLines, NULL, &card);
+    return callback(err == OK ? card : NULL, err, cardIndex, userData);
+}
+
+/**
+ * A source of logical lines for the streaming parser: either a stdio reader, whose
+ * lines are heap-allocated, or an in-place span reader, whose lines live in its buffer.
+ */
+typedef struct lineSource
+{
+    LineReader *file;
+    SpanReader *span;
+} LineSource;
+
+/**
+ * Reads the next logical line from a line source.
+ * @param source The line source.
+ * @param line Set to the next logical line, or NULL once the source is exhausted.
+ * @return The error code of the underlying reader.
+ */
+static VCardErrorCode nextSourceLine(LineSource *source, char **line)
+{
+    if (source->file)
+        return nextLogicalLine(source->file, line);
+    return nextSpanLine(source->span, line);
+}
+
+/**
+ * Releases a single line read from a line source.
+ * @param source The line source the line came from.
+ * @param line The line to release.
+ */
+static void releaseSourceLine(LineSource *source, char *line)
+{
+    if (source->file)
+        free(line);
+}
+
+/**
+ * Releases the lines collected from a line source, leaving the array allocated and empty.
+ * @param source The line source the lines came from.
+ * @param lines The array of lines.
+ * @param numLines The number of lines, reset to zero.
+ */
+static void releaseSourceLines(LineSource *source, char **lines, int *numLines)
+{
+    for (int i = 0; i < *numLines; i++)
+        releaseSourceLine(source, lines[i]);
+    *numLines = 0;
+}
+
+/**
+ * Splits a line source into BEGIN:VCARD ... END:VCARD blocks and parses each block,
+ * invoking the callback once per card. Only the lines of the current card are kept.
+ * @param source The line source.
+ * @param callback Called once per card; receives ownership of the Card on OK.
+ * @param userData Caller data passed through to the callback.
+ * @return OK once the source has been read, or OTHER_ERROR on allocation failure.
+ */
+static VCardErrorCode streamCards(LineSource *source, CardStreamCallback callback, void *userData)
+{
+    int numLines = 0, capacity = 16;
+    char **lines = malloc(capacity * sizeof(char *));
+    if (!lines)
+        return OTHER_ERROR;
+
+    VCardErrorCode status = OK;
+    VCardErrorCode lineError = OK;
+    int cardIndex = 0;
+    bool keepGoing = true;
+    while (keepGoing)
+    {
+        char *line = NULL;
+        VCardErrorCode err = nextSourceLine(source, &line);
+        if (err == OTHER_ERROR)
+        {
+            status = OTHER_ERROR;
+            break;
+        }
+        if (err != OK)
+        {
+            // The malformed physical line invalidates the card it belongs to.
+            if (lineError == OK)
+                lineError = err;
+            continue;
+        }
+        if (!line)
+            break;
+
+        // Skip blank lines between cards.
+        if (numLines == 0 && lineError == OK && line[0] == '\0')
+        {
+            releaseSourceLine(source, line);
+            continue;
+        }
+
+        // A BEGIN inside an open card means the previous card was never terminated.
+        if (numLines > 0 && strcmp(line, "BEGIN:VCARD") == 0)
+        {
+            keepGoing = emitStreamCard(lines, numLines, lineError != OK ? lineError : INV_CARD,
+                                       cardIndex++, callback, userData);
+            releaseSourceLines(source, lines, &numLines);
+            lineError = OK;
+            if (!keepGoing)
+            {
+                releaseSourceLine(source, line);
+                break;
+            }
+        }
+
+        if (!appendLogicalLine(&lines, &numLines, &capacity, line))
+        {
+            releaseSourceLine(source, line);
+            status = OTHER_ERROR;
+            break;
+        }
+
+        if (strcmp(line, "END:VCARD") == 0)
+        {
+            keepGoing = emitStreamCard(lines, numLines, lineError, cardIndex++, callback, userData);
+            releaseSourceLines(source, lines, &numLines);
+            lineError = OK;
+        }
+    }
+
+    // Whatever is left over is a card that was never terminated.
+    if (status == OK && keepGoing && (numLines > 0 || lineError != OK))
+        emitStreamCard(lines, numLines, lineError != OK ? lineError : INV_CARD, cardIndex, callback, userData);
+
+    releaseSourceLines(source, lines, &numLines);
+    free(lines);
+    return status;
+}
+
+/**
+ * Parses every BEGIN:VCARD ... END:VCARD block of a (possibly very large) vCard file,
+ * invoking the callback once per card. Only the lines of the card currently being
+ * parsed are held in memory. A malformed card is reported to the callback with its
+ * error code and a NULL Card, and parsing resumes with the next card.
+ * @param fileName The name of the vCard file.
+ * @param callback Called once per card; receives ownership of the Card on OK.
+ * @param userData Caller data passed through to the callback.
+ * @return OK once the stream has been read (even if some cards were invalid), INV_FILE if
+ *         the file cannot be opened, or OTHER_ERROR on allocation failure.
+ */
+VCardErrorCode parseCardStream(const char *fileName, CardStreamCallback callback, void *userData)
+{
+    if (!callback || !hasCardExtension(fileName))
+        return INV_FILE;
+
+    FILE *file = fopen(fileName, "r");
+    if (!file)
+        return INV_FILE;
+    removeBOM(file);
+
+    LineReader reader;
+    initLineReader(&reader, file);
+    LineSource source = {&reader, NULL};
+    VCardErrorCode status = streamCards(&source, callback, userData);
+    releaseLineReader(&reader);
+    fclose(file);
+    return status;
+}
+
+/**
+ * Copies a caller's buffer into a mutable scratch buffer for in-place parsing.
+ * @param buffer The vCard text.
+ * @param length The number of bytes of vCard text.
+ * @return The newly allocated copy, or NULL if memory allocation fails.
+ */
+static char *copyCardBuffer(const char *buffer, size_t length)
+{
+    char *copy = malloc(length);
+    if (copy)
+        memcpy(copy, buffer, length);
+    return copy;
+}
+
+/**
+ * Parses a single vCard held in memory and creates a Card object.
+ * The input is copied once and then unfolded and tokenized in place, exactly as
+ * createCard does for a mapped file.
+ * @param buffer The vCard text. It does not need to be NUL-terminated.
+ * @param length The number of bytes of vCard text.
+ * @param obj A pointer to a Card pointer that will be set to the newly created Card on success.
+ * @return OK on success, or an appropriate VCardErrorCode if an error occurs.
+ */
+VCardErrorCode createCardFromBuffer(const char *buffer, size_t length, Card **obj)
+{
+    if (!buffer || !obj)
+        return INV_FILE;
+    if (length == 0)
+        return INV_CARD;
+
+    char *data = copyCardBuffer(buffer, length);
+    if (!data)
+        return OTHER_ERROR;
+    VCardErrorCode err = parseCardSpan(data, length, NULL, obj);
+    free(data);
+    return err;
+}
+
+/**
+ * Parses every card of a multi-card vCard held in memory, invoking the callback once per card.
+ * @param buffer The vCard text. It does not need to be NUL-terminated.
+ * @param length The number of bytes of vCard text.
+ * @param callback Called once per card; receives ownership of the Card on OK.
+ * @param userData Caller data passed through to the callback.
+ * @return OK once the buffer has been read (even if some cards were invalid), INV_FILE for a
+ *         NULL buffer or callback, or OTHER_ERROR on allocation failure.
+ */
+VCardErrorCode parseCardBufferStream(const char *buffer, size_t length, CardStreamCallback callback, void *userData)
+{
+    if (!buffer || !callback)
+        return INV_FILE;
+    if (length == 0)
+        return OK;
+
+    char *data = copyCardBuffer(buffer, length);
+    if (!data)
+        return OTHER_ERROR;
+
+    size_t bom = byteOrderMarkLength(data, length);
+    SpanReader reader = {data + bom, length - bom, 0};
+    LineSource source = {NULL, &reader};
+    VCardErrorCode status = streamCards(&source, callback, userData);
+    free(data);
+    return status;
+}
+
+/**
+ * Output buffer of the card serializer. When the buffer is too small (or NULL, in the
+ * counting pass), output past capacity is dropped but still counted, so one pass over
+ * the card yields its exact size. When fold is set, column tracks the octets on the
+ * current physical line so that long lines can be folded.
+ */
+typedef struct cardWriter
+{
+    char *buffer;
+    size_t capacity;
+    size_t length;
+    bool fold;
+    size_t column;
+} CardWriter;
+
+#define MAX_LINE_OCTETS 75
+
+/**
+ * Appends bytes to a writer without folding.
+ * @param writer The writer.
+ * @param text The bytes to append.
+ * @param length The number of bytes.
+ */
+static void writeRaw(CardWriter *writer, const char *text, size_t length)
+{
+    if (writer->length < writer->capacity)
+    {
+        size_t room = writer->capacity - writer->length;
+        memcpy(writer->buffer + writer->length, text, length < room ? length : room);
+    }
+    writer->length += length;
+}
+
+/**
+ * Appends bytes to the current line of a folding writer. Whole runs of up to 75 octets
+ * are copied at once; at each boundary the cut moves back over at most three UTF-8
+ * continuation bytes, so a multi-byte character is never split, and CRLF plus a space
+ * starts the next physical line.
+ * @param writer The writer.
+ * @param text The bytes to append.
+ * @param length The number of bytes.
+ */
+static void writeFolded(CardWriter *writer, const char *text, size_t length)
+{
+    while (length > MAX_LINE_OCTETS - writer->column)
+    {
+        size_t cut = MAX_LINE_OCTETS - writer->column;
+        size_t backoff = 0;
+        while (backoff < 3 && cut > backoff && ((unsigned char)text[cut - backoff] & 0xC0) == 0x80)
+            backoff++;
+        // More than three continuation bytes in a row is not UTF-8; cut at the boundary.
+        if (((unsigned char)text[cut - backoff] & 0xC0) != 0x80)
+            cut -= backoff;
+        writeRaw(writer, text, cut);
+        writeRaw(writer, "\r\n ", 3);
+        writer->column = 1;
+        text += cut;
+        length -= cut;
+    }
+    writeRaw(writer, text, length);
+    writer->column += length;
+}
+
+/**
+ * Appends bytes to a writer, folding the line if the writer folds.
+ * @param writer The writer.
+ * @param text The bytes to append.
+ * @param length The number of bytes.
+ */
+static void writeBytes(CardWriter *writer, const char *text, size_t length)
+{
+    if (writer->fold)
+        writeFolded(writer, text, length);
+    else
+        writeRaw(writer, text, length);
+}
+
+/**
+ * Ends the current content line with CRLF.
+ * @param writer The writer.
+ */
+static void writeLineEnd(CardWriter *writer)
+{
+    writeRaw(writer, "\r\n", 2);
+    writer->column = 0;
+}
+
+/**
+ * Appends a NUL-terminated string to a writer.
+ * @param writer The writer.
+ * @param text The string to append.
+ */
+static void writeString(CardWriter *writer, const char *text)
+{
+    writeBytes(writer, text, strlen(text));
+}
+
+/**
+ * Writes a Property as one content line in vCard file format:
+ * [group.]name[;paramName=paramValue...]:value[;value2...] followed by CRLF.
+ * @param writer The writer.
+ * @param prop The Property to write.
+ */
+static void writePropertyLine(CardWriter *writer, const Property *prop)
+{
+    if (prop->group[0] != '\0')
+    {
+        writeString(writer, prop->group);
+        writeBytes(writer, ".", 1);
+    }
+    writeString(writer, prop->name);
+
+    ListIterator paramIter = createIterator(prop->parameters);
+    Parameter *param;
+    while ((param = nextElement(&paramIter)) != NULL)
+    {
+        writeBytes(writer, ";", 1);
+        writeString(writer, param->name);
+        writeBytes(writer, "=", 1);
+        writeString(writer, param->value);
+    }
+
+    writeBytes(writer, ":", 1);
+    // Property values are joined by semicolons.
+    ListIterator valIter = createIterator(prop->values);
+    const char *value;
+    bool first = true;
+    while ((value = nextElement(&valIter)) != NULL)
+    {
+        if (!first)
+            writeBytes(writer, ";", 1);
+        writeString(writer, value);
+        first = false;
+    }
+    writeLineEnd(writer);
+}
+
+/**
+ * Writes a DateTime in the same form as dateToString.
+ * @param writer The writer.
+ * @param dt The DateTime to write.
+ */
+static void writeDateValue(CardWriter *writer, const DateTime *dt)
+{
+    if (dt->isText)
+    {
+        writeString(writer, dt->text);
+        return;
+    }
+    writeString(writer, dt->date);
+    if (dt->time[0] != '\0' || dt->date[0] == '\0')
+    {
+        writeBytes(writer, "T", 1);
+        writeString(writer, dt->time);
+        if (dt->UTC && dt->time[0] != '\0' && dt->time[strlen(dt->time) - 1] != 'Z')
+            writeBytes(writer, "Z", 1);
+    }
+}
+
+/**
+ * Writes a BDAY or ANNIVERSARY content line.
+ * @param writer The writer.
+ * @param name The property name.
+ * @param dt The DateTime to write.
+ */
+static void writeDateLine(CardWriter *writer, const char *name, const DateTime *dt)
+{
+    writeString(writer, name);
+    if (dt->isText)
+        writeString(writer, ";VALUE=text");
+    writeBytes(writer, ":", 1);
+    writeDateValue(writer, dt);
+    writeLineEnd(writer);
+}
+
+/**
+ * Writes a whole Card in vCard file format with CRLF line endings, unfolded.
+ * @param writer The writer.
+ * @param obj The Card to write. Its FN must not be NULL.
+ */
+static void writeCardText(CardWriter *writer, const Card *obj)
+{
+    writeString(writer, "BEGIN:VCARD");
+    writeLineEnd(writer);
+    writeString(writer, "VERSION:4.0");
+    writeLineEnd(writer);
+    writePropertyLine(writer, obj->fn);
+    if (obj->birthday)
+        writeDateLine(writer, "BDAY", obj->birthday);
+    if (obj->anniversary)
+        writeDateLine(writer, "ANNIVERSARY", obj->anniversary);
+
+    ListIterator iter = createIterator(obj->optionalProperties);
+    const Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
+        writePropertyLine(writer, prop);
+    writeString(writer, "END:VCARD");
+    writeLineEnd(writer);
+}
+
+/**
+ * Writes a string as a JSON string literal. Runs of bytes that need no escaping are
+ * copied in one step; quotes, backslashes and control characters are escaped. Other
+ * bytes, including UTF-8 sequences, are copied unchanged.
+ * @param writer The writer.
+ * @param text The string to write. NULL is written as null.
+ */
+static void writeJSONString(CardWriter *writer, const char *text)
+{
+    if (!text)
+    {
+        writeRaw(writer, "null", 4);
+        return;
+    }
+    static const char hex[] = "0123456789abcdef";
+    writeRaw(writer, "\"", 1);
+    const char *run = text;
+    for (const char *c = text;; c++)
+    {
+        unsigned char byte = (unsigned char)*c;
+        if (byte >= 0x20 && byte != '"' && byte != '\\')
+            continue;
+        writeRaw(writer, run, (size_t)(c - run));
+        if (byte == '\0')
+            break;
+        switch (byte)
+        {
+        case '"':
+            writeRaw(writer, "\\\"", 2);
+            break;
+        case '\\':
+            writeRaw(writer, "\\\\", 2);
+            break;
+        case '\n':
+            writeRaw(writer, "\\n", 2);
+            break;
+        case '\r':
+            writeRaw(writer, "\\r", 2);
+            break;
+        case '\t':
+            writeRaw(writer, "\\t", 2);
+            break;
+        default:
+        {
+            char escape[6] = {'\\', 'u', '0', '0', hex[byte >> 4], hex[byte & 0xF]};
+            writeRaw(writer, escape, sizeof(escape));
+        }
+        }
+        run = c + 1;
+    }
+    writeRaw(writer, "\"", 1);
+}
+
+/**
+ * Writes a Property as a JSON object with its group, name, parameters and values.
+ * @param writer The writer.
+ * @param prop The Property to write. NULL is written as null.
+ */
+static void writeJSONProperty(CardWriter *writer, const Property *prop)
+{
+    if (!prop)
+    {
+        writeRaw(writer, "null", 4);
+        return;
+    }
+    writeString(writer, "{\"group\":");
+    writeJSONString(writer, prop->group);
+    writeString(writer, ",\"name\":");
+    writeJSONString(writer, prop->name);
+    writeString(writer, ",\"parameters\":[");
+    ListIterator paramIter = createIterator(prop->parameters);
+    const Parameter *param;
+    bool first = true;
+    while ((param = nextElement(&paramIter)) != NULL)
+    {
+        writeString(writer, first ? "{\"name\":" : ",{\"name\":");
+        writeJSONString(writer, param->name);
+        writeString(writer, ",\"value\":");
+        writeJSONString(writer, param->value);
+        writeRaw(writer, "}", 1);
+        first = false;
+    }
+    writeString(writer, "],\"values\":[");
+    ListIterator valIter = createIterator(prop->values);
+    const char *value;
+    first = true;
+    while ((value = nextElement(&valIter)) != NULL)
+    {
+        if (!first)
+            writeRaw(writer, ",", 1);
+        writeJSONString(writer, value);
+        first = false;
+    }
+    writeString(writer, "]}");
+}
+
+/**
+ * Writes a DateTime as a JSON object with all of its fields.
+ * @param writer The writer.
+ * @param dt The DateTime to write. NULL is written as null.
+ */
+static void writeJSONDate(CardWriter *writer, const DateTime *dt)
+{
+    if (!dt)
+    {
+        writeRaw(writer, "null", 4);
+        return;
+    }
+    writeString(writer, dt->UTC ? "{\"UTC\":true" : "{\"UTC\":false");
+    writeString(writer, dt->isText ? ",\"isText\":true" : ",\"isText\":false");
+    writeString(writer, ",\"date\":");
+    writeJSONString(writer, dt->date);
+    writeString(writer, ",\"time\":");
+    writeJSONString(writer, dt->time);
+    writeString(writer, ",\"text\":");
+    writeJSONString(writer, dt->text);
+    writeRaw(writer, "}", 1);
+}
+
+/**
+ * Writes a whole Card as a JSON object mirroring the Card struct.
+ * @param writer The writer.
+ * @param obj The Card to write.
+ */
+static void writeJSONCard(CardWriter *writer, const Card *obj)
+{
+    writeString(writer, "{\"fn\":");
+    writeJSONProperty(writer, obj->fn);
+    writeString(writer, ",\"birthday\":");
+    writeJSONDate(writer, obj->birthday);
+    writeString(writer, ",\"anniversary\":");
+    writeJSONDate(writer, obj->anniversary);
+    writeString(writer, ",\"optionalProperties\":[");
+    ListIterator iter = createIterator(obj->optionalProperties);
+    const Property *prop;
+    bool first = true;
+    while ((prop = nextElement(&iter)) != NULL)
+    {
+        if (!first)
+            writeRaw(writer, ",", 1);
+        writeJSONProperty(writer, prop);
+        first = false;
+    }
+    writeString(writer, "]}");
+}
+
+/**
+ * Converts a Card into a JSON object. A counting pass computes the exact length first,
+ * so the string is allocated once and filled in a single linear pass.
+ * @param obj The Card to convert.
+ * @return A newly allocated JSON string, "null" if obj is NULL, or NULL if memory allocation fails.
+ */
+char *cardToJSON(const Card *obj)
+{
+    if (!obj)
+        return duplicateString("null");
+    CardWriter counter = {NULL, 0, 0, false, 0};
+    writeJSONCard(&counter, obj);
+    char *json = malloc(counter.length + 1);
+    if (!json)
+        return NULL;
+    CardWriter writer = {json, counter.length, 0, false, 0};
+    writeJSONCard(&writer, obj);
+    json[writer.length] = '\0';
+    return json;
+}
+
+/**
+ * Serializes a Card into a caller-provided buffer, like snprintf: at most capacity bytes
+ * are stored, including a terminating NUL, and the return value is the full length.
+ * @param obj The Card to serialize.
+ * @param buffer The output buffer. May be NULL if capacity is 0.
+ * @param capacity The size of the buffer.
+ * @param flags VCARD_FOLD_LINES to fold content lines at 75 octets, or 0.
+ * @return The length of the serialized card, excluding the NUL, or 0 if obj is invalid.
+ */
+size_t serializeCardWithFlags(const Card *obj, char *buffer, size_t capacity, int flags)
+{
+    if (!obj || !obj->fn || (!buffer && capacity > 0))
+        return 0;
+    CardWriter writer = {buffer, capacity > 0 ? capacity - 1 : 0, 0, (flags & VCARD_FOLD_LINES) != 0, 0};
+    writeCardText(&writer, obj);
+    if (capacity > 0)
+        buffer[writer.length < capacity - 1 ? writer.length : capacity - 1] = '\0';
+    return writer.length;
+}
+
+/**
+ * Serializes a Card into a caller-provided buffer without folding.
+ * @param obj The Card to serialize.
+ * @param buffer The output buffer. May be NULL if capacity is 0.
+ * @param capacity The size of the buffer.
+ * @return The length of the serialized card, excluding the NUL, or 0 if obj is invalid.
+ */
+size_t serializeCard(const Card *obj, char *buffer, size_t capacity)
+{
+    return serializeCardWithFlags(obj, buffer, capacity, 0);
+}
+
+/**
+ * Serializes a Card into a newly allocated string. The exact size is computed by a
+ * counting pass, so the string is allocated once and never grown.
+ * @param obj The Card to serialize.
+ * @return The vCard text, or NULL if obj is invalid or memory allocation fails.
+ */
+char *cardToFileString(const Card *obj)
+{
+    size_t length = serializeCard(obj, NULL, 0);
+    if (length == 0)
+        return NULL;
+    char *text = malloc(length + 1);
+    if (!text)
+        return NULL;
+    serializeCard(obj, text, length + 1);
+    return text;
+}
+
+/**
+ * Creates or truncates a file and writes a buffer to it, retrying short writes.
+ * @param fileName The file to write.
+ * @param data The bytes to write.
+ * @param length The number of bytes.
+ * @return true on success, false if the file cannot be opened or written.
+ */
+static bool writeFileBytes(const char *fileName, const char *data, size_t length)
+{
+    int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0)
+        return false;
+    size_t written = 0;
+    while (written < length)
+    {
+        ssize_t n = write(fd, data + written, length - written);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        written += (size_t)n;
+    }
+    return close(fd) == 0 && written == length;
+}
+
+/**
+ * Writes a Card object to a file in valid vCard format with CRLF line endings.
+ * The card is serialized into one exactly sized buffer and written with a single
+ * write call. If any write fails, returns WRITE_ERROR.
+ * @param fileName The output file name.
+ * @param obj The Card object to write.
+ * @param flags VCARD_FOLD_LINES to fold content lines at 75 octets, or 0.
+ * @return OK on success, WRITE_ERROR on failure.
+ */
+VCardErrorCode writeCardWithFlags(const char *fileName, const Card *obj, int flags)
+{
+    if (!fileName || !obj || !obj->fn)
+        return WRITE_ERROR;
+
+    size_t length = serializeCardWithFlags(obj, NULL, 0, flags);
+    char *text = malloc(length + 1);
+    if (!text)
+        return WRITE_ERROR;
+    serializeCardWithFlags(obj, text, length + 1, flags);
+    VCardErrorCode err = writeFileBytes(fileName, text, length) ? OK : WRITE_ERROR;
+    free(text);
+    return err;
+}
+
+/**
+ * Writes a Card object to a file in valid vCard format with CRLF line endings.
+ * The output is not folded. If any write fails, returns WRITE_ERROR.
+ * @param fileName The output file name.
+ * @param obj The Card object to write.
+ * @return OK on success, WRITE_ERROR on failure.
+ */
+VCardErrorCode writeCard(const char *fileName, const Card *obj)
+{
+    return writeCardWithFlags(fileName, obj, 0);
+}
+
+#define PROPERTY_KIND_COUNT (PROP_CALURI + 1)
+#define CARD_BINARY_MAGIC "VCRD"
+#define CARD_BINARY_HEADER_SIZE 24
+#define BINARY_HAS_BIRTHDAY 0x1
+#define BINARY_HAS_ANNIVERSARY 0x2
+#define BINARY_DATE_UTC 0x1
+#define BINARY_DATE_TEXT 0x2
+
+/**
+ * Writes a 32-bit integer in little-endian byte order.
+ * @param writer The writer.
+ * @param value The integer.
+ */
+static void writeBinaryU32(CardWriter *writer, uint32_t value)
+{
+    char bytes[4] = {(char)value, (char)(value >> 8), (char)(value >> 16), (char)(value >> 24)};
+    writeRaw(writer, bytes, sizeof(bytes));
+}
+
+/**
+ * Writes a 64-bit integer in little-endian byte order.
+ * @param writer The writer.
+ * @param value The integer.
+ */
+static void writeBinaryU64(CardWriter *writer, uint64_t value)
+{
+    writeBinaryU32(writer, (uint32_t)value);
+    writeBinaryU32(writer, (uint32_t)(value >> 32));
+}
+
+/**
+ * Writes an unsigned integer as a LEB128 varint: seven bits per byte, low bits first,
+ * with the high bit set on every byte but the last. Values below 128 take one byte.
+ * @param writer The writer.
+ * @param value The integer.
+ */
+static void writeBinaryVarint(CardWriter *writer, uint32_t value)
+{
+    char bytes[5];
+    size_t length = 0;
+    while (value >= 0x80)
+    {
+        bytes[length++] = (char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[length++] = (char)value;
+    writeRaw(writer, bytes, length);
+}
+
+/**
+ * Writes a string as a varint length, its bytes and a NUL, so that a loaded copy of the
+ * encoding can be used as a C string in place.
+ * @param writer The writer.
+ * @param text The string. NULL is written as an empty string.
+ */
+static void writeBinaryString(CardWriter *writer, const char *text)
+{
+    size_t length = text ? strlen(text) : 0;
+    writeBinaryVarint(writer, (uint32_t)length);
+    writeRaw(writer, text ? text : "", length + 1);
+}
+
+/**
+ * Writes a Property: its kind, its name if the kind is PROP_OTHER, its group, then its
+ * parameters and values, each list preceded by its length.
+ * @param writer The writer.
+ * @param prop The Property to write.
+ */
+static void writeBinaryProperty(CardWriter *writer, const Property *prop)
+{
+    char kind = (char)propertyKind(prop->name);
+    writeRaw(writer, &kind, 1);
+    if (kind == PROP_OTHER)
+        writeBinaryString(writer, prop->name);
+    writeBinaryString(writer, prop->group);
+
+    writeBinaryVarint(writer, (uint32_t)getLength(prop->parameters));
+    ListIterator paramIter = createIterator(prop->parameters);
+    const Parameter *param;
+    while ((param = nextElement(&paramIter)) != NULL)
+    {
+        writeBinaryString(writer, param->name);
+        writeBinaryString(writer, param->value);
+    }
+    writeBinaryVarint(writer, (uint32_t)getLength(prop->values));
+    ListIterator valIter = createIterator(prop->values);
+    const char *value;
+    while ((value = nextElement(&valIter)) != NULL)
+        writeBinaryString(writer, value);
+}
+
+/**
+ * Writes a DateTime: one byte of flags followed by its date, time and text.
+ * @param writer The writer.
+ * @param dt The DateTime to write.
+ */
+static void writeBinaryDate(CardWriter *writer, const DateTime *dt)
+{
+    char flags = (char)((dt->UTC ? BINARY_DATE_UTC : 0) | (dt->isText ? BINARY_DATE_TEXT : 0));
+    writeRaw(writer, &flags, 1);
+    writeBinaryString(writer, dt->date);
+    writeBinaryString(writer, dt->time);
+    writeBinaryString(writer, dt->text);
+}
+
+/**
+ * Writes a whole Card in binary card format. The header records how many properties
+ * (FN first), parameters and values follow, so that a reader can allocate every object
+ * of the Card at once.
+ * @param writer The writer.
+ * @param obj The Card to write. Its FN must not be NULL.
+ * @param totalLength The length to record in the header; 0 during a counting pass.
+ */
+static void writeBinaryCard(CardWriter *writer, const Card *obj, size_t totalLength)
+{
+    uint32_t parameters = (uint32_t)getLength(obj->fn->parameters);
+    uint32_t values = (uint32_t)getLength(obj->fn->values);
+    ListIterator iter = createIterator(obj->optionalProperties);
+    const Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
+    {
+        parameters += (uint32_t)getLength(prop->parameters);
+        values += (uint32_t)getLength(prop->values);
+    }
+
+    char header[4] = {CARD_BINARY_VERSION,
+                      (char)((obj->birthday ? BINARY_HAS_BIRTHDAY : 0) | (obj->anniversary ? BINARY_HAS_ANNIVERSARY : 0)),
+                      0, 0};
+    writeRaw(writer, CARD_BINARY_MAGIC, 4);
+    writeRaw(writer, header, sizeof(header));
+    writeBinaryU32(writer, (uint32_t)getLength(obj->optionalProperties) + 1);
+    writeBinaryU32(writer, parameters);
+    writeBinaryU32(writer, values);
+    writeBinaryU32(writer, (uint32_t)totalLength);
+
+    writeBinaryProperty(writer, obj->fn);
+    iter = createIterator(obj->optionalProperties);
+    while ((prop = nextElement(&iter)) != NULL)
+        writeBinaryProperty(writer, prop);
+    if (obj->birthday)
+        writeBinaryDate(writer, obj->birthday);
+    if (obj->anniversary)
+        writeBinaryDate(writer, obj->anniversary);
+}
+
+/**
+ * Encodes a Card in binary card format into a caller-provided buffer.
+ * @param obj The Card to encode.
+ * @param buffer The output buffer, or NULL if capacity is 0.
+ * @param capacity The size of buffer in bytes.
+ * @return The full length of the encoding, or 0 if obj is NULL, has no FN, or is
+ *         larger than the format allows.
+ */
+size_t serializeCardBinary(const Card *obj, char *buffer, size_t capacity)
+{
+    if (!obj || !obj->fn)
+        return 0;
+    CardWriter counter = {NULL, 0, 0, false, 0};
+    writeBinaryCard(&counter, obj, 0);
+    if (counter.length > UINT32_MAX)
+        return 0;
+    if (capacity > 0)
+    {
+        CardWriter writer = {buffer, capacity, 0, false, 0};
+        writeBinaryCard(&writer, obj, counter.length);
+    }
+    return counter.length;
+}
+
+/**
+ * Writes a Card to a file in binary card format with a single write call.
+ * @param fileName The output file name.
+ * @param obj The Card to write.
+ * @return OK on success, WRITE_ERROR on failure.
+ */
+VCardErrorCode writeCardBinary(const char *fileName, const Card *obj)
+{
+    size_t length = serializeCardBinary(obj, NULL, 0);
+    if (!fileName || length == 0)
+        return WRITE_ERROR;
+    char *data = malloc(length);
+    if (!data)
+        return WRITE_ERROR;
+    serializeCardBinary(obj, data, length);
+    VCardErrorCode err = writeFileBytes(fileName, data, length) ? OK : WRITE_ERROR;
+    free(data);
+    return err;
+}
+
+/*	Bounds-checked cursor over a binary encoding. */
+typedef struct binaryReader
+{
+    const char *data;
+    size_t length;
+    size_t offset;
+} BinaryReader;
+
+/**
+ * Reads one byte.
+ * @param reader The cursor.
+ * @param value Set to the byte.
+ * @return true on success, false if the encoding ends first.
+ */
+static bool readBinaryU8(BinaryReader *reader, uint8_t *value)
+{
+    if (reader->offset >= reader->length)
+        return false;
+    *value = (uint8_t)reader->data[reader->offset++];
+    return true;
+}
+
+/**
+ * Reads a little-endian 32-bit integer.
+ * @param reader The cursor.
+ * @param value Set to the integer.
+ * @return true on success, false if the encoding ends first.
+ */
+static bool readBinaryU32(BinaryReader *reader, uint32_t *value)
+{
+    if (reader->length - reader->offset < 4)
+        return false;
+    const unsigned char *bytes = (const unsigned char *)reader->data + reader->offset;
+    *value = (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+    reader->offset += 4;
+    return true;
+}
+
+/**
+ * Reads a little-endian 64-bit integer.
+ * @param reader The cursor.
+ * @param value Set to the integer.
+ * @return true on success, false if the encoding ends first.
+ */
+static bool readBinaryU64(BinaryReader *reader, uint64_t *value)
+{
+    uint32_t low, high;
+    if (!readBinaryU32(reader, &low) || !readBinaryU32(reader, &high))
+        return false;
+    *value = (uint64_t)high << 32 | low;
+    return true;
+}
+
+/**
+ * Reads a LEB128 varint of at most 32 bits.
+ * @param reader The cursor.
+ * @param value Set to the integer.
+ * @return true on success, false if the encoding ends first or the varint is too long.
+ */
+static bool readBinaryVarint(BinaryReader *reader, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35 && reader->offset < reader->length; shift += 7)
+    {
+        unsigned char byte = (unsigned char)reader->data[reader->offset++];
+        result |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Reads a length-prefixed string in place.
+ * @param reader The cursor.
+ * @return A pointer to the NUL-terminated string inside the encoding, or NULL if the
+ *         string runs past the end or is not terminated.
+ */
+static const char *readBinaryString(BinaryReader *reader)
+{
+    uint32_t length;
+    if (!readBinaryVarint(reader, &length) || reader->length - reader->offset <= length ||
+        reader->data[reader->offset + length] != '\0')
+        return NULL;
+    const char *text = reader->data + reader->offset;
+    reader->offset += (size_t)length + 1;
+    return text;
+}
+
+/*	Objects of a Card being decoded. They are carved out of one arena block sized from
+	the counts in the header; each remaining count guards its array against an encoding
+	whose properties hold more items than the header announced.
+*/
+typedef struct binaryObjects
+{
+    Property *properties;
+    List *lists;
+    Node *nodes;
+    Parameter *parameters;
+    DateTime *dates;
+    uint32_t parametersLeft;
+    uint32_t nodesLeft;
+    char *kindNames[PROPERTY_KIND_COUNT];
+} BinaryObjects;
+
+/**
+ * Initializes the next free List of a Card being decoded.
+ * @param objects The objects of the Card.
+ * @param printFunction Function pointer to print a single element of the list.
+ * @param deleteFunction Function pointer to delete a single element of the list.
+ * @param compareFunction Function pointer to compare two elements of the list.
+ * @return The List.
+ */
+static List *takeBinaryList(BinaryObjects *objects, char *(*printFunction)(void *), void (*deleteFunction)(void *),
+                            int (*compareFunction)(const void *, const void *))
+{
+    List *list = objects->lists++;
+    list->head = NULL;
+    list->tail = NULL;
+    list->length = 0;
+    list->deleteData = deleteFunction;
+    list->compare = compareFunction;
+    list->printData = printFunction;
+    return list;
+}
+
+/**
+ * Appends an element to a List of a Card being decoded, using the next free Node.
+ * @param objects The objects of the Card.
+ * @param list The List.
+ * @param data The element.
+ * @return true on success, false if every Node announced by the header is in use.
+ */
+static bool linkBinaryNode(BinaryObjects *objects, List *list, void *data)
+{
+    if (objects->nodesLeft == 0)
+        return false;
+    objects->nodesLeft--;
+    Node *node = objects->nodes++;
+    node->data = data;
+    node->next = NULL;
+    node->previous = list->tail;
+    if (list->tail)
+        list->tail->next = node;
+    else
+        list->head = node;
+    list->tail = node;
+    list->length++;
+    return true;
+}
+
+/**
+ * Decodes one Property. Strings are not copied: they point into the copy of the
+ * encoding that the arena of the Card holds.
+ * @param reader The cursor, over the arena's copy of the encoding.
+ * @param arena The arena of the Card.
+ * @param objects The objects of the Card; the next free Property is used.
+ * @return The Property, or NULL if the encoding is malformed or memory allocation fails.
+ */
+static Property *readBinaryProperty(BinaryReader *reader, Arena *arena, BinaryObjects *objects)
+{
+    uint8_t kind;
+    if (!readBinaryU8(reader, &kind))
+        return NULL;
+    char *name;
+    if (kind == PROP_OTHER)
+        name = (char *)readBinaryString(reader);
+    else if (kind < PROPERTY_KIND_COUNT)
+    {
+        // Properties of the same kind share one copy of the name.
+        if (!objects->kindNames[kind])
+            objects->kindNames[kind] = cardCopyString(arena, propertyKindName((PropertyKind)kind));
+        name = objects->kindNames[kind];
+    }
+    else
+        return NULL;
+
+    Property *prop = objects->properties++;
+    prop->name = name;
+    prop->group = (char *)readBinaryString(reader);
+    prop->parameters = takeBinaryList(objects, parameterToString, deleteParameter, compareParameters);
+    prop->values = takeBinaryList(objects, valueToString, deleteValue, compareValues);
+    uint32_t count;
+    if (!name || !prop->group || !readBinaryVarint(reader, &count) || count > objects->parametersLeft)
+        return NULL;
+    objects->parametersLeft -= count;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        Parameter *param = objects->parameters++;
+        if (!(param->name = (char *)readBinaryString(reader)) || !(param->value = (char *)readBinaryString(reader)) ||
+            !linkBinaryNode(objects, prop->parameters, param))
+            return NULL;
+    }
+    if (!readBinaryVarint(reader, &count))
+        return NULL;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        char *value = (char *)readBinaryString(reader);
+        if (!value || !linkBinaryNode(objects, prop->values, value))
+            return NULL;
+    }
+    return prop;
+}
+
+/**
+ * Decodes one DateTime into the next free DateTime of a Card being decoded.
+ * @param reader The cursor, over the arena's copy of the encoding.
+ * @param objects The objects of the Card.
+ * @return The DateTime, or NULL if the encoding is malformed.
+ */
+static DateTime *readBinaryDate(BinaryReader *reader, BinaryObjects *objects)
+{
+    uint8_t flags;
+    if (!readBinaryU8(reader, &flags))
+        return NULL;
+    DateTime *dt = objects->dates++;
+    dt->UTC = (flags & BINARY_DATE_UTC) != 0;
+    dt->isText = (flags & BINARY_DATE_TEXT) != 0;
+    dt->date = (char *)readBinaryString(reader);
+    dt->time = (char *)readBinaryString(reader);
+    dt->text = (char *)readBinaryString(reader);
+    return dt->date && dt->time && dt->text ? dt : NULL;
+}
+
+/**
+ * Reads and checks the header of a binary card encoding.
+ * @param data The encoding.
+ * @param length The number of bytes available.
+ * @param flags Set to the date flags.
+ * @param counts Set to the property, parameter and value counts.
+ * @param total Set to the length of the encoding.
+ * @return true if the header is valid, of the current version, and its counts fit the
+ *         recorded length.
+ */
+static bool readBinaryHeader(const char *data, size_t length, uint8_t *flags, uint32_t counts[3], uint32_t *total)
+{
+    if (length < CARD_BINARY_HEADER_SIZE || memcmp(data, CARD_BINARY_MAGIC, 4) != 0 || data[4] != CARD_BINARY_VERSION)
+        return false;
+    *flags = (uint8_t)data[5];
+    BinaryReader reader = {data, length, 8};
+    readBinaryU32(&reader, &counts[0]);
+    readBinaryU32(&reader, &counts[1]);
+    readBinaryU32(&reader, &counts[2]);
+    readBinaryU32(&reader, total);
+    // Every property takes at least 4 bytes, every parameter 4 and every value 2, so
+    // counts that could not fit in the encoding are rejected before anything is allocated.
+    uint64_t minimum = (uint64_t)counts[0] * 4 + (uint64_t)counts[1] * 4 + (uint64_t)counts[2] * 2;
+    return counts[0] > 0 && *total >= CARD_BINARY_HEADER_SIZE && *total <= length &&
+           minimum <= *total - CARD_BINARY_HEADER_SIZE;
+}
+
+/**
+ * Computes the size of the block that holds every object of a decoded Card.
+ * @param counts The property, parameter and value counts of the header.
+ * @return The size in bytes.
+ */
+static size_t binaryObjectsSize(const uint32_t counts[3])
+{
+    size_t properties = counts[0];
+    size_t nodes = (properties - 1) + counts[1] + counts[2];
+    return sizeof(Card) + properties * sizeof(Property) + (2 * properties + 1) * sizeof(List) +
+           nodes * sizeof(Node) + counts[1] * sizeof(Parameter) + 2 * sizeof(DateTime);
+}
+
+/**
+ * Creates the arena of a Card being decoded, sized so that the encoding, the object
+ * block and the shared property names all fit in its first chunk.
+ * @param counts The property, parameter and value counts of the header.
+ * @param total The length of the encoding.
+ * @return The arena, or NULL if memory allocation fails.
+ */
+static Arena *createBinaryArena(const uint32_t counts[3], size_t total)
+{
+    // Slack covers alignment padding and the names of the RFC 6350 properties.
+    return createArena(total + binaryObjectsSize(counts) + 1024);
+}
+
+/**
+ * Decodes a Card from an encoding that already sits in the Card's arena. All objects of
+ * the Card are carved out of one block; only pointers are filled in.
+ * @param arena The arena of the new Card.
+ * @param data The encoding, inside the arena. Its header has been checked.
+ * @param flags The date flags of the header.
+ * @param counts The property, parameter and value counts of the header.
+ * @param total The length of the encoding.
+ * @return The Card, or NULL if the encoding is malformed or memory allocation fails.
+ */
+static Card *decodeBinaryCard(Arena *arena, const char *data, uint8_t flags, const uint32_t counts[3], uint32_t total)
+{
+    size_t properties = counts[0];
+    size_t nodes = (properties - 1) + counts[1] + counts[2];
+    char *block = arenaAlloc(arena, binaryObjectsSize(counts));
+    if (!block)
+        return NULL;
+
+    Card *card = (Card *)block;
+    BinaryObjects objects = {0};
+    objects.properties = (Property *)(card + 1);
+    objects.lists = (List *)(objects.properties + properties);
+    objects.nodes = (Node *)(objects.lists + 2 * properties + 1);
+    objects.parameters = (Parameter *)(objects.nodes + nodes);
+    objects.dates = (DateTime *)(objects.parameters + counts[1]);
+    objects.parametersLeft = counts[1];
+    objects.nodesLeft = (uint32_t)nodes;
+
+    BinaryReader reader = {data, total, CARD_BINARY_HEADER_SIZE};
+    card->optionalProperties = takeBinaryList(&objects, propertyToString, deleteProperty, compareProperties);
+    card->birthday = NULL;
+    card->anniversary = NULL;
+    if (!(card->fn = readBinaryProperty(&reader, arena, &objects)))
+        return NULL;
+    for (size_t i = 1; i < properties; i++)
+    {
+        Property *prop = readBinaryProperty(&reader, arena, &objects);
+        if (!prop || !linkBinaryNode(&objects, card->optionalProperties, prop))
+            return NULL;
+    }
+    if ((flags & BINARY_HAS_BIRTHDAY) && !(card->birthday = readBinaryDate(&reader, &objects)))
+        return NULL;
+    if ((flags & BINARY_HAS_ANNIVERSARY) && !(card->anniversary = readBinaryDate(&reader, &objects)))
+        return NULL;
+    return reader.offset == total ? card : NULL;
+}
+
+/**
+ * Registers a decoded Card with its arena, or releases the arena if decoding failed.
+ * @param arena The arena of the Card.
+ * @param card The decoded Card, or NULL if decoding failed.
+ * @param obj Set to the Card on success.
+ * @return OK on success, INV_CARD if decoding failed, or OTHER_ERROR on allocation failure.
+ */
+static VCardErrorCode finishBinaryCard(Arena *arena, Card *card, Card **obj)
+{
+    if (!card || !sideTablePut(&cardArenas, card, arena))
+    {
+        destroyArena(arena);
+        return card ? OTHER_ERROR : INV_CARD;
+    }
+    *obj = card;
+    return OK;
+}
+
+/**
+ * Decodes a Card from binary card format. The encoding is copied into the arena of the
+ * new Card in one step, and the Card's strings point into that copy.
+ * @param buffer The encoding.
+ * @param length The number of bytes available in buffer. Bytes past the length recorded
+ *        in the header are ignored, so encodings can be read back to back from a stream.
+ * @param obj Set to the new arena-backed Card on success.
+ * @return OK on success, INV_FILE for NULL arguments, INV_CARD if the encoding is
+ *         malformed or from another format version, or OTHER_ERROR on allocation failure.
+ */
+VCardErrorCode createCardFromBinary(const char *buffer, size_t length, Card **obj)
+{
+    if (!buffer || !obj)
+        return INV_FILE;
+    uint8_t flags;
+    uint32_t counts[3], total;
+    if (!readBinaryHeader(buffer, length, &flags, counts, &total))
+        return INV_CARD;
+    Arena *arena = createBinaryArena(counts, total);
+    char *data = arena ? arenaAlloc(arena, total) : NULL;
+    if (!data)
+    {
+        destroyArena(arena);
+        return OTHER_ERROR;
+    }
+    memcpy(data, buffer, total);
+    return finishBinaryCard(arena, decodeBinaryCard(arena, data, flags, counts, total), obj);
+}
+
+/**
+ * Reads from a file until a buffer is full or the file ends, retrying short reads.
+ * @param fd The file descriptor.
+ * @param buffer The buffer to fill.
+ * @param length The number of bytes to read.
+ * @return The number of bytes read.
+ */
+static size_t readFileBytes(int fd, char *buffer, size_t length)
+{
+    size_t filled = 0;
+    while (filled < length)
+    {
+        ssize_t n = read(fd, buffer + filled, length - filled);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        filled += (size_t)n;
+    }
+    return filled;
+}
+
+/**
+ * Loads a Card from a file in binary card format. The header is read first to size the
+ * arena of the new Card; the encoding is then read straight into the arena and decoded
+ * there.
+ * @param fileName The name of the file.
+ * @param obj Set to the new arena-backed Card on success.
+ * @return OK on success, INV_FILE if the file cannot be read, INV_CARD if it does not
+ *         hold a valid encoding, or OTHER_ERROR on allocation failure.
+ */
+VCardErrorCode readCardBinary(const char *fileName, Card **obj)
+{
+    if (!fileName || !obj)
+        return INV_FILE;
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+        return INV_FILE;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+    {
+        close(fd);
+        return INV_FILE;
+    }
+
+    char header[CARD_BINARY_HEADER_SIZE];
+    uint8_t flags;
+    uint32_t counts[3], total;
+    if (readFileBytes(fd, header, sizeof(header)) != sizeof(header) ||
+        !readBinaryHeader(header, (size_t)info.st_size, &flags, counts, &total))
+    {
+        close(fd);
+        return INV_CARD;
+    }
+    Arena *arena = createBinaryArena(counts, total);
+    char *data = arena ? arenaAlloc(arena, total) : NULL;
+    if (!data)
+    {
+        close(fd);
+        destroyArena(arena);
+        return OTHER_ERROR;
+    }
+    memcpy(data, header, sizeof(header));
+    size_t filled = sizeof(header) + readFileBytes(fd, data + sizeof(header), total - sizeof(header));
+    close(fd);
+    if (filled != total)
+    {
+        destroyArena(arena);
+        return INV_FILE;
+    }
+    return finishBinaryCard(arena, decodeBinaryCard(arena, data, flags, counts, total), obj);
+}
+
+#define MIN_OTHER_BUCKETS 8
+
+/*
+ * Name -> properties index of a Card, built on the first lookup and kept in propertyIndexes.
+ * RFC 6350 names are bucketed by PropertyKind; any other name gets a bucket in a small
+ * open-addressed table keyed by a copy of the name. addProperty and removeProperty update
+ * the index in place. The stamp catches List operations that move the ends or the length
+ * of the list, but not a property replaced in the middle of it, so such edits must be
+ * followed by invalidatePropertyIndex.
+ */
+typedef struct propertyIndex
+{
+    const Property *fn;
+    const List *list;
+    const Node *head;
+    const Node *tail;
+    int length;
+    ArrayList *byKind[PROPERTY_KIND_COUNT];
+    char **otherNames;
+    ArrayList **others;
+    size_t otherCapacity;
+    size_t otherCount;
+} PropertyIndex;
+
+static SideTable propertyIndexes = SIDE_TABLE_INITIALIZER;
+
+/**
+ * Leaves an indexed Property alone when its bucket is cleared; the Card owns it.
+ * @param toBeDeleted The Property. Not freed.
+ */
+static void keepIndexedProperty(void *toBeDeleted)
+{
+    (void)toBeDeleted;
+}
+
+/**
+ * Hashes a property name or path with FNV-1a.
+ * @param name The string to hash.
+ * @return The hash of the string.
+ */
+static size_t hashName(const char *name)
+{
+    size_t h = (size_t)14695981039346656037ULL;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++)
+        h = (h ^ *c) * (size_t)1099511628211ULL;
+    return h;
+}
+
+/**
+ * Finds the slot of the other-name table that holds the bucket for a name, or the
+ * empty slot where it would go.
+ * @param index The property index. Its table must have a non-zero capacity.
+ * @param name The property name.
+ * @return The slot.
+ */
+static ArrayList **findOtherBucket(PropertyIndex *index, const char *name)
+{
+    size_t mask = index->otherCapacity - 1;
+    size_t slot = hashName(name) & mask;
+    while (index->otherNames[slot] && strcmp(index->otherNames[slot], name) != 0)
+        slot = (slot + 1) & mask;
+    return &index->others[slot];
+}
+
+/**
+ * Doubles the other-name table of an index and reinserts its buckets.
+ * @param index The property index.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool growOtherBuckets(PropertyIndex *index)
+{
+    size_t oldCapacity = index->otherCapacity;
+    char **oldNames = index->otherNames;
+    ArrayList **oldBuckets = index->others;
+    size_t newCapacity = oldCapacity ? oldCapacity * 2 : MIN_OTHER_BUCKETS;
+    char **names = calloc(newCapacity, sizeof(char *));
+    ArrayList **buckets = calloc(newCapacity, sizeof(ArrayList *));
+    if (!names || !buckets)
+    {
+        free(names);
+        free(buckets);
+        return false;
+    }
+    index->otherNames = names;
+    index->others = buckets;
+    index->otherCapacity = newCapacity;
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (oldNames[i])
+        {
+            ArrayList **bucket = findOtherBucket(index, oldNames[i]);
+            index->otherNames[bucket - index->others] = oldNames[i];
+            *bucket = oldBuckets[i];
+        }
+    }
+    free(oldNames);
+    free(oldBuckets);
+    return true;
+}
+
+/**
+ * Finds the bucket of an index that holds the properties with a given name.
+ * @param index The property index.
+ * @param name The property name.
+ * @param create true to create the bucket slot if it does not exist yet.
+ * @return The slot holding the bucket (which may be NULL if the bucket is empty), or NULL
+ *         if there is no such slot and create is false, or if memory allocation fails.
+ */
+static ArrayList **indexBucket(PropertyIndex *index, const char *name, bool create)
+{
+    PropertyKind kind = propertyKind(name);
+    if (kind != PROP_OTHER)
+        return &index->byKind[kind];
+    if (!index->otherCapacity)
+    {
+        if (!create || !growOtherBuckets(index))
+            return NULL;
+    }
+    else if (create && (index->otherCount + 1) * 2 > index->otherCapacity && !growOtherBuckets(index))
+    {
+        return NULL;
+    }
+    return findOtherBucket(index, name);
+}
+
+/**
+ * Adds a Property to the back of its bucket in an index.
+ * @param index The property index.
+ * @param prop The Property to add.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool indexProperty(PropertyIndex *index, Property *prop)
+{
+    ArrayList **bucket = indexBucket(index, prop->name, true);
+    if (!bucket)
+        return false;
+    if (!*bucket)
+    {
+        bool other = propertyKind(prop->name) == PROP_OTHER;
+        char *key = other ? duplicateString(prop->name) : NULL;
+        *bucket = initializeArrayList(&propertyToString, &keepIndexedProperty, &compareProperties);
+        if (!*bucket || (other && !key))
+        {
+            freeArrayList(*bucket);
+            *bucket = NULL;
+            free(key);
+            return false;
+        }
+        if (other)
+        {
+            index->otherNames[bucket - index->others] = key;
+            index->otherCount++;
+        }
+    }
+    return appendArrayElement(*bucket, prop);
+}
+
+/**
+ * Frees a property index. The indexed Properties are not touched.
+ * @param index The property index. May be NULL.
+ */
+static void freePropertyIndex(PropertyIndex *index)
+{
+    if (!index)
+        return;
+    for (int i = 0; i < PROPERTY_KIND_COUNT; i++)
+        freeArrayList(index->byKind[i]);
+    for (size_t i = 0; i < index->otherCapacity; i++)
+    {
+        free(index->otherNames[i]);
+        freeArrayList(index->others[i]);
+    }
+    free(index->otherNames);
+    free(index->others);
+    free(index);
+}
+
+/**
+ * Records the current state of a Card in the stamp of its index.
+ * @param index The property index.
+ * @param card The indexed Card.
+ */
+static void stampPropertyIndex(PropertyIndex *index, const Card *card)
+{
+    index->fn = card->fn;
+    index->list = card->optionalProperties;
+    index->head = card->optionalProperties ? card->optionalProperties->head : NULL;
+    index->tail = card->optionalProperties ? card->optionalProperties->tail : NULL;
+    index->length = card->optionalProperties ? card->optionalProperties->length : 0;
+}
+
+/**
+ * Checks whether an index still describes its Card.
+ * @param index The property index.
+ * @param card The indexed Card.
+ * @return true if the Card has not gained or lost properties since the index was stamped.
+ */
+static bool propertyIndexIsCurrent(const PropertyIndex *index, const Card *card)
+{
+    const List *list = card->optionalProperties;
+    return index->fn == card->fn && index->list == list &&
+           index->head == (list ? list->head : NULL) &&
+           index->tail == (list ? list->tail : NULL) &&
+           index->length == (list ? list->length : 0);
+}
+
+/**
+ * Builds the property index of a Card from scratch. FN comes first in its bucket.
+ * @param card The Card to index.
+ * @return The new index, or NULL if memory allocation fails.
+ */
+static PropertyIndex *buildPropertyIndex(const Card *card)
+{
+    PropertyIndex *index = calloc(1, sizeof(PropertyIndex));
+    if (!index)
+        return NULL;
+    bool ok = !card->fn || indexProperty(index, card->fn);
+    if (card->optionalProperties)
+    {
+        ListIterator iter = createIterator(card->optionalProperties);
+        Property *prop;
+        while (ok && (prop = nextElement(&iter)) != NULL)
+            ok = indexProperty(index, prop);
+    }
+    if (!ok)
+    {
+        freePropertyIndex(index);
+        return NULL;
+    }
+    stampPropertyIndex(index, card);
+    return index;
+}
+
+/**
+ * Returns the index of a Card, building or rebuilding it if it is missing or stale.
+ * @param card The Card.
+ * @return The current index, or NULL if memory allocation fails.
+ */
+static PropertyIndex *currentPropertyIndex(const Card *card)
+{
+    PropertyIndex *index = sideTableGet(&propertyIndexes, card);
+    if (index && propertyIndexIsCurrent(index, card))
+        return index;
+    freePropertyIndex(sideTableRemove(&propertyIndexes, card));
+    index = buildPropertyIndex(card);
+    if (index && !sideTablePut(&propertyIndexes, card, index))
+    {
+        freePropertyIndex(index);
+        return NULL;
+    }
+    return index;
+}
+
+/**
+ * Looks up every property of a Card with a given name, FN and optional properties alike.
+ * @param card The Card to search.
+ * @param name The property name, matched exactly.
+ * @return A read-only array of Property* in card order, or NULL if there are none.
+ */
+const ArrayList *getPropertiesByName(const Card *card, const char *name)
+{
+    if (!card || !name)
+        return NULL;
+    PropertyIndex *index = currentPropertyIndex(card);
+    if (!index)
+        return NULL;
+    ArrayList **bucket = indexBucket(index, name, false);
+    if (!bucket || !*bucket || (*bucket)->length == 0)
+        return NULL;
+    return *bucket;
+}
+
+/**
+ * Looks up the first property of a Card with a given name.
+ * @param card The Card to search.
+ * @param name The property name, matched exactly.
+ * @return The first matching Property, or NULL if there is none.
+ */
+Property *getPropertyByName(const Card *card, const char *name)
+{
+    return getArrayElement(getPropertiesByName(card, name), 0);
+}
+
+/**
+ * Appends a Property to the optional properties of a Card and to its index.
+ * @param card The Card to modify.
+ * @param prop The Property to add. The Card takes ownership of it.
+ * @return OK on success, INV_CARD for a NULL, arena-backed or view Card, INV_PROP for a
+ *         NULL Property, or OTHER_ERROR if memory allocation fails.
+ */
+VCardErrorCode addProperty(Card *card, Property *prop)
+{
+    if (!card || !card->optionalProperties || sideTableGet(&cardArenas, card))
+        return INV_CARD;
+    if (!prop || !prop->name)
+        return INV_PROP;
+    PropertyIndex *index = sideTableGet(&propertyIndexes, card);
+    bool current = index && propertyIndexIsCurrent(index, card);
+    if (!cardAppend(NULL, card->optionalProperties, prop))
+        return OTHER_ERROR;
+    if (current)
+    {
+        if (indexProperty(index, prop))
+            stampPropertyIndex(index, card);
+        else
+            freePropertyIndex(sideTableRemove(&propertyIndexes, card));
+    }
+    return OK;
+}
+
+/**
+ * Unlinks a Property from the optional properties of a Card and from its index.
+ * Unlike deleteDataFromList, the Property is matched by address, not by name.
+ * @param card The Card to modify.
+ * @param prop The Property to remove.
+ * @return prop, now owned by the caller, or NULL if it is not an optional property of
+ *         the Card or the Card is arena-backed or a view.
+ */
+Property *removeProperty(Card *card, Property *prop)
+{
+    if (!card || !card->optionalProperties || !prop || sideTableGet(&cardArenas, card))
+        return NULL;
+    List *list = card->optionalProperties;
+    Node *node = list->head;
+    while (node && node->data != prop)
+        node = node->next;
+    if (!node)
+        return NULL;
+
+    PropertyIndex *index = sideTableGet(&propertyIndexes, card);
+    bool current = index && propertyIndexIsCurrent(index, card);
+    if (node->previous)
+        node->previous->next = node->next;
+    else
+        list->head = node->next;
+    if (node->next)
+        node->next->previous = node->previous;
+    else
+        list->tail = node->previous;
+    list->length--;
+    free(node);
+
+    if (current)
+    {
+        ArrayList **slot = indexBucket(index, prop->name, false);
+        ArrayList *bucket = slot ? *slot : NULL;
+        for (int i = 0; bucket && i < bucket->length; i++)
+        {
+            if (bucket->elements[i] == prop)
+            {
+                memmove(&bucket->elements[i], &bucket->elements[i + 1],
+                        (size_t)(bucket->length - i - 1) * sizeof(void *));
+                bucket->length--;
+                break;
+            }
+        }
+        stampPropertyIndex(index, card);
+    }
+    return prop;
+}
+
+/**
+ * Drops the property index of a Card, so that the next lookup rebuilds it.
+ * @param card The Card. May be NULL.
+ */
+void invalidatePropertyIndex(const Card *card)
+{
+    if (card)
+        freePropertyIndex(sideTableRemove(&propertyIndexes, card));
+}
+
+/*
+ * Structured value of a Property, split into components and values on first request and
+ * kept in propertyComponents. The stamp is the values list and its first string, which
+ * change whenever the value is replaced (e.g. by updateFN).
+ */
+typedef struct propertyComponents
+{
+    const List *values;
+    const void *firstValue;
+    int numValues;
+    ArrayList *components;
+} PropertyComponents;
+
+static SideTable propertyComponents = SIDE_TABLE_INITIALIZER;
+
+#define SPLIT_COMPONENTS 1
+#define SPLIT_VALUES 2
+
+/**
+ * Decides how the value of a property is split, following the value grammar of RFC 6350.
+ * Unknown and extended properties are split on both separators.
+ * @param kind The PropertyKind of the property.
+ * @return A combination of SPLIT_COMPONENTS (';') and SPLIT_VALUES (',').
+ */
+static int componentSplitting(PropertyKind kind)
+{
+    switch (kind)
+    {
+    case PROP_N:
+    case PROP_ADR:
+    case PROP_OTHER:
+        return SPLIT_COMPONENTS | SPLIT_VALUES;
+    case PROP_ORG:
+    case PROP_GENDER:
+    case PROP_CLIENTPIDMAP:
+        return SPLIT_COMPONENTS;
+    case PROP_CATEGORIES:
+    case PROP_NICKNAME:
+        return SPLIT_VALUES;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Frees the cached structured value of a Property.
+ * @param cached The cached value. May be NULL.
+ */
+static void freePropertyComponents(PropertyComponents *cached)
+{
+    if (!cached)
+        return;
+    freeArrayList(cached->components);
+    free(cached);
+}
+
+/**
+ * Frees an array of component values; used as the deleteData of the outer array.
+ * @param toBeDeleted The ArrayList of strings.
+ */
+static void deleteComponent(void *toBeDeleted)
+{
+    freeArrayList((ArrayList *)toBeDeleted);
+}
+
+/**
+ * Prints a component as its values separated by ','.
+ * @param toBePrinted The ArrayList of strings.
+ * @return A newly allocated string.
+ */
+static char *componentToString(void *toBePrinted)
+{
+    const ArrayList *values = toBePrinted;
+    size_t size = 1;
+    for (int i = 0; i < values->length; i++)
+        size += strlen(values->elements[i]) + 1;
+    char *result = malloc(size);
+    if (!result)
+        return NULL;
+    result[0] = '\0';
+    for (int i = 0; i < values->length; i++)
+    {
+        if (i > 0)
+            strcat(result, ",");
+        strcat(result, values->elements[i]);
+    }
+    return result;
+}
+
+/**
+ * Compares two components by their printed form.
+ * @param first The first ArrayList of strings.
+ * @param second The second ArrayList of strings.
+ * @return The result of strcmp on the printed components.
+ */
+static int compareComponents(const void *first, const void *second)
+{
+    char *s1 = componentToString((void *)first);
+    char *s2 = componentToString((void *)second);
+    int result = (s1 && s2) ? strcmp(s1, s2) : 0;
+    free(s1);
+    free(s2);
+    return result;
+}
+
+/**
+ * Appends a new, empty component to a structured value.
+ * @param components The structured value.
+ * @return The new component, or NULL if memory allocation fails.
+ */
+static ArrayList *appendComponent(ArrayList *components)
+{
+    ArrayList *component = initializeArrayList(&valueToString, &deleteValue, &compareValues);
+    if (component && !appendArrayElement(components, component))
+    {
+        freeArrayList(component);
+        return NULL;
+    }
+    return component;
+}
+
+/**
+ * Splits one raw value into components and values, decoding backslash escapes
+ * (\n, \N, \\, \, and \;). The separators are located with the delimiter scanner.
+ * @param raw The raw property value.
+ * @param splitting A combination of SPLIT_COMPONENTS and SPLIT_VALUES.
+ * @param components The structured value to append the components of raw to.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool splitRawValue(const char *raw, int splitting, ArrayList *components)
+{
+    size_t length = strlen(raw);
+    char *buffer = malloc(length + 1);
+    ArrayList *component = appendComponent(components);
+    if (!buffer || !component)
+    {
+        free(buffer);
+        return false;
+    }
+
+    DelimiterScanner scanner;
+    initDelimiterScanner(&scanner, raw, length);
+    size_t pos, from = 0, used = 0;
+    bool ok = true;
+    while (ok && (pos = nextDelimiter(&scanner)) < length)
+    {
+        // A delimiter right after a backslash has already been decoded.
+        if (pos < from)
+            continue;
+        char c = raw[pos];
+        if (c == '\\')
+        {
+            memcpy(buffer + used, raw + from, pos - from);
+            used += pos - from;
+            char next = pos + 1 < length ? raw[pos + 1] : '\0';
+            if (next == 'n' || next == 'N')
+                buffer[used++] = '\n';
+            else if (next == '\\' || next == ',' || next == ';')
+                buffer[used++] = next;
+            else
+            {
+                buffer[used++] = '\\';
+                if (next)
+                    buffer[used++] = next;
+            }
+            from = next ? pos + 2 : pos + 1;
+        }
+        else if ((c == ';' && (splitting & SPLIT_COMPONENTS)) || (c == ',' && (splitting & SPLIT_VALUES)))
+        {
+            memcpy(buffer + used, raw + from, pos - from);
+            used += pos - from;
+            char *value = cardCopySpan(NULL, buffer, 0, used);
+            ok = value && appendArrayElement(component, value);
+            if (!ok)
+                free(value);
+            used = 0;
+            from = pos + 1;
+            if (ok && c == ';')
+                ok = (component = appendComponent(components)) != NULL;
+        }
+    }
+    if (ok)
+    {
+        memcpy(buffer + used, raw + from, length - from);
+        used += length - from;
+        char *value = cardCopySpan(NULL, buffer, 0, used);
+        ok = value && appendArrayElement(component, value);
+        if (!ok)
+            free(value);
+    }
+    free(buffer);
+    return ok;
+}
+
+/**
+ * Splits the value of a Property into components (separated by ';') and values within
+ * each component (separated by ','), decoding escapes. A property such as N whose values
+ * were already split by the parser contributes one component per value. The result is
+ * computed on first request and cached until the Property is deleted or its value replaced.
+ * @param prop The Property.
+ * @return A read-only array of components, each a read-only array of char*, or NULL if
+ *         prop has no value or memory allocation fails.
+ */
+const ArrayList *getPropertyComponents(const Property *prop)
+{
+    if (!prop || !prop->values || !prop->values->head)
+        return NULL;
+    PropertyComponents *cached = sideTableGet(&propertyComponents, prop);
+    if (cached && cached->values == prop->values && cached->firstValue == prop->values->head->data &&
+        cached->numValues == prop->values->length)
+        return cached->components;
+    freePropertyComponents(sideTableRemove(&propertyComponents, prop));
+
+    cached = malloc(sizeof(PropertyComponents));
+    if (!cached)
+        return NULL;
+    cached->values = prop->values;
+    cached->firstValue = prop->values->head->data;
+    cached->numValues = prop->values->length;
+    cached->components = initializeArrayList(&componentToString, &deleteComponent, &compareComponents);
+    bool ok = cached->components != NULL;
+    int splitting = componentSplitting(propertyKind(prop->name));
+    ListIterator iter = createIterator(prop->values);
+    const char *raw;
+    while (ok && (raw = nextElement(&iter)) != NULL)
+        ok = splitRawValue(raw, splitting, cached->components);
+    if (!ok || !sideTablePut(&propertyComponents, prop, cached))
+    {
+        freePropertyComponents(cached);
+        return NULL;
+    }
+    return cached->components;
+}
+
+/**
+ * Looks up one decoded value of a structured Property value.
+ * @param prop The Property.
+ * @param component The zero-based component (';'-separated field).
+ * @param index The zero-based value within the component (','-separated item).
+ * @return The decoded value, or NULL if it does not exist.
+ */
+const char *getPropertyComponent(const Property *prop, int component, int index)
+{
+    return getArrayElement(getArrayElement(getPropertyComponents(prop), component), index);
+}
+
+/**
+ * Drops the cached structured values of every property of an arena-backed Card, whose
+ * Properties are released with the arena instead of through deleteProperty.
+ * @param card The Card.
+ */
+static void dropCardComponents(const Card *card)
+{
+    if (sideTableSize(&propertyComponents) == 0)
+        return;
+    if (card->fn)
+        freePropertyComponents(sideTableRemove(&propertyComponents, card->fn));
+    if (!card->optionalProperties)
+        return;
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
+        freePropertyComponents(sideTableRemove(&propertyComponents, prop));
+}
+
+/**
+ * Validates a Card object against both the internal structure requirements and a subset of the vCard format rules.
+ * Checks that required properties (FN, VERSION) are present and validates the properties and DateTime fields.
+ * @param obj The Card object to validate.
+ * @return OK if the card is valid, or an appropriate error code (INV_CARD, INV_PROP, INV_DT).
+ */
+VCardErrorCode validateCard(const Card *obj)
+{
+    if (!obj)
+        return INV_CARD;
+
+    if (!obj->fn || !obj->optionalProperties)
+        return INV_CARD;
+    if (propertyKind(obj->fn->name) != PROP_FN)
+        return INV_PROP;
+    if (getLength(obj->fn->values) == 0)
+        return INV_PROP;
+
+    ListIterator iter = createIterator(obj->optionalProperties);
+    void *data;
+    int countN = 0, countKIND = 0;
+    while ((data = nextElement(&iter)) != NULL)
+    {
+        Property *prop = (Property *)data;
+        switch (propertyKind(prop->name))
+        {
+        case PROP_VERSION:
+            return INV_CARD;
+        case PROP_BDAY:
+        case PROP_ANNIVERSARY:
+            return INV_DT;
+        case PROP_N:
+            countN++;
+            if (getLength(prop->values) != 5)
+                return INV_PROP;
+            break;
+        case PROP_KIND:
+            countKIND++;
+            break;
+        default:
+            break;
+        }
+        if (getLength(prop->values) == 0)
+            return INV_PROP;
+        ListIterator paramIter = createIterator(prop->parameters);
+        void *pData;
+        while ((pData = nextElement(&paramIter)) != NULL)
+        {
+            Parameter *p = (Parameter *)pData;
+            if (strlen(p->name) == 0 || strlen(p->value) == 0)
+                return INV_PROP;
+        }
+    }
+    if (countN > 1)
+        return INV_PROP;
+    if (countKIND > 1)
+        return INV_PROP;
+
+    if (obj->birthday)
+    {
+        if (obj->birthday->isText)
+        {
+            if (strlen(obj->birthday->date) > 0 || strlen(obj->birthday->time) > 0 || obj->birthday->UTC)
+                return INV_DT;
+        }
+        else
+        {
+            int dateEmpty = (strlen(obj->birthday->date) == 0);
+            int timeEmpty = (strlen(obj->birthday->time) == 0);
+            if (dateEmpty && timeEmpty)
+                return INV_DT;
+            if (strlen(obj->birthday->text) > 0)
+                return INV_DT;
+        }
+    }
+    if (obj->anniversary)
+    {
+        if (obj->anniversary->isText)
+        {
+            if (strlen(obj->anniversary->date) > 0 || strlen(obj->anniversary->time) > 0 || obj->anniversary->UTC)
+                return INV_DT;
+        }
+        else
+        {
+            int dateEmpty = (strlen(obj->anniversary->date) == 0);
+            int timeEmpty = (strlen(obj->anniversary->time) == 0);
+            if (dateEmpty && timeEmpty)
+                return INV_DT;
+            if (strlen(obj->anniversary->text) > 0)
+                return INV_DT;
+        }
+    }
+
+    return OK;
+}
+
+/**
+ * Frees all memory associated with a Card object, including its subcomponents.
+ * @param obj The Card object to delete.
+ */
+void deleteCard(Card *obj)
+{
+    if (!obj)
+        return;
+    freePropertyIndex(sideTableRemove(&propertyIndexes, obj));
+    // An arena-backed Card lives entirely in its arena.
+    Arena *arena = sideTableRemove(&cardArenas, obj);
+    if (arena)
+    {
+        dropCardComponents(obj);
+        destroyArena(arena);
+        return;
+    }
+    if (obj->fn)
+        deleteProperty(obj->fn);
+    if (obj->optionalProperties)
+    {
+        clearList(obj->optionalProperties);
+        free(obj->optionalProperties);
+    }
+    if (obj->birthday)
+        deleteDate(obj->birthday);
+    if (obj->anniversary)
+        deleteDate(obj->anniversary);
+    free(obj);
+}
+
+/**
+ * Writes the human-readable form of a Property: [group.]name: first_value.
+ * @param writer The writer.
+ * @param prop The Property to write.
+ */
+static void writePropertySummary(CardWriter *writer, const Property *prop)
+{
+    if (prop->group[0] != '\0')
+    {
+        writeString(writer, prop->group);
+        writeRaw(writer, ".", 1);
+    }
+    writeString(writer, prop->name);
+    writeRaw(writer, ": ", 2);
+    const char *value = getFromFront(prop->values);
+    writeString(writer, value ? value : "(null)");
+}
+
+/**
+ * Writes the human-readable form of a Card, one line per field.
+ * @param writer The writer.
+ * @param obj The Card to write.
+ */
+static void writeCardSummary(CardWriter *writer, const Card *obj)
+{
+    writeString(writer, "FN: ");
+    const char *fn = obj->fn ? getFromFront(obj->fn->values) : NULL;
+    writeString(writer, fn ? fn : "(null)");
+    writeRaw(writer, "\n", 1);
+    if (obj->birthday)
+    {
+        writeString(writer, "BDAY: ");
+        writeDateValue(writer, obj->birthday);
+        writeRaw(writer, "\n", 1);
+    }
+    if (obj->anniversary)
+    {
+        writeString(writer, "ANNIVERSARY: ");
+        writeDateValue(writer, obj->anniversary);
+        writeRaw(writer, "\n", 1);
+    }
+    ListIterator iter = createIterator(obj->optionalProperties);
+    const Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
+    {
+        writePropertySummary(writer, prop);
+        writeRaw(writer, "\n", 1);
+    }
+}
+
+/**
+ * Converts a Card object into a human-readable string representation.
+ * The returned string is allocated once, at its exact size.
+ * @param obj The Card object to convert.
+ * @return A pointer to the allocated string, or "null" if obj is NULL.
+ */
+char *cardToString(const Card *obj)
+{
+    if (!obj)
+        return duplicateString("null");
+    CardWriter counter = {NULL, 0, 0, false, 0};
+    writeCardSummary(&counter, obj);
+    char *result = malloc(counter.length + 1);
+    if (!result)
+        return NULL;
+    CardWriter writer = {result, counter.length, 0, false, 0};
+    writeCardSummary(&writer, obj);
+    result[writer.length] = '\0';
+    return result;
+}
+
+/**
+ * Terminates a summary field filled by a writer. When the text did not fit, the cut is
+ * moved back to the start of any UTF-8 sequence it split.
+ * @param field The field, CARD_SUMMARY_FIELD bytes long.
+ * @param writer The writer that filled the field.
+ * @return true if the text was truncated.
+ */
+static bool finishSummaryField(char *field, const CardWriter *writer)
+{
+    if (writer->length <= writer->capacity)
+    {
+        field[writer->length] = '\0';
+        return false;
+    }
+    // Find the lead byte of the last character kept, and drop that character if
+    // fewer bytes were kept than its lead byte announces.
+    size_t end = writer->capacity;
+    size_t lead = end;
+    while (lead > 0 && end - lead < 3 && ((unsigned char)field[lead - 1] & 0xC0) == 0x80)
+        lead--;
+    if (lead > 0)
+    {
+        unsigned char c = (unsigned char)field[lead - 1];
+        size_t expected = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        if (end - (lead - 1) < expected)
+            end = lead - 1;
+    }
+    field[end] = '\0';
+    return true;
+}
+
+/**
+ * Fills one summary record from a parsed Card.
+ * @param card The Card to summarize.
+ * @param summary The record to fill. Its error field is already set.
+ */
+static void summarizeCard(const Card *card, CardSummary *summary)
+{
+    CardWriter writer = {summary->fn, CARD_SUMMARY_FIELD - 1, 0, false, 0};
+    const char *fn = card->fn ? getFromFront(card->fn->values) : NULL;
+    if (fn)
+        writeString(&writer, fn);
+    summary->truncated = finishSummaryField(summary->fn, &writer);
+
+    writer = (CardWriter){summary->birthday, CARD_SUMMARY_FIELD - 1, 0, false, 0};
+    if (card->birthday)
+        writeDateValue(&writer, card->birthday);
+    summary->truncated |= finishSummaryField(summary->birthday, &writer);
+
+    writer = (CardWriter){summary->anniversary, CARD_SUMMARY_FIELD - 1, 0, false, 0};
+    if (card->anniversary)
+        writeDateValue(&writer, card->anniversary);
+    summary->truncated |= finishSummaryField(summary->anniversary, &writer);
+
+    summary->propertyCount = getLength(card->optionalProperties);
+    cardFingerprint(card, &summary->fingerprint);
+}
+
+/**
+ * Parses one vCard file into an arena-backed Card, summarizes it and releases it.
+ * @param fileName The name of the vCard file. May be NULL.
+ * @param summary The record to fill.
+ * @return true if the file parsed successfully.
+ */
+static bool summarizeFile(const char *fileName, CardSummary *summary)
+{
+    memset(summary, 0, sizeof(CardSummary));
+    Card *card = NULL;
+    summary->error = fileName ? loadCard((char *)fileName, true, &card) : INV_FILE;
+    if (summary->error != OK)
+        return false;
+    summarizeCard(card, summary);
+    deleteCard(card);
+    return true;
+}
+
+typedef struct summaryBatch
+{
+    const char *const *fileNames;
+    CardSummary *summaries;
+    atomic_int parsed;
+} SummaryBatch;
+
+/**
+ * Parses one file of a summary batch and fills its record. Runs on a pool worker.
+ * @param index The position of the file in the batch.
+ * @param context The SummaryBatch.
+ * @return true, so that the batch always runs to the end.
+ */
+static bool summarizeBatchItem(size_t index, void *context)
+{
+    SummaryBatch *batch = context;
+    if (summarizeFile(batch->fileNames[index], &batch->summaries[index]))
+        atomic_fetch_add(&batch->parsed, 1);
+    return true;
+}
+
+/**
+ * Parses a batch of vCard files and fills one fixed-layout summary record per file.
+ * Files are parsed in parallel on a work-stealing pool with one worker per CPU. Each card
+ * is built in an arena, so it is released in one step once summarized.
+ * @param fileNames The names of the vCard files.
+ * @param count The number of files.
+ * @param summaries The records to fill, one per file.
+ * @return The number of files that parsed successfully, or -1 for invalid arguments.
+ */
+int summarizeCards(const char *const *fileNames, int count, CardSummary *summaries)
+{
+    if (count < 0 || (count > 0 && (!fileNames || !summaries)))
+        return -1;
+    SummaryBatch batch = {fileNames, summaries, 0};
+    runWorkStealing((size_t)count, 0, summarizeBatchItem, &batch);
+    return atomic_load(&batch.parsed);
+}
+
+typedef struct directoryScan
+{
+    ArrayList *paths;
+    bool useArena;
+    CardScanCallback callback;
+    void *userData;
+} DirectoryScan;
+
+/**
+ * Parses one file of a directory scan and hands the result to the callback. Runs on a
+ * pool worker.
+ * @param index The position of the file in the scan.
+ * @param context The DirectoryScan.
+ * @return The callback's result: true to keep scanning, false to stop.
+ */
+static bool scanDirectoryItem(size_t index, void *context)
+{
+    DirectoryScan *scan = context;
+    char *path = getArrayElement(scan->paths, (int)index);
+    Card *card = NULL;
+    VCardErrorCode err = loadCard(path, scan->useArena, &card);
+    return scan->callback(err == OK ? card : NULL, err, path, scan->userData);
+}
+
+/**
+ * Lists the vCard files of a directory. Subdirectories are skipped; entries whose type
+ * the file system does not report are kept and left to loadCard to reject.
+ * @param dirName The directory to list.
+ * @param paths The list to which the path of each file is appended.
+ * @return OK on success, INV_FILE if the directory cannot be read, or OTHER_ERROR if
+ *         memory allocation fails.
+ */
+static VCardErrorCode listCardFiles(const char *dirName, ArrayList *paths)
+{
+    DIR *dir = opendir(dirName);
+    if (!dir)
+        return INV_FILE;
+    size_t dirLength = strlen(dirName);
+    bool separator = dirLength > 0 && dirName[dirLength - 1] != '/';
+    VCardErrorCode err = OK;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_type == DT_DIR || !hasCardExtension(entry->d_name))
+            continue;
+        size_t nameLength = strlen(entry->d_name);
+        char *path = malloc(dirLength + separator + nameLength + 1);
+        if (!path)
+        {
+            err = OTHER_ERROR;
+            break;
+        }
+        memcpy(path, dirName, dirLength);
+        if (separator)
+            path[dirLength] = '/';
+        memcpy(path + dirLength + separator, entry->d_name, nameLength + 1);
+        if (!appendArrayElement(paths, path))
+        {
+            free(path);
+            err = OTHER_ERROR;
+            break;
+        }
+    }
+    closedir(dir);
+    return err;
+}
+
+/**
+ * Parses every vCard file of a directory on a pool of work-stealing threads. The directory
+ * is listed first, then each file is parsed exactly once and reported to the callback.
+ * @param dirName The directory to scan.
+ * @param options The scan options, or NULL for the defaults.
+ * @param callback Function receiving each parsed Card or its error code.
+ * @param userData Caller data passed through to the callback.
+ * @return OK on success, INV_FILE for a NULL callback or an unreadable directory, or
+ *         OTHER_ERROR if memory allocation fails.
+ */
+VCardErrorCode scanCardDirectory(const char *dirName, const ScanOptions *options, CardScanCallback callback, void *userData)
+{
+    if (!dirName || !callback)
+        return INV_FILE;
+    ArrayList *paths = initializeArrayList(valueToString, deleteValue, compareValues);
+    if (!paths)
+        return OTHER_ERROR;
+    VCardErrorCode err = listCardFiles(dirName, paths);
+    if (err == OK)
+    {
+        DirectoryScan scan = {paths, options && options->useArena, callback, userData};
+        size_t workers = options && options->threads > 0 ? (size_t)options->threads : 0;
+        runWorkStealing((size_t)getArrayLength(paths), workers, scanDirectoryItem, &scan);
+    }
+    freeArrayList(paths);
+    return err;
+}
+
+#define CARD_CACHE_NAME "/.vcparser-cache"
+#define CARD_CACHE_MAGIC "VCPC"
+#define CARD_CACHE_VERSION 3u
+#define NO_CACHE_ENTRY SIZE_MAX
+
+/*	Identity of one version of a file. An entry is only reused while the file still has
+	the same inode, size and modification time, so an edit or a replacement by rename
+	invalidates it.
+*/
+typedef struct cacheKey
+{
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtime;
+} CacheKey;
+
+/*	Cached result of parsing one file: its summary and, once the Card itself has been
+	requested, its binary encoding. The strings and the encoding point either into the
+	mapped cache file or into blocks the entry owns (copies and encoding), which are
+	freed when the entry is replaced or dropped.
+*/
+typedef struct cacheEntry
+{
+    const char *path;
+    CacheKey key;
+    VCardErrorCode error;
+    int propertyCount;
+    bool truncated;
+    CardFingerprint fingerprint;
+    const char *fn;
+    const char *birthday;
+    const char *anniversary;
+    const char *card;
+    size_t cardLength;
+    bool used;
+    char *copies;
+    char *encoding;
+} CacheEntry;
+
+/*	In-memory form of a cache file: an array of entries and an open-addressed table of
+	entry indices keyed by path. The loaded cache file stays mapped, so entries read
+	from it are never copied; entries stored since then own their copies.
+*/
+struct cardCache
+{
+    char *fileName;
+    char *mapping;
+    size_t mappingLength;
+    CacheEntry *entries;
+    size_t count;
+    size_t capacity;
+    size_t *slots;
+    size_t slotCapacity;
+    bool dirty;
+};
+
+/**
+ * Reads the identity of the current version of a file.
+ * @param path The file to look at.
+ * @param key Set to the identity of the file.
+ * @return true if the file is a regular file that could be examined.
+ */
+static bool readCacheKey(const char *path, CacheKey *key)
+{
+    struct stat info;
+    if (stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+        return false;
+    key->inode = (uint64_t)info.st_ino;
+    key->size = (uint64_t)info.st_size;
+    key->mtime = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+    return true;
+}
+
+/**
+ * Finds the entry of a path.
+ * @param cache The cache.
+ * @param path The path to look for.
+ * @return The index of the entry, or NO_CACHE_ENTRY if the path has none.
+ */
+static size_t findCacheEntry(const CardCache *cache, const char *path)
+{
+    if (cache->slotCapacity == 0)
+        return NO_CACHE_ENTRY;
+    size_t mask = cache->slotCapacity - 1;
+    for (size_t slot = hashName(path) & mask; cache->slots[slot] != NO_CACHE_ENTRY; slot = (slot + 1) & mask)
+    {
+        if (strcmp(cache->entries[cache->slots[slot]].path, path) == 0)
+            return cache->slots[slot];
+    }
+    return NO_CACHE_ENTRY;
+}
+
+/**
+ * Finds the entry of a file if it describes the current version of the file.
+ * @param cache The cache.
+ * @param path The path of the file.
+ * @param key The identity of the current version of the file.
+ * @return The index of the entry, or NO_CACHE_ENTRY if there is none or it is stale.
+ */
+static size_t findFreshCacheEntry(const CardCache *cache, const char *path, const CacheKey *key)
+{
+    size_t index = findCacheEntry(cache, path);
+    if (index != NO_CACHE_ENTRY && memcmp(&cache->entries[index].key, key, sizeof(CacheKey)) != 0)
+        return NO_CACHE_ENTRY;
+    return index;
+}
+
+/**
+ * Rebuilds the path table of a cache with room for at least twice its entries.
+ * @param cache The cache.
+ * @param minimum The number of entries the table must be able to hold.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool rebuildCacheSlots(CardCache *cache, size_t minimum)
+{
+    size_t capacity = 64;
+    while (capacity < minimum * 2)
+        capacity *= 2;
+    size_t *slots = malloc(capacity * sizeof(size_t));
+    if (!slots)
+        return false;
+    for (size_t i = 0; i < capacity; i++)
+        slots[i] = NO_CACHE_ENTRY;
+    for (size_t i = 0; i < cache->count; i++)
+    {
+        size_t slot = hashName(cache->entries[i].path) & (capacity - 1);
+        while (slots[slot] != NO_CACHE_ENTRY)
+            slot = (slot + 1) & (capacity - 1);
+        slots[slot] = i;
+    }
+    free(cache->slots);
+    cache->slots = slots;
+    cache->slotCapacity = capacity;
+    return true;
+}
+
+/**
+ * Appends an entry for a path that has none and adds it to the path table.
+ * @param cache The cache.
+ * @param path The path, in memory that lives as long as the cache.
+ * @return The index of the new entry, or NO_CACHE_ENTRY if memory allocation fails.
+ */
+static size_t addCacheEntry(CardCache *cache, const char *path)
+{
+    if (cache->count == cache->capacity)
+    {
+        size_t capacity = cache->capacity ? cache->capacity * 2 : 64;
+        CacheEntry *entries = realloc(cache->entries, capacity * sizeof(CacheEntry));
+        if (!entries)
+            return NO_CACHE_ENTRY;
+        cache->entries = entries;
+        cache->capacity = capacity;
+    }
+    if ((cache->count + 1) * 2 > cache->slotCapacity && !rebuildCacheSlots(cache, cache->count + 1))
+        return NO_CACHE_ENTRY;
+
+    size_t index = cache->count++;
+    memset(&cache->entries[index], 0, sizeof(CacheEntry));
+    cache->entries[index].path = path;
+    size_t mask = cache->slotCapacity - 1;
+    size_t slot = hashName(path) & mask;
+    while (cache->slots[slot] != NO_CACHE_ENTRY)
+        slot = (slot + 1) & mask;
+    cache->slots[slot] = index;
+    return index;
+}
+
+/**
+ * Frees the blocks a cache entry owns. Entries read from the cache file own none.
+ * @param entry The entry.
+ */
+static void releaseCacheEntry(CacheEntry *entry)
+{
+    free(entry->copies);
+    free(entry->encoding);
+    entry->copies = NULL;
+    entry->encoding = NULL;
+}
+
+/**
+ * Records the summary of one version of a file, replacing any earlier entry for its path.
+ * The entry has no cached Card until one is attached.
+ * @param cache The cache.
+ * @param path The path of the file.
+ * @param key The identity of the version that was summarized.
+ * @param summary The summary to record.
+ * @return The index of the entry, or NO_CACHE_ENTRY if memory allocation fails.
+ */
+static size_t storeCacheEntry(CardCache *cache, const char *path, const CacheKey *key, const CardSummary *summary)
+{
+    // The path and the summary strings are copied into one block owned by the entry.
+    size_t pathLength = strlen(path) + 1;
+    size_t fnLength = strlen(summary->fn) + 1;
+    size_t birthdayLength = strlen(summary->birthday) + 1;
+    size_t anniversaryLength = strlen(summary->anniversary) + 1;
+    char *copies = malloc(pathLength + fnLength + birthdayLength + anniversaryLength);
+    if (!copies)
+        return NO_CACHE_ENTRY;
+    char *copy = memcpy(copies, path, pathLength);
+    char *fn = memcpy(copy + pathLength, summary->fn, fnLength);
+    char *birthday = memcpy(fn + fnLength, summary->birthday, birthdayLength);
+    char *anniversary = memcpy(birthday + birthdayLength, summary->anniversary, anniversaryLength);
+
+    size_t index = findCacheEntry(cache, path);
+    if (index == NO_CACHE_ENTRY && (index = addCacheEntry(cache, copy)) == NO_CACHE_ENTRY)
+    {
+        free(copies);
+        return NO_CACHE_ENTRY;
+    }
+    CacheEntry *entry = &cache->entries[index];
+    releaseCacheEntry(entry);
+    entry->copies = copies;
+    entry->path = copy;
+    entry->key = *key;
+    entry->error = summary->error;
+    entry->propertyCount = summary->propertyCount;
+    entry->truncated = summary->truncated;
+    entry->fingerprint = summary->fingerprint;
+    entry->fn = fn;
+    entry->birthday = birthday;
+    entry->anniversary = anniversary;
+    entry->card = NULL;
+    entry->cardLength = 0;
+    entry->used = true;
+    cache->dirty = true;
+    return index;
+}
+
+/**
+ * Fills a summary record from a cache entry.
+ * @param entry The entry.
+ * @param summary The record to fill.
+ */
+static void summaryFromCacheEntry(const CacheEntry *entry, CardSummary *summary)
+{
+    memset(summary, 0, sizeof(CardSummary));
+    summary->error = entry->error;
+    summary->propertyCount = entry->propertyCount;
+    summary->truncated = entry->truncated;
+    summary->fingerprint = entry->fingerprint;
+    // Entries only come from summaries or from a validated cache file, so every field fits.
+    strcpy(summary->fn, entry->fn);
+    strcpy(summary->birthday, entry->birthday);
+    strcpy(summary->anniversary, entry->anniversary);
+}
+
+/**
+ * Reads a summary string of a cache file in place.
+ * @param reader The cursor over the cache file.
+ * @return The string, or NULL if it is malformed or too long for a summary field.
+ */
+static const char *readCacheField(BinaryReader *reader)
+{
+    const char *text = readBinaryString(reader);
+    return text && strlen(text) < CARD_SUMMARY_FIELD ? text : NULL;
+}
+
+/**
+ * Reads one entry of a cache file and adds it to the cache. Its strings and Card
+ * encoding are used in place.
+ * @param reader The cursor over the cache file.
+ * @param cache The cache.
+ * @return true on success, false if the entry is malformed or memory allocation fails.
+ */
+static bool readCacheEntry(BinaryReader *reader, CardCache *cache)
+{
+    CacheKey key;
+    uint8_t error, truncated;
+    uint32_t propertyCount, cardLength;
+    CardFingerprint fingerprint;
+    const char *path;
+    if (!readBinaryU64(reader, &key.inode) || !readBinaryU64(reader, &key.size) ||
+        !readBinaryU64(reader, (uint64_t *)&key.mtime) || !readBinaryU8(reader, &error) || error > OTHER_ERROR ||
+        !readBinaryVarint(reader, &propertyCount) || propertyCount > INT32_MAX || !readBinaryU8(reader, &truncated) ||
+        !readBinaryU64(reader, &fingerprint.low) || !readBinaryU64(reader, &fingerprint.high) ||
+        !(path = readBinaryString(reader)) || findCacheEntry(cache, path) != NO_CACHE_ENTRY)
+        return false;
+    size_t index = addCacheEntry(cache, path);
+    if (index == NO_CACHE_ENTRY)
+        return false;
+    CacheEntry *entry = &cache->entries[index];
+    entry->key = key;
+    entry->error = (VCardErrorCode)error;
+    entry->propertyCount = (int)propertyCount;
+    entry->truncated = truncated != 0;
+    entry->fingerprint = fingerprint;
+    if (!(entry->fn = readCacheField(reader)) || !(entry->birthday = readCacheField(reader)) ||
+        !(entry->anniversary = readCacheField(reader)) || !readBinaryVarint(reader, &cardLength) ||
+        reader->length - reader->offset < cardLength)
+        return false;
+    entry->card = cardLength ? reader->data + reader->offset : NULL;
+    entry->cardLength = cardLength;
+    reader->offset += cardLength;
+    return true;
+}
+
+/**
+ * Maps a cache file and loads its entries. A missing, outdated or damaged file leaves
+ * the cache empty, so the cache is rebuilt from the cards.
+ * @param cache The cache, still empty.
+ */
+static void loadCacheFile(CardCache *cache)
+{
+    int fd = open(cache->fileName, O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0)
+    {
+        close(fd);
+        return;
+    }
+    size_t size = (size_t)info.st_size;
+    char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return;
+
+    BinaryReader reader = {data, size, 4};
+    uint32_t version, count;
+    bool valid = size >= 4 && memcmp(data, CARD_CACHE_MAGIC, 4) == 0 && readBinaryU32(&reader, &version) &&
+                 version == CARD_CACHE_VERSION && readBinaryU32(&reader, &count);
+    for (uint32_t i = 0; valid && i < count; i++)
+        valid = readCacheEntry(&reader, cache);
+    if (!valid)
+    {
+        munmap(data, size);
+        cache->count = 0;
+        for (size_t i = 0; i < cache->slotCapacity; i++)
+            cache->slots[i] = NO_CACHE_ENTRY;
+        return;
+    }
+    cache->mapping = data;
+    cache->mappingLength = size;
+}
+
+/**
+ * Writes the used entries of a cache in cache file format.
+ * @param writer The writer.
+ * @param cache The cache.
+ * @param used The number of used entries.
+ */
+static void writeCacheFile(CardWriter *writer, const CardCache *cache, uint32_t used)
+{
+    writeRaw(writer, CARD_CACHE_MAGIC, 4);
+    writeBinaryU32(writer, CARD_CACHE_VERSION);
+    writeBinaryU32(writer, used);
+    for (size_t i = 0; i < cache->count; i++)
+    {
+        const CacheEntry *entry = &cache->entries[i];
+        if (!entry->used)
+            continue;
+        char flags[1] = {(char)entry->error};
+        writeBinaryU64(writer, entry->key.inode);
+        writeBinaryU64(writer, entry->key.size);
+        writeBinaryU64(writer, (uint64_t)entry->key.mtime);
+        writeRaw(writer, flags, 1);
+        writeBinaryVarint(writer, (uint32_t)entry->propertyCount);
+        flags[0] = (char)entry->truncated;
+        writeRaw(writer, flags, 1);
+        writeBinaryU64(writer, entry->fingerprint.low);
+        writeBinaryU64(writer, entry->fingerprint.high);
+        writeBinaryString(writer, entry->path);
+        writeBinaryString(writer, entry->fn);
+        writeBinaryString(writer, entry->birthday);
+        writeBinaryString(writer, entry->anniversary);
+        writeBinaryVarint(writer, (uint32_t)entry->cardLength);
+        if (entry->card)
+            writeRaw(writer, entry->card, entry->cardLength);
+    }
+}
+
+/**
+ * Opens the parse cache of a card directory, loading the cache file if there is one.
+ * @param dirName The card directory.
+ * @return The cache, or NULL if dirName is NULL or memory allocation fails.
+ */
+CardCache *openCardCache(const char *dirName)
+{
+    if (!dirName)
+        return NULL;
+    CardCache *cache = calloc(1, sizeof(CardCache));
+    if (!cache)
+        return NULL;
+    size_t dirLength = strlen(dirName);
+    cache->fileName = malloc(dirLength + sizeof(CARD_CACHE_NAME));
+    if (!cache->fileName || !rebuildCacheSlots(cache, 0))
+    {
+        closeCardCache(cache);
+        return NULL;
+    }
+    memcpy(cache->fileName, dirName, dirLength);
+    memcpy(cache->fileName + dirLength, CARD_CACHE_NAME, sizeof(CARD_CACHE_NAME));
+    loadCacheFile(cache);
+    return cache;
+}
+
+/*	Per-file state of a cached summary batch. entry is the cache entry that was reused,
+	or NO_CACHE_ENTRY if the file was parsed; keyed is false if the file could not be
+	examined, in which case its result is not cached.
+*/
+typedef struct cachedItem
+{
+    CacheKey key;
+    size_t entry;
+    bool keyed;
+} CachedItem;
+
+typedef struct cachedSummaryBatch
+{
+    const CardCache *cache;
+    const char *const *fileNames;
+    CardSummary *summaries;
+    CachedItem *items;
+} CachedSummaryBatch;
+
+/**
+ * Fills the record of one file of a cached batch, from its cache entry if the file is
+ * unchanged and by parsing it otherwise. Runs on a pool worker; the cache is only read.
+ * @param index The position of the file in the batch.
+ * @param context The CachedSummaryBatch.
+ * @return true, so that the batch always runs to the end.
+ */
+static bool summarizeCachedItem(size_t index, void *context)
+{
+    CachedSummaryBatch *batch = context;
+    const char *fileName = batch->fileNames[index];
+    CachedItem *item = &batch->items[index];
+    item->keyed = fileName && readCacheKey(fileName, &item->key);
+    item->entry = item->keyed ? findFreshCacheEntry(batch->cache, fileName, &item->key) : NO_CACHE_ENTRY;
+    if (item->entry != NO_CACHE_ENTRY)
+        summaryFromCacheEntry(&batch->cache->entries[item->entry], &batch->summaries[index]);
+    else
+        summarizeFile(fileName, &batch->summaries[index]);
+    return true;
+}
+
+/**
+ * Summarizes a batch of vCard files like summarizeCards, reusing the cached summary of
+ * every file whose inode, size and modification time are unchanged. Only the files that
+ * changed are parsed, in parallel, and their summaries are added to the cache.
+ * @param cache The cache.
+ * @param fileNames The names of the vCard files.
+ * @param count The number of files.
+ * @param summaries The records to fill, one per file.
+ * @return The number of files that are valid cards, or -1 for invalid arguments or if
+ *         memory allocation fails.
+ */
+int summarizeCardsCached(CardCache *cache, const char *const *fileNames, int count, CardSummary *summaries)
+{
+    if (!cache || count < 0 || (count > 0 && (!fileNames || !summaries)))
+        return -1;
+    CachedItem *items = malloc((count > 0 ? (size_t)count : 1) * sizeof(CachedItem));
+    if (!items)
+        return -1;
+    CachedSummaryBatch batch = {cache, fileNames, summaries, items};
+    runWorkStealing((size_t)count, 0, summarizeCachedItem, &batch);
+
+    // The workers only read the cache; it is updated here, on the calling thread.
+    int parsed = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (summaries[i].error == OK)
+            parsed++;
+        if (items[i].entry != NO_CACHE_ENTRY)
+            cache->entries[items[i].entry].used = true;
+        else if (items[i].keyed)
+            storeCacheEntry(cache, fileNames[i], &items[i].key, &summaries[i]);
+    }
+    free(items);
+    return parsed;
+}
+
+/**
+ * Creates a Card through a cache. An unchanged file whose Card is cached is decoded
+ * from its binary encoding without being read, and an unchanged file that is known
+ * not to parse fails straight away. Any other file is parsed, and its summary and
+ * encoding are cached.
+ * @param cache The cache.
+ * @param fileName The name of the vCard file.
+ * @param obj Set to the new arena-backed Card on success.
+ * @return The error code createCard would return for the file.
+ */
+VCardErrorCode createCardCached(CardCache *cache, const char *fileName, Card **obj)
+{
+    if (!cache || !fileName || !obj)
+        return INV_FILE;
+    CacheKey key;
+    bool keyed = readCacheKey(fileName, &key);
+    size_t index = keyed ? findFreshCacheEntry(cache, fileName, &key) : NO_CACHE_ENTRY;
+    if (index != NO_CACHE_ENTRY)
+    {
+        CacheEntry *entry = &cache->entries[index];
+        entry->used = true;
+        if (entry->error != OK)
+            return entry->error;
+        if (entry->card && createCardFromBinary(entry->card, entry->cardLength, obj) == OK)
+            return OK;
+    }
+
+    VCardErrorCode err = loadCard((char *)fileName, true, obj);
+    if (!keyed)
+        return err;
+    CardSummary summary;
+    memset(&summary, 0, sizeof(summary));
+    summary.error = err;
+    if (err == OK)
+        summarizeCard(*obj, &summary);
+    index = storeCacheEntry(cache, fileName, &key, &summary);
+    if (err == OK && index != NO_CACHE_ENTRY)
+    {
+        size_t length = serializeCardBinary(*obj, NULL, 0);
+        char *encoding = length ? malloc(length) : NULL;
+        if (encoding)
+        {
+            serializeCardBinary(*obj, encoding, length);
+            cache->entries[index].encoding = encoding;
+            cache->entries[index].card = encoding;
+            cache->entries[index].cardLength = length;
+        }
+    }
+    return err;
+}
+
+/**
+ * Writes a cache to its file. The file is written under a temporary name and renamed
+ * into place, so readers never see a partly written cache. Entries not used since the
+ * cache was opened or last saved are dropped, so deleted files do not accumulate.
+ * @param cache The cache.
+ * @return OK on success, INV_FILE for a NULL cache, WRITE_ERROR if the file cannot be
+ *         written, or OTHER_ERROR if memory allocation fails.
+ */
+VCardErrorCode saveCardCache(CardCache *cache)
+{
+    if (!cache)
+        return INV_FILE;
+    uint32_t used = 0;
+    for (size_t i = 0; i < cache->count; i++)
+        used += cache->entries[i].used;
+    if (!cache->dirty && used == cache->count)
+    {
+        for (size_t i = 0; i < cache->count; i++)
+            cache->entries[i].used = false;
+        return OK;
+    }
+
+    CardWriter counter = {NULL, 0, 0, false, 0};
+    writeCacheFile(&counter, cache, used);
+    char *data = malloc(counter.length);
+    if (!data)
+        return OTHER_ERROR;
+    CardWriter writer = {data, counter.length, 0, false, 0};
+    writeCacheFile(&writer, cache, used);
+
+    // The old file stays mapped after the rename, so entries loaded from it remain valid.
+    bool written = replaceFile(cache->fileName, data, writer.length, NULL, 0);
+    free(data);
+    if (!written)
+        return WRITE_ERROR;
+
+    // Drop the unused entries from memory as well, and start a new round of use tracking.
+    size_t kept = 0;
+    for (size_t i = 0; i < cache->count; i++)
+    {
+        if (cache->entries[i].used)
+        {
+            cache->entries[kept] = cache->entries[i];
+            cache->entries[kept++].used = false;
+        }
+        else
+            releaseCacheEntry(&cache->entries[i]);
+    }
+    cache->count = kept;
+    cache->dirty = false;
+    return rebuildCacheSlots(cache, kept) ? OK : OTHER_ERROR;
+}
+
+/**
+ * Releases a cache without saving it.
+ * @param cache The cache. May be NULL.
+ */
+void closeCardCache(CardCache *cache)
+{
+    if (!cache)
+        return;
+    if (cache->mapping)
+        munmap(cache->mapping, cache->mappingLength);
+    for (size_t i = 0; i < cache->count; i++)
+        releaseCacheEntry(&cache->entries[i]);
+    free(cache->fileName);
+    free(cache->entries);
+    free(cache->slots);
+    free(cache);
+}
+
+#ifdef __linux__
+
+// A new file is seen when it is closed after writing or moved in, never while it is written.
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+#define NO_WATCHED_FILE SIZE_MAX
+
+/*	Last state of one card file name seen by a watcher. present and key describe the
+	version that was last reported; pending is set while an event for the name has not
+	been reported yet.
+*/
+typedef struct watchedFile
+{
+    char *path;
+    const char *name;
+    CacheKey key;
+    bool present;
+    bool pending;
+} WatchedFile;
+
+/*	Watcher of one card directory: an inotify descriptor and the watch on the directory,
+	the files known to exist with an open-addressed table of their indices keyed by file
+	name, and the names whose events still have to be reported. rewatch is set when the
+	directory was deleted or moved away and the watch has to be added again by path.
+*/
+struct cardWatcher
+{
+    int fd;
+    int wd;
+    char *dirName;
+    ScanOptions options;
+    WatchedFile *files;
+    size_t count;
+    size_t capacity;
+    size_t *slots;
+    size_t slotCapacity;
+    size_t *pending;
+    size_t pendingCount;
+    bool rescan;
+    bool rewatch;
+};
+
+/*	One change found by pollCardWatcher, with the Card parsed for it. */
+typedef struct watchJob
+{
+    size_t file;
+    CacheKey key;
+    CardChangeKind kind;
+    Card *card;
+    CardSummary summary;
+} WatchJob;
+
+typedef struct watchBatch
+{
+    const CardWatcher *watcher;
+    WatchJob *jobs;
+} WatchBatch;
+
+/**
+ * Finds the state of a file name.
+ * @param watcher The watcher.
+ * @param name The file name, without the directory.
+ * @return The index of the file, or NO_WATCHED_FILE if the name has not been seen.
+ */
+static size_t findWatchedFile(const CardWatcher *watcher, const char *name)
+{
+    size_t mask = watcher->slotCapacity - 1;
+    for (size_t slot = hashName(name) & mask; watcher->slots[slot] != NO_WATCHED_FILE; slot = (slot + 1) & mask)
+    {
+        if (strcmp(watcher->files[watcher->slots[slot]].name, name) == 0)
+            return watcher->slots[slot];
+    }
+    return NO_WATCHED_FILE;
+}
+
+/**
+ * Rebuilds the name table of a watcher with room for at least twice its files.
+ * @param watcher The watcher.
+ * @param minimum The number of files the table must be able to hold.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool rebuildWatchSlots(CardWatcher *watcher, size_t minimum)
+{
+    size_t capacity = 64;
+    while (capacity < minimum * 2)
+        capacity *= 2;
+    size_t *slots = malloc(capacity * sizeof(size_t));
+    if (!slots)
+        return false;
+    for (size_t i = 0; i < capacity; i++)
+        slots[i] = NO_WATCHED_FILE;
+    for (size_t i = 0; i < watcher->count; i++)
+    {
+        size_t slot = hashName(watcher->files[i].name) & (capacity - 1);
+        while (slots[slot] != NO_WATCHED_FILE)
+            slot = (slot + 1) & (capacity - 1);
+        slots[slot] = i;
+    }
+    free(watcher->slots);
+    watcher->slots = slots;
+    watcher->slotCapacity = capacity;
+    return true;
+}
+
+/**
+ * Finds the state of a file name, adding a state for a name not seen before. A new
+ * name starts out absent.
+ * @param watcher The watcher.
+ * @param name The file name, without the directory.
+ * @return The index of the file, or NO_WATCHED_FILE if memory allocation fails.
+ */
+static size_t watchFileName(CardWatcher *watcher, const char *name)
+{
+    size_t index = findWatchedFile(watcher, name);
+    if (index != NO_WATCHED_FILE)
+        return index;
+    if (watcher->count == watcher->capacity)
+    {
+        size_t capacity = watcher->capacity ? watcher->capacity * 2 : 64;
+        WatchedFile *files = realloc(watcher->files, capacity * sizeof(WatchedFile));
+        size_t *pending = realloc(watcher->pending, capacity * sizeof(size_t));
+        if (files)
+            watcher->files = files;
+        if (pending)
+            watcher->pending = pending;
+        if (!files || !pending)
+            return NO_WATCHED_FILE;
+        watcher->capacity = capacity;
+    }
+    if ((watcher->count + 1) * 2 > watcher->slotCapacity && !rebuildWatchSlots(watcher, watcher->count + 1))
+        return NO_WATCHED_FILE;
+
+    size_t dirLength = strlen(watcher->dirName);
+    size_t nameLength = strlen(name);
+    char *path = malloc(dirLength + nameLength + 2);
+    if (!path)
+        return NO_WATCHED_FILE;
+    memcpy(path, watcher->dirName, dirLength);
+    path[dirLength] = '/';
+    memcpy(path + dirLength + 1, name, nameLength + 1);
+
+    index = watcher->count++;
+    watcher->files[index] = (WatchedFile){path, path + dirLength + 1, {0, 0, 0}, false, false};
+    size_t mask = watcher->slotCapacity - 1;
+    size_t slot = hashName(name) & mask;
+    while (watcher->slots[slot] != NO_WATCHED_FILE)
+        slot = (slot + 1) & mask;
+    watcher->slots[slot] = index;
+    return index;
+}
+
+/**
+ * Queues a file to be examined by the next poll.
+ * @param watcher The watcher.
+ * @param index The index of the file.
+ */
+static void markWatchedFile(CardWatcher *watcher, size_t index)
+{
+    if (!watcher->files[index].pending)
+    {
+        watcher->files[index].pending = true;
+        watcher->pending[watcher->pendingCount++] = index;
+    }
+}
+
+/**
+ * Lists the card files of the watched directory and records every name. While the
+ * watcher is opened the current version of each file is recorded as already seen;
+ * later every listed and every known file is queued, which recovers from lost events.
+ * @param watcher The watcher.
+ * @param initial true while the watcher is being opened.
+ * @return true on success, false if memory allocation fails. A directory that cannot
+ *         be read lists no files, so every known file is then reported removed.
+ */
+static bool listWatchedFiles(CardWatcher *watcher, bool initial)
+{
+    if (!initial)
+    {
+        for (size_t i = 0; i < watcher->count; i++)
+        {
+            if (watcher->files[i].present)
+                markWatchedFile(watcher, i);
+        }
+    }
+    DIR *dir = opendir(watcher->dirName);
+    if (!dir)
+        return true;
+    bool ok = true;
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir)) != NULL)
+    {
+        if (entry->d_type == DT_DIR || !hasCardExtension(entry->d_name))
+            continue;
+        size_t index = watchFileName(watcher, entry->d_name);
+        if (index == NO_WATCHED_FILE)
+            ok = false;
+        else if (!initial)
+            markWatchedFile(watcher, index);
+        else
+            watcher->files[index].present = readCacheKey(watcher->files[index].path, &watcher->files[index].key);
+    }
+    closedir(dir);
+    return ok;
+}
+
+/**
+ * Drains the inotify descriptor of a watcher and queues every card file named by an
+ * event. A lost event schedules a full rescan, and the loss of the directory itself a
+ * new watch followed by a full rescan. Events of an earlier watch are dropped.
+ * @param watcher The watcher.
+ * @return true on success, false if the descriptor fails or memory allocation fails.
+ */
+static bool readWatchEvents(CardWatcher *watcher)
+{
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;)
+    {
+        ssize_t length = read(watcher->fd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR)
+            continue;
+        if (length < 0)
+            return errno == EAGAIN;
+        if (length == 0)
+            return true;
+        for (char *next = buffer; next < buffer + length;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)next;
+            next += sizeof(struct inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                watcher->rescan = true;
+                continue;
+            }
+            if (event->wd != watcher->wd)
+                continue;
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+            {
+                watcher->rewatch = true;
+                watcher->rescan = true;
+                continue;
+            }
+            if (event->len == 0 || (event->mask & IN_ISDIR) || !hasCardExtension(event->name))
+                continue;
+            size_t index = watchFileName(watcher, event->name);
+            if (index == NO_WATCHED_FILE)
+                return false;
+            markWatchedFile(watcher, index);
+        }
+    }
+}
+
+/**
+ * Parses the file of one change of a poll and summarizes it. Runs on a pool worker.
+ * @param index The position of the change in the poll.
+ * @param context The WatchBatch.
+ * @return true, so that the batch always runs to the end.
+ */
+static bool parseWatchJob(size_t index, void *context)
+{
+    WatchBatch *batch = context;
+    WatchJob *job = &batch->jobs[index];
+    memset(&job->summary, 0, sizeof(CardSummary));
+    if (job->kind == CARD_REMOVED)
+        return true;
+    job->summary.error = loadCard(batch->watcher->files[job->file].path, batch->watcher->options.useArena, &job->card);
+    if (job->summary.error == OK)
+        summarizeCard(job->card, &job->summary);
+    else
+        job->card = NULL;
+    return true;
+}
+
+/**
+ * Opens a watcher on a card directory. The card files present now are recorded as
+ * already known, so only later changes are reported.
+ * @param dirName The card directory.
+ * @param options The options used to parse changed files, or NULL for the defaults.
+ * @return The watcher, or NULL if the directory cannot be watched or memory allocation
+ *         fails.
+ */
+CardWatcher *openCardWatcher(const char *dirName, const ScanOptions *options)
+{
+    if (!dirName)
+        return NULL;
+    CardWatcher *watcher = calloc(1, sizeof(CardWatcher));
+    if (!watcher)
+        return NULL;
+    if (options)
+        watcher->options = *options;
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    watcher->dirName = strdup(dirName);
+    // The watch is added before the directory is listed, so no change falls between them.
+    if (watcher->fd < 0 || !watcher->dirName ||
+        (watcher->wd = inotify_add_watch(watcher->fd, dirName, WATCH_EVENTS | IN_ONLYDIR)) < 0 ||
+        !rebuildWatchSlots(watcher, 0) || !listWatchedFiles(watcher, true))
+    {
+        closeCardWatcher(watcher);
+        return NULL;
+    }
+    return watcher;
+}
+
+/**
+ * Gets the inotify descriptor of a watcher, for use with poll or select.
+ * @param watcher The watcher.
+ * @return The descriptor, or -1 for a NULL watcher.
+ */
+int cardWatcherDescriptor(const CardWatcher *watcher)
+{
+    return watcher ? watcher->fd : -1;
+}
+
+/**
+ * Waits for changes in the watched directory and reports them. Every file named by an
+ * event is examined once per poll, however many events it had, and only files whose
+ * inode, size or modification time differ from what was last reported are parsed, in
+ * parallel. The changes are then reported in turn on the calling thread.
+ * @param watcher The watcher.
+ * @param timeout The longest time to wait for an event, in milliseconds, 0 to return
+ *        at once or -1 to wait indefinitely.
+ * @param callback Function receiving each change.
+ * @param userData Caller data passed through to the callback.
+ * @return The number of changes reported, or -1 for invalid arguments, a failed
+ *         descriptor, a directory that no longer exists or if memory allocation fails.
+ */
+int pollCardWatcher(CardWatcher *watcher, int timeout, CardChangeCallback callback, void *userData)
+{
+    if (!watcher || !callback)
+        return -1;
+    if (watcher->pendingCount == 0 && !watcher->rewatch)
+    {
+        struct pollfd ready = {watcher->fd, POLLIN, 0};
+        int events = poll(&ready, 1, timeout);
+        if (events <= 0)
+            return events < 0 && errno != EINTR ? -1 : 0;
+    }
+    if (!readWatchEvents(watcher))
+        return -1;
+    if (watcher->rewatch)
+    {
+        // A moved directory keeps its watch, which would follow it to its new name.
+        if (watcher->wd >= 0)
+            inotify_rm_watch(watcher->fd, watcher->wd);
+        watcher->wd = inotify_add_watch(watcher->fd, watcher->dirName, WATCH_EVENTS | IN_ONLYDIR);
+        if (watcher->wd < 0)
+            return -1;
+        watcher->rewatch = false;
+    }
+    if (watcher->rescan)
+    {
+        watcher->rescan = false;
+        if (!listWatchedFiles(watcher, false))
+            return -1;
+    }
+    if (watcher->pendingCount == 0)
+        return 0;
+
+    WatchJob *jobs = malloc(watcher->pendingCount * sizeof(WatchJob));
+    if (!jobs)
+        return -1;
+    size_t jobCount = 0;
+    for (size_t i = 0; i < watcher->pendingCount; i++)
+    {
+        WatchedFile *file = &watcher->files[watcher->pending[i]];
+        WatchJob *job = &jobs[jobCount];
+        job->file = watcher->pending[i];
+        job->card = NULL;
+        job->key = (CacheKey){0, 0, 0};
+        bool present = readCacheKey(file->path, &job->key);
+        if (present == file->present && (!present || memcmp(&job->key, &file->key, sizeof(CacheKey)) == 0))
+        {
+            // Nothing to report: unchanged, or created and deleted again since the last poll.
+            file->pending = false;
+            continue;
+        }
+        job->kind = !present ? CARD_REMOVED : file->present ? CARD_CHANGED : CARD_ADDED;
+        jobCount++;
+    }
+    WatchBatch batch = {watcher, jobs};
+    runWorkStealing(jobCount, watcher->options.threads > 0 ? (size_t)watcher->options.threads : 0, parseWatchJob, &batch);
+
+    // A change the callback does not take stays queued and is found again by the next poll.
+    size_t reported = 0;
+    bool more = true;
+    for (size_t i = 0; i < jobCount; i++)
+    {
+        WatchedFile *file = &watcher->files[jobs[i].file];
+        if (!more)
+        {
+            if (jobs[i].card)
+                deleteCard(jobs[i].card);
+            continue;
+        }
+        CardChange change = {jobs[i].kind, file->path, jobs[i].card, jobs[i].summary};
+        more = callback(&change, userData);
+        file->present = jobs[i].kind != CARD_REMOVED;
+        file->key = jobs[i].key;
+        file->pending = false;
+        reported++;
+    }
+    free(jobs);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < watcher->pendingCount; i++)
+    {
+        if (watcher->files[watcher->pending[i]].pending)
+            watcher->pending[kept++] = watcher->pending[i];
+    }
+    watcher->pendingCount = kept;
+    return (int)reported;
+}
+
+/**
+ * Stops watching a directory and releases the watcher.
+ * @param watcher The watcher. May be NULL.
+ */
+void closeCardWatcher(CardWatcher *watcher)
+{
+    if (!watcher)
+        return;
+    if (watcher->fd >= 0)
+        close(watcher->fd);
+    for (size_t i = 0; i < watcher->count; i++)
+        free(watcher->files[i].path);
+    free(watcher->dirName);
+    free(watcher->files);
+    free(watcher->slots);
+    free(watcher->pending);
+    free(watcher);
+}
+
+#else
+
+/**
+ * Directory watching needs inotify, so it is unavailable on this platform.
+ * @param dirName The card directory.
+ * @param options The options used to parse changed files.
+ * @return NULL.
+ */
+CardWatcher *openCardWatcher(const char *dirName, const ScanOptions *options)
+{
+    (void)dirName;
+    (void)options;
+    return NULL;
+}
+
+int cardWatcherDescriptor(const CardWatcher *watcher)
+{
+    (void)watcher;
+    return -1;
+}
+
+int pollCardWatcher(CardWatcher *watcher, int timeout, CardChangeCallback callback, void *userData)
+{
+    (void)watcher;
+    (void)timeout;
+    (void)callback;
+    (void)userData;
+    return -1;
+}
+
+void closeCardWatcher(CardWatcher *watcher)
+{
+    (void)watcher;
+}
+
+#endif
+
+/**
+ * Converts a VCardErrorCode value into a human-readable string.
+ * The returned string is dynamically allocated.
+ * @param err The VCardErrorCode to convert.
+ * @return A pointer to the allocated string representing the error.
+ */
+char *errorToString(VCardErrorCode err)
+{
+    switch (err)
+    {
+    case OK:
+        return duplicateString("OK");
+    case INV_FILE:
+        return duplicateString("Invalid file");
+    case INV_CARD:
+        return duplicateString("Invalid card");
+    case INV_PROP:
+        return duplicateString("Invalid property");
+    case INV_DT:
+        return duplicateString("Invalid date-time");
+    case WRITE_ERROR:
+        return duplicateString("Write error");
+    case OTHER_ERROR:
+        return duplicateString("Other error");
+    default:
+        return duplicateString("Invalid error code");
+    }
+}
+
+/**
+ * Frees all memory associated with a Property structure.
+ * This includes its name, group, parameters list, values list, and the property itself.
+ * @param toBeDeleted The Property to delete.
+ */
+void deleteProperty(void *toBeDeleted)
+{
+    Property *prop = (Property *)toBeDeleted;
+    if (prop)
+    {
+        freePropertyComponents(sideTableRemove(&propertyComponents, prop));
+        free(prop->name);
+        free(prop->group);
+        clearList(prop->parameters);
+        free(prop->parameters);
+        clearList(prop->values);
+        free(prop->values);
+        free(prop);
+    }
+}
+
+/**
+ * Compares two Property structures based on their name.
+ * @param first A pointer to the first Property.
+ * @param second A pointer to the second Property.
+ * @return The result of strcmp on the property names.
+ */
+int compareProperties(const void *first, const void *second)
+{
+    Property *p1 = (Property *)first;
+    Property *p2 = (Property *)second;
+    return strcmp(p1->name, p2->name);
+}
+
+/**
+ * Converts a Property to a human-readable string representation.
+ * The output format is: [group.]name: first_value.
+ * @param prop The Property to convert.
+ * @return A newly allocated string representing the property.
+ */
+char *propertyToString(void *prop)
+{
+    Property *p = (Property *)prop;
+    CardWriter counter = {NULL, 0, 0, false, 0};
+    writePropertySummary(&counter, p);
+    char *result = malloc(counter.length + 1);
+    if (!result)
+        return NULL;
+    CardWriter writer = {result, counter.length, 0, false, 0};
+    writePropertySummary(&writer, p);
+    result[writer.length] = '\0';
+    return result;
+}
+
+/**
+ * Frees all memory associated with a Parameter structure.
+ * @param toBeDeleted The Parameter to delete.
+ */
+void deleteParameter(void *toBeDeleted)
+{
+    Parameter *param = (Parameter *)toBeDeleted;
+    if (param)
+    {
+        free(param->name);
+        free(param->value);
+        free(param);
+    }
+}
+
+/**
+ * Compares two Parameter structures based on their name.
+ * @param first A pointer to the first Parameter.
+ * @param second A pointer to the second Parameter.
+ * @return The result of strcmp on the parameter names.
+ */
+int compareParameters(const void *first, const void *second)
+{
+    Parameter *p1 = (Parameter *)first;
+    Parameter *p2 = (Parameter *)second;
+    return strcmp(p1->name, p2->name);
+}
+
+/**
+ * Converts a Parameter structure into a string of the format "name=value".
+ * The returned string is dynamically allocated.
+ * @param param The Parameter to convert.
+ * @return A pointer to the allocated string.
+ */
+char *parameterToString(void *param)
+{
+    Parameter *p = (Parameter *)param;
+    char *result = malloc(256);
+    if (!result)
+        return NULL;
+    sprintf(result, "%s=%s", p->name, p->value);
+    return result;
+}
+
+/**
+ * Frees the memory associated with a value (assumed to be a char pointer).
+ * @param toBeDeleted The value to free.
+ */
+void deleteValue(void *toBeDeleted)
+{
+    char *value = (char *)toBeDeleted;
+    if (value)
+        free(value);
+}
+
+/**
+ * Compares two values (strings) using strcmp.
+ * @param first A pointer to the first value.
+ * @param second A pointer to the second value.
+ * @return The result of strcmp on the two strings.
+ */
+int compareValues(const void *first, const void *second)
+{
+    char *v1 = (char *)first;
+    char *v2 = (char *)second;
+    return strcmp(v1, v2);
+}
+
+/**
+ * Converts a value (string) into a new duplicate string.
+ * @param val The value to convert.
+ * @return A pointer to the newly allocated duplicate of the string.
+ */
+char *valueToString(void *val)
+{
+    return duplicateString((char *)val);
+}
+
+/**
+ * Frees all memory associated with a DateTime structure.
+ * This includes the date, time, text fields, and the structure itself.
+ * @param toBeDeleted The DateTime structure to delete.
+ */
+void deleteDate(void *toBeDeleted)
+{
+    DateTime *dt = (DateTime *)toBeDeleted;
+    if (dt)
+    {
+        free(dt->date);
+        free(dt->time);
+        free(dt->text);
+        free(dt);
+    }
+}
+
+/**
+ * Compares two DateTime structures chronologically, through their packed fields.
+ * Values that are not valid dates (including text values) sort after all valid ones,
+ * ordered by their date and text strings.
+ * @param first A pointer to the first DateTime.
+ * @param second A pointer to the second DateTime.
+ * @return Negative, zero or positive as first sorts before, with or after second.
+ */
+int compareDates(const void *first, const void *second)
+{
+    const DateTime *d1 = first;
+    const DateTime *d2 = second;
+    PackedDateTime p1;
+    PackedDateTime p2;
+    bool packed1 = packDateTime(d1, &p1) == OK;
+    bool packed2 = packDateTime(d2, &p2) == OK;
+    if (packed1 && packed2)
+        return comparePackedDateTimes(&p1, &p2);
+    if (packed1 != packed2)
+        return packed1 ? -1 : 1;
+    int order = strcmp(d1->date, d2->date);
+    return order != 0 ? order : strcmp(d1->text, d2->text);
+}
+
+/**
+ * Converts a DateTime structure to a string representation.
+ * For text DateTime, returns the text; otherwise, returns the concatenation of date and time.
+ * @param date The DateTime structure to convert.
+ * @return A newly allocated string representing the DateTime.
+ */
+char *dateToString(void *date)
+{
+    DateTime *dt = (DateTime *)date;
+    CardWriter counter = {NULL, 0, 0, false, 0};
+    writeDateValue(&counter, dt);
+    char *result = malloc(counter.length + 1);
+    if (!result)
+        return NULL;
+    CardWriter writer = {result, counter.length, 0, false, 0};
+    writeDateValue(&writer, dt);
+    result[writer.length] = '\0';
+    return result;
+}
+
+/* --- Additional Helper Functions for Assignment 3 --- */
+
+/**
+ * Creates and returns a new, empty Card object.
+ * The new Card has its optionalProperties list initialized and birthday/anniversary set to NULL.
+ * The FN property is set to NULL and should be added using updateFN.
+ * @return A pointer to the newly created Card, or NULL if memory allocation fails.
+ */
+Card *createEmptyCard(void)
+{
+    Card *card = malloc(sizeof(Card));
+    if (!card)
+        return NULL;
+    card->fn = NULL;
+    card->optionalProperties = initializeList(&propertyToString, &deleteProperty, &compareProperties);
+    card->birthday = NULL;
+    card->anniversary = NULL;
+    return card;
+}
+
+/**
+ * Updates the FN property of an arena-backed Card. The new value comes from the Card's
+ * arena; the old value is left in place and reclaimed together with the arena.
+ * @param arena The arena of the Card.
+ * @param card The Card object whose FN property is to be updated.
+ * @param newFN The new contact name.
+ * @return OK on success, or OTHER_ERROR if memory allocation fails.
+ */
+static VCardErrorCode updateArenaFN(Arena *arena, Card *card, const char *newFN)
+{
+    char *newVal = cardCopyString(arena, newFN);
+    if (!newVal)
+        return OTHER_ERROR;
+    if (card->fn && card->fn->values->head)
+    {
+        card->fn->values->head->data = newVal;
+        return OK;
+    }
+    if (!card->fn)
+    {
+        Property *fnProp = cardAlloc(arena, sizeof(Property));
+        if (!fnProp)
+            return OTHER_ERROR;
+        fnProp->name = cardCopyString(arena, "FN");
+        fnProp->group = cardCopyString(arena, "");
+        fnProp->parameters = cardList(arena, &parameterToString, &deleteParameter, &compareParameters);
+        fnProp->values = cardList(arena, &valueToString, &deleteValue, &compareValues);
+        if (!fnProp->name || !fnProp->group || !fnProp->parameters || !fnProp->values)
+            return OTHER_ERROR;
+        card->fn = fnProp;
+    }
+    return cardAppend(arena, card->fn->values, newVal) ? OK : OTHER_ERROR;
+}
+
+/**
+ * Updates the FN property of the given Card object with newFN.
+ * If the FN property does not exist, it is created.
+ * The FN property must not be empty.
+ * @param card The Card object whose FN property is to be updated.
+ * @param newFN The new contact name.
+ * @return OK on success, or an appropriate error code (e.g., INV_PROP or OTHER_ERROR) on failure.
+ */
+VCardErrorCode updateFN(Card *card, const char *newFN)
+{
+    if (!card || !newFN || strlen(newFN) == 0)
+        return INV_PROP;
+
+    Arena *arena = sideTableGet(&cardArenas, card);
+    if (arena)
+        return updateArenaFN(arena, card, newFN);
+
+    if (card->fn) {
+        // Update existing FN property.
+        if (getLength(card->fn->values) > 0 && card->fn->values->head) {
+            // Free the old value.
+            free(card->fn->values->head->data);
+            // Set new value.
+            card->fn->values->head->data = duplicateString(newFN);
+            if (!card->fn->values->head->data)
+                return OTHER_ERROR;
+        } else {
+            char *newVal = duplicateString(newFN);
+            if (!newVal)
+                return OTHER_ERROR;
+            insertBack(card->fn->values, newVal);
+        }
+    } else {
+        // Create a new FN property.
+        Property *fnProp = malloc(sizeof(Property));
+        if (!fnProp)
+            return OTHER_ERROR;
+        fnProp->name = duplicateString("FN");
+        fnProp->group = duplicateString("");
+        fnProp->parameters = initializeList(&parameterToString, &deleteParameter, &compareParameters);
+        fnProp->values = initializeList(&valueToString, &deleteValue, &compareValues);
+        if (!fnProp->name || !fnProp->group || !fnProp->parameters || !fnProp->values) {
+            free(fnProp);
+            return OTHER_ERROR;
+        }
+        char *newVal = duplicateString(newFN);
+        if (!newVal) {
+            free(fnProp->name);
+            free(fnProp->group);
+            free(fnProp->parameters);
+            free(fnProp->values);
+            free(fnProp);
+            return OTHER_ERROR;
+        }
+        insertBack(fnProp->values, newVal);
+        card->fn = fnProp;
+    }
+    return OK;
+}
+
+/**
+ * Frees all memory associated with a FlatProperty structure.
+ * @param toBeDeleted The FlatProperty to delete.
+ */
+static void deleteFlatProperty(void *toBeDeleted)
+{
+    FlatProperty *prop = (FlatProperty *)toBeDeleted;
+    if (prop)
+    {
+        free(prop->name);
+        free(prop->group);
+        freeArrayList(prop->parameters);
+        freeArrayList(prop->values);
+        free(prop);
     }
+}
 
-    // Write ANNIVERSARY property if present.
-    if (obj->anniversary)
+/**
+ * Compares two FlatProperty structures based on their name.
+ * @param first A pointer to the first FlatProperty.
+ * @param second A pointer to the second FlatProperty.
+ * @return The result of strcmp on the property names.
+ */
+static int compareFlatProperties(const void *first, const void *second)
+{
+    const FlatProperty *p1 = (const FlatProperty *)first;
+    const FlatProperty *p2 = (const FlatProperty *)second;
+    return strcmp(p1->name, p2->name);
+}
+
+/**
+ * Converts a FlatProperty to the same string representation as propertyToString.
+ * @param prop The FlatProperty to convert.
+ * @return A newly allocated string representing the property.
+ */
+static char *flatPropertyToString(void *prop)
+{
+    FlatProperty *p = (FlatProperty *)prop;
+    const char *value = getArrayElement(p->values, 0);
+    if (!value)
+        value = "";
+    size_t size = strlen(p->group) + strlen(p->name) + strlen(value) + 4;
+    char *result = malloc(size);
+    if (!result)
+        return NULL;
+    if (strlen(p->group) > 0)
+        snprintf(result, size, "%s.%s: %s", p->group, p->name, value);
+    else
+        snprintf(result, size, "%s: %s", p->name, value);
+    return result;
+}
+
+/**
+ * Allocates a deep copy of a DateTime structure.
+ * @param dt The DateTime to copy.
+ * @return The copy, or NULL if memory allocation fails.
+ */
+static DateTime *copyDate(const DateTime *dt)
+{
+    DateTime *copy = malloc(sizeof(DateTime));
+    if (!copy)
+        return NULL;
+    copy->UTC = dt->UTC;
+    copy->isText = dt->isText;
+    copy->date = duplicateString(dt->date);
+    copy->time = duplicateString(dt->time);
+    copy->text = duplicateString(dt->text);
+    if (!copy->date || !copy->time || !copy->text)
+    {
+        deleteDate(copy);
+        return NULL;
+    }
+    return copy;
+}
+
+/**
+ * Copies a Property into the contiguous representation.
+ * @param prop The Property to copy.
+ * @return The new FlatProperty, or NULL if memory allocation fails.
+ */
+static FlatProperty *flattenProperty(const Property *prop)
+{
+    FlatProperty *flat = malloc(sizeof(FlatProperty));
+    if (!flat)
+        return NULL;
+    flat->name = duplicateString(prop->name);
+    flat->group = duplicateString(prop->group);
+    flat->parameters = initializeArrayList(&parameterToString, &deleteParameter, &compareParameters);
+    flat->values = initializeArrayList(&valueToString, &deleteValue, &compareValues);
+    if (!flat->name || !flat->group || !flat->parameters || !flat->values ||
+        !reserveArrayList(flat->parameters, getLength(prop->parameters)) ||
+        !reserveArrayList(flat->values, getLength(prop->values)))
+    {
+        deleteFlatProperty(flat);
+        return NULL;
+    }
+
+    ListIterator paramIter = createIterator(prop->parameters);
+    Parameter *param;
+    while ((param = nextElement(&paramIter)) != NULL)
     {
-        DateTime *dt = obj->anniversary;
-        if (dt->isText)
+        Parameter *copy = malloc(sizeof(Parameter));
+        if (copy)
         {
-            if (fprintf(fp, "ANNIVERSARY;VALUE=text:%s\r\n", dt->text) < 0)
-            {
-                fclose(fp);
-                return WRITE_ERROR;
-            }
+            copy->name = duplicateString(param->name);
+            copy->value = duplicateString(param->value);
         }
-        else
+        if (!copy || !copy->name || !copy->value || !appendArrayElement(flat->parameters, copy))
         {
-            char *anniv = dateToString((void *)dt);
-            if (fprintf(fp, "ANNIVERSARY:%s\r\n", anniv) < 0)
-            {
-                free(anniv);
-                fclose(fp);
-                return WRITE_ERROR;
-            }
-            free(anniv);
+            deleteParameter(copy);
+            deleteFlatProperty(flat);
+            return NULL;
         }
     }
 
-    // Write optional properties.
-    ListIterator iter = createIterator(obj->optionalProperties);
-    void *data;
-    while ((data = nextElement(&iter)) != NULL)
+    ListIterator valueIter = createIterator(prop->values);
+    char *value;
+    while ((value = nextElement(&valueIter)) != NULL)
     {
-        char *propLine = propertyToFileString(data);
-        if (!propLine)
+        char *copy = duplicateString(value);
+        if (!copy || !appendArrayElement(flat->values, copy))
         {
-            fclose(fp);
-            return WRITE_ERROR;
+            free(copy);
+            deleteFlatProperty(flat);
+            return NULL;
         }
-        if (fprintf(fp, "%s\r\n", propLine) < 0)
-        {
-            free(propLine);
-            fclose(fp);
-            return WRITE_ERROR;
-        }
-        free(propLine);
     }
+    return flat;
+}
 
-    if (fprintf(fp, "END:VCARD\r\n") < 0)
+/**
+ * Copies a Card into the contiguous representation.
+ * @param card The Card to copy.
+ * @return The new FlatCard, or NULL if card is NULL or memory allocation fails.
+ */
+FlatCard *flattenCard(const Card *card)
+{
+    if (!card)
+        return NULL;
+    FlatCard *flat = calloc(1, sizeof(FlatCard));
+    if (!flat)
+        return NULL;
+    flat->optionalProperties = initializeArrayList(&flatPropertyToString, &deleteFlatProperty, &compareFlatProperties);
+    if (!flat->optionalProperties ||
+        !reserveArrayList(flat->optionalProperties, getLength(card->optionalProperties)) ||
+        (card->fn && !(flat->fn = flattenProperty(card->fn))) ||
+        (card->birthday && !(flat->birthday = copyDate(card->birthday))) ||
+        (card->anniversary && !(flat->anniversary = copyDate(card->anniversary))))
     {
-        fclose(fp);
-        return WRITE_ERROR;
+        deleteFlatCard(flat);
+        return NULL;
     }
 
-    if (ferror(fp))
+    ListIterator iter = createIterator(card->optionalProperties);
+    Property *prop;
+    while ((prop = nextElement(&iter)) != NULL)
     {
-        fclose(fp);
-        return WRITE_ERROR;
+        FlatProperty *copy = flattenProperty(prop);
+        if (!copy || !appendArrayElement(flat->optionalProperties, copy))
+        {
+            deleteFlatProperty(copy);
+            deleteFlatCard(flat);
+            return NULL;
+        }
     }
+    return flat;
+}
 
-    fclose(fp);
+/**
+ * Parses a vCard file into the contiguous representation.
+ * The card is parsed into an arena first, so the intermediate linked lists are
+ * released in a single step once they have been copied.
+ * @param fileName The name of the vCard file.
+ * @param obj A pointer to a FlatCard pointer that will be set to the newly created FlatCard on success.
+ * @return OK on success, or an appropriate VCardErrorCode if an error occurs.
+ */
+VCardErrorCode createFlatCard(char *fileName, FlatCard **obj)
+{
+    if (!obj)
+        return INV_FILE;
+    Card *card = NULL;
+    VCardErrorCode err = createArenaCard(fileName, &card);
+    if (err != OK)
+        return err;
+    FlatCard *flat = flattenCard(card);
+    deleteCard(card);
+    if (!flat)
+        return OTHER_ERROR;
+    *obj = flat;
     return OK;
 }
 
 /**
- * Validates a Card object against both the internal structure requirements and a subset of the vCard format rules.
- * Checks that required properties (FN, VERSION) are present and validates the properties and DateTime fields.
- * @param obj The Card object to validate.
- * @return OK if the card is valid, or an appropriate error code (INV_CARD, INV_PROP, INV_DT).
+ * Builds a List in an arena over existing data, with all of its Nodes in one contiguous array.
+ * @param arena The arena of the view.
+ * @param data The elements of the list, in order.
+ * @param length The number of elements.
+ * @param printFunction Function pointer to print a single element of the list.
+ * @param deleteFunction Function pointer to delete a single element of the list.
+ * @param compareFunction Function pointer to compare two elements of the list.
+ * @return The new List, or NULL if memory allocation fails.
  */
-VCardErrorCode validateCard(const Card *obj)
+static List *viewList(Arena *arena, void *const *data, int length, char *(*printFunction)(void *),
+                      void (*deleteFunction)(void *), int (*compareFunction)(const void *, const void *))
 {
-    if (!obj)
-        return INV_CARD;
+    List *list = cardList(arena, printFunction, deleteFunction, compareFunction);
+    if (!list || length <= 0)
+        return list;
+    Node *nodes = arenaAlloc(arena, (size_t)length * sizeof(Node));
+    if (!nodes)
+        return NULL;
+    for (int i = 0; i < length; i++)
+    {
+        nodes[i].data = data[i];
+        nodes[i].previous = i > 0 ? &nodes[i - 1] : NULL;
+        nodes[i].next = i + 1 < length ? &nodes[i + 1] : NULL;
+    }
+    list->head = &nodes[0];
+    list->tail = &nodes[length - 1];
+    list->length = length;
+    return list;
+}
 
-    if (!obj->fn || !obj->optionalProperties)
-        return INV_CARD;
-    if (strcmp(obj->fn->name, "FN") != 0)
-        return INV_PROP;
-    if (getLength(obj->fn->values) == 0)
-        return INV_PROP;
+/**
+ * Fills in a Property of a view from a FlatProperty, sharing its strings and Parameters.
+ * @param arena The arena of the view.
+ * @param flat The FlatProperty to view.
+ * @param out The Property to fill in.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool viewProperty(Arena *arena, const FlatProperty *flat, Property *out)
+{
+    out->name = flat->name;
+    out->group = flat->group;
+    out->parameters = viewList(arena, flat->parameters->elements, flat->parameters->length,
+                               &parameterToString, &deleteParameter, &compareParameters);
+    out->values = viewList(arena, flat->values->elements, flat->values->length,
+                           &valueToString, &deleteValue, &compareValues);
+    return out->parameters && out->values;
+}
 
-    ListIterator iter = createIterator(obj->optionalProperties);
-    void *data;
-    int countN = 0, countKIND = 0;
-    while ((data = nextElement(&iter)) != NULL)
+/**
+ * Creates a read-only Card view of a FlatCard. The view lives in an arena of its own,
+ * registered in cardArenas, so deleteCard releases it without touching the FlatCard.
+ * @param flat The FlatCard to view.
+ * @return The view, or NULL if flat is NULL or memory allocation fails.
+ */
+Card *flatCardView(const FlatCard *flat)
+{
+    if (!flat || !flat->optionalProperties)
+        return NULL;
+
+    int numProps = flat->optionalProperties->length;
+    size_t numNodes = (size_t)numProps;
+    for (int i = -1; i < numProps; i++)
     {
-        Property *prop = (Property *)data;
-        if (strcmp(prop->name, "VERSION") == 0)
-            return INV_CARD;
-        if (strcmp(prop->name, "BDAY") == 0 || strcmp(prop->name, "ANNIVERSARY") == 0)
-            return INV_DT;
-        if (strcmp(prop->name, "N") == 0)
-        {
-            countN++;
-            if (getLength(prop->values) != 5)
-                return INV_PROP;
-        }
-        if (strcmp(prop->name, "KIND") == 0)
-        {
-            countKIND++;
-        }
-        if (getLength(prop->values) == 0)
-            return INV_PROP;
-        ListIterator paramIter = createIterator(prop->parameters);
-        void *pData;
-        while ((pData = nextElement(&paramIter)) != NULL)
-        {
-            Parameter *p = (Parameter *)pData;
-            if (strlen(p->name) == 0 || strlen(p->value) == 0)
-                return INV_PROP;
-        }
+        const FlatProperty *prop = i < 0 ? flat->fn : getArrayElement(flat->optionalProperties, i);
+        if (prop)
+            numNodes += (size_t)(prop->parameters->length + prop->values->length);
     }
-    if (countN > 1)
-        return INV_PROP;
-    if (countKIND > 1)
-        return INV_PROP;
+    size_t size = sizeof(Card) + (size_t)(numProps + 1) * (sizeof(Property) + 2 * sizeof(List) + sizeof(void *)) +
+                  numNodes * sizeof(Node) + 1024;
+    Arena *arena = createArena(size);
+    if (!arena)
+        return NULL;
 
-    if (obj->birthday)
+    // Every Property of the view sits in one array, with FN in front of the optional ones.
+    Card *card = arenaAlloc(arena, sizeof(Card));
+    Property *props = arenaAlloc(arena, (size_t)(numProps + 1) * sizeof(Property));
+    void **propData = arenaAlloc(arena, (size_t)(numProps + 1) * sizeof(void *));
+    bool ok = card && props && propData;
+    if (ok)
     {
-        if (obj->birthday->isText)
+        card->fn = NULL;
+        card->birthday = flat->birthday;
+        card->anniversary = flat->anniversary;
+        if (flat->fn)
         {
-            if (strlen(obj->birthday->date) > 0 || strlen(obj->birthday->time) > 0 || obj->birthday->UTC)
-                return INV_DT;
+            ok = viewProperty(arena, flat->fn, &props[0]);
+            card->fn = &props[0];
         }
-        else
+        for (int i = 0; ok && i < numProps; i++)
         {
-            int dateEmpty = (strlen(obj->birthday->date) == 0);
-            int timeEmpty = (strlen(obj->birthday->time) == 0);
-            if (dateEmpty && timeEmpty)
-                return INV_DT;
-            if (strlen(obj->birthday->text) > 0)
-                return INV_DT;
+            ok = viewProperty(arena, getArrayElement(flat->optionalProperties, i), &props[i + 1]);
+            propData[i] = &props[i + 1];
         }
     }
-    if (obj->anniversary)
+    if (ok)
     {
-        if (obj->anniversary->isText)
-        {
-            if (strlen(obj->anniversary->date) > 0 || strlen(obj->anniversary->time) > 0 || obj->anniversary->UTC)
-                return INV_DT;
-        }
-        else
-        {
-            int dateEmpty = (strlen(obj->anniversary->date) == 0);
-            int timeEmpty = (strlen(obj->anniversary->time) == 0);
-            if (dateEmpty && timeEmpty)
-                return INV_DT;
-            if (strlen(obj->anniversary->text) > 0)
-                return INV_DT;
-        }
+        card->optionalProperties = viewList(arena, propData, numProps,
+                                            &propertyToString, &deleteProperty, &compareProperties);
+        ok = card->optionalProperties && sideTablePut(&cardArenas, card, arena);
     }
-
-    return OK;
+    if (!ok)
+    {
+        destroyArena(arena);
+        return NULL;
+    }
+    return card;
 }
 
 /**
- * Frees all memory associated with a Card object, including its subcomponents.
- * @param obj The Card object to delete.
+ * Frees all memory associated with a FlatCard object.
+ * @param obj The FlatCard object to delete.
  */
-void deleteCard(Card *obj)
+void deleteFlatCard(FlatCard *obj)
 {
     if (!obj)
         return;
-    if (obj->fn)
-        deleteProperty(obj->fn);
-    if (obj->optionalProperties)
-    {
-        clearList(obj->optionalProperties);
-        free(obj->optionalProperties);
-    }
-    if (obj->birthday)
-        deleteDate(obj->birthday);
-    if (obj->anniversary)
-        deleteDate(obj->anniversary);
+    deleteFlatProperty(obj->fn);
+    freeArrayList(obj->optionalProperties);
+    deleteDate(obj->birthday);
+    deleteDate(obj->anniversary);
     free(obj);
 }
 
+/* --- Card diff and patch --- */
+
+/*
+ * Largest number of cells of the longest-common-subsequence table of diffCards. Cards
+ * whose differing middle section is larger are aligned only on their common prefix and
+ * suffix, and the rest is paired by name.
+ */
+#define MAX_DIFF_CELLS (1 << 20)
+
 /**
- * Converts a Card object into a human-readable string representation.
- * The returned string is dynamically allocated.
- * @param obj The Card object to convert.
- * @return A pointer to the allocated string, or "null" if obj is NULL.
+ * Compares two lists of strings in order.
+ * @return true if the lists have the same strings in the same order.
  */
-char *cardToString(const Card *obj)
+static bool equalValueLists(List *first, List *second)
 {
-    if (!obj)
-        return duplicateString("null");
-    char *result = malloc(1024);
-    if (!result)
-        return NULL;
-    sprintf(result, "FN: %s\n", (char *)getFromFront(obj->fn->values));
-    if (obj->birthday)
-    {
-        char *bdayStr = dateToString(obj->birthday);
-        sprintf(result + strlen(result), "BDAY: %s\n", bdayStr);
-        free(bdayStr);
-    }
-    if (obj->anniversary)
-    {
-        char *annivStr = dateToString(obj->anniversary);
-        sprintf(result + strlen(result), "ANNIVERSARY: %s\n", annivStr);
-        free(annivStr);
-    }
-    ListIterator iter = createIterator(obj->optionalProperties);
-    void *data;
-    while ((data = nextElement(&iter)) != NULL)
+    if (getLength(first) != getLength(second))
+        return false;
+    ListIterator a = createIterator(first);
+    ListIterator b = createIterator(second);
+    const char *x;
+    const char *y;
+    while ((x = nextElement(&a)) != NULL && (y = nextElement(&b)) != NULL)
     {
-        Property *prop = (Property *)data;
-        char *propStr = propertyToString(prop);
-        sprintf(result + strlen(result), "%s\n", propStr);
-        free(propStr);
+        if (strcmp(x, y) != 0)
+            return false;
     }
-    return result;
+    return true;
 }
 
 /**
- * Converts a VCardErrorCode value into a human-readable string.
- * The returned string is dynamically allocated.
- * @param err The VCardErrorCode to convert.
- * @return A pointer to the allocated string representing the error.
+ * Compares two lists of Parameters in order.
+ * @return true if the lists have the same names and values in the same order.
  */
-char *errorToString(VCardErrorCode err)
+static bool equalParameterLists(List *first, List *second)
 {
-    switch (err)
+    if (getLength(first) != getLength(second))
+        return false;
+    ListIterator a = createIterator(first);
+    ListIterator b = createIterator(second);
+    const Parameter *x;
+    const Parameter *y;
+    while ((x = nextElement(&a)) != NULL && (y = nextElement(&b)) != NULL)
     {
-    case OK:
-        return duplicateString("OK");
-    case INV_FILE:
-        return duplicateString("Invalid file");
-    case INV_CARD:
-        return duplicateString("Invalid card");
-    case INV_PROP:
-        return duplicateString("Invalid property");
-    case INV_DT:
-        return duplicateString("Invalid date-time");
-    case WRITE_ERROR:
-        return duplicateString("Write error");
-    case OTHER_ERROR:
-        return duplicateString("Other error");
-    default:
-        return duplicateString("Invalid error code");
+        if (strcmp(x->name, y->name) != 0 || strcmp(x->value, y->value) != 0)
+            return false;
     }
+    return true;
 }
 
 /**
- * Frees all memory associated with a Property structure.
- * This includes its name, group, parameters list, values list, and the property itself.
- * @param toBeDeleted The Property to delete.
+ * Finds the parts in which two properties differ.
+ * @return A combination of EDIT_NAME, EDIT_GROUP, EDIT_PARAMETERS and EDIT_VALUES, or 0
+ *         if the properties are equal.
  */
-void deleteProperty(void *toBeDeleted)
+static int propertyChanges(const Property *first, const Property *second)
 {
-    Property *prop = (Property *)toBeDeleted;
-    if (prop)
+    int changes = 0;
+    if (strcmp(first->name, second->name) != 0)
+        changes |= EDIT_NAME;
+    if (strcmp(first->group, second->group) != 0)
+        changes |= EDIT_GROUP;
+    if (!equalParameterLists(first->parameters, second->parameters))
+        changes |= EDIT_PARAMETERS;
+    if (!equalValueLists(first->values, second->values))
+        changes |= EDIT_VALUES;
+    return changes;
+}
+
+static bool equalDates(const DateTime *first, const DateTime *second)
+{
+    if (!first || !second)
+        return first == second;
+    return first->UTC == second->UTC && first->isText == second->isText && strcmp(first->date, second->date) == 0 &&
+           strcmp(first->time, second->time) == 0 && strcmp(first->text, second->text) == 0;
+}
+
+/**
+ * Hashes a property with FNV-1a over its name, group, parameters and values, so that
+ * properties with different hashes are known to differ.
+ */
+static size_t hashProperty(const Property *prop)
+{
+    size_t h = hashName(prop->name) ^ hashName(prop->group) * 31;
+    ListIterator params = createIterator(prop->parameters);
+    const Parameter *param;
+    while ((param = nextElement(&params)) != NULL)
+        h = (h ^ hashName(param->name) ^ hashName(param->value) * 31) * (size_t)1099511628211ULL;
+    ListIterator values = createIterator(prop->values);
+    const char *value;
+    while ((value = nextElement(&values)) != NULL)
+        h = (h ^ hashName(value)) * (size_t)1099511628211ULL;
+    return h;
+}
+
+/**
+ * Allocates a deep copy of a list of Parameters.
+ * @return The copy, or NULL if memory allocation fails.
+ */
+static List *copyParameterList(List *params)
+{
+    List *copy = initializeList(&parameterToString, &deleteParameter, &compareParameters);
+    ListIterator iter = createIterator(params);
+    const Parameter *param;
+    while (copy && (param = nextElement(&iter)) != NULL)
     {
-        free(prop->name);
-        free(prop->group);
-        clearList(prop->parameters);
-        free(prop->parameters);
-        clearList(prop->values);
-        free(prop->values);
-        free(prop);
+        Parameter *dup = malloc(sizeof(Parameter));
+        if (dup)
+        {
+            dup->name = duplicateString(param->name);
+            dup->value = duplicateString(param->value);
+        }
+        if (!dup || !dup->name || !dup->value || !cardAppend(NULL, copy, dup))
+        {
+            deleteParameter(dup);
+            freeList(copy);
+            return NULL;
+        }
     }
+    return copy;
 }
 
 /**
- * Compares two Property structures based on their name.
- * @param first A pointer to the first Property.
- * @param second A pointer to the second Property.
- * @return The result of strcmp on the property names.
+ * Allocates a deep copy of a list of strings.
+ * @return The copy, or NULL if memory allocation fails.
  */
-int compareProperties(const void *first, const void *second)
+static List *copyValueList(List *values)
 {
-    Property *p1 = (Property *)first;
-    Property *p2 = (Property *)second;
-    return strcmp(p1->name, p2->name);
+    List *copy = initializeList(&valueToString, &deleteValue, &compareValues);
+    ListIterator iter = createIterator(values);
+    const char *value;
+    while (copy && (value = nextElement(&iter)) != NULL)
+    {
+        char *dup = duplicateString(value);
+        if (!dup || !cardAppend(NULL, copy, dup))
+        {
+            free(dup);
+            freeList(copy);
+            return NULL;
+        }
+    }
+    return copy;
 }
 
 /**
- * Converts a Property to a human-readable string representation.
- * The output format is: [group.]name: first_value.
- * @param prop The Property to convert.
- * @return A newly allocated string representing the property.
+ * Allocates a deep copy of a Property.
+ * @return The copy, or NULL if memory allocation fails.
  */
-char *propertyToString(void *prop)
+static Property *copyProperty(const Property *prop)
 {
-    Property *p = (Property *)prop;
-    char *result = malloc(1024);
-    if (!result)
+    Property *copy = malloc(sizeof(Property));
+    if (!copy)
         return NULL;
-    if (strlen(p->group) > 0)
-        sprintf(result, "%s.%s: %s", p->group, p->name, (char *)getFromFront(p->values));
-    else
-        sprintf(result, "%s: %s", p->name, (char *)getFromFront(p->values));
-    return result;
+    copy->name = duplicateString(prop->name);
+    copy->group = duplicateString(prop->group);
+    copy->parameters = copyParameterList(prop->parameters);
+    copy->values = copyValueList(prop->values);
+    if (!copy->name || !copy->group || !copy->parameters || !copy->values)
+    {
+        free(copy->name);
+        free(copy->group);
+        freeList(copy->parameters);
+        freeList(copy->values);
+        free(copy);
+        return NULL;
+    }
+    return copy;
 }
 
 /**
- * Frees all memory associated with a Parameter structure.
- * @param toBeDeleted The Parameter to delete.
+ * Appends an edit to a patch, taking ownership of its property and date.
+ * @return true on success, false if memory allocation fails; the property and date are
+ *         then freed.
  */
-void deleteParameter(void *toBeDeleted)
+static bool addCardEdit(CardPatch *patch, int *capacity, CardEdit edit)
 {
-    Parameter *param = (Parameter *)toBeDeleted;
-    if (param)
+    if (patch->numEdits == *capacity)
     {
-        free(param->name);
-        free(param->value);
-        free(param);
+        int grown = *capacity ? *capacity * 2 : 8;
+        CardEdit *edits = realloc(patch->edits, (size_t)grown * sizeof(CardEdit));
+        if (!edits)
+        {
+            deleteProperty(edit.property);
+            deleteDate(edit.date);
+            return false;
+        }
+        patch->edits = edits;
+        *capacity = grown;
     }
+    patch->edits[patch->numEdits++] = edit;
+    return true;
 }
 
 /**
- * Compares two Parameter structures based on their name.
- * @param first A pointer to the first Parameter.
- * @param second A pointer to the second Parameter.
- * @return The result of strcmp on the parameter names.
+ * Adds the edit of one property, given where it is in each card.
+ * @param oldProp The property in the old card, or NULL if it was added.
+ * @param newProp The property in the new card, or NULL if it was removed.
+ * @return true on success, false if memory allocation fails.
  */
-int compareParameters(const void *first, const void *second)
+static bool addPropertyEdit(CardPatch *patch, int *capacity, const Property *oldProp, int oldPosition,
+                            const Property *newProp, int newPosition)
 {
-    Parameter *p1 = (Parameter *)first;
-    Parameter *p2 = (Parameter *)second;
-    return strcmp(p1->name, p2->name);
+    CardEdit edit = {PROPERTY_CHANGED, oldPosition, 0, NULL, NULL};
+    if (!newProp)
+        edit.kind = PROPERTY_REMOVED;
+    else if (!oldProp)
+    {
+        edit.kind = PROPERTY_ADDED;
+        edit.position = newPosition;
+    }
+    else if ((edit.changes = propertyChanges(oldProp, newProp)) == 0)
+        return true;
+    if (newProp && !(edit.property = copyProperty(newProp)))
+        return false;
+    return addCardEdit(patch, capacity, edit);
 }
 
 /**
- * Converts a Parameter structure into a string of the format "name=value".
- * The returned string is dynamically allocated.
- * @param param The Parameter to convert.
- * @return A pointer to the allocated string.
+ * Adds the edits of a run of removed and added properties between two aligned ones.
+ * Removed and added properties of the same name are paired, in order, into changes.
+ * @return true on success, false if memory allocation fails.
  */
-char *parameterToString(void *param)
+static bool addGapEdits(CardPatch *patch, int *capacity, Property **oldProps, int oldStart, int oldEnd,
+                        Property **newProps, int newStart, int newEnd)
 {
-    Parameter *p = (Parameter *)param;
-    char *result = malloc(256);
-    if (!result)
-        return NULL;
-    sprintf(result, "%s=%s", p->name, p->value);
-    return result;
+    int next = newStart;
+    // A name with no added property left stays unmatched, since next only moves forward.
+    const char *missing = NULL;
+    for (int i = oldStart; i < oldEnd; i++)
+    {
+        int match = missing && strcasecmp(oldProps[i]->name, missing) == 0 ? newEnd : next;
+        while (match < newEnd && strcasecmp(oldProps[i]->name, newProps[match]->name) != 0)
+            match++;
+        if (match == newEnd)
+        {
+            missing = oldProps[i]->name;
+            if (!addPropertyEdit(patch, capacity, oldProps[i], i, NULL, -1))
+                return false;
+            continue;
+        }
+        for (; next < match; next++)
+        {
+            if (!addPropertyEdit(patch, capacity, NULL, -1, newProps[next], next))
+                return false;
+        }
+        if (!addPropertyEdit(patch, capacity, oldProps[i], i, newProps[match], match))
+            return false;
+        next = match + 1;
+    }
+    for (; next < newEnd; next++)
+    {
+        if (!addPropertyEdit(patch, capacity, NULL, -1, newProps[next], next))
+            return false;
+    }
+    return true;
 }
 
 /**
- * Frees the memory associated with a value (assumed to be a char pointer).
- * @param toBeDeleted The value to free.
+ * Collects the optional properties of a Card and their hashes into arrays.
+ * @return true on success, false if memory allocation fails.
  */
-void deleteValue(void *toBeDeleted)
+static bool collectProperties(const Card *card, Property ***props, size_t **hashes, int *count)
 {
-    char *value = (char *)toBeDeleted;
-    if (value)
-        free(value);
+    *count = getLength(card->optionalProperties);
+    *props = malloc(((size_t)*count + 1) * sizeof(Property *));
+    *hashes = malloc(((size_t)*count + 1) * sizeof(size_t));
+    if (!*props || !*hashes)
+        return false;
+    ListIterator iter = createIterator(card->optionalProperties);
+    for (int i = 0; i < *count; i++)
+    {
+        (*props)[i] = nextElement(&iter);
+        (*hashes)[i] = hashProperty((*props)[i]);
+    }
+    return true;
 }
 
 /**
- * Compares two values (strings) using strcmp.
- * @param first A pointer to the first value.
- * @param second A pointer to the second value.
- * @return The result of strcmp on the two strings.
+ * Aligns the optional properties of two cards and adds their edits to a patch. Equal
+ * leading and trailing properties are skipped, and the middle sections are aligned on a
+ * longest common subsequence of equal properties.
+ * @return true on success, false if memory allocation fails.
  */
-int compareValues(const void *first, const void *second)
+static bool addOptionalEdits(CardPatch *patch, int *capacity, const Card *oldCard, const Card *newCard)
 {
-    char *v1 = (char *)first;
-    char *v2 = (char *)second;
-    return strcmp(v1, v2);
+    Property **oldProps = NULL;
+    Property **newProps = NULL;
+    size_t *oldHashes = NULL;
+    size_t *newHashes = NULL;
+    int n = 0;
+    int m = 0;
+    bool ok = collectProperties(oldCard, &oldProps, &oldHashes, &n) &&
+              collectProperties(newCard, &newProps, &newHashes, &m);
+
+    int prefix = 0;
+    int suffix = 0;
+    while (ok && prefix < n && prefix < m && oldHashes[prefix] == newHashes[prefix] &&
+           propertyChanges(oldProps[prefix], newProps[prefix]) == 0)
+        prefix++;
+    while (ok && suffix < n - prefix && suffix < m - prefix && oldHashes[n - 1 - suffix] == newHashes[m - 1 - suffix] &&
+           propertyChanges(oldProps[n - 1 - suffix], newProps[m - 1 - suffix]) == 0)
+        suffix++;
+    int rows = n - prefix - suffix;
+    int cols = m - prefix - suffix;
+
+    // lengths[i][j] is the length of the common subsequence of old[i..] and new[j..].
+    int *lengths = NULL;
+    if (ok && rows > 0 && cols > 0 && (size_t)(rows + 1) * (size_t)(cols + 1) <= MAX_DIFF_CELLS)
+    {
+        lengths = calloc((size_t)(rows + 1) * (size_t)(cols + 1), sizeof(int));
+        ok = lengths != NULL;
+    }
+    for (int i = rows - 1; lengths && i >= 0; i--)
+    {
+        for (int j = cols - 1; j >= 0; j--)
+        {
+            int *cell = &lengths[i * (cols + 1) + j];
+            const Property *a = oldProps[prefix + i];
+            const Property *b = newProps[prefix + j];
+            if (oldHashes[prefix + i] == newHashes[prefix + j] && propertyChanges(a, b) == 0)
+                *cell = cell[cols + 2] + 1;
+            else
+                *cell = cell[cols + 1] > cell[1] ? cell[cols + 1] : cell[1];
+        }
+    }
+
+    // Walk the table, emitting the gap between each pair of aligned properties.
+    int i = 0;
+    int j = 0;
+    int gapOld = 0;
+    int gapNew = 0;
+    while (ok && lengths && i < rows && j < cols)
+    {
+        int *cell = &lengths[i * (cols + 1) + j];
+        if (oldHashes[prefix + i] == newHashes[prefix + j] && *cell == cell[cols + 2] + 1 &&
+            propertyChanges(oldProps[prefix + i], newProps[prefix + j]) == 0)
+        {
+            ok = addGapEdits(patch, capacity, oldProps, prefix + gapOld, prefix + i, newProps, prefix + gapNew, prefix + j);
+            gapOld = ++i;
+            gapNew = ++j;
+        }
+        else if (cell[cols + 1] >= cell[1])
+            i++;
+        else
+            j++;
+    }
+    if (ok)
+        ok = addGapEdits(patch, capacity, oldProps, prefix + gapOld, n - suffix, newProps, prefix + gapNew, m - suffix);
+
+    free(lengths);
+    free(oldProps);
+    free(newProps);
+    free(oldHashes);
+    free(newHashes);
+    return ok;
 }
 
 /**
- * Converts a value (string) into a new duplicate string.
- * @param val The value to convert.
- * @return A pointer to the newly allocated duplicate of the string.
+ * Adds the edit of a birthday or anniversary if it differs between two cards.
+ * @return true on success, false if memory allocation fails.
  */
-char *valueToString(void *val)
+static bool addDateEdit(CardPatch *patch, int *capacity, CardDateKind kind, const DateTime *oldDate,
+                        const DateTime *newDate)
 {
-    return duplicateString((char *)val);
+    if (equalDates(oldDate, newDate))
+        return true;
+    CardEdit edit = {DATE_CHANGED, kind, 0, NULL, NULL};
+    if (newDate && !(edit.date = copyDate(newDate)))
+        return false;
+    return addCardEdit(patch, capacity, edit);
 }
 
 /**
- * Frees all memory associated with a DateTime structure.
- * This includes the date, time, text fields, and the structure itself.
- * @param toBeDeleted The DateTime structure to delete.
+ * Computes the edits that turn oldCard into newCard: FN first, then the optional
+ * properties in order of position, then the birthday and the anniversary.
+ * @param oldCard The card before the change.
+ * @param newCard The card after the change.
+ * @return The patch, or NULL if an argument is NULL or memory allocation fails.
  */
-void deleteDate(void *toBeDeleted)
+CardPatch *diffCards(const Card *oldCard, const Card *newCard)
 {
-    DateTime *dt = (DateTime *)toBeDeleted;
-    if (dt)
+    if (!oldCard || !newCard || !oldCard->optionalProperties || !newCard->optionalProperties)
+        return NULL;
+    CardPatch *patch = calloc(1, sizeof(CardPatch));
+    if (!patch)
+        return NULL;
+    patch->oldLength = getLength(oldCard->optionalProperties);
+    patch->newLength = getLength(newCard->optionalProperties);
+    int capacity = 0;
+    bool ok = true;
+    if (oldCard->fn || newCard->fn)
+        ok = addPropertyEdit(patch, &capacity, oldCard->fn, -1, newCard->fn, -1);
+    ok = ok && addOptionalEdits(patch, &capacity, oldCard, newCard) &&
+         addDateEdit(patch, &capacity, BIRTHDAY_DATE, oldCard->birthday, newCard->birthday) &&
+         addDateEdit(patch, &capacity, ANNIVERSARY_DATE, oldCard->anniversary, newCard->anniversary);
+    if (!ok)
     {
-        free(dt->date);
-        free(dt->time);
-        free(dt->text);
-        free(dt);
+        deleteCardPatch(patch);
+        return NULL;
     }
+    return patch;
 }
 
+/*
+ * Everything applyCardPatch allocates before it modifies the Card: copies of the
+ * replaced parts of each property, and the Nodes of the new optional property list.
+ */
+typedef struct patchCopies
+{
+    Property *fn;
+    Property **changed;
+    Node **nodes;
+    DateTime *dates[2];
+    bool hasDate[2];
+} PatchCopies;
+
 /**
- * Compares two DateTime structures based on their date strings.
- * @param first A pointer to the first DateTime.
- * @param second A pointer to the second DateTime.
- * @return The result of strcmp on the date fields.
+ * Copies the parts of a property that a PROPERTY_CHANGED edit replaces into a Property
+ * whose other fields are NULL.
+ * @return The copy, or NULL if memory allocation fails.
  */
-int compareDates(const void *first, const void *second)
+static Property *copyChangedParts(const Property *prop, int changes)
 {
-    DateTime *d1 = (DateTime *)first;
-    DateTime *d2 = (DateTime *)second;
-    return strcmp(d1->date, d2->date);
+    Property *copy = calloc(1, sizeof(Property));
+    if (!copy)
+        return NULL;
+    bool ok = (!(changes & EDIT_NAME) || (copy->name = duplicateString(prop->name))) &&
+              (!(changes & EDIT_GROUP) || (copy->group = duplicateString(prop->group))) &&
+              (!(changes & EDIT_PARAMETERS) || (copy->parameters = copyParameterList(prop->parameters))) &&
+              (!(changes & EDIT_VALUES) || (copy->values = copyValueList(prop->values)));
+    if (!ok)
+    {
+        free(copy->name);
+        free(copy->group);
+        freeList(copy->parameters);
+        freeList(copy->values);
+        free(copy);
+        return NULL;
+    }
+    return copy;
 }
 
 /**
- * Converts a DateTime structure to a string representation.
- * For text DateTime, returns the text; otherwise, returns the concatenation of date and time.
- * @param date The DateTime structure to convert.
- * @return A newly allocated string representing the DateTime.
+ * Moves the replaced parts of a property into place and frees the old ones.
+ * @param prop The property of the Card.
+ * @param parts The parts made by copyChangedParts. Freed.
  */
-char *dateToString(void *date)
+static void replaceChangedParts(Property *prop, Property *parts)
 {
-    DateTime *dt = (DateTime *)date;
-    char *result = malloc(256);
-    if (!result)
-        return NULL;
-    if (dt->isText)
-        sprintf(result, "%s", dt->text);
-    else
+    freePropertyComponents(sideTableRemove(&propertyComponents, prop));
+    if (parts->name)
     {
-        if (strlen(dt->date) > 0 && strlen(dt->time) > 0)
-            sprintf(result, "%sT%s", dt->date, dt->time);
-        else if (strlen(dt->date) > 0)
-            sprintf(result, "%s", dt->date);
-        else
-            sprintf(result, "T%s", dt->time);
+        free(prop->name);
+        prop->name = parts->name;
     }
-    return result;
+    if (parts->group)
+    {
+        free(prop->group);
+        prop->group = parts->group;
+    }
+    if (parts->parameters)
+    {
+        freeList(prop->parameters);
+        prop->parameters = parts->parameters;
+    }
+    if (parts->values)
+    {
+        freeList(prop->values);
+        prop->values = parts->values;
+    }
+    free(parts);
 }
 
-/* --- Additional Helper Functions for Assignment 3 --- */
+static void freePatchCopies(PatchCopies *copies, const CardPatch *patch)
+{
+    for (int i = 0; i < patch->numEdits; i++)
+    {
+        if (copies->changed && copies->changed[i])
+            deleteProperty(copies->changed[i]);
+    }
+    for (int i = 0; copies->nodes && i < patch->newLength; i++)
+    {
+        if (copies->nodes[i])
+        {
+            deleteProperty(copies->nodes[i]->data);
+            free(copies->nodes[i]);
+        }
+    }
+    deleteProperty(copies->fn);
+    deleteDate(copies->dates[0]);
+    deleteDate(copies->dates[1]);
+    free(copies->changed);
+    free(copies->nodes);
+}
 
 /**
- * Creates and returns a new, empty Card object.
- * The new Card has its optionalProperties list initialized and birthday/anniversary set to NULL.
- * The FN property is set to NULL and should be added using updateFN.
- * @return A pointer to the newly created Card, or NULL if memory allocation fails.
+ * Checks that the edits of a patch fit a Card: FN, each date and each old position are
+ * edited at most once, each new position is added at most once, and the properties that
+ * are kept fill exactly the new positions that are not added.
+ * @param removed Receives, for each old position, whether the property is removed.
+ * @param added Receives, for each new position, whether a property is added there.
+ * @return true if the patch can be applied.
  */
-Card *createEmptyCard(void)
+static bool patchFitsCard(const CardPatch *patch, const Card *card, bool *removed, bool *added)
 {
-    Card *card = malloc(sizeof(Card));
-    if (!card)
-        return NULL;
-    card->fn = NULL;
-    card->optionalProperties = initializeList(&propertyToString, &deleteProperty, &compareProperties);
-    card->birthday = NULL;
-    card->anniversary = NULL;
-    return card;
+    bool *edited = calloc((size_t)patch->oldLength + 1, sizeof(bool));
+    bool fnEdited = false;
+    bool dateEdited[2] = {false, false};
+    int removals = 0;
+    int additions = 0;
+    bool ok = edited != NULL;
+    for (int i = 0; ok && i < patch->numEdits; i++)
+    {
+        const CardEdit *edit = &patch->edits[i];
+        int position = edit->position;
+        if (edit->kind == DATE_CHANGED)
+        {
+            ok = (position == BIRTHDAY_DATE || position == ANNIVERSARY_DATE) && !dateEdited[position];
+            if (ok)
+                dateEdited[position] = true;
+            continue;
+        }
+        if (position < -1 || (edit->kind != PROPERTY_REMOVED && !edit->property))
+            ok = false;
+        else if (edit->kind == PROPERTY_ADDED)
+        {
+            ok = position < patch->newLength && (position < 0 ? !card->fn && !fnEdited : !added[position]);
+            if (ok && position >= 0)
+            {
+                added[position] = true;
+                additions++;
+            }
+        }
+        else if (edit->kind == PROPERTY_REMOVED || edit->kind == PROPERTY_CHANGED)
+        {
+            ok = position < patch->oldLength && (position < 0 ? card->fn && !fnEdited : !edited[position]) &&
+                 (edit->kind == PROPERTY_REMOVED || edit->changes != 0);
+            if (ok && position >= 0)
+            {
+                edited[position] = true;
+                removed[position] = edit->kind == PROPERTY_REMOVED;
+                removals += edit->kind == PROPERTY_REMOVED;
+            }
+        }
+        else
+            ok = false;
+        if (position < 0)
+            fnEdited = true;
+    }
+    free(edited);
+    return ok && patch->oldLength - removals + additions == patch->newLength;
 }
 
 /**
- * Updates the FN property of the given Card object with newFN.
- * If the FN property does not exist, it is created.
- * The FN property must not be empty.
- * @param card The Card object whose FN property is to be updated.
- * @param newFN The new contact name.
- * @return OK on success, or an appropriate error code (e.g., INV_PROP or OTHER_ERROR) on failure.
+ * Applies a patch to a Card. All copies and Nodes are allocated first, then the Card's
+ * optional property list is relinked in its new order.
+ * @param card The Card to modify.
+ * @param patch The patch.
+ * @return OK on success, INV_CARD if the Card is NULL, arena-backed, a view or does not
+ *         have oldLength optional properties, INV_PROP if the patch is NULL or
+ *         inconsistent, or OTHER_ERROR if memory allocation fails.
  */
-VCardErrorCode updateFN(Card *card, const char *newFN)
+VCardErrorCode applyCardPatch(Card *card, const CardPatch *patch)
 {
-    if (!card || !newFN || strlen(newFN) == 0)
+    if (!card || !card->optionalProperties || sideTableGet(&cardArenas, card))
+        return INV_CARD;
+    if (!patch || patch->numEdits < 0 || patch->oldLength < 0 || patch->newLength < 0 ||
+        (patch->numEdits > 0 && !patch->edits))
         return INV_PROP;
+    if (getLength(card->optionalProperties) != patch->oldLength)
+        return INV_CARD;
 
-    if (card->fn) {
-        // Update existing FN property.
-        if (getLength(card->fn->values) > 0 && card->fn->values->head) {
-            // Free the old value.
-            free(card->fn->values->head->data);
-            // Set new value.
-            card->fn->values->head->data = duplicateString(newFN);
-            if (!card->fn->values->head->data)
-                return OTHER_ERROR;
-        } else {
-            char *newVal = duplicateString(newFN);
-            if (!newVal)
-                return OTHER_ERROR;
-            insertBack(card->fn->values, newVal);
+    bool *removed = calloc((size_t)patch->oldLength + 1, sizeof(bool));
+    bool *added = calloc((size_t)patch->newLength + 1, sizeof(bool));
+    PatchCopies copies = {0};
+    copies.changed = calloc((size_t)patch->numEdits + 1, sizeof(Property *));
+    copies.nodes = calloc((size_t)patch->newLength + 1, sizeof(Node *));
+    Node **oldNodes = malloc(((size_t)patch->oldLength + 1) * sizeof(Node *));
+    VCardErrorCode err = removed && added && copies.changed && copies.nodes && oldNodes ? OK : OTHER_ERROR;
+    if (err == OK && !patchFitsCard(patch, card, removed, added))
+        err = INV_PROP;
+
+    for (int i = 0; err == OK && i < patch->numEdits; i++)
+    {
+        const CardEdit *edit = &patch->edits[i];
+        bool ok = true;
+        if (edit->kind == DATE_CHANGED)
+        {
+            copies.hasDate[edit->position] = true;
+            ok = !edit->date || (copies.dates[edit->position] = copyDate(edit->date));
         }
-    } else {
-        // Create a new FN property.
-        Property *fnProp = malloc(sizeof(Property));
-        if (!fnProp)
-            return OTHER_ERROR;
-        fnProp->name = duplicateString("FN");
-        fnProp->group = duplicateString("");
-        fnProp->parameters = initializeList(&parameterToString, &deleteParameter, &compareParameters);
-        fnProp->values = initializeList(&valueToString, &deleteValue, &compareValues);
-        if (!fnProp->name || !fnProp->group || !fnProp->parameters || !fnProp->values) {
-            free(fnProp);
-            return OTHER_ERROR;
+        else if (edit->kind == PROPERTY_CHANGED)
+            ok = (copies.changed[i] = copyChangedParts(edit->property, edit->changes)) != NULL;
+        else if (edit->kind == PROPERTY_ADDED && edit->position < 0)
+            ok = (copies.fn = copyProperty(edit->property)) != NULL;
+        else if (edit->kind == PROPERTY_ADDED)
+        {
+            Property *prop = copyProperty(edit->property);
+            ok = prop && (copies.nodes[edit->position] = initializeNode(prop));
+            if (prop && !ok)
+                deleteProperty(prop);
         }
-        char *newVal = duplicateString(newFN);
-        if (!newVal) {
-            free(fnProp->name);
-            free(fnProp->group);
-            free(fnProp->parameters);
-            free(fnProp->values);
-            free(fnProp);
-            return OTHER_ERROR;
+        if (!ok)
+            err = OTHER_ERROR;
+    }
+    if (err != OK)
+    {
+        freePatchCopies(&copies, patch);
+        free(oldNodes);
+        free(removed);
+        free(added);
+        return err;
+    }
+
+    // Nothing can fail from here on.
+    Node *node = card->optionalProperties->head;
+    for (int i = 0; i < patch->oldLength; i++, node = node->next)
+        oldNodes[i] = node;
+    freePropertyIndex(sideTableRemove(&propertyIndexes, card));
+
+    for (int i = 0; i < patch->numEdits; i++)
+    {
+        const CardEdit *edit = &patch->edits[i];
+        if (edit->kind == PROPERTY_CHANGED)
+        {
+            replaceChangedParts(edit->position < 0 ? card->fn : oldNodes[edit->position]->data, copies.changed[i]);
+            copies.changed[i] = NULL;
         }
-        insertBack(fnProp->values, newVal);
-        card->fn = fnProp;
+        else if (edit->kind == PROPERTY_REMOVED && edit->position < 0)
+        {
+            deleteProperty(card->fn);
+            card->fn = NULL;
+        }
+    }
+    if (copies.fn)
+        card->fn = copies.fn;
+    for (int kind = BIRTHDAY_DATE; kind <= ANNIVERSARY_DATE; kind++)
+    {
+        if (!copies.hasDate[kind])
+            continue;
+        DateTime **date = kind == BIRTHDAY_DATE ? &card->birthday : &card->anniversary;
+        deleteDate(*date);
+        *date = copies.dates[kind];
+    }
+
+    // Fill the new positions that are not added with the kept properties, in order.
+    List *list = card->optionalProperties;
+    list->head = NULL;
+    list->tail = NULL;
+    list->length = 0;
+    int kept = 0;
+    for (int i = 0; i < patch->newLength; i++)
+    {
+        if (!added[i])
+        {
+            while (removed[kept])
+            {
+                deleteProperty(oldNodes[kept]->data);
+                free(oldNodes[kept++]);
+            }
+            node = oldNodes[kept++];
+        }
+        else
+            node = copies.nodes[i];
+        node->previous = list->tail;
+        node->next = NULL;
+        if (list->tail)
+            list->tail->next = node;
+        else
+            list->head = node;
+        list->tail = node;
+        list->length++;
+    }
+    for (; kept < patch->oldLength; kept++)
+    {
+        deleteProperty(oldNodes[kept]->data);
+        free(oldNodes[kept]);
     }
+
+    free(oldNodes);
+    free(copies.changed);
+    free(copies.nodes);
+    free(removed);
+    free(added);
     return OK;
 }
+
+/**
+ * Frees a patch together with the properties and dates of its edits.
+ * @param patch The patch. May be NULL.
+ */
+void deleteCardPatch(CardPatch *patch)
+{
+    if (!patch)
+        return;
+    for (int i = 0; i < patch->numEdits; i++)
+    {
+        deleteProperty(patch->edits[i].property);
+        deleteDate(patch->edits[i].date);
+    }
+    free(patch->edits);
+    free(patch);
+}
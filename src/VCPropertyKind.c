@@ -0,0 +1,131 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/VCParser.h"
+
+#define TABLE_SIZE 128
+#define HASH_MULTIPLIER 404u
+
+/**
+ * One slot of the property name table. Empty slots have a NULL name.
+ */
+typedef struct propertyName
+{
+    const char *name;
+    size_t length;
+    PropertyKind kind;
+} PropertyName;
+
+/*
+ * Perfect hash table over the RFC 6350 property names: every name hashes to its own slot,
+ * so a lookup is one probe and one comparison. The multiplier and the slot of each name
+ * were found by an offline search; any change to the name set needs a new search.
+ */
+static const PropertyName propertyNames[TABLE_SIZE] = {
+    [0] = {"BEGIN", 5, PROP_BEGIN},
+    [2] = {"TZ", 2, PROP_TZ},
+    [5] = {"VERSION", 7, PROP_VERSION},
+    [7] = {"CALADRURI", 9, PROP_CALADRURI},
+    [10] = {"PRODID", 6, PROP_PRODID},
+    [11] = {"NOTE", 4, PROP_NOTE},
+    [13] = {"UID", 3, PROP_UID},
+    [25] = {"RELATED", 7, PROP_RELATED},
+    [29] = {"GENDER", 6, PROP_GENDER},
+    [31] = {"MEMBER", 6, PROP_MEMBER},
+    [37] = {"LANG", 4, PROP_LANG},
+    [42] = {"GEO", 3, PROP_GEO},
+    [46] = {"ANNIVERSARY", 11, PROP_ANNIVERSARY},
+    [54] = {"REV", 3, PROP_REV},
+    [61] = {"CATEGORIES", 10, PROP_CATEGORIES},
+    [62] = {"KEY", 3, PROP_KEY},
+    [68] = {"SOUND", 5, PROP_SOUND},
+    [69] = {"ORG", 3, PROP_ORG},
+    [72] = {"PHOTO", 5, PROP_PHOTO},
+    [73] = {"BDAY", 4, PROP_BDAY},
+    [77] = {"ADR", 3, PROP_ADR},
+    [78] = {"IMPP", 4, PROP_IMPP},
+    [82] = {"CALURI", 6, PROP_CALURI},
+    [83] = {"XML", 3, PROP_XML},
+    [87] = {"ROLE", 4, PROP_ROLE},
+    [88] = {"CLIENTPIDMAP", 12, PROP_CLIENTPIDMAP},
+    [92] = {"END", 3, PROP_END},
+    [95] = {"NICKNAME", 8, PROP_NICKNAME},
+    [100] = {"TITLE", 5, PROP_TITLE},
+    [101] = {"EMAIL", 5, PROP_EMAIL},
+    [106] = {"KIND", 4, PROP_KIND},
+    [111] = {"URL", 3, PROP_URL},
+    [112] = {"N", 1, PROP_N},
+    [113] = {"FBURL", 5, PROP_FBURL},
+    [119] = {"TEL", 3, PROP_TEL},
+    [120] = {"FN", 2, PROP_FN},
+    [122] = {"LOGO", 4, PROP_LOGO},
+    [127] = {"SOURCE", 6, PROP_SOURCE},
+};
+
+/**
+ * Hashes a property name from its length and its first, second and last characters.
+ * @param name The property name.
+ * @param length The length of the name, at least 1.
+ * @return The slot of the name in propertyNames.
+ */
+static size_t hashName(const char *name, size_t length)
+{
+    uint32_t h = (uint32_t)length;
+    h = h * HASH_MULTIPLIER + (unsigned char)name[0];
+    h = h * HASH_MULTIPLIER + (unsigned char)name[length - 1];
+    h = h * HASH_MULTIPLIER + (length > 1 ? (unsigned char)name[1] : 0);
+    return (h ^ (h >> 7)) & (TABLE_SIZE - 1);
+}
+
+/**
+ * Classifies a property name as one of the RFC 6350 properties.
+ * @param name The property name, without its group.
+ * @return The PropertyKind of the name, or PROP_OTHER if it is not an RFC 6350 property.
+ */
+PropertyKind propertyKind(const char *name)
+{
+    if (!name)
+        return PROP_OTHER;
+    size_t length = strlen(name);
+    if (length == 0)
+        return PROP_OTHER;
+    const PropertyName *slot = &propertyNames[hashName(name, length)];
+    if (slot->name && slot->length == length && memcmp(slot->name, name, length) == 0)
+        return slot->kind;
+    return PROP_OTHER;
+}
+
+/*
+ * Names of the RFC 6350 properties, indexed by PropertyKind.
+ */
+static const char *const kindNames[] = {
+    [PROP_BEGIN] = "BEGIN", [PROP_END] = "END", [PROP_SOURCE] = "SOURCE", [PROP_KIND] = "KIND", [PROP_XML] = "XML",
+    [PROP_FN] = "FN", [PROP_N] = "N", [PROP_NICKNAME] = "NICKNAME", [PROP_PHOTO] = "PHOTO", [PROP_BDAY] = "BDAY",
+    [PROP_ANNIVERSARY] = "ANNIVERSARY", [PROP_GENDER] = "GENDER",
+    [PROP_ADR] = "ADR",
+    [PROP_TEL] = "TEL", [PROP_EMAIL] = "EMAIL", [PROP_IMPP] = "IMPP", [PROP_LANG] = "LANG",
+    [PROP_TZ] = "TZ", [PROP_GEO] = "GEO",
+    [PROP_TITLE] = "TITLE", [PROP_ROLE] = "ROLE", [PROP_LOGO] = "LOGO", [PROP_ORG] = "ORG", [PROP_MEMBER] = "MEMBER",
+    [PROP_RELATED] = "RELATED",
+    [PROP_CATEGORIES] = "CATEGORIES", [PROP_NOTE] = "NOTE", [PROP_PRODID] = "PRODID", [PROP_REV] = "REV",
+    [PROP_SOUND] = "SOUND", [PROP_UID] = "UID", [PROP_CLIENTPIDMAP] = "CLIENTPIDMAP", [PROP_URL] = "URL",
+    [PROP_VERSION] = "VERSION",
+    [PROP_KEY] = "KEY",
+    [PROP_FBURL] = "FBURL", [PROP_CALADRURI] = "CALADRURI", [PROP_CALURI] = "CALURI",
+};
+
+/**
+ * Returns the name of an RFC 6350 property kind, the inverse of propertyKind.
+ * @param kind The property kind.
+ * @return The property name, or NULL for PROP_OTHER and values outside the enum.
+ */
+const char *propertyKindName(PropertyKind kind)
+{
+    if ((int)kind <= PROP_OTHER || (size_t)kind >= sizeof(kindNames) / sizeof(kindNames[0]))
+        return NULL;
+    return kindNames[kind];
+}
@@ -0,0 +1,197 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "../include/VCScanner.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define VC_SCANNER_X86 1
+#include <immintrin.h>
+#endif
+
+#define BLOCK_SIZE 64
+
+/**
+ * Classifies one byte as a delimiter or not. Used by the scalar kernel.
+ * @param c The byte to classify.
+ * @return true if c is CR, LF, ':', ';', '=', '.', ',' or '\\'.
+ */
+static bool isDelimiter(unsigned char c)
+{
+    switch (c)
+    {
+    case '\r':
+    case '\n':
+    case ':':
+    case ';':
+    case '=':
+    case '.':
+    case ',':
+    case '\\':
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Computes the delimiter mask of a 64-byte block one byte at a time.
+ * @param block The 64 bytes to classify.
+ * @return A mask with bit i set if block[i] is a delimiter.
+ */
+static uint64_t blockMaskScalar(const char *block)
+{
+    uint64_t mask = 0;
+    for (int i = 0; i < BLOCK_SIZE; i++)
+    {
+        if (isDelimiter((unsigned char)block[i]))
+            mask |= (uint64_t)1 << i;
+    }
+    return mask;
+}
+
+#ifdef VC_SCANNER_X86
+/**
+ * Computes the delimiter mask of a 64-byte block with SSE2, comparing each 16-byte lane
+ * against every delimiter.
+ * @param block The 64 bytes to classify.
+ * @return A mask with bit i set if block[i] is a delimiter.
+ */
+static uint64_t blockMaskSSE2(const char *block)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i semicolon = _mm_set1_epi8(';');
+    const __m128i equals = _mm_set1_epi8('=');
+    const __m128i dot = _mm_set1_epi8('.');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    uint64_t mask = 0;
+    for (int lane = 0; lane < BLOCK_SIZE / 16; lane++)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(block + lane * 16));
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, cr), _mm_cmpeq_epi8(bytes, lf)),
+                         _mm_or_si128(_mm_cmpeq_epi8(bytes, colon), _mm_cmpeq_epi8(bytes, semicolon))),
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, equals), _mm_cmpeq_epi8(bytes, dot)),
+                         _mm_or_si128(_mm_cmpeq_epi8(bytes, comma), _mm_cmpeq_epi8(bytes, backslash))));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(hits) << (lane * 16);
+    }
+    return mask;
+}
+
+/**
+ * Computes the delimiter mask of a 64-byte block with AVX2. Each byte is classified by
+ * looking up its low and high nibbles in two 16-entry tables; a byte is a delimiter when
+ * the two lookups share a bit. The high-nibble bits are 0x0_ (CR, LF), 0x2_ (',', '.'),
+ * 0x3_ (':', ';', '=') and 0x5_ ('\\'), and the low-nibble table lists which of those
+ * rows contain a delimiter with that low nibble.
+ * @param block The 64 bytes to classify.
+ * @return A mask with bit i set if block[i] is a delimiter.
+ */
+__attribute__((target("avx2"))) static uint64_t blockMaskAVX2(const char *block)
+{
+    const __m256i lowTable = _mm256_setr_epi8(
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x05, 0x04, 0x0A, 0x05, 0x02, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x05, 0x04, 0x0A, 0x05, 0x02, 0);
+    const __m256i highTable = _mm256_setr_epi8(
+        0x01, 0, 0x02, 0x04, 0, 0x08, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0x01, 0, 0x02, 0x04, 0, 0x08, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+
+    uint64_t mask = 0;
+    for (int lane = 0; lane < BLOCK_SIZE / 32; lane++)
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(block + lane * 32));
+        __m256i low = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(bytes, nibble));
+        __m256i high = _mm256_shuffle_epi8(highTable, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+        __m256i misses = _mm256_cmpeq_epi8(_mm256_and_si256(low, high), zero);
+        mask |= (uint64_t)(uint32_t)~_mm256_movemask_epi8(misses) << (lane * 32);
+    }
+    return mask;
+}
+#endif
+
+static uint64_t (*blockMask)(const char *block) = blockMaskScalar;
+static const char *blockMaskName = "scalar";
+
+/**
+ * Selects the widest kernel the CPU supports. Runs once when the library is loaded, so
+ * the choice is made before any thread can scan.
+ */
+__attribute__((constructor)) static void selectBlockMask(void)
+{
+#ifdef VC_SCANNER_X86
+    blockMask = blockMaskSSE2;
+    blockMaskName = "sse2";
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        blockMask = blockMaskAVX2;
+        blockMaskName = "avx2";
+    }
+#endif
+}
+
+/**
+ * Starts scanning a block of text for delimiters.
+ * @param scanner The scanner to initialize.
+ * @param data The text to scan. It does not need to be NUL-terminated.
+ * @param length The number of bytes of text.
+ */
+void initDelimiterScanner(DelimiterScanner *scanner, const char *data, size_t length)
+{
+    scanner->data = data;
+    scanner->length = length;
+    scanner->blockStart = 0;
+    scanner->nextBlock = 0;
+    scanner->mask = 0;
+}
+
+/**
+ * Returns the offset of the next delimiter, classifying the next 64-byte block when the
+ * current one has been used up.
+ * @param scanner The scanner to advance.
+ * @return The offset of the next delimiter, or the text length once none remain.
+ */
+size_t nextDelimiter(DelimiterScanner *scanner)
+{
+    while (scanner->mask == 0)
+    {
+        size_t start = scanner->nextBlock;
+        if (start >= scanner->length)
+            return scanner->length;
+        size_t remaining = scanner->length - start;
+        if (remaining >= BLOCK_SIZE)
+        {
+            scanner->mask = blockMask(scanner->data + start);
+        }
+        else
+        {
+            // The final partial block is padded with NULs, which are never delimiters.
+            char padded[BLOCK_SIZE] = {0};
+            memcpy(padded, scanner->data + start, remaining);
+            scanner->mask = blockMask(padded);
+        }
+        scanner->blockStart = start;
+        scanner->nextBlock = start + BLOCK_SIZE;
+    }
+    size_t offset = scanner->blockStart + (size_t)__builtin_ctzll(scanner->mask);
+    scanner->mask &= scanner->mask - 1;
+    return offset;
+}
+
+/**
+ * Reports which kernel the scanner selected for this CPU.
+ * @return "avx2", "sse2" or "scalar".
+ */
+const char *delimiterScannerKernel(void)
+{
+    return blockMaskName;
+}
@@ -0,0 +1,190 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../include/VCSideTable.h"
+
+#define INITIAL_CAPACITY 64
+
+/**
+ * Hashes an address into a slot index. Heap addresses share their low bits, so the
+ * address is mixed before it is masked.
+ * @param key The address to hash.
+ * @param capacity The table capacity, a power of two.
+ * @return The home slot of the key.
+ */
+static size_t slotFor(const void *key, size_t capacity)
+{
+    uint64_t h = (uint64_t)(uintptr_t)key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t)h & (capacity - 1);
+}
+
+/**
+ * Finds the slot holding a key, or the empty slot where it would be inserted.
+ * @param table The side table. Must be locked and have a non-zero capacity.
+ * @param key The address to look for.
+ * @return The slot index.
+ */
+static size_t findSlot(const SideTable *table, const void *key)
+{
+    size_t mask = table->capacity - 1;
+    size_t slot = slotFor(key, table->capacity);
+    while (table->keys[slot] && table->keys[slot] != key)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+/**
+ * Doubles the capacity of a table and reinserts its entries.
+ * @param table The side table. Must be locked.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool growTable(SideTable *table)
+{
+    size_t newCapacity = table->capacity ? table->capacity * 2 : INITIAL_CAPACITY;
+    const void **keys = calloc(newCapacity, sizeof(void *));
+    void **values = calloc(newCapacity, sizeof(void *));
+    if (!keys || !values)
+    {
+        free(keys);
+        free(values);
+        return false;
+    }
+
+    const void **oldKeys = table->keys;
+    void **oldValues = table->values;
+    size_t oldCapacity = table->capacity;
+    table->keys = keys;
+    table->values = values;
+    table->capacity = newCapacity;
+    for (size_t i = 0; i < oldCapacity; i++)
+    {
+        if (oldKeys[i])
+        {
+            size_t slot = findSlot(table, oldKeys[i]);
+            table->keys[slot] = oldKeys[i];
+            table->values[slot] = oldValues[i];
+        }
+    }
+    free(oldKeys);
+    free(oldValues);
+    return true;
+}
+
+/**
+ * Attaches a value to a key, replacing any value already attached.
+ * @param table The side table.
+ * @param key The object address.
+ * @param value The data to attach.
+ * @return true on success, false if memory allocation fails.
+ */
+bool sideTablePut(SideTable *table, const void *key, void *value)
+{
+    if (!key || !value)
+        return false;
+    pthread_mutex_lock(&table->lock);
+    size_t count = atomic_load(&table->count);
+    // Keep the load factor at or below one half so probe sequences stay short.
+    if ((count + 1) * 2 > table->capacity && !growTable(table))
+    {
+        pthread_mutex_unlock(&table->lock);
+        return false;
+    }
+    size_t slot = findSlot(table, key);
+    if (!table->keys[slot])
+    {
+        table->keys[slot] = key;
+        atomic_store(&table->count, count + 1);
+    }
+    table->values[slot] = value;
+    pthread_mutex_unlock(&table->lock);
+    return true;
+}
+
+/**
+ * Looks up the value attached to a key.
+ * @param table The side table.
+ * @param key The object address.
+ * @return The attached value, or NULL if there is none.
+ */
+void *sideTableGet(SideTable *table, const void *key)
+{
+    if (!key || atomic_load(&table->count) == 0)
+        return NULL;
+    pthread_mutex_lock(&table->lock);
+    void *value = NULL;
+    if (table->capacity)
+    {
+        size_t slot = findSlot(table, key);
+        if (table->keys[slot])
+            value = table->values[slot];
+    }
+    pthread_mutex_unlock(&table->lock);
+    return value;
+}
+
+/**
+ * Detaches the value attached to a key. The entries that follow it in its probe
+ * sequence are shifted back, so no tombstones are left behind.
+ * @param table The side table.
+ * @param key The object address.
+ * @return The value that was attached, or NULL if there was none.
+ */
+void *sideTableRemove(SideTable *table, const void *key)
+{
+    if (!key || atomic_load(&table->count) == 0)
+        return NULL;
+    pthread_mutex_lock(&table->lock);
+    void *value = NULL;
+    if (table->capacity)
+    {
+        size_t mask = table->capacity - 1;
+        size_t slot = findSlot(table, key);
+        if (table->keys[slot])
+        {
+            value = table->values[slot];
+            table->keys[slot] = NULL;
+            table->values[slot] = NULL;
+            atomic_store(&table->count, atomic_load(&table->count) - 1);
+
+            // Backward-shift deletion: move later entries into the hole when their
+            // home slot does not lie between the hole and their current slot.
+            size_t hole = slot;
+            size_t next = (slot + 1) & mask;
+            while (table->keys[next])
+            {
+                size_t home = slotFor(table->keys[next], table->capacity);
+                bool movable = (next > hole) ? (home <= hole || home > next)
+                                             : (home <= hole && home > next);
+                if (movable)
+                {
+                    table->keys[hole] = table->keys[next];
+                    table->values[hole] = table->values[next];
+                    table->keys[next] = NULL;
+                    table->values[next] = NULL;
+                    hole = next;
+                }
+                next = (next + 1) & mask;
+            }
+        }
+    }
+    pthread_mutex_unlock(&table->lock);
+    return value;
+}
+
+/**
+ * Counts the entries of a table. The count is read atomically, so callers can skip
+ * work for an empty table without taking the lock.
+ * @param table The side table.
+ * @return The number of keys with a value attached.
+ */
+size_t sideTableSize(SideTable *table)
+{
+    return atomic_load(&table->count);
+}
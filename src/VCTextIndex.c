@@ -0,0 +1,889 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../include/VCFileFormat.h"
+#include "../include/VCParser.h"
+
+/*	Layout of a text index, in memory and on disk alike, all integers little-endian u32:
+	header        "VCTX", version, card count, term count, posting count, gram count,
+	              gram posting count, string length
+	cards         the string offset of the file name of each card
+	terms         per term, in byte order: string offset, first posting, posting count
+	postings      card numbers, ascending within each term
+	grams         per trigram, in byte order: its three bytes as an integer, first gram
+	              posting, gram posting count
+	gram postings term numbers, ascending within each trigram
+	strings       the NUL-terminated file names and terms
+
+	A query word of three or more bytes is looked up through its rarest trigram, whose
+	terms are then checked for the whole word; a shorter word is looked up as a prefix in
+	the sorted terms.
+*/
+#define TEXT_INDEX_MAGIC "VCTX"
+#define TEXT_INDEX_VERSION 2u
+#define TEXT_HEADER_SIZE 32u
+#define TERM_SIZE 12u
+#define GRAM_SIZE 12u
+#define GRAM_LENGTH 3u
+#define MAX_TERM_LENGTH 64u
+#define NO_TERM UINT32_MAX
+
+/*	A term of the index being built: its bytes in termBytes. */
+typedef struct termEntry
+{
+    uint32_t offset;
+    uint32_t length;
+} TermEntry;
+
+/*	A term and the position it sorts to, while the index is compiled. */
+typedef struct sortedTerm
+{
+    const char *bytes;
+    uint32_t term;
+} SortedTerm;
+
+/*	Growable byte buffer. */
+typedef struct byteBuffer
+{
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+} ByteBuffer;
+
+struct cardTextIndex
+{
+    // Cards added since the index was created. Empty for an index opened from a file.
+    pthread_mutex_t lock;
+    bool readOnly;
+    bool changed;
+    ByteBuffer names;
+    uint32_t *nameOffsets;
+    size_t cardsAdded;
+    size_t cardCapacity;
+    ByteBuffer termBytes;
+    TermEntry *termEntries;
+    size_t termEntryCount;
+    size_t termEntryCapacity;
+    uint32_t *slots;
+    size_t slotCapacity;
+    // (term, card) pairs in the order the cards were added.
+    uint32_t *pairs;
+    size_t pairCount;
+    size_t pairCapacity;
+
+    // The compiled image: a mapped file, or a buffer owned by the index.
+    unsigned char *data;
+    size_t length;
+    bool mapped;
+    uint32_t cardCount;
+    uint32_t termCount;
+    uint32_t postingCount;
+    uint32_t gramCount;
+    uint32_t gramPostingCount;
+    uint32_t stringLength;
+    const unsigned char *cards;
+    const unsigned char *terms;
+    const unsigned char *postings;
+    const unsigned char *grams;
+    const unsigned char *gramPostings;
+    const char *strings;
+};
+
+/**
+ * Makes room for more elements in a growable array, doubling its capacity as needed.
+ * @param data The array.
+ * @param capacity The capacity of the array, in elements.
+ * @param needed The number of elements the array must hold.
+ * @param size The size of one element.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool reserve(void **data, size_t *capacity, size_t needed, size_t size)
+{
+    if (needed <= *capacity)
+        return true;
+    size_t grown = *capacity ? *capacity : 64;
+    while (grown < needed)
+        grown *= 2;
+    void *array = realloc(*data, grown * size);
+    if (!array)
+        return false;
+    *data = array;
+    *capacity = grown;
+    return true;
+}
+
+static bool appendBytes(ByteBuffer *buffer, const void *bytes, size_t length)
+{
+    if (!reserve((void **)&buffer->data, &buffer->capacity, buffer->length + length, 1))
+        return false;
+    memcpy(buffer->data + buffer->length, bytes, length);
+    buffer->length += length;
+    return true;
+}
+
+/**
+ * Hashes a term with FNV-1a.
+ */
+static size_t hashTerm(const unsigned char *bytes, size_t length)
+{
+    size_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool isWordByte(unsigned char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+/**
+ * Reads the next word of a text: a run of ASCII letters and digits and non-ASCII bytes,
+ * with ASCII letters lowercased and accented Latin-1 letters folded to ASCII. Words
+ * longer than MAX_TERM_LENGTH bytes are cut.
+ * @param text The position to read from; advanced past the word.
+ * @param word Buffer of MAX_TERM_LENGTH + 1 bytes for the NUL-terminated word.
+ * @return The length of the word, or 0 at the end of the text.
+ */
+static size_t nextWord(const char **text, char *word)
+{
+    const unsigned char *c = (const unsigned char *)*text;
+    while (*c && !isWordByte(*c))
+        c++;
+    size_t length = 0;
+    for (; *c && isWordByte(*c); c++)
+    {
+        // Accented letters fold like the name index's keys, so "alv" finds "Álvarez".
+        const char *fold = foldLatinLetter(c);
+        if (fold)
+        {
+            for (; *fold && length < MAX_TERM_LENGTH; fold++)
+                word[length++] = *fold;
+            c++;
+        }
+        else if (length < MAX_TERM_LENGTH)
+            word[length++] = (char)((*c >= 'A' && *c <= 'Z') ? *c + 'a' - 'A' : *c);
+    }
+    word[length] = '\0';
+    *text = (const char *)c;
+    return length;
+}
+
+/**
+ * Adds the words of a value to a list of NUL-terminated terms.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool addWordTerms(ByteBuffer *list, const char *value)
+{
+    char word[MAX_TERM_LENGTH + 1];
+    size_t length;
+    while ((length = nextWord(&value, word)) > 0)
+    {
+        if (!appendBytes(list, word, length + 1))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Adds the digits of a telephone number, up to any URI parameters, to a list of terms as
+ * one term, so that any run of its digits can be found whatever the punctuation.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool addDigitTerm(ByteBuffer *list, const char *value)
+{
+    char digits[MAX_TERM_LENGTH + 1];
+    size_t length = 0;
+    for (const char *c = value; *c && *c != ';' && length < MAX_TERM_LENGTH; c++)
+    {
+        if (*c >= '0' && *c <= '9')
+            digits[length++] = *c;
+    }
+    digits[length] = '\0';
+    return length == 0 || appendBytes(list, digits, length + 1);
+}
+
+/**
+ * Collects the terms of the searchable properties of a card: the words of FN, N, ORG,
+ * NOTE and EMAIL values and the digits of TEL values.
+ * @param card The card.
+ * @param list Receives the NUL-terminated terms, with repeats.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool collectCardTerms(const Card *card, ByteBuffer *list)
+{
+    bool ok = true;
+    if (card->fn && card->fn->values)
+    {
+        ListIterator values = createIterator(card->fn->values);
+        char *value;
+        while (ok && (value = nextElement(&values)) != NULL)
+            ok = addWordTerms(list, value);
+    }
+    ListIterator properties = createIterator(card->optionalProperties);
+    Property *property;
+    while (ok && (property = nextElement(&properties)) != NULL)
+    {
+        if (!property->name || !property->values)
+            continue;
+        PropertyKind kind = propertyKind(property->name);
+        if (kind != PROP_FN && kind != PROP_N && kind != PROP_ORG && kind != PROP_NOTE &&
+            kind != PROP_EMAIL && kind != PROP_TEL)
+            continue;
+        ListIterator values = createIterator(property->values);
+        char *value;
+        while (ok && (value = nextElement(&values)) != NULL)
+            ok = kind == PROP_TEL ? addDigitTerm(list, value) : addWordTerms(list, value);
+    }
+    return ok;
+}
+
+/**
+ * Rehashes the term table of an index into twice as many slots.
+ * @return true on success, false if memory allocation fails.
+ */
+static bool growTermSlots(CardTextIndex *index)
+{
+    size_t capacity = index->slotCapacity ? index->slotCapacity * 2 : 1024;
+    uint32_t *slots = malloc(capacity * sizeof(uint32_t));
+    if (!slots)
+        return false;
+    memset(slots, 0xFF, capacity * sizeof(uint32_t));
+    for (size_t term = 0; term < index->termEntryCount; term++)
+    {
+        const TermEntry *entry = &index->termEntries[term];
+        size_t slot = hashTerm(index->termBytes.data + entry->offset, entry->length) & (capacity - 1);
+        while (slots[slot] != NO_TERM)
+            slot = (slot + 1) & (capacity - 1);
+        slots[slot] = (uint32_t)term;
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->slotCapacity = capacity;
+    return true;
+}
+
+/**
+ * Finds the number of a term of the index being built, adding the term if it is new.
+ * @return The term number, or NO_TERM if memory allocation fails.
+ */
+static uint32_t internTerm(CardTextIndex *index, const char *term, size_t length)
+{
+    if (index->termEntryCount * 2 >= index->slotCapacity && !growTermSlots(index))
+        return NO_TERM;
+    size_t mask = index->slotCapacity - 1;
+    size_t slot = hashTerm((const unsigned char *)term, length) & mask;
+    for (; index->slots[slot] != NO_TERM; slot = (slot + 1) & mask)
+    {
+        const TermEntry *entry = &index->termEntries[index->slots[slot]];
+        if (entry->length == length && memcmp(index->termBytes.data + entry->offset, term, length) == 0)
+            return index->slots[slot];
+    }
+    if (index->termEntryCount >= NO_TERM - 1 ||
+        !reserve((void **)&index->termEntries, &index->termEntryCapacity, index->termEntryCount + 1, sizeof(TermEntry)))
+        return NO_TERM;
+    TermEntry entry = {(uint32_t)index->termBytes.length, (uint32_t)length};
+    if (!appendBytes(&index->termBytes, term, length + 1))
+        return NO_TERM;
+    index->termEntries[index->termEntryCount] = entry;
+    index->slots[slot] = (uint32_t)index->termEntryCount;
+    return (uint32_t)index->termEntryCount++;
+}
+
+CardTextIndex *createCardTextIndex(void)
+{
+    CardTextIndex *index = calloc(1, sizeof(CardTextIndex));
+    if (!index)
+        return NULL;
+    if (pthread_mutex_init(&index->lock, NULL) != 0)
+    {
+        free(index);
+        return NULL;
+    }
+    index->changed = true;
+    return index;
+}
+
+/**
+ * Adds the terms of a card to an index. The card is tokenized before the index is
+ * locked, so cards can be added from several threads at once, e.g. from the callback
+ * of scanCardDirectory.
+ * @param index The index, created by createCardTextIndex.
+ * @param fileName The name reported for the card by queries.
+ * @param card The card.
+ * @return OK on success, INV_CARD if card is NULL, INV_FILE for other invalid arguments
+ *         or a read-only index, or OTHER_ERROR if memory allocation fails or the index
+ *         is full.
+ */
+VCardErrorCode addCardToTextIndex(CardTextIndex *index, const char *fileName, const Card *card)
+{
+    if (!card)
+        return INV_CARD;
+    if (!index || !fileName || index->readOnly)
+        return INV_FILE;
+    ByteBuffer list = {NULL, 0, 0};
+    if (!collectCardTerms(card, &list))
+    {
+        free(list.data);
+        return OTHER_ERROR;
+    }
+
+    pthread_mutex_lock(&index->lock);
+    size_t cardNumber = index->cardsAdded;
+    size_t namesLength = index->names.length;
+    size_t terms = 0;
+    for (size_t at = 0; at < list.length; at += strlen((const char *)list.data + at) + 1)
+        terms++;
+    bool ok = cardNumber < NO_TERM && index->names.length + strlen(fileName) + 1 < UINT32_MAX &&
+              reserve((void **)&index->nameOffsets, &index->cardCapacity, cardNumber + 1, sizeof(uint32_t)) &&
+              reserve((void **)&index->pairs, &index->pairCapacity, index->pairCount + 2 * terms, sizeof(uint32_t));
+    if (ok)
+    {
+        index->nameOffsets[cardNumber] = (uint32_t)index->names.length;
+        ok = appendBytes(&index->names, fileName, strlen(fileName) + 1);
+    }
+    size_t pairCount = index->pairCount;
+    for (size_t at = 0; ok && at < list.length;)
+    {
+        const char *term = (const char *)list.data + at;
+        size_t length = strlen(term);
+        uint32_t number = internTerm(index, term, length);
+        ok = number != NO_TERM;
+        index->pairs[pairCount++] = number;
+        index->pairs[pairCount++] = (uint32_t)cardNumber;
+        at += length + 1;
+    }
+    // A card that could not be added completely is left out; its new terms stay unused.
+    if (ok)
+    {
+        index->pairCount = pairCount;
+        index->cardsAdded++;
+        index->changed = true;
+    }
+    else
+        index->names.length = namesLength;
+    pthread_mutex_unlock(&index->lock);
+    free(list.data);
+    return ok ? OK : OTHER_ERROR;
+}
+
+/**
+ * Points the sections of an index at an image and checks that the header and section
+ * sizes are consistent. Entries are checked as queries reach them, so a damaged file
+ * cannot make a query read outside the image.
+ * @param index The index.
+ * @param data The image.
+ * @param length The length of the image.
+ * @return true if the image is a valid text index.
+ */
+static bool attachImage(CardTextIndex *index, unsigned char *data, size_t length)
+{
+    if (length < TEXT_HEADER_SIZE + 1 || memcmp(data, TEXT_INDEX_MAGIC, 4) != 0 ||
+        loadU32(data + 4) != TEXT_INDEX_VERSION || data[length - 1] != '\0')
+        return false;
+    uint32_t cardCount = loadU32(data + 8);
+    uint32_t termCount = loadU32(data + 12);
+    uint32_t postingCount = loadU32(data + 16);
+    uint32_t gramCount = loadU32(data + 20);
+    uint32_t gramPostingCount = loadU32(data + 24);
+    uint32_t stringLength = loadU32(data + 28);
+    uint64_t expected = (uint64_t)TEXT_HEADER_SIZE + 4 * (uint64_t)cardCount + TERM_SIZE * (uint64_t)termCount +
+                        4 * (uint64_t)postingCount + GRAM_SIZE * (uint64_t)gramCount +
+                        4 * (uint64_t)gramPostingCount + stringLength;
+    if (expected != length || stringLength == 0)
+        return false;
+
+    index->data = data;
+    index->length = length;
+    index->cardCount = cardCount;
+    index->termCount = termCount;
+    index->postingCount = postingCount;
+    index->gramCount = gramCount;
+    index->gramPostingCount = gramPostingCount;
+    index->stringLength = stringLength;
+    index->cards = data + TEXT_HEADER_SIZE;
+    index->terms = index->cards + 4 * (size_t)cardCount;
+    index->postings = index->terms + TERM_SIZE * (size_t)termCount;
+    index->grams = index->postings + 4 * (size_t)postingCount;
+    index->gramPostings = index->grams + GRAM_SIZE * (size_t)gramCount;
+    index->strings = (const char *)(index->gramPostings + 4 * (size_t)gramPostingCount);
+    return true;
+}
+
+static int compareSortedTerms(const void *first, const void *second)
+{
+    return strcmp(((const SortedTerm *)first)->bytes, ((const SortedTerm *)second)->bytes);
+}
+
+static int compareGramPairs(const void *first, const void *second)
+{
+    uint64_t a = *(const uint64_t *)first;
+    uint64_t b = *(const uint64_t *)second;
+    return (a > b) - (a < b);
+}
+
+static uint32_t gramKey(const unsigned char *bytes)
+{
+    return (uint32_t)bytes[0] << 16 | (uint32_t)bytes[1] << 8 | bytes[2];
+}
+
+/*	Working arrays of compileTextIndex. */
+typedef struct textCompile
+{
+    SortedTerm *sorted;
+    uint32_t *rank;
+    uint32_t *firstPosting;
+    uint32_t *lastCard;
+    uint64_t *gramPairs;
+    unsigned char *image;
+} TextCompile;
+
+/**
+ * Counts the postings of every term, leaving out repeats of a term within one card, and
+ * turns the counts into the first posting of each term in sorted order.
+ * @return The number of postings.
+ */
+static size_t countPostings(const CardTextIndex *index, TextCompile *work)
+{
+    size_t terms = index->termEntryCount;
+    memset(work->firstPosting, 0, (terms + 1) * sizeof(uint32_t));
+    memset(work->lastCard, 0xFF, terms * sizeof(uint32_t));
+    for (size_t pair = 0; pair < index->pairCount; pair += 2)
+    {
+        uint32_t term = index->pairs[pair];
+        if (work->lastCard[term] != index->pairs[pair + 1])
+        {
+            work->lastCard[term] = index->pairs[pair + 1];
+            work->firstPosting[work->rank[term] + 1]++;
+        }
+    }
+    for (size_t term = 0; term < terms; term++)
+        work->firstPosting[term + 1] += work->firstPosting[term];
+    return work->firstPosting[terms];
+}
+
+/**
+ * Collects the distinct (trigram, term) pairs of the sorted terms, sorted.
+ * @return The number of pairs.
+ */
+static size_t collectGrams(const CardTextIndex *index, TextCompile *work)
+{
+    size_t count = 0;
+    for (size_t term = 0; term < index->termEntryCount; term++)
+    {
+        const unsigned char *bytes = (const unsigned char *)work->sorted[term].bytes;
+        size_t length = index->termEntries[work->sorted[term].term].length;
+        for (size_t at = 0; at + GRAM_LENGTH <= length; at++)
+            work->gramPairs[count++] = (uint64_t)gramKey(bytes + at) << 32 | term;
+    }
+    qsort(work->gramPairs, count, sizeof(uint64_t), compareGramPairs);
+    size_t unique = 0;
+    for (size_t pair = 0; pair < count; pair++)
+    {
+        if (unique == 0 || work->gramPairs[unique - 1] != work->gramPairs[pair])
+            work->gramPairs[unique++] = work->gramPairs[pair];
+    }
+    return unique;
+}
+
+/**
+ * Writes the image of an index from the cards added to it.
+ * @return The length of the image, or 0 if memory allocation fails or the index is too
+ *         large for its 32-bit offsets.
+ */
+static size_t writeImage(const CardTextIndex *index, TextCompile *work, size_t postings, size_t gramPairs)
+{
+    size_t terms = index->termEntryCount;
+    size_t cards = index->cardsAdded;
+    size_t grams = 0;
+    for (size_t pair = 0; pair < gramPairs; pair++)
+        grams += pair == 0 || work->gramPairs[pair] >> 32 != work->gramPairs[pair - 1] >> 32;
+    size_t stringLength = index->names.length + index->termBytes.length + 1;
+    uint64_t length = (uint64_t)TEXT_HEADER_SIZE + 4 * (uint64_t)cards + TERM_SIZE * (uint64_t)terms +
+                      4 * (uint64_t)postings + GRAM_SIZE * (uint64_t)grams + 4 * (uint64_t)gramPairs + stringLength;
+    if (length > UINT32_MAX || !(work->image = malloc((size_t)length)))
+        return 0;
+
+    unsigned char *out = work->image;
+    memcpy(out, TEXT_INDEX_MAGIC, 4);
+    uint32_t header[7] = {TEXT_INDEX_VERSION, (uint32_t)cards, (uint32_t)terms, (uint32_t)postings,
+                          (uint32_t)grams, (uint32_t)gramPairs, (uint32_t)stringLength};
+    for (int field = 0; field < 7; field++)
+        storeU32(out + 4 + 4 * field, header[field]);
+    unsigned char *cardTable = out + TEXT_HEADER_SIZE;
+    unsigned char *termTable = cardTable + 4 * cards;
+    unsigned char *postingTable = termTable + TERM_SIZE * terms;
+    unsigned char *gramTable = postingTable + 4 * postings;
+    unsigned char *gramPostingTable = gramTable + GRAM_SIZE * grams;
+    unsigned char *strings = gramPostingTable + 4 * gramPairs;
+
+    // The file names come first in the strings, then the terms in sorted order.
+    for (size_t card = 0; card < cards; card++)
+        storeU32(cardTable + 4 * card, index->nameOffsets[card]);
+    memcpy(strings, index->names.data, index->names.length);
+    size_t stringOffset = index->names.length;
+    for (size_t term = 0; term < terms; term++)
+    {
+        size_t termLength = index->termEntries[work->sorted[term].term].length + 1;
+        memcpy(strings + stringOffset, work->sorted[term].bytes, termLength);
+        storeU32(termTable + TERM_SIZE * term, (uint32_t)stringOffset);
+        storeU32(termTable + TERM_SIZE * term + 4, work->firstPosting[term]);
+        storeU32(termTable + TERM_SIZE * term + 8, work->firstPosting[term + 1] - work->firstPosting[term]);
+        stringOffset += termLength;
+    }
+    strings[stringOffset] = '\0';
+
+    // Cards were added in order, so each term's postings come out ascending.
+    memset(work->lastCard, 0xFF, terms * sizeof(uint32_t));
+    for (size_t pair = 0; pair < index->pairCount; pair += 2)
+    {
+        uint32_t term = index->pairs[pair];
+        uint32_t card = index->pairs[pair + 1];
+        if (work->lastCard[term] != card)
+        {
+            work->lastCard[term] = card;
+            storeU32(postingTable + 4 * (size_t)work->firstPosting[work->rank[term]]++, card);
+        }
+    }
+
+    size_t gram = 0;
+    for (size_t pair = 0; pair < gramPairs; pair++)
+    {
+        uint32_t key = (uint32_t)(work->gramPairs[pair] >> 32);
+        if (pair == 0 || key != (uint32_t)(work->gramPairs[pair - 1] >> 32))
+        {
+            storeU32(gramTable + GRAM_SIZE * gram, key);
+            storeU32(gramTable + GRAM_SIZE * gram + 4, (uint32_t)pair);
+            storeU32(gramTable + GRAM_SIZE * gram + 8, 0);
+            gram++;
+        }
+        unsigned char *count = gramTable + GRAM_SIZE * (gram - 1) + 8;
+        storeU32(count, loadU32(count) + 1);
+        storeU32(gramPostingTable + 4 * pair, (uint32_t)work->gramPairs[pair]);
+    }
+    return (size_t)length;
+}
+
+/**
+ * Compiles the cards added to an index into its image, unless they are compiled already.
+ * @param index The index.
+ * @return true on success, false if memory allocation fails or the index is too large.
+ */
+static bool compileTextIndex(CardTextIndex *index)
+{
+    if (!index->changed)
+        return true;
+    size_t terms = index->termEntryCount;
+    size_t gramCount = 0;
+    for (size_t term = 0; term < terms; term++)
+        gramCount += index->termEntries[term].length >= GRAM_LENGTH ? index->termEntries[term].length - GRAM_LENGTH + 1 : 0;
+
+    TextCompile work = {0};
+    work.sorted = malloc((terms + 1) * sizeof(SortedTerm));
+    work.rank = malloc((terms + 1) * sizeof(uint32_t));
+    work.firstPosting = malloc((terms + 1) * sizeof(uint32_t));
+    work.lastCard = malloc((terms + 1) * sizeof(uint32_t));
+    work.gramPairs = malloc((gramCount + 1) * sizeof(uint64_t));
+    size_t length = 0;
+    if (work.sorted && work.rank && work.firstPosting && work.lastCard && work.gramPairs)
+    {
+        for (size_t term = 0; term < terms; term++)
+            work.sorted[term] = (SortedTerm){(const char *)index->termBytes.data + index->termEntries[term].offset, (uint32_t)term};
+        qsort(work.sorted, terms, sizeof(SortedTerm), compareSortedTerms);
+        for (size_t term = 0; term < terms; term++)
+            work.rank[work.sorted[term].term] = (uint32_t)term;
+        size_t postings = countPostings(index, &work);
+        size_t gramPairs = collectGrams(index, &work);
+        length = writeImage(index, &work, postings, gramPairs);
+    }
+    free(work.sorted);
+    free(work.rank);
+    free(work.firstPosting);
+    free(work.lastCard);
+    free(work.gramPairs);
+    if (length == 0)
+    {
+        free(work.image);
+        return false;
+    }
+    free(index->data);
+    attachImage(index, work.image, length);
+    index->changed = false;
+    return true;
+}
+
+/**
+ * Writes a text index to a file, compiling it first if cards were added since it was
+ * last compiled. The file is written under a temporary name and renamed into place.
+ * @param index The index.
+ * @param indexFileName The file to create or replace.
+ * @return OK on success, INV_FILE for invalid arguments, WRITE_ERROR if the file cannot
+ *         be written, or OTHER_ERROR if memory allocation fails.
+ */
+VCardErrorCode writeCardTextIndex(CardTextIndex *index, const char *indexFileName)
+{
+    if (!index || !indexFileName)
+        return INV_FILE;
+    if (!compileTextIndex(index))
+        return OTHER_ERROR;
+    return replaceFile(indexFileName, index->data, index->length, NULL, 0) ? OK : WRITE_ERROR;
+}
+
+/**
+ * Maps a text index file for queries. Cards cannot be added to it.
+ * @param indexFileName The index file.
+ * @return The index, or NULL if the file cannot be read, is not a valid text index or
+ *         memory allocation fails.
+ */
+CardTextIndex *openCardTextIndex(const char *indexFileName)
+{
+    if (!indexFileName)
+        return NULL;
+    int fd = open(indexFileName, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || (size_t)info.st_size <= TEXT_HEADER_SIZE)
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t length = (size_t)info.st_size;
+    unsigned char *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+    CardTextIndex *index = createCardTextIndex();
+    if (!index || !attachImage(index, data, length))
+    {
+        munmap(data, length);
+        if (index)
+            pthread_mutex_destroy(&index->lock);
+        free(index);
+        return NULL;
+    }
+    index->readOnly = true;
+    index->mapped = true;
+    index->changed = false;
+    return index;
+}
+
+/**
+ * Finds a term of a compiled index.
+ * @return The NUL-terminated term, or NULL if its entry is damaged.
+ */
+static const char *termString(const CardTextIndex *index, uint32_t term)
+{
+    uint32_t offset = loadU32(index->terms + TERM_SIZE * (size_t)term);
+    return offset < index->stringLength ? index->strings + offset : NULL;
+}
+
+/**
+ * Marks the cards of one term in a bitmap of cards.
+ * @return false if the postings of the term are damaged.
+ */
+static bool markTermCards(const CardTextIndex *index, uint32_t term, uint64_t *cards)
+{
+    const unsigned char *entry = index->terms + TERM_SIZE * (size_t)term;
+    uint32_t first = loadU32(entry + 4);
+    uint32_t count = loadU32(entry + 8);
+    if (first > index->postingCount || count > index->postingCount - first)
+        return false;
+    for (uint32_t posting = first; posting < first + count; posting++)
+    {
+        uint32_t card = loadU32(index->postings + 4 * (size_t)posting);
+        if (card >= index->cardCount)
+            return false;
+        cards[card / 64] |= (uint64_t)1 << (card % 64);
+    }
+    return true;
+}
+
+/**
+ * Marks the cards that have a term beginning with a word, through a binary search of the
+ * sorted terms.
+ * @return false if the index is damaged.
+ */
+static bool markPrefixCards(const CardTextIndex *index, const char *word, size_t length, uint64_t *cards)
+{
+    uint32_t low = 0, high = index->termCount;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        const char *term = termString(index, middle);
+        if (!term)
+            return false;
+        if (strcmp(term, word) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    for (uint32_t term = low; term < index->termCount; term++)
+    {
+        const char *bytes = termString(index, term);
+        if (!bytes)
+            return false;
+        if (strncmp(bytes, word, length) != 0)
+            break;
+        if (!markTermCards(index, term, cards))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Finds the gram postings of a trigram through a binary search of the gram table.
+ * @param first Set to the first gram posting.
+ * @param count Set to the number of gram postings, 0 if the trigram is not indexed.
+ * @return false if the entry of the trigram is damaged.
+ */
+static bool findGram(const CardTextIndex *index, uint32_t key, uint32_t *first, uint32_t *count)
+{
+    uint32_t low = 0, high = index->gramCount;
+    *count = 0;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        const unsigned char *entry = index->grams + GRAM_SIZE * (size_t)middle;
+        uint32_t found = loadU32(entry);
+        if (found == key)
+        {
+            *first = loadU32(entry + 4);
+            *count = loadU32(entry + 8);
+            return *first <= index->gramPostingCount && *count <= index->gramPostingCount - *first;
+        }
+        if (found < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return true;
+}
+
+/**
+ * Marks the cards that have a term containing a word of at least GRAM_LENGTH bytes. The
+ * terms holding the word's rarest trigram are the candidates, and each is checked for
+ * the whole word.
+ * @return false if the index is damaged.
+ */
+static bool markSubstringCards(const CardTextIndex *index, const char *word, size_t length, uint64_t *cards)
+{
+    uint32_t bestFirst = 0, bestCount = UINT32_MAX;
+    for (size_t at = 0; at + GRAM_LENGTH <= length; at++)
+    {
+        uint32_t first, count;
+        if (!findGram(index, gramKey((const unsigned char *)word + at), &first, &count))
+            return false;
+        if (count == 0)
+            return true;
+        if (count < bestCount)
+        {
+            bestFirst = first;
+            bestCount = count;
+        }
+    }
+    for (uint32_t posting = bestFirst; posting < bestFirst + bestCount; posting++)
+    {
+        uint32_t term = loadU32(index->gramPostings + 4 * (size_t)posting);
+        if (term >= index->termCount)
+            return false;
+        const char *bytes = termString(index, term);
+        if (!bytes)
+            return false;
+        if (strstr(bytes, word) && !markTermCards(index, term, cards))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Reports the cards of a text index that match every word of a query, in the order the
+ * cards were added. A word of three or more bytes matches any indexed term that contains
+ * it; a shorter word matches the terms it begins. Words are split and lowercased as the
+ * indexed values are, so "Smi", "example.com" and "555-0123" all work.
+ * @param index The index. If cards were added since it was last compiled, it is compiled.
+ * @param query The words to look for.
+ * @param callback Function receiving the file name of each matching card.
+ * @param userData Caller data passed through to the callback.
+ * @return The number of cards reported, or -1 for invalid arguments, a damaged index or
+ *         a memory allocation failure.
+ */
+int findCardsByText(CardTextIndex *index, const char *query, TextMatchCallback callback, void *userData)
+{
+    if (!index || !query || !callback || !compileTextIndex(index))
+        return -1;
+    size_t bitmapWords = (index->cardCount + 63) / 64;
+    uint64_t *matches = calloc(bitmapWords + 1, sizeof(uint64_t));
+    uint64_t *wordMatches = malloc((bitmapWords + 1) * sizeof(uint64_t));
+    bool ok = matches && wordMatches;
+    bool first = true;
+    char word[MAX_TERM_LENGTH + 1];
+    size_t length;
+    while (ok && (length = nextWord(&query, word)) > 0)
+    {
+        memset(wordMatches, 0, bitmapWords * sizeof(uint64_t));
+        ok = length >= GRAM_LENGTH ? markSubstringCards(index, word, length, wordMatches)
+                                   : markPrefixCards(index, word, length, wordMatches);
+        for (size_t i = 0; ok && i < bitmapWords; i++)
+            matches[i] = first ? wordMatches[i] : matches[i] & wordMatches[i];
+        first = false;
+    }
+
+    int reported = 0;
+    bool more = true;
+    for (size_t i = 0; ok && more && i < bitmapWords; i++)
+    {
+        for (uint64_t bits = matches[i]; more && bits; bits &= bits - 1)
+        {
+            size_t card = 64 * i + (size_t)__builtin_ctzll(bits);
+            uint32_t offset = loadU32(index->cards + 4 * card);
+            if (offset >= index->stringLength)
+            {
+                ok = false;
+                break;
+            }
+            reported++;
+            more = callback(index->strings + offset, userData);
+        }
+    }
+    free(matches);
+    free(wordMatches);
+    return ok ? reported : -1;
+}
+
+/**
+ * Releases a text index, unmapping its file if it was opened from one.
+ * @param index The index. May be NULL.
+ */
+void closeCardTextIndex(CardTextIndex *index)
+{
+    if (!index)
+        return;
+    if (index->mapped)
+        munmap(index->data, index->length);
+    else
+        free(index->data);
+    free(index->names.data);
+    free(index->nameOffsets);
+    free(index->termBytes.data);
+    free(index->termEntries);
+    free(index->slots);
+    free(index->pairs);
+    pthread_mutex_destroy(&index->lock);
+    free(index);
+}
@@ -0,0 +1,200 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../include/VCThreadPool.h"
+
+/*	Range of item indices owned by one worker, [next, end). The owner takes items from
+	the front and thieves take them from the back. Each range sits on its own cache line
+	so that workers do not slow each other down by touching neighbouring ranges.
+*/
+typedef struct workRange
+{
+    alignas(64) pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+} WorkRange;
+
+typedef struct workPool
+{
+    WorkRange *ranges;
+    size_t workers;
+    WorkItemFunction run;
+    void *context;
+    atomic_bool stopped;
+} WorkPool;
+
+typedef struct workerStart
+{
+    WorkPool *pool;
+    size_t self;
+} WorkerStart;
+
+/**
+ * Takes the next item from the front of a worker's own range.
+ * @param range The worker's range.
+ * @param index Set to the item taken.
+ * @return true if an item was taken, false if the range is empty.
+ */
+static bool takeOwnItem(WorkRange *range, size_t *index)
+{
+    pthread_mutex_lock(&range->lock);
+    bool found = range->next < range->end;
+    if (found)
+        *index = range->next++;
+    pthread_mutex_unlock(&range->lock);
+    return found;
+}
+
+/**
+ * Steals the upper half of the remaining items of another worker and makes them the
+ * thief's own range. Victims are tried in turn, starting after the thief.
+ * @param pool The pool.
+ * @param self The thief's worker number. Its own range must be empty.
+ * @return true if items were stolen, false if every other range is empty.
+ */
+static bool stealItems(WorkPool *pool, size_t self)
+{
+    for (size_t offset = 1; offset < pool->workers; offset++)
+    {
+        WorkRange *victim = &pool->ranges[(self + offset) % pool->workers];
+        pthread_mutex_lock(&victim->lock);
+        size_t remaining = victim->end - victim->next;
+        size_t end = victim->end;
+        size_t start = end - (remaining + 1) / 2;
+        if (remaining > 0)
+            victim->end = start;
+        pthread_mutex_unlock(&victim->lock);
+        if (remaining == 0)
+            continue;
+
+        // The stolen items are invisible to other thieves until they are published
+        // here, but no item is lost: only this worker can run them in the meantime.
+        WorkRange *own = &pool->ranges[self];
+        pthread_mutex_lock(&own->lock);
+        own->next = start;
+        own->end = end;
+        pthread_mutex_unlock(&own->lock);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Runs items until neither the worker's own range nor any other range has work left,
+ * or until a task stops the batch.
+ * @param pool The pool.
+ * @param self The worker number.
+ */
+static void runWorker(WorkPool *pool, size_t self)
+{
+    size_t index;
+    while (!atomic_load_explicit(&pool->stopped, memory_order_relaxed))
+    {
+        if (!takeOwnItem(&pool->ranges[self], &index))
+        {
+            if (!stealItems(pool, self))
+                return;
+            continue;
+        }
+        if (!pool->run(index, pool->context))
+            atomic_store(&pool->stopped, true);
+    }
+}
+
+/**
+ * Entry point of a pool thread.
+ * @param arg The WorkerStart of the thread.
+ * @return NULL.
+ */
+static void *workerThread(void *arg)
+{
+    WorkerStart *start = arg;
+    runWorker(start->pool, start->self);
+    return NULL;
+}
+
+/**
+ * Reports how many workers a batch uses by default.
+ * @return The number of online CPUs, or 1 if it cannot be determined.
+ */
+size_t defaultWorkerCount(void)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (size_t)cpus : 1;
+}
+
+/**
+ * Runs a task on every item of a batch with a pool of work-stealing threads. The calling
+ * thread is worker 0; if a thread cannot be created, the range it was given is stolen
+ * by the workers that did start.
+ * @param count The number of items.
+ * @param workers The number of workers, or 0 for one per online CPU.
+ * @param run The task to run for each item.
+ * @param context Caller data passed through to each task.
+ * @return true if every item ran, false if a task stopped the batch.
+ */
+bool runWorkStealing(size_t count, size_t workers, WorkItemFunction run, void *context)
+{
+    if (workers == 0)
+        workers = defaultWorkerCount();
+    if (workers > count)
+        workers = count;
+
+    WorkRange *ranges = NULL;
+    pthread_t *threads = NULL;
+    WorkerStart *starts = NULL;
+    if (workers > 1)
+    {
+        ranges = aligned_alloc(alignof(WorkRange), workers * sizeof(WorkRange));
+        threads = malloc((workers - 1) * sizeof(pthread_t));
+        starts = malloc((workers - 1) * sizeof(WorkerStart));
+    }
+    if (!ranges || !threads || !starts)
+    {
+        // Too small to share, or no memory for the pool: run the batch on this thread.
+        free(ranges);
+        free(threads);
+        free(starts);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!run(i, context))
+                return false;
+        }
+        return true;
+    }
+
+    WorkPool pool = {ranges, workers, run, context, false};
+    for (size_t w = 0; w < workers; w++)
+    {
+        pthread_mutex_init(&ranges[w].lock, NULL);
+        ranges[w].next = count * w / workers;
+        ranges[w].end = count * (w + 1) / workers;
+    }
+
+    size_t started = 0;
+    for (size_t w = 1; w < workers; w++)
+    {
+        starts[started] = (WorkerStart){&pool, w};
+        if (pthread_create(&threads[started], NULL, workerThread, &starts[started]) == 0)
+            started++;
+    }
+    runWorker(&pool, 0);
+    for (size_t t = 0; t < started; t++)
+        pthread_join(threads[t], NULL);
+
+    for (size_t w = 0; w < workers; w++)
+        pthread_mutex_destroy(&ranges[w].lock);
+    free(ranges);
+    free(threads);
+    free(starts);
+    return !atomic_load(&pool.stopped);
+}
@@ -0,0 +1,550 @@
+// Name: Danial Changez
+// Student #: 1232341
+// Class: CIS*2750
+
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../include/VCParser.h"
+/*
+ * Regression checks for the parser library. Fixtures live in testFiles/checks.
+ * Usage (from the repository root):
+ *   make check
+ */
+
+#define FORMAT_FIXTURES 3
+
+static const char *const formatFixtures[FORMAT_FIXTURES] = {
+    "testFiles/checks/full.vcf", "testFiles/checks/reordered.vcf", "testFiles/checks/yearless.vcf"};
+
+/*	Fingerprints of the format fixtures. full.vcf and reordered.vcf hold the same card.
+	A change to these values invalidates every stored fingerprint and cache.
+*/
+static const CardFingerprint fixtureFingerprints[FORMAT_FIXTURES] = {
+    {0x47ed47726ebc0c72u, 0xf173d12785a844b2u},
+    {0x47ed47726ebc0c72u, 0xf173d12785a844b2u},
+    {0xc5583bc2f2b0fca3u, 0xcf6177dad05f6ce2u}};
+
+static int failures = 0;
+
+#define CHECK(cond) check((cond), #cond, __func__, __LINE__)
+
+/**
+ * Records the outcome of one check, printing it if it failed.
+ * @param ok Whether the check passed.
+ * @param what The text of the checked condition.
+ * @param test The name of the test function.
+ * @param line The line of the check.
+ * @return ok.
+ */
+static bool check(bool ok, const char *what, const char *test, int line)
+{
+    if (!ok)
+    {
+        printf("FAIL %s:%d: %s\n", test, line, what);
+        failures++;
+    }
+    return ok;
+}
+
+/**
+ * Creates a heap Property with one value and no group or parameters.
+ * @param name The property name.
+ * @param value The value.
+ * @return The Property, owned by the caller.
+ */
+static Property *makeProperty(const char *name, const char *value)
+{
+    Property *prop = malloc(sizeof(Property));
+    prop->name = strcpy(malloc(strlen(name) + 1), name);
+    prop->group = calloc(1, 1);
+    prop->parameters = initializeList(&parameterToString, &deleteParameter, &compareParameters);
+    prop->values = initializeList(&valueToString, &deleteValue, &compareValues);
+    insertBack(prop->values, strcpy(malloc(strlen(value) + 1), value));
+    return prop;
+}
+
+/**
+ * Reads a whole file.
+ * @param fileName The file.
+ * @param length Set to the length of the file.
+ * @return The contents, owned by the caller, or NULL if the file cannot be read.
+ */
+static char *readWholeFile(const char *fileName, size_t *length)
+{
+    FILE *file = fopen(fileName, "rb");
+    if (!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    char *data = malloc(size > 0 ? (size_t)size : 1);
+    *length = size > 0 ? fread(data, 1, (size_t)size, file) : 0;
+    fclose(file);
+    return data;
+}
+
+/**
+ * Writes a whole file.
+ * @param fileName The file to create or replace.
+ * @param data The contents.
+ * @param length The length of the contents.
+ */
+static void writeWholeFile(const char *fileName, const char *data, size_t length)
+{
+    FILE *file = fopen(fileName, "wb");
+    if (file)
+    {
+        fwrite(data, 1, length, file);
+        fclose(file);
+    }
+}
+
+/**
+ * Builds the name of a file in a directory.
+ * @param dirName The directory.
+ * @param name The file name.
+ * @return The path, owned by the caller.
+ */
+static char *joinPath(const char *dirName, const char *name)
+{
+    char *path = malloc(strlen(dirName) + strlen(name) + 2);
+    sprintf(path, "%s/%s", dirName, name);
+    return path;
+}
+
+/**
+ * Compares the vCard text of two Cards.
+ * @param first The first Card.
+ * @param second The second Card.
+ * @return true if both Cards serialize to the same text.
+ */
+static bool sameCardText(const Card *first, const Card *second)
+{
+    char *firstText = cardToFileString(first);
+    char *secondText = cardToFileString(second);
+    bool same = firstText && secondText && strcmp(firstText, secondText) == 0;
+    free(firstText);
+    free(secondText);
+    return same;
+}
+
+/**
+ * Copies the format fixtures into a directory.
+ * @param dirName The directory.
+ * @param paths Set to the paths of the copies, owned by the caller.
+ */
+static void copyFormatFixtures(const char *dirName, char *paths[FORMAT_FIXTURES])
+{
+    for (int i = 0; i < FORMAT_FIXTURES; i++)
+    {
+        size_t length = 0;
+        char *data = readWholeFile(formatFixtures[i], &length);
+        paths[i] = joinPath(dirName, strrchr(formatFixtures[i], '/') + 1);
+        writeWholeFile(paths[i], data, length);
+        free(data);
+    }
+}
+
+/**
+ * A property replaced in the middle of the list keeps the ends and the length of the list,
+ * so the index only notices it through invalidatePropertyIndex.
+ */
+static void testPropertyIndexInteriorEdit(void)
+{
+    Card *card = NULL;
+    if (!CHECK(createCard("testFiles/checks/notes.vcf", &card) == OK))
+        return;
+    const ArrayList *notes = getPropertiesByName(card, "NOTE");
+    CHECK(notes && notes->length == 2);
+
+    // The first NOTE sits between EMAIL and URL; ORG sorts in right after EMAIL.
+    Property *first = getPropertyByName(card, "NOTE");
+    Property *removed = deleteDataFromList(card->optionalProperties, first);
+    CHECK(removed == first);
+    deleteProperty(removed);
+    Property *added = makeProperty("ORG", "Viagenie");
+    insertSorted(card->optionalProperties, added);
+    invalidatePropertyIndex(card);
+
+    notes = getPropertiesByName(card, "NOTE");
+    CHECK(notes && notes->length == 1);
+    CHECK(getPropertyByName(card, "ORG") == added);
+    Property *second = getPropertyByName(card, "NOTE");
+    CHECK(second && strcmp(getFromFront(second->values), "second note") == 0);
+
+    // addProperty and removeProperty keep the index current on their own.
+    Property *note = makeProperty("NOTE", "third note");
+    CHECK(addProperty(card, note) == OK);
+    notes = getPropertiesByName(card, "NOTE");
+    CHECK(notes && notes->length == 2 && getArrayElement(notes, 1) == note);
+    CHECK(removeProperty(card, second) == second);
+    deleteProperty(second);
+    CHECK(getPropertyByName(card, "NOTE") == note);
+    deleteCard(card);
+}
+
+/**
+ * Text to binary to text gives the same card, the encoding of full.vcf matches the
+ * stored golden file, and truncated or damaged encodings are rejected without reading
+ * past the buffer.
+ */
+static void testBinaryCardFormat(void)
+{
+    for (int i = 0; i < FORMAT_FIXTURES; i++)
+    {
+        Card *card = NULL;
+        if (!CHECK(createCard((char *)formatFixtures[i], &card) == OK))
+            continue;
+        size_t length = serializeCardBinary(card, NULL, 0);
+        char *encoding = malloc(length);
+        CHECK(length > 0 && serializeCardBinary(card, encoding, length) == length);
+        Card *decoded = NULL;
+        if (CHECK(createCardFromBinary(encoding, length, &decoded) == OK))
+        {
+            CHECK(sameCardText(card, decoded));
+            CardFingerprint fingerprint;
+            CHECK(cardFingerprint(decoded, &fingerprint) == OK && fingerprint.low == fixtureFingerprints[i].low &&
+                  fingerprint.high == fixtureFingerprints[i].high);
+            deleteCard(decoded);
+        }
+
+        // Every proper prefix is rejected, so a cut-off file never yields a card.
+        bool truncatedRejected = true;
+        for (size_t cut = 0; cut < length; cut++)
+        {
+            char *prefix = malloc(cut ? cut : 1);
+            memcpy(prefix, encoding, cut);
+            decoded = NULL;
+            truncatedRejected &= createCardFromBinary(prefix, cut, &decoded) == INV_CARD && !decoded;
+            free(prefix);
+        }
+        CHECK(truncatedRejected);
+
+        // A damaged byte either is rejected or still decodes to a Card; it never crashes.
+        bool damageHandled = true;
+        for (size_t at = 0; at < length; at++)
+        {
+            char *damaged = malloc(length);
+            memcpy(damaged, encoding, length);
+            damaged[at] ^= 0x5A;
+            decoded = NULL;
+            VCardErrorCode err = createCardFromBinary(damaged, length, &decoded);
+            damageHandled &= err == OK ? decoded != NULL : err == INV_CARD && !decoded;
+            deleteCard(decoded);
+            free(damaged);
+        }
+        CHECK(damageHandled);
+
+        char *damaged = malloc(length);
+        memcpy(damaged, encoding, length);
+        damaged[0] = 'X';
+        CHECK(createCardFromBinary(damaged, length, &decoded) == INV_CARD);
+        memcpy(damaged, encoding, length);
+        damaged[4] = CARD_BINARY_VERSION + 1;
+        CHECK(createCardFromBinary(damaged, length, &decoded) == INV_CARD);
+        free(damaged);
+
+        if (i == 0)
+        {
+            size_t goldenLength = 0;
+            char *golden = readWholeFile("testFiles/checks/full.vcrd", &goldenLength);
+            CHECK(golden && goldenLength == length && memcmp(golden, encoding, length) == 0);
+            free(golden);
+            decoded = NULL;
+            if (CHECK(readCardBinary("testFiles/checks/full.vcrd", &decoded) == OK))
+                CHECK(sameCardText(card, decoded));
+            deleteCard(decoded);
+        }
+        free(encoding);
+        deleteCard(card);
+    }
+}
+
+/**
+ * Fingerprints are fixed across releases and ignore the order and case of properties
+ * and parameters, while any change of content changes them.
+ */
+static void testFingerprintStability(void)
+{
+    for (int i = 0; i < FORMAT_FIXTURES; i++)
+    {
+        Card *card = NULL;
+        if (!CHECK(createCard((char *)formatFixtures[i], &card) == OK))
+            continue;
+        CardFingerprint fingerprint;
+        CHECK(cardFingerprint(card, &fingerprint) == OK && fingerprint.low == fixtureFingerprints[i].low &&
+              fingerprint.high == fixtureFingerprints[i].high);
+        CHECK(updateFN(card, "Jose Alvarez") == OK);
+        CHECK(cardFingerprint(card, &fingerprint) == OK && (fingerprint.low != fixtureFingerprints[i].low ||
+                                                            fingerprint.high != fixtureFingerprints[i].high));
+        deleteCard(card);
+    }
+}
+
+/**
+ * Summarizes the copied fixtures through a cache, loading every Card so that its
+ * encoding is cached too, and checks the results against uncached parsing.
+ * @param dirName The directory holding the cache.
+ * @param paths The copied fixtures.
+ * @return true if every result matched.
+ */
+static bool useCardCache(const char *dirName, char *paths[FORMAT_FIXTURES])
+{
+    CardCache *cache = openCardCache(dirName);
+    if (!cache)
+        return false;
+    CardSummary cached[FORMAT_FIXTURES], parsed[FORMAT_FIXTURES];
+    bool same = summarizeCardsCached(cache, (const char *const *)paths, FORMAT_FIXTURES, cached) == FORMAT_FIXTURES &&
+                summarizeCards((const char *const *)paths, FORMAT_FIXTURES, parsed) == FORMAT_FIXTURES &&
+                memcmp(cached, parsed, sizeof(cached)) == 0;
+    for (int i = 0; i < FORMAT_FIXTURES; i++)
+    {
+        Card *fromCache = NULL, *card = NULL;
+        same &= createCardCached(cache, paths[i], &fromCache) == OK && createCard(paths[i], &card) == OK &&
+                sameCardText(fromCache, card);
+        deleteCard(fromCache);
+        deleteCard(card);
+    }
+    same &= saveCardCache(cache) == OK;
+    closeCardCache(cache);
+    return same;
+}
+
+/**
+ * A saved cache answers unchanged files without being rewritten, and a truncated or
+ * damaged cache file is discarded and rebuilt to the same bytes.
+ * @param dirName A scratch directory.
+ */
+static void testCardCacheFile(const char *dirName)
+{
+    char *paths[FORMAT_FIXTURES];
+    copyFormatFixtures(dirName, paths);
+    char *cacheName = joinPath(dirName, ".vcparser-cache");
+    CHECK(useCardCache(dirName, paths));
+    size_t length = 0;
+    char *saved = readWholeFile(cacheName, &length);
+    if (CHECK(saved && length > 12))
+    {
+        CHECK(memcmp(saved, "VCPC", 4) == 0);
+
+        // An unchanged directory is served from the cache, which is then not rewritten.
+        struct stat before, after;
+        stat(cacheName, &before);
+        CHECK(useCardCache(dirName, paths));
+        stat(cacheName, &after);
+        CHECK(before.st_ino == after.st_ino);
+
+        size_t cuts[] = {0, 3, 8, 12, length / 2, length - 1};
+        for (size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++)
+        {
+            writeWholeFile(cacheName, saved, cuts[i]);
+            CHECK(useCardCache(dirName, paths));
+            size_t rebuiltLength = 0;
+            char *rebuilt = readWholeFile(cacheName, &rebuiltLength);
+            CHECK(rebuilt && rebuiltLength == length && memcmp(rebuilt, saved, length) == 0);
+            free(rebuilt);
+        }
+        // Damaged magic, version and entry count.
+        size_t offsets[] = {0, 4, 8};
+        for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++)
+        {
+            saved[offsets[i]] ^= 0x40;
+            writeWholeFile(cacheName, saved, length);
+            saved[offsets[i]] ^= 0x40;
+            CHECK(useCardCache(dirName, paths));
+            size_t rebuiltLength = 0;
+            char *rebuilt = readWholeFile(cacheName, &rebuiltLength);
+            CHECK(rebuilt && rebuiltLength == length && memcmp(rebuilt, saved, length) == 0);
+            free(rebuilt);
+        }
+    }
+    free(saved);
+    unlink(cacheName);
+    free(cacheName);
+    for (int i = 0; i < FORMAT_FIXTURES; i++)
+    {
+        unlink(paths[i]);
+        free(paths[i]);
+    }
+}
+
+static bool countIndexedCard(const IndexedCard *card, void *userData)
+{
+    (void)card;
+    (*(int *)userData)++;
+    return true;
+}
+
+static bool countTextMatch(const char *fileName, void *userData)
+{
+    (void)fileName;
+    (*(int *)userData)++;
+    return true;
+}
+
+/**
+ * Checks that every truncation of a file, and the given damage to it, is rejected when
+ * the file is opened.
+ * @param fileName The scratch file to write the damaged copies to.
+ * @param data The valid contents.
+ * @param length The length of the contents.
+ * @param offsets The offsets of the header fields to damage.
+ * @param offsetCount The number of offsets.
+ * @param opens Function opening the file and closing it again; returns whether it opened.
+ * @return true if every damaged copy was rejected.
+ */
+static bool damagedCopiesRejected(const char *fileName, char *data, size_t length, const size_t *offsets,
+                                  size_t offsetCount, bool (*opens)(const char *))
+{
+    bool rejected = true;
+    for (size_t cut = 0; cut < length; cut++)
+    {
+        writeWholeFile(fileName, data, cut);
+        rejected &= !opens(fileName);
+    }
+    for (size_t i = 0; i < offsetCount; i++)
+    {
+        data[offsets[i]] ^= 0x40;
+        writeWholeFile(fileName, data, length);
+        data[offsets[i]] ^= 0x40;
+        rejected &= !opens(fileName);
+    }
+    return rejected;
+}
+
+static bool opensCardIndex(const char *fileName)
+{
+    CardIndex *index = openCardIndex(fileName);
+    closeCardIndex(index);
+    return index != NULL;
+}
+
+static bool opensTextIndex(const char *fileName)
+{
+    CardTextIndex *index = openCardTextIndex(fileName);
+    closeCardTextIndex(index);
+    return index != NULL;
+}
+
+/**
+ * The contact index answers queries after a round trip through its file, rejects
+ * truncated files and damaged headers, and fails queries over damaged pages.
+ * @param dirName A scratch directory.
+ */
+static void testCardIndexFile(const char *dirName)
+{
+    char *indexName = joinPath(dirName, ".vcparser-index");
+    CardSummary summaries[FORMAT_FIXTURES];
+    CHECK(summarizeCards((const char *const *)formatFixtures, FORMAT_FIXTURES, summaries) == FORMAT_FIXTURES);
+    CHECK(writeCardIndex(indexName, (const char *const *)formatFixtures, summaries, FORMAT_FIXTURES) == OK);
+    CardIndex *index = openCardIndex(indexName);
+    if (!CHECK(index != NULL))
+    {
+        free(indexName);
+        return;
+    }
+    int found = 0;
+    CHECK(findCardsByName(index, "", countIndexedCard, &found) == FORMAT_FIXTURES && found == FORMAT_FIXTURES);
+    found = 0;
+    CHECK(findCardsByName(index, "jose", countIndexedCard, &found) == 2 && found == 2);
+    found = 0;
+    CHECK(findCardsByDate(index, BIRTHDAY_DATE, 6, 0, 31, countIndexedCard, &found) == 3 && found == 3);
+    closeCardIndex(index);
+
+    size_t length = 0;
+    char *saved = readWholeFile(indexName, &length);
+    // Magic, version, page size, page count, record count, both roots and string length.
+    size_t offsets[] = {0, 4, 8, 12, 16, 20, 24, 28, length - 1};
+    CHECK(damagedCopiesRejected(indexName, saved, length, offsets, sizeof(offsets) / sizeof(offsets[0]),
+                                opensCardIndex));
+
+    // Pages are checked when a query reaches them: damage to the first tree page fails it.
+    saved[4096] = 0x7F;
+    writeWholeFile(indexName, saved, length);
+    index = openCardIndex(indexName);
+    if (CHECK(index != NULL))
+    {
+        found = 0;
+        int results[2] = {findCardsByName(index, "", countIndexedCard, &found),
+                          findCardsByDate(index, BIRTHDAY_DATE, 6, 0, 31, countIndexedCard, &found)};
+        CHECK(results[0] == -1 || results[1] == -1);
+        closeCardIndex(index);
+    }
+    free(saved);
+    unlink(indexName);
+    free(indexName);
+}
+
+/**
+ * The text index gives the same answers before and after a round trip through its
+ * file, and rejects truncated files and damaged headers.
+ * @param dirName A scratch directory.
+ */
+static void testTextIndexFile(const char *dirName)
+{
+    char *indexName = joinPath(dirName, "text.index");
+    CardTextIndex *built = createCardTextIndex();
+    for (int i = 0; i < FORMAT_FIXTURES; i++)
+    {
+        Card *card = NULL;
+        if (CHECK(createCard((char *)formatFixtures[i], &card) == OK))
+            CHECK(addCardToTextIndex(built, formatFixtures[i], card) == OK);
+        deleteCard(card);
+    }
+    CHECK(writeCardTextIndex(built, indexName) == OK);
+    CardTextIndex *loaded = openCardTextIndex(indexName);
+    if (CHECK(loaded != NULL))
+    {
+        const char *queries[] = {"alv", "ÁLVAREZ", "example", "0123", "mei", "trains boats", "nobody"};
+        for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++)
+        {
+            int inMemory = 0, fromFile = 0;
+            CHECK(findCardsByText(built, queries[i], countTextMatch, &inMemory) ==
+                  findCardsByText(loaded, queries[i], countTextMatch, &fromFile));
+            CHECK(inMemory == fromFile);
+        }
+        int found = 0;
+        CHECK(findCardsByText(loaded, "alv", countTextMatch, &found) == 2);
+        closeCardTextIndex(loaded);
+    }
+    closeCardTextIndex(built);
+
+    size_t length = 0;
+    char *saved = readWholeFile(indexName, &length);
+    // Magic, version, every section count and the final NUL.
+    size_t offsets[] = {0, 4, 8, 12, 16, 20, 24, 28, length - 1};
+    CHECK(saved && damagedCopiesRejected(indexName, saved, length, offsets, sizeof(offsets) / sizeof(offsets[0]),
+                                         opensTextIndex));
+    free(saved);
+    unlink(indexName);
+    free(indexName);
+}
+
+int main(void)
+{
+    char dirName[] = "/tmp/vcchecksXXXXXX";
+    if (!mkdtemp(dirName))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+    testPropertyIndexInteriorEdit();
+    testBinaryCardFormat();
+    testFingerprintStability();
+    testCardCacheFile(dirName);
+    testCardIndexFile(dirName);
+    testTextIndexFile(dirName);
+    rmdir(dirName);
+    if (failures)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}